@@ -20,6 +20,10 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -27,6 +31,8 @@
 
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "gimp.h"
 #include "gimp-batch.h"
 #include "gimpparamspecs.h"
@@ -38,15 +44,56 @@
 
 
 #define BATCH_DEFAULT_EVAL_PROC   "plug-in-script-fu-eval"
+#define BATCH_INPUT_PLACEHOLDER   "{}"
+
+
+typedef struct
+{
+  const gchar  *prog;
+  const gchar **args;
+  const gchar **commands;
+  const gchar **inputs;
+  gint          next_input;
+  gint          n_running;
+  gint          n_jobs;
+  gint64        memory_limit;
+  gint          n_failed;
+  GMainLoop    *loop;
+} BatchQueue;
+
+typedef struct
+{
+  BatchQueue   *queue;
+  gint          index;
+  gint64        start_time;
+} BatchJob;
+
+
+static void      gimp_batch_exit_after_callback (Gimp          *gimp) G_GNUC_NORETURN;
 
+static gboolean  gimp_batch_run_cmd             (Gimp          *gimp,
+                                                 const gchar   *proc_name,
+                                                 GimpProcedure *procedure,
+                                                 GimpRunMode    run_mode,
+                                                 const gchar   *cmd);
 
-static void  gimp_batch_exit_after_callback (Gimp          *gimp) G_GNUC_NORETURN;
+static gchar   * gimp_batch_job_command         (const gchar   *cmd,
+                                                 const gchar   *input);
+static gboolean  gimp_batch_job_start           (BatchQueue    *queue);
+static void      gimp_batch_job_setup           (gpointer       data);
+static void      gimp_batch_job_exited          (GPid           pid,
+                                                 gint           status,
+                                                 BatchJob      *job);
+static void      gimp_batch_job_report          (BatchQueue    *queue,
+                                                 gint           index,
+                                                 gboolean       success,
+                                                 gint           exit_code,
+                                                 gint64         start_time);
 
-static void  gimp_batch_run_cmd             (Gimp          *gimp,
-                                             const gchar   *proc_name,
-                                             GimpProcedure *procedure,
-                                             GimpRunMode    run_mode,
-                                             const gchar   *cmd);
+
+/*  set when running as one job of gimp_batch_run_jobs()  */
+static gboolean batch_job    = FALSE;
+static gboolean batch_failed = FALSE;
 
 
 void
@@ -59,6 +106,24 @@ gimp_batch_run (Gimp         *gimp,
   if (! batch_commands || ! batch_commands[0])
     return;
 
+  if (g_getenv ("GIMP_BATCH_JOB"))
+    {
+      const gchar *memory = g_getenv ("GIMP_BATCH_JOB_MEMORY");
+
+      batch_job = TRUE;
+
+      /*  let GEGL swap before the job hits its memory limit  */
+      if (memory)
+        {
+          guint64 limit = g_ascii_strtoull (memory, NULL, 10);
+
+          if (limit > 0)
+            g_object_set (gimp->config,
+                          "tile-cache-size", limit / 2,
+                          NULL);
+        }
+    }
+
   exit_id = g_signal_connect_after (gimp, "exit",
                                     G_CALLBACK (gimp_batch_exit_after_callback),
                                     NULL);
@@ -87,11 +152,17 @@ gimp_batch_run (Gimp         *gimp,
                                                             proc_name);
 
       if (procedure)
-        gimp_batch_run_cmd (gimp, proc_name, procedure,
-                            GIMP_RUN_NONINTERACTIVE, NULL);
+        {
+          if (! gimp_batch_run_cmd (gimp, proc_name, procedure,
+                                    GIMP_RUN_NONINTERACTIVE, NULL))
+            batch_failed = TRUE;
+        }
       else
-        g_message (_("The batch interpreter '%s' is not available. "
-                     "Batch mode disabled."), proc_name);
+        {
+          g_message (_("The batch interpreter '%s' is not available. "
+                       "Batch mode disabled."), proc_name);
+          batch_failed = TRUE;
+        }
     }
   else
     {
@@ -103,19 +174,112 @@ gimp_batch_run (Gimp         *gimp,
           gint i;
 
           for (i = 0; batch_commands[i]; i++)
-            gimp_batch_run_cmd (gimp, batch_interpreter, eval_proc,
-                                GIMP_RUN_NONINTERACTIVE, batch_commands[i]);
+            {
+              if (! gimp_batch_run_cmd (gimp, batch_interpreter, eval_proc,
+                                        GIMP_RUN_NONINTERACTIVE,
+                                        batch_commands[i]))
+                {
+                  batch_failed = TRUE;
+
+                  /*  a job is done with its input when a command fails  */
+                  if (batch_job)
+                    break;
+                }
+            }
         }
       else
         {
           g_message (_("The batch interpreter '%s' is not available. "
                        "Batch mode disabled."), batch_interpreter);
+          batch_failed = TRUE;
         }
     }
 
+  /*  a job quits when done, its exit status tells how it went  */
+  if (batch_job)
+    gimp_batch_exit_after_callback (gimp);
+
   g_signal_handler_disconnect (gimp, exit_id);
 }
 
+/**
+ * gimp_batch_run_jobs:
+ * @prog:           the GIMP executable
+ * @args:           options to pass to each job
+ * @batch_commands: the batch commands to run for each input
+ * @inputs:         the inputs
+ * @n_jobs:         the number of jobs to run in parallel
+ * @memory_limit:   the memory limit of each job in bytes, or 0
+ *
+ * Runs @batch_commands once for each of @inputs, each time in a new
+ * non-interactive GIMP process, with "{}" in the commands replaced by
+ * the input.  Up to @n_jobs of these processes run at the same time.
+ *
+ * A line is printed on stdout when a job is done, with the tab
+ * separated input index, "ok" or "failed", the job's exit code, the
+ * time it took in seconds and the input.
+ *
+ * Return value: EXIT_SUCCESS if all jobs succeeded, EXIT_FAILURE
+ *               otherwise.
+ **/
+gint
+gimp_batch_run_jobs (const gchar  *prog,
+                     const gchar **args,
+                     const gchar **batch_commands,
+                     const gchar **inputs,
+                     gint          n_jobs,
+                     gint64        memory_limit)
+{
+  BatchQueue queue = { 0, };
+  gint       i;
+
+  g_return_val_if_fail (prog != NULL, EXIT_FAILURE);
+  g_return_val_if_fail (n_jobs > 0, EXIT_FAILURE);
+
+  if (! batch_commands || ! batch_commands[0] || ! inputs || ! inputs[0])
+    {
+      g_printerr (_("Batch jobs need batch commands and files to "
+                    "process.\n"));
+      return EXIT_FAILURE;
+    }
+
+  /*  the jobs would all read their commands from the same stdin  */
+  for (i = 0; batch_commands[i]; i++)
+    {
+      if (strcmp (batch_commands[i], "-") == 0)
+        {
+          g_printerr (_("Batch jobs can't read batch commands from "
+                        "stdin (\"-b -\").\n"));
+          return EXIT_FAILURE;
+        }
+    }
+
+#ifndef HAVE_SYS_RESOURCE_H
+  if (memory_limit > 0)
+    g_printerr (_("Memory limits of batch jobs are not supported on "
+                  "this platform.\n"));
+#endif
+
+  queue.prog         = prog;
+  queue.args         = args;
+  queue.commands     = batch_commands;
+  queue.inputs       = inputs;
+  queue.n_jobs       = n_jobs;
+  queue.memory_limit = memory_limit;
+  queue.loop         = g_main_loop_new (NULL, FALSE);
+
+  g_print ("# index\tstatus\texit-code\tseconds\tinput\n");
+
+  while (queue.n_running < queue.n_jobs && gimp_batch_job_start (&queue));
+
+  if (queue.n_running > 0)
+    g_main_loop_run (queue.loop);
+
+  g_main_loop_unref (queue.loop);
+
+  return queue.n_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 
 /*
  * The purpose of this handler is to exit GIMP cleanly when the batch
@@ -131,10 +295,13 @@ gimp_batch_exit_after_callback (Gimp *gimp)
 
   gegl_exit ();
 
+  if (batch_job && batch_failed)
+    exit (EXIT_FAILURE);
+
   exit (EXIT_SUCCESS);
 }
 
-static void
+static gboolean
 gimp_batch_run_cmd (Gimp          *gimp,
                     const gchar   *proc_name,
                     GimpProcedure *procedure,
@@ -143,8 +310,9 @@ gimp_batch_run_cmd (Gimp          *gimp,
 {
   GimpValueArray *args;
   GimpValueArray *return_vals;
-  GError         *error = NULL;
-  gint            i     = 0;
+  GError         *error   = NULL;
+  gboolean        success = FALSE;
+  gint            i       = 0;
 
   args = gimp_procedure_get_arguments (procedure);
 
@@ -190,6 +358,7 @@ gimp_batch_run_cmd (Gimp          *gimp,
 
     case GIMP_PDB_SUCCESS:
       g_printerr ("batch command executed successfully\n");
+      success = TRUE;
       break;
     }
 
@@ -199,5 +368,194 @@ gimp_batch_run_cmd (Gimp          *gimp,
   if (error)
     g_error_free (error);
 
-  return;
+  return success;
+}
+
+static gchar *
+gimp_batch_job_command (const gchar *cmd,
+                        const gchar *input)
+{
+  GString     *str = g_string_new (NULL);
+  const gchar *p;
+
+  /*  the input ends up in a string literal, escape it like one  */
+  while ((p = strstr (cmd, BATCH_INPUT_PLACEHOLDER)))
+    {
+      const gchar *c;
+
+      g_string_append_len (str, cmd, p - cmd);
+
+      for (c = input; *c; c++)
+        {
+          if (*c == '"' || *c == '\\')
+            g_string_append_c (str, '\\');
+
+          g_string_append_c (str, *c);
+        }
+
+      cmd = p + strlen (BATCH_INPUT_PLACEHOLDER);
+    }
+
+  g_string_append (str, cmd);
+
+  return g_string_free (str, FALSE);
+}
+
+static gboolean
+gimp_batch_job_start (BatchQueue *queue)
+{
+  BatchJob   *job;
+  GPtrArray  *argv;
+  gchar     **envp;
+  gchar      *index;
+  GPid        pid;
+  GError     *error = NULL;
+  gint        i;
+
+  if (! queue->inputs[queue->next_input])
+    return FALSE;
+
+  job = g_slice_new0 (BatchJob);
+
+  job->queue      = queue;
+  job->index      = queue->next_input++;
+  job->start_time = g_get_monotonic_time ();
+
+  argv = g_ptr_array_new_with_free_func (g_free);
+
+  g_ptr_array_add (argv, g_strdup (queue->prog));
+
+  for (i = 0; queue->args && queue->args[i]; i++)
+    g_ptr_array_add (argv, g_strdup (queue->args[i]));
+
+  for (i = 0; queue->commands[i]; i++)
+    {
+      g_ptr_array_add (argv, g_strdup ("-b"));
+      g_ptr_array_add (argv,
+                       gimp_batch_job_command (queue->commands[i],
+                                               queue->inputs[job->index]));
+    }
+
+  g_ptr_array_add (argv, NULL);
+
+  index = g_strdup_printf ("%d", job->index);
+
+  envp = g_get_environ ();
+  envp = g_environ_setenv (envp, "GIMP_BATCH_JOB", index, TRUE);
+
+  if (queue->memory_limit > 0)
+    {
+      gchar *memory = g_strdup_printf ("%" G_GINT64_FORMAT,
+                                       queue->memory_limit);
+
+      envp = g_environ_setenv (envp, "GIMP_BATCH_JOB_MEMORY", memory, TRUE);
+
+      g_free (memory);
+    }
+
+  g_free (index);
+
+  /*  stdout is reserved for the job reports  */
+  if (g_spawn_async (NULL, (gchar **) argv->pdata, envp,
+                     G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH |
+                     G_SPAWN_STDOUT_TO_DEV_NULL,
+                     gimp_batch_job_setup, &queue->memory_limit,
+                     &pid, &error))
+    {
+      queue->n_running++;
+
+      g_child_watch_add (pid, (GChildWatchFunc) gimp_batch_job_exited, job);
+    }
+  else
+    {
+      g_printerr ("batch job %d could not be started: %s\n",
+                  job->index, error->message);
+      g_clear_error (&error);
+
+      gimp_batch_job_report (queue, job->index, FALSE, -1, job->start_time);
+
+      g_slice_free (BatchJob, job);
+    }
+
+  g_strfreev (envp);
+  g_ptr_array_free (argv, TRUE);
+
+  return TRUE;
+}
+
+/*  runs in the job's process, before it executes GIMP  */
+static void
+gimp_batch_job_setup (gpointer data)
+{
+#ifdef HAVE_SYS_RESOURCE_H
+  const gint64 *memory_limit = data;
+
+  if (*memory_limit > 0)
+    {
+      struct rlimit limit;
+
+      limit.rlim_cur = *memory_limit;
+      limit.rlim_max = *memory_limit;
+
+      setrlimit (RLIMIT_DATA, &limit);
+    }
+#endif
+}
+
+static void
+gimp_batch_job_exited (GPid      pid,
+                       gint      status,
+                       BatchJob *job)
+{
+  BatchQueue *queue     = job->queue;
+  GError     *error     = NULL;
+  gboolean    success;
+  gint        exit_code = -1;
+
+  success = g_spawn_check_exit_status (status, &error);
+
+  if (success)
+    {
+      exit_code = 0;
+    }
+  else if (error->domain == G_SPAWN_EXIT_ERROR)
+    {
+      exit_code = error->code;
+    }
+
+  g_clear_error (&error);
+  g_spawn_close_pid (pid);
+
+  gimp_batch_job_report (queue, job->index, success, exit_code,
+                         job->start_time);
+
+  g_slice_free (BatchJob, job);
+
+  queue->n_running--;
+
+  while (queue->n_running < queue->n_jobs && gimp_batch_job_start (queue));
+
+  if (queue->n_running == 0)
+    g_main_loop_quit (queue->loop);
+}
+
+static void
+gimp_batch_job_report (BatchQueue *queue,
+                       gint        index,
+                       gboolean    success,
+                       gint        exit_code,
+                       gint64      start_time)
+{
+  gdouble seconds = (g_get_monotonic_time () - start_time) / 1000000.0;
+  gchar   buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  if (! success)
+    queue->n_failed++;
+
+  /*  locale independent, this is meant to be parsed  */
+  g_ascii_formatd (buf, sizeof (buf), "%.3f", seconds);
+
+  g_print ("%d\t%s\t%d\t%s\t%s\n",
+           index, success ? "ok" : "failed", exit_code, buf,
+           queue->inputs[index]);
 }
@@ -19,9 +19,16 @@
 #define __GIMP_BATCH_H__
 
 
-void   gimp_batch_run (Gimp         *gimp,
-                       const gchar  *batch_interpreter,
-                       const gchar **batch_commands);
+void   gimp_batch_run      (Gimp         *gimp,
+                            const gchar  *batch_interpreter,
+                            const gchar **batch_commands);
+
+gint   gimp_batch_run_jobs (const gchar  *prog,
+                            const gchar **args,
+                            const gchar **batch_commands,
+                            const gchar **inputs,
+                            gint          n_jobs,
+                            gint64        memory_limit);
 
 
 #endif /* __GIMP_BATCH_H__ */
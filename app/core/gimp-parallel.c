@@ -0,0 +1,256 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-parallel.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "gimp-parallel.h"
+
+
+#define GIMP_PARALLEL_MAX_THREADS 64
+
+
+typedef struct
+{
+  GimpParallelDistributeFunc  func;
+  gpointer                    user_data;
+  gint                        n;
+
+  GMutex                      mutex;
+  GCond                       cond;
+  gint                        n_remaining;
+} GimpParallelDistributeData;
+
+typedef struct
+{
+  GimpParallelDistributeData *data;
+  gint                        i;
+} GimpParallelDistributeTask;
+
+typedef struct
+{
+  GimpParallelDistributeRangeFunc  func;
+  gpointer                         user_data;
+  gint                             size;
+} GimpParallelDistributeRangeData;
+
+
+/*  local function prototypes  */
+
+static void   gimp_parallel_init                (void);
+static void   gimp_parallel_notify_threads      (GeglConfig                      *config);
+static void   gimp_parallel_task_run            (GimpParallelDistributeTask      *task,
+                                                 gpointer                         data);
+static void   gimp_parallel_distribute_range_func
+                                                (gint                             i,
+                                                 gint                             n,
+                                                 GimpParallelDistributeRangeData *data);
+
+
+/*  local variables  */
+
+static GThreadPool *gimp_parallel_pool      = NULL;
+static gint         gimp_parallel_n_threads = 1;
+
+/*  set in the pool's threads, which must not wait for the pool  */
+static GPrivate     gimp_parallel_worker    = G_PRIVATE_INIT (NULL);
+
+
+/*  public functions  */
+
+/*  Calls @func (i, n, @user_data) for i = 0 .. n - 1, with n being at
+ *  most @max_n and the number of threads GEGL is configured to use.
+ *  The calls run concurrently, the first one on the calling thread;
+ *  returns when all of them are done.
+ */
+void
+gimp_parallel_distribute (gint                       max_n,
+                          GimpParallelDistributeFunc func,
+                          gpointer                   user_data)
+{
+  GimpParallelDistributeData data;
+  GimpParallelDistributeTask tasks[GIMP_PARALLEL_MAX_THREADS];
+  gint                       n;
+  gint                       i;
+
+  g_return_if_fail (func != NULL);
+
+  gimp_parallel_init ();
+
+  n = MIN (max_n, g_atomic_int_get (&gimp_parallel_n_threads));
+
+  /*  nested calls from a pool thread run serially, waiting for tasks
+   *  queued behind ourselves could deadlock
+   */
+  if (n <= 1 || g_private_get (&gimp_parallel_worker))
+    {
+      func (0, 1, user_data);
+
+      return;
+    }
+
+  data.func        = func;
+  data.user_data   = user_data;
+  data.n           = n;
+  data.n_remaining = n - 1;
+
+  g_mutex_init (&data.mutex);
+  g_cond_init (&data.cond);
+
+  for (i = 1; i < n; i++)
+    {
+      tasks[i].data = &data;
+      tasks[i].i    = i;
+
+      g_thread_pool_push (gimp_parallel_pool, &tasks[i], NULL);
+    }
+
+  func (0, n, user_data);
+
+  g_mutex_lock (&data.mutex);
+
+  while (data.n_remaining > 0)
+    g_cond_wait (&data.cond, &data.mutex);
+
+  g_mutex_unlock (&data.mutex);
+
+  g_cond_clear (&data.cond);
+  g_mutex_clear (&data.mutex);
+}
+
+/*  Splits [0, @size) into consecutive ranges of at least @min_sub_size
+ *  elements, one per thread, and calls @func (offset, size, @user_data)
+ *  for each of them like gimp_parallel_distribute().
+ */
+void
+gimp_parallel_distribute_range (gint                            size,
+                                gint                            min_sub_size,
+                                GimpParallelDistributeRangeFunc func,
+                                gpointer                        user_data)
+{
+  GimpParallelDistributeRangeData data;
+  gint                            max_n;
+
+  g_return_if_fail (size >= 0);
+  g_return_if_fail (func != NULL);
+
+  if (size == 0)
+    return;
+
+  max_n = size / MAX (min_sub_size, 1);
+
+  data.func      = func;
+  data.user_data = user_data;
+  data.size      = size;
+
+  gimp_parallel_distribute (MAX (max_n, 1),
+                            (GimpParallelDistributeFunc)
+                            gimp_parallel_distribute_range_func,
+                            &data);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_parallel_init (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      GeglConfig *config = gegl_config ();
+
+      /*  the pool's threads are kept around, so there is no cost of
+       *  creating threads for every call
+       */
+      gimp_parallel_notify_threads (config);
+
+      g_signal_connect (config, "notify::threads",
+                        G_CALLBACK (gimp_parallel_notify_threads),
+                        NULL);
+
+      g_once_init_leave (&initialized, 1);
+    }
+}
+
+static void
+gimp_parallel_notify_threads (GeglConfig *config)
+{
+  gint n_threads;
+
+  g_object_get (config,
+                "threads", &n_threads,
+                NULL);
+
+  n_threads = CLAMP (n_threads, 1, GIMP_PARALLEL_MAX_THREADS);
+
+  /*  the calling thread does one part of the work itself  */
+  if (n_threads > 1)
+    {
+      if (! gimp_parallel_pool)
+        {
+          gimp_parallel_pool = g_thread_pool_new ((GFunc) gimp_parallel_task_run,
+                                                  NULL,
+                                                  n_threads - 1, TRUE,
+                                                  NULL);
+        }
+      else
+        {
+          g_thread_pool_set_max_threads (gimp_parallel_pool,
+                                         n_threads - 1, NULL);
+        }
+    }
+
+  g_atomic_int_set (&gimp_parallel_n_threads, n_threads);
+}
+
+static void
+gimp_parallel_task_run (GimpParallelDistributeTask *task,
+                        gpointer                    data)
+{
+  GimpParallelDistributeData *distribute_data = task->data;
+
+  g_private_set (&gimp_parallel_worker, GINT_TO_POINTER (TRUE));
+
+  distribute_data->func (task->i, distribute_data->n,
+                         distribute_data->user_data);
+
+  /*  signal while holding the lock, the data lives on the stack of the
+   *  waiting thread
+   */
+  g_mutex_lock (&distribute_data->mutex);
+
+  if (--distribute_data->n_remaining == 0)
+    g_cond_signal (&distribute_data->cond);
+
+  g_mutex_unlock (&distribute_data->mutex);
+}
+
+static void
+gimp_parallel_distribute_range_func (gint                             i,
+                                     gint                             n,
+                                     GimpParallelDistributeRangeData *data)
+{
+  gint offset = (gint64) data->size * i       / n;
+  gint end    = (gint64) data->size * (i + 1) / n;
+
+  data->func (offset, end - offset, data->user_data);
+}
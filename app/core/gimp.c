@@ -59,6 +59,7 @@
 #include "gimpcontext.h"
 #include "gimpdynamics.h"
 #include "gimpdocumentlist.h"
+#include "gimpdrawable-preview.h"
 #include "gimpgradient.h"
 #include "gimpidtable.h"
 #include "gimpimage.h"
@@ -629,6 +630,9 @@ gimp_real_exit (Gimp     *gimp,
   if (gimp->be_verbose)
     g_print ("EXIT: %s\n", G_STRFUNC);
 
+  gimp_imagefile_flush_thumbnails ();
+  gimp_drawable_preview_exit ();
+
   gimp_plug_in_manager_exit (gimp->plug_in_manager);
   gimp_modules_unload (gimp);
 
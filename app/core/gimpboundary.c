@@ -91,6 +91,19 @@ static void           make_horiz_segs          (GimpBoundary        *boundary,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
+static void           fill_row_mask            (guchar              *mask,
+                                                gint                 width,
+                                                const gint          *empty,
+                                                gint                 num_empty);
+static void           seed_vert_segs           (GimpBoundary        *boundary,
+                                                const GeglRectangle *region,
+                                                gint                 scanline,
+                                                gint                 num_empty_l,
+                                                gint                 num_empty_c);
+static void           close_vert_segs          (GimpBoundary        *boundary,
+                                                const GeglRectangle *region,
+                                                gint                 scanline,
+                                                gint                 num_empty_l);
 static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 const GeglRectangle *region,
                                                 const Babl          *format,
@@ -99,7 +112,9 @@ static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 gint                 y1,
                                                 gint                 x2,
                                                 gint                 y2,
-                                                gfloat               threshold);
+                                                gfloat               threshold,
+                                                gint                 band_start,
+                                                gint                 band_end);
 
 static gint       cmp_segptr_xy1_addr     (const GimpBoundSeg **seg_ptr_a,
                                            const GimpBoundSeg **seg_ptr_b);
@@ -184,7 +199,74 @@ gimp_boundary_find (GeglBuffer          *buffer,
     }
 
   boundary = generate_boundary (buffer, &rect, format, type,
-                                x1, y1, x2, y2, threshold);
+                                x1, y1, x2, y2, threshold,
+                                G_MININT, G_MAXINT);
+
+  *num_segs = boundary->num_segs;
+
+  return gimp_boundary_free (boundary, FALSE);
+}
+
+/**
+ * gimp_boundary_find_rows:
+ * @buffer:    a #GeglBuffer
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        botton side of bounds
+ * @threshold: pixel value of boundary line
+ * @row:       first scanline of the band
+ * @n_rows:    number of scanlines in the band
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but only returns the segments belonging
+ * to the scanlines @row to @row + @n_rows - 1. Vertical segments
+ * which cross the band's top or bottom edge are cut there, so the
+ * results of adjacent bands can simply be concatenated to get the
+ * complete boundary, and a band can be recomputed on its own when
+ * only its part of @buffer changed.
+ *
+ * Return value: the boundary array.
+ **/
+GimpBoundSeg *
+gimp_boundary_find_rows (GeglBuffer          *buffer,
+                         const GeglRectangle *region,
+                         const Babl          *format,
+                         GimpBoundaryType     type,
+                         gint                 x1,
+                         gint                 y1,
+                         gint                 x2,
+                         gint                 y2,
+                         gfloat               threshold,
+                         gint                 row,
+                         gint                 n_rows,
+                         gint                *num_segs)
+{
+  GimpBoundary  *boundary;
+  GeglRectangle  rect = { 0, };
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (babl_format_get_bytes_per_pixel (format) ==
+                        sizeof (gfloat), NULL);
+  g_return_val_if_fail (n_rows >= 0, NULL);
+
+  if (region)
+    {
+      rect = *region;
+    }
+  else
+    {
+      rect.width  = gegl_buffer_get_width  (buffer);
+      rect.height = gegl_buffer_get_height (buffer);
+    }
+
+  boundary = generate_boundary (buffer, &rect, format, type,
+                                x1, y1, x2, y2, threshold,
+                                row, row + n_rows);
 
   *num_segs = boundary->num_segs;
 
@@ -612,9 +694,13 @@ process_horiz_seg (GimpBoundary *boundary,
   /*  This procedure accounts for any vertical segments that must be
       drawn to close in the horizontal segments.                     */
 
+  /*  A vertical segment seeded at the top of a band can be closed
+      right away, don't add an empty segment for it.                 */
+
   if (boundary->vert_segs[x1] >= 0)
     {
-      gimp_boundary_add_seg (boundary, x1, boundary->vert_segs[x1], x1, y1, !open);
+      if (boundary->vert_segs[x1] != y1)
+        gimp_boundary_add_seg (boundary, x1, boundary->vert_segs[x1], x1, y1, !open);
       boundary->vert_segs[x1] = -1;
     }
   else
@@ -622,7 +708,8 @@ process_horiz_seg (GimpBoundary *boundary,
 
   if (boundary->vert_segs[x2] >= 0)
     {
-      gimp_boundary_add_seg (boundary, x2, boundary->vert_segs[x2], x2, y2, open);
+      if (boundary->vert_segs[x2] != y2)
+        gimp_boundary_add_seg (boundary, x2, boundary->vert_segs[x2], x2, y2, open);
       boundary->vert_segs[x2] = -1;
     }
   else
@@ -663,6 +750,96 @@ make_horiz_segs (GimpBoundary *boundary,
     }
 }
 
+static void
+fill_row_mask (guchar     *mask,
+               gint        width,
+               const gint *empty,
+               gint        num_empty)
+{
+  gint i;
+
+  /*  mask[x + 1] is set for each pixel x inside a non-empty segment,
+   *  mask[0] and mask[width + 1] stand for the pixels off either end
+   */
+  memset (mask, 0, width + 2);
+
+  for (i = 1; i < num_empty - 1; i += 2)
+    {
+      gint start = CLAMP (empty[i],     0, width);
+      gint end   = CLAMP (empty[i + 1], 0, width);
+
+      if (end > start)
+        memset (mask + start + 1, 1, end - start);
+    }
+}
+
+static void
+seed_vert_segs (GimpBoundary        *boundary,
+                const GeglRectangle *region,
+                gint                 scanline,
+                gint                 num_empty_l,
+                gint                 num_empty_c)
+{
+  gint    width = region->x + region->width;
+  guchar *above = g_new (guchar, width + 2);
+  guchar *below = g_new (guchar, width + 2);
+  gint    x;
+
+  fill_row_mask (above, width, boundary->empty_segs_l, num_empty_l);
+  fill_row_mask (below, width, boundary->empty_segs_c, num_empty_c);
+
+  /*  Reconstruct the vertical segments which are still open when
+   *  generate_boundary() reaches @scanline without starting at the
+   *  top: one is open at x if the previous scanline has a vertical
+   *  edge there, toggled by each horizontal segment of the previous
+   *  scanline ending at x on @scanline.
+   */
+  for (x = 0; x <= width; x++)
+    {
+      gboolean a = above[x];
+      gboolean b = above[x + 1];
+      gboolean c = below[x];
+      gboolean d = below[x + 1];
+
+      if ((a != b) ^ (a && ! c) ^ (b && ! d))
+        boundary->vert_segs[x] = scanline;
+      else
+        boundary->vert_segs[x] = -1;
+    }
+
+  g_free (above);
+  g_free (below);
+}
+
+static void
+close_vert_segs (GimpBoundary        *boundary,
+                 const GeglRectangle *region,
+                 gint                 scanline,
+                 gint                 num_empty_l)
+{
+  gint    width = region->x + region->width;
+  guchar *above = g_new (guchar, width + 2);
+  gint    x;
+
+  fill_row_mask (above, width, boundary->empty_segs_l, num_empty_l);
+
+  /*  Cut the vertical segments still open at the bottom of a band.
+   *  Like all vertical segments, they are open if the inside is on
+   *  their right.
+   */
+  for (x = 0; x <= width; x++)
+    {
+      if (boundary->vert_segs[x] >= 0 && boundary->vert_segs[x] < scanline)
+        gimp_boundary_add_seg (boundary,
+                               x, boundary->vert_segs[x], x, scanline,
+                               above[x + 1]);
+
+      boundary->vert_segs[x] = -1;
+    }
+
+  g_free (above);
+}
+
 static GimpBoundary *
 generate_boundary (GeglBuffer          *buffer,
                    const GeglRectangle *region,
@@ -672,7 +849,9 @@ generate_boundary (GeglBuffer          *buffer,
                    gint                 y1,
                    gint                 x2,
                    gint                 y2,
-                   gfloat               threshold)
+                   gfloat               threshold,
+                   gint                 band_start,
+                   gint                 band_end)
 {
   GimpBoundary  *boundary;
   GeglRectangle  line_rect = { 0, };
@@ -707,25 +886,50 @@ generate_boundary (GeglBuffer          *buffer,
       end   = region->y + region->height;
     }
 
+  band_start = MAX (band_start, start);
+  band_end   = MIN (band_end,   end);
+
+  if (band_start >= band_end)
+    return boundary;
+
   /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
-                   start - 1, boundary->empty_segs_l,
-                   boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
+  if (band_start > start)
+    {
+      line_rect.y = band_start - 1;
+      gegl_buffer_get (buffer, &line_rect, 1.0, format,
+                       line_data, GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
 
-  line_rect.y = start;
+      find_empty_segs (region, line_data,
+                       band_start - 1, boundary->empty_segs_l,
+                       boundary->max_empty_segs, &num_empty_l,
+                       type, x1, y1, x2, y2,
+                       threshold);
+    }
+  else
+    {
+      find_empty_segs (region, NULL,
+                       band_start - 1, boundary->empty_segs_l,
+                       boundary->max_empty_segs, &num_empty_l,
+                       type, x1, y1, x2, y2,
+                       threshold);
+    }
+
+  line_rect.y = band_start;
   gegl_buffer_get (buffer, &line_rect, 1.0, format,
                    line_data, GEGL_AUTO_ROWSTRIDE,
                    GEGL_ABYSS_NONE);
 
   find_empty_segs (region, line_data,
-                   start, boundary->empty_segs_c,
+                   band_start, boundary->empty_segs_c,
                    boundary->max_empty_segs, &num_empty_c,
                    type, x1, y1, x2, y2,
                    threshold);
 
-  for (scanline = start; scanline < end; scanline++)
+  if (band_start > start)
+    seed_vert_segs (boundary, region, band_start, num_empty_l, num_empty_c);
+
+  for (scanline = band_start; scanline < band_end; scanline++)
     {
       /*  find the empty segment list for the next scanline  */
       line_rect.y = scanline + 1;
@@ -766,6 +970,9 @@ generate_boundary (GeglBuffer          *buffer,
       boundary->empty_segs_n = tmp_segs;
     }
 
+  if (band_end < end)
+    close_vert_segs (boundary, region, band_end, num_empty_l);
+
   return boundary;
 }
 
@@ -94,6 +94,9 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
 
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
+static GimpTempBuf * gimp_brush_apply_operation       (const GimpTempBuf    *src,
+                                                       GeglNode             *op);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpBrush, gimp_brush, GIMP_TYPE_DATA,
                          G_IMPLEMENT_INTERFACE (GIMP_TYPE_TAGGED,
@@ -539,6 +542,46 @@ gimp_brush_get_checksum (GimpTagged *tagged)
   return checksum_string;
 }
 
+static GimpTempBuf *
+gimp_brush_apply_operation (const GimpTempBuf *src,
+                            GeglNode          *op)
+{
+  GimpTempBuf *dest;
+  GeglNode    *graph, *source, *target;
+  GeglBuffer  *src_buffer;
+  GeglBuffer  *dest_buffer;
+
+  /*  src is owned by the cache, the result goes to a copy  */
+  dest = gimp_temp_buf_copy (src);
+
+  src_buffer  = gimp_temp_buf_create_buffer ((GimpTempBuf *) src);
+  dest_buffer = gimp_temp_buf_create_buffer (dest);
+
+  graph  = gegl_node_new ();
+  source = gegl_node_new_child (graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer", src_buffer,
+                                NULL);
+  gegl_node_add_child (graph, op);
+  target = gegl_node_new_child (graph,
+                                "operation", "gegl:write-buffer",
+                                "buffer", dest_buffer,
+                                NULL);
+
+  gegl_node_link_many (source, op, target, NULL);
+  gegl_node_blit (target, 1.0,
+                  GEGL_RECTANGLE (0, 0,
+                                  gegl_buffer_get_width (dest_buffer),
+                                  gegl_buffer_get_height (dest_buffer)),
+                  NULL, NULL, 0, GEGL_BLIT_DEFAULT);
+
+  g_object_unref (graph);
+  g_object_unref (src_buffer);
+  g_object_unref (dest_buffer);
+
+  return dest;
+}
+
 /*  public functions  */
 
 GimpData *
@@ -700,38 +743,26 @@ gimp_brush_transform_mask (GimpBrush *brush,
         }
 #endif
 
-      mask = GIMP_BRUSH_GET_CLASS (brush)->transform_mask (brush,
-                                                           scale,
-                                                           aspect_ratio,
-                                                           angle,
-                                                           effective_hardness);
-
       if (op)
         {
-          GeglNode   *graph, *source, *target;
-          GeglBuffer *buffer = gimp_temp_buf_create_buffer ((GimpTempBuf *) mask);
-
-          graph  = gegl_node_new ();
-          source = gegl_node_new_child (graph,
-                                        "operation", "gegl:buffer-source",
-                                        "buffer", buffer,
-                                        NULL);
-          gegl_node_add_child (graph, op);
-          target = gegl_node_new_child (graph,
-                                        "operation", "gegl:write-buffer",
-                                        "buffer", buffer,
-                                        NULL);
-
-          gegl_node_link_many (source, op, target, NULL);
-          gegl_node_blit (target, 1.0,
-                          GEGL_RECTANGLE (0, 0,
-                                          gegl_buffer_get_width (buffer),
-                                          gegl_buffer_get_height (buffer)),
-                          NULL, NULL, 0, GEGL_BLIT_DEFAULT);
-
-
-          g_object_unref (graph);
-          g_object_unref (buffer);
+          /*  all transformed variants of a dab, like the strokes of a
+           *  symmetry, are made from the same untransformed mask
+           */
+          mask = gimp_brush_apply_operation (gimp_brush_transform_mask (brush,
+                                                                        NULL,
+                                                                        scale,
+                                                                        aspect_ratio,
+                                                                        angle,
+                                                                        hardness),
+                                             op);
+        }
+      else
+        {
+          mask = GIMP_BRUSH_GET_CLASS (brush)->transform_mask (brush,
+                                                               scale,
+                                                               aspect_ratio,
+                                                               angle,
+                                                               effective_hardness);
         }
 
       gimp_brush_cache_add (brush->priv->mask_cache,
@@ -789,37 +820,23 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
       }
 #endif
 
-      pixmap = GIMP_BRUSH_GET_CLASS (brush)->transform_pixmap (brush,
-                                                               scale,
-                                                               aspect_ratio,
-                                                               angle,
-                                                               effective_hardness);
-
       if (op)
         {
-          GeglNode   *graph, *source, *target;
-          GeglBuffer *buffer = gimp_temp_buf_create_buffer ((GimpTempBuf *) pixmap);
-
-          graph  = gegl_node_new ();
-          source = gegl_node_new_child (graph,
-                                        "operation", "gegl:buffer-source",
-                                        "buffer", buffer,
-                                        NULL);
-          gegl_node_add_child (graph, op);
-          target = gegl_node_new_child (graph,
-                                        "operation", "gegl:write-buffer",
-                                        "buffer", buffer,
-                                        NULL);
-
-          gegl_node_link_many (source, op, target, NULL);
-          gegl_node_blit (target, 1.0,
-                          GEGL_RECTANGLE (0, 0,
-                                          gegl_buffer_get_width (buffer),
-                                          gegl_buffer_get_height (buffer)),
-                          NULL, NULL, 0, GEGL_BLIT_DEFAULT);
-
-          g_object_unref (graph);
-          g_object_unref (buffer);
+          pixmap = gimp_brush_apply_operation (gimp_brush_transform_pixmap (brush,
+                                                                            NULL,
+                                                                            scale,
+                                                                            aspect_ratio,
+                                                                            angle,
+                                                                            hardness),
+                                               op);
+        }
+      else
+        {
+          pixmap = GIMP_BRUSH_GET_CLASS (brush)->transform_pixmap (brush,
+                                                                   scale,
+                                                                   aspect_ratio,
+                                                                   angle,
+                                                                   effective_hardness);
         }
 
       gimp_brush_cache_add (brush->priv->pixmap_cache,
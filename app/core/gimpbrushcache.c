@@ -30,7 +30,8 @@
 #include "gimp-intl.h"
 
 
-#define MAX_CACHED_DATA 20
+#define MAX_CACHED_DATA  20
+#define MAX_CACHED_UNITS 256
 
 
 enum
@@ -258,8 +259,10 @@ gimp_brush_cache_add (GimpBrushCache *cache,
 {
   GList              *iter;
   GimpBrushCacheUnit *unit;
-  GList              *last   = NULL;
-  gint                length = 0;
+  GList              *last      = NULL;
+  GList              *last_op   = NULL;
+  gint                length    = 0;
+  gint                length_op = 0;
 
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
@@ -273,9 +276,23 @@ gimp_brush_cache_add (GimpBrushCache *cache,
 
       length++;
       last = iter;
+
+      if (unit->op == op)
+        {
+          length_op++;
+          last_op = iter;
+        }
     }
 
-  if (length > MAX_CACHED_DATA)
+  /*  every transformation gets its own share of the cache, so painting
+   *  with many symmetry strokes doesn't keep evicting their brushes
+   */
+  if (length_op > MAX_CACHED_DATA)
+    last = last_op;
+  else if (length <= MAX_CACHED_UNITS)
+    last = NULL;
+
+  if (last)
     {
       unit = last->data;
 
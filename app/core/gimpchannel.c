@@ -57,6 +57,22 @@
 #include "gimp-intl.h"
 
 
+/*  the selection boundary is cached in bands of this many rows, so
+ *  that only the bands touched by an update need to be recomputed
+ */
+#define BOUNDARY_BAND_HEIGHT 64
+
+
+typedef struct
+{
+  GimpBoundSeg *segs_in;
+  GimpBoundSeg *segs_out;
+  gint          num_segs_in;
+  gint          num_segs_out;
+  gboolean      valid;
+} GimpChannelBoundaryBand;
+
+
 enum
 {
   COLOR_CHANGED,
@@ -152,6 +168,11 @@ static void       gimp_channel_convert_type  (GimpDrawable      *drawable,
                                               gboolean           push_undo,
                                               GimpProgress      *progress);
 static void gimp_channel_invalidate_boundary   (GimpDrawable       *drawable);
+static void gimp_channel_update                (GimpDrawable       *drawable,
+                                                gint                x,
+                                                gint                y,
+                                                gint                width,
+                                                gint                height);
 static void gimp_channel_get_active_components (GimpDrawable       *drawable,
                                                 gboolean           *active);
 static GimpComponentMask
@@ -236,6 +257,11 @@ static void       gimp_channel_real_shrink   (GimpChannel         *channel,
 static void       gimp_channel_real_flood    (GimpChannel         *channel,
                                               gboolean             push_undo);
 
+static void       gimp_channel_free_boundary_bands
+                                             (GimpChannel         *channel);
+static void       gimp_channel_boundary_band_clear
+                                             (GimpChannelBoundaryBand *band);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpChannel, gimp_channel, GIMP_TYPE_DRAWABLE,
                          G_IMPLEMENT_INTERFACE (GIMP_TYPE_PICKABLE,
@@ -309,6 +335,7 @@ gimp_channel_class_init (GimpChannelClass *klass)
 
   drawable_class->convert_type          = gimp_channel_convert_type;
   drawable_class->invalidate_boundary   = gimp_channel_invalidate_boundary;
+  drawable_class->update                = gimp_channel_update;
   drawable_class->get_active_components = gimp_channel_get_active_components;
   drawable_class->get_active_mask       = gimp_channel_get_active_mask;
   drawable_class->apply_buffer          = gimp_channel_apply_buffer;
@@ -352,6 +379,7 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->boundary_bands = NULL;
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -383,6 +411,8 @@ gimp_channel_finalize (GObject *object)
       channel->segs_out = NULL;
     }
 
+  gimp_channel_free_boundary_bands (channel);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -993,6 +1023,37 @@ gimp_channel_invalidate_boundary (GimpDrawable *drawable)
   GIMP_CHANNEL (drawable)->boundary_known = FALSE;
 }
 
+static void
+gimp_channel_update (GimpDrawable *drawable,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+
+  if (channel->boundary_bands && width > 0 && height > 0)
+    {
+      gint n_bands = channel->boundary_bands->len;
+      gint first;
+      gint last;
+      gint i;
+
+      /*  a band's boundary also depends on the row just above and
+       *  the row just below it
+       */
+      first = MAX (y - 1, 0) / BOUNDARY_BAND_HEIGHT;
+      last  = MIN (MAX (y + height, 0) / BOUNDARY_BAND_HEIGHT, n_bands - 1);
+
+      for (i = first; i <= last; i++)
+        gimp_channel_boundary_band_clear (&g_array_index (channel->boundary_bands,
+                                                          GimpChannelBoundaryBand,
+                                                          i));
+    }
+
+  GIMP_DRAWABLE_CLASS (parent_class)->update (drawable, x, y, width, height);
+}
+
 static void
 gimp_channel_get_active_components (GimpDrawable *drawable,
                                     gboolean     *active)
@@ -1080,6 +1141,8 @@ gimp_channel_set_buffer (GimpDrawable *drawable,
 
   channel->bounds_known = FALSE;
 
+  gimp_channel_free_boundary_bands (channel);
+
   if (gimp_filter_peek_node (GIMP_FILTER (channel)))
     {
       const Babl *color_format;
@@ -1154,48 +1217,143 @@ gimp_channel_real_boundary (GimpChannel         *channel,
       g_free (channel->segs_in);
       g_free (channel->segs_out);
 
+      channel->segs_in      = NULL;
+      channel->segs_out     = NULL;
+      channel->num_segs_in  = 0;
+      channel->num_segs_out = 0;
+
+      if (channel->boundary_bands &&
+          (channel->boundary_x1 != x1 || channel->boundary_y1 != y1 ||
+           channel->boundary_x2 != x2 || channel->boundary_y2 != y2))
+        {
+          gimp_channel_free_boundary_bands (channel);
+        }
+
       if (gimp_item_bounds (GIMP_ITEM (channel), &x3, &y3, &x4, &y4))
         {
-          GeglBuffer    *buffer;
-          GeglRectangle  rect = { x3, y3, x4, y4 };
+          GeglBuffer *buffer;
+          gint        width;
+          gint        height;
+          gint        in_x1, in_y1, in_x2, in_y2;
+          gint        n_bands;
+          gint        n_in;
+          gint        n_out;
+          gint        i;
 
           x4 += x3;
           y4 += y3;
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
-          x1 = MAX (x1, x3);
-          y1 = MAX (y1, y3);
-          x2 = MIN (x2, x4);
-          y2 = MIN (y2, y4);
-
-          if (x2 > x1 && y2 > y1)
+          width  = gegl_buffer_get_width  (buffer);
+          height = gegl_buffer_get_height (buffer);
+
+          n_bands = (height + BOUNDARY_BAND_HEIGHT - 1) / BOUNDARY_BAND_HEIGHT;
+
+          if (! channel->boundary_bands)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              channel->boundary_bands =
+                g_array_sized_new (FALSE, TRUE,
+                                   sizeof (GimpChannelBoundaryBand), n_bands);
+              g_array_set_size (channel->boundary_bands, n_bands);
+
+              channel->boundary_x1 = x1;
+              channel->boundary_y1 = y1;
+              channel->boundary_x2 = x2;
+              channel->boundary_y2 = y2;
             }
-          else
+
+          /*  pixels outside of the mask's bounds are never selected,
+           *  so the bands don't depend on them and they only need to
+           *  be clipped to the buffer
+           */
+          in_x1 = CLAMP (x1, 0, width);
+          in_y1 = CLAMP (y1, 0, height);
+          in_x2 = CLAMP (x2, 0, width);
+          in_y2 = CLAMP (y2, 0, height);
+
+          for (i = 0; i < n_bands; i++)
             {
-              channel->segs_in     = NULL;
-              channel->num_segs_in = 0;
+              GimpChannelBoundaryBand *band;
+              gint                     row;
+              gint                     n_rows;
+
+              band = &g_array_index (channel->boundary_bands,
+                                     GimpChannelBoundaryBand, i);
+
+              if (band->valid)
+                continue;
+
+              row    = i * BOUNDARY_BAND_HEIGHT;
+              n_rows = MIN (BOUNDARY_BAND_HEIGHT, height - row);
+
+              if (row < y4 && row + n_rows > y3)
+                {
+                  band->segs_out =
+                    gimp_boundary_find_rows (buffer, NULL,
+                                             babl_format ("Y float"),
+                                             GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                             x1, y1, x2, y2,
+                                             GIMP_BOUNDARY_HALF_WAY,
+                                             row, n_rows,
+                                             &band->num_segs_out);
+
+                  if (in_x2 > in_x1 && in_y2 > in_y1)
+                    {
+                      band->segs_in =
+                        gimp_boundary_find_rows (buffer, NULL,
+                                                 babl_format ("Y float"),
+                                                 GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                                 in_x1, in_y1, in_x2, in_y2,
+                                                 GIMP_BOUNDARY_HALF_WAY,
+                                                 row, n_rows,
+                                                 &band->num_segs_in);
+                    }
+                }
+
+              band->valid = TRUE;
+            }
+
+          /*  stitch the bands together  */
+          for (i = 0; i < n_bands; i++)
+            {
+              GimpChannelBoundaryBand *band;
+
+              band = &g_array_index (channel->boundary_bands,
+                                     GimpChannelBoundaryBand, i);
+
+              channel->num_segs_in  += band->num_segs_in;
+              channel->num_segs_out += band->num_segs_out;
+            }
+
+          if (channel->num_segs_in)
+            channel->segs_in = g_new (GimpBoundSeg, channel->num_segs_in);
+
+          if (channel->num_segs_out)
+            channel->segs_out = g_new (GimpBoundSeg, channel->num_segs_out);
+
+          for (i = 0, n_in = 0, n_out = 0; i < n_bands; i++)
+            {
+              GimpChannelBoundaryBand *band;
+
+              band = &g_array_index (channel->boundary_bands,
+                                     GimpChannelBoundaryBand, i);
+
+              if (band->num_segs_in)
+                memcpy (channel->segs_in + n_in, band->segs_in,
+                        band->num_segs_in * sizeof (GimpBoundSeg));
+
+              if (band->num_segs_out)
+                memcpy (channel->segs_out + n_out, band->segs_out,
+                        band->num_segs_out * sizeof (GimpBoundSeg));
+
+              n_in  += band->num_segs_in;
+              n_out += band->num_segs_out;
             }
         }
       else
         {
-          channel->segs_in      = NULL;
-          channel->segs_out     = NULL;
-          channel->num_segs_in  = 0;
-          channel->num_segs_out = 0;
+          gimp_channel_free_boundary_bands (channel);
         }
 
       channel->boundary_known = TRUE;
@@ -1228,6 +1386,8 @@ gimp_channel_real_is_empty (GimpChannel *channel)
   if (channel->segs_out)
     g_free (channel->segs_out);
 
+  gimp_channel_free_boundary_bands (channel);
+
   channel->empty          = TRUE;
   channel->segs_in        = NULL;
   channel->segs_out       = NULL;
@@ -1629,6 +1789,37 @@ gimp_channel_real_flood (GimpChannel *channel,
 }
 
 
+static void
+gimp_channel_boundary_band_clear (GimpChannelBoundaryBand *band)
+{
+  g_free (band->segs_in);
+  g_free (band->segs_out);
+
+  band->segs_in      = NULL;
+  band->segs_out     = NULL;
+  band->num_segs_in  = 0;
+  band->num_segs_out = 0;
+  band->valid        = FALSE;
+}
+
+static void
+gimp_channel_free_boundary_bands (GimpChannel *channel)
+{
+  if (channel->boundary_bands)
+    {
+      gint i;
+
+      for (i = 0; i < channel->boundary_bands->len; i++)
+        gimp_channel_boundary_band_clear (&g_array_index (channel->boundary_bands,
+                                                          GimpChannelBoundaryBand,
+                                                          i));
+
+      g_array_free (channel->boundary_bands, TRUE);
+      channel->boundary_bands = NULL;
+    }
+}
+
+
 /*  public functions  */
 
 GimpChannel *
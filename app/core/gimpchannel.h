@@ -49,6 +49,11 @@ struct _GimpChannel
   GimpBoundSeg *segs_out;          /*  outline of selected region     */
   gint          num_segs_in;       /*  number of lines in boundary    */
   gint          num_segs_out;      /*  number of lines in boundary    */
+  GArray       *boundary_bands;    /*  boundary cached per tile row   */
+  gint          boundary_x1;       /*  bounds the cached boundary     */
+  gint          boundary_y1;       /*  bands were computed for        */
+  gint          boundary_x2;
+  gint          boundary_y2;
   gboolean      empty;             /*  is the region empty?           */
   gboolean      bounds_known;      /*  recalculate the bounds?        */
   gint          x1, y1;            /*  coordinates for bounding box   */
@@ -22,6 +22,7 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
@@ -36,6 +37,48 @@
 #include "gimp-intl.h"
 
 
+/*  the preview is solved on a proxy of at most PREVIEW_SIZE pixels
+ *  across, which covers the unknown band plus PREVIEW_MARGIN proxy
+ *  pixels of known ones around it
+ */
+#define PREVIEW_SIZE    512
+#define PREVIEW_MARGIN  8
+
+/*  the guided filter that upsamples the proxy alpha, in proxy pixels  */
+#define GUIDED_RADIUS   2
+#define GUIDED_EPSILON  1e-4
+
+#define STRIP_HEIGHT    64
+
+
+/*  local function prototypes  */
+
+static GeglBuffer * foreground_extract_matting        (GeglBuffer          *input,
+                                                        GeglBuffer          *trimap,
+                                                        gint                 off_x,
+                                                        gint                 off_y,
+                                                        GimpMattingEngine    engine,
+                                                        gint                 global_iterations,
+                                                        gint                 levin_levels,
+                                                        gint                 levin_active_levels,
+                                                        GimpProgress        *progress);
+static gboolean     foreground_extract_unknown_bounds (GeglBuffer          *trimap,
+                                                        const GeglRectangle *area,
+                                                        GeglRectangle       *bounds);
+static void         foreground_extract_box_filter     (const gfloat        *src,
+                                                        gfloat              *dest,
+                                                        gint                 width,
+                                                        gint                 height,
+                                                        gint                 radius);
+static void         foreground_extract_upsample       (GeglBuffer          *input,
+                                                        GeglBuffer          *trimap,
+                                                        GeglBuffer          *output,
+                                                        const GeglRectangle *rect,
+                                                        const GeglRectangle *proxy_rect,
+                                                        gdouble              scale,
+                                                        const gfloat        *proxy_alpha);
+
+
 /*  public functions  */
 
 GeglBuffer *
@@ -47,25 +90,205 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
                                   GeglBuffer        *trimap,
                                   GimpProgress      *progress)
 {
-  GeglBuffer    *drawable_buffer;
-  GeglNode      *gegl;
-  GeglNode      *input_node;
-  GeglNode      *trimap_node;
-  GeglNode      *matting_node;
-  GeglNode      *output_node;
+  GeglBuffer *buffer;
+  gint        off_x, off_y;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+
+  progress = gimp_progress_start (progress, FALSE,
+                                  _("Computing alpha of unknown pixels"));
+
+  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+
+  buffer = foreground_extract_matting (gimp_drawable_get_buffer (drawable),
+                                       trimap, off_x, off_y,
+                                       engine,
+                                       global_iterations,
+                                       levin_levels,
+                                       levin_active_levels,
+                                       progress);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  return buffer;
+}
+
+/*  Like gimp_drawable_foreground_extract(), but only solves the matting
+ *  on a downscaled proxy of the area around the trimap's unknown band,
+ *  and upsamples the result with a guided filter that follows the
+ *  edges of the drawable.  Known trimap pixels are copied as they are.
+ *  Meant for previews, the result is close to but not the same as the
+ *  full resolution solve.
+ */
+GeglBuffer *
+gimp_drawable_foreground_extract_preview (GimpDrawable      *drawable,
+                                          GimpMattingEngine  engine,
+                                          gint               global_iterations,
+                                          gint               levin_levels,
+                                          gint               levin_active_levels,
+                                          GeglBuffer        *trimap,
+                                          GimpProgress      *progress)
+{
+  GeglBuffer    *view;
   GeglBuffer    *buffer;
-  GeglProcessor *processor;
-  gdouble        value;
+  GeglBuffer    *proxy_input;
+  GeglBuffer    *proxy_trimap;
+  GeglBuffer    *proxy_output;
+  GeglRectangle  extent;
+  GeglRectangle  bounds;
+  GeglRectangle  rect;
+  GeglRectangle  proxy_rect;
+  gfloat        *data;
+  gdouble        scale;
+  gint           pad;
   gint           off_x, off_y;
+  gint           i;
 
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
 
+  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+
+  gegl_rectangle_intersect (&extent,
+                            GEGL_RECTANGLE (off_x, off_y,
+                                            gimp_item_get_width  (GIMP_ITEM (drawable)),
+                                            gimp_item_get_height (GIMP_ITEM (drawable))),
+                            gegl_buffer_get_extent (trimap));
+
+  buffer = gegl_buffer_new (&extent, babl_format ("Y float"));
+
+  gegl_buffer_copy (trimap, &extent, GEGL_ABYSS_NONE,
+                    buffer, &extent);
+
+  if (! foreground_extract_unknown_bounds (trimap, &extent, &bounds))
+    return buffer;
+
+  scale = MIN (1.0, (gdouble) (PREVIEW_SIZE - 2 * PREVIEW_MARGIN) /
+                    MAX (bounds.width, bounds.height));
+  pad   = ceil (PREVIEW_MARGIN / scale);
+
+  gegl_rectangle_intersect (&rect,
+                            GEGL_RECTANGLE (bounds.x      - pad,
+                                            bounds.y      - pad,
+                                            bounds.width  + 2 * pad,
+                                            bounds.height + 2 * pad),
+                            &extent);
+
+  proxy_rect.x      = floor (rect.x * scale);
+  proxy_rect.y      = floor (rect.y * scale);
+  proxy_rect.width  = ceil ((rect.x + rect.width)  * scale) - proxy_rect.x;
+  proxy_rect.height = ceil ((rect.y + rect.height) * scale) - proxy_rect.y;
+
   progress = gimp_progress_start (progress, FALSE,
                                   _("Computing alpha of unknown pixels"));
 
-  drawable_buffer = gimp_drawable_get_buffer (drawable);
+  /*  a view of the drawable in image coordinates, like the trimap  */
+  view = g_object_new (GEGL_TYPE_BUFFER,
+                       "source",  gimp_drawable_get_buffer (drawable),
+                       "shift-x", -off_x,
+                       "shift-y", -off_y,
+                       NULL);
+
+  proxy_input  = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                  proxy_rect.width,
+                                                  proxy_rect.height),
+                                  babl_format ("R'G'B'A float"));
+  proxy_trimap = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                  proxy_rect.width,
+                                                  proxy_rect.height),
+                                  babl_format ("Y float"));
+
+  data = g_new (gfloat, proxy_rect.width * proxy_rect.height * 4);
+
+  gegl_buffer_get (view, &proxy_rect, scale,
+                   babl_format ("R'G'B'A float"), data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_set (proxy_input, NULL, 0,
+                   babl_format ("R'G'B'A float"), data,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  gegl_buffer_get (trimap, &proxy_rect, scale,
+                   babl_format ("Y float"), data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  /*  proxy pixels that mix known and unknown ones are unknown  */
+  for (i = 0; i < proxy_rect.width * proxy_rect.height; i++)
+    {
+      if (data[i] < 0.001)
+        data[i] = 0.0;
+      else if (data[i] > 0.999)
+        data[i] = 1.0;
+      else
+        data[i] = 0.5;
+    }
+
+  gegl_buffer_set (proxy_trimap, NULL, 0,
+                   babl_format ("Y float"), data,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  proxy_output = foreground_extract_matting (proxy_input, proxy_trimap, 0, 0,
+                                             engine,
+                                             global_iterations,
+                                             levin_levels,
+                                             levin_active_levels,
+                                             progress);
+
+  gegl_buffer_get (proxy_output,
+                   GEGL_RECTANGLE (0, 0, proxy_rect.width, proxy_rect.height),
+                   1.0, babl_format ("Y float"), data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  if (scale == 1.0)
+    {
+      gegl_buffer_set (buffer, &rect, 0,
+                       babl_format ("Y float"), data,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+  else
+    {
+      foreground_extract_upsample (view, trimap, buffer,
+                                   &rect, &proxy_rect, scale, data);
+    }
+
+  g_free (data);
+
+  g_object_unref (proxy_output);
+  g_object_unref (proxy_trimap);
+  g_object_unref (proxy_input);
+  g_object_unref (view);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  return buffer;
+}
+
+
+/*  private functions  */
+
+static GeglBuffer *
+foreground_extract_matting (GeglBuffer        *input,
+                            GeglBuffer        *trimap,
+                            gint               off_x,
+                            gint               off_y,
+                            GimpMattingEngine  engine,
+                            gint               global_iterations,
+                            gint               levin_levels,
+                            gint               levin_active_levels,
+                            GimpProgress      *progress)
+{
+  GeglNode      *gegl;
+  GeglNode      *input_node;
+  GeglNode      *trimap_node;
+  GeglNode      *matting_node;
+  GeglNode      *output_node;
+  GeglBuffer    *buffer;
+  GeglProcessor *processor;
+  gdouble        value;
 
   gegl = gegl_node_new ();
 
@@ -75,7 +298,7 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
                                      NULL);
   input_node = gegl_node_new_child (gegl,
                                     "operation", "gegl:buffer-source",
-                                    "buffer",    drawable_buffer,
+                                    "buffer",    input,
                                     NULL);
   output_node = gegl_node_new_child (gegl,
                                      "operation", "gegl:buffer-sink",
@@ -99,8 +322,6 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
                                           NULL);
     }
 
-  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
-
   if (off_x || off_y)
     {
       GeglNode *pre;
@@ -139,12 +360,269 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
         gimp_progress_set_value (progress, value);
     }
 
-  if (progress)
-    gimp_progress_end (progress);
-
   g_object_unref (processor);
 
   g_object_unref (gegl);
 
   return buffer;
 }
+
+static gboolean
+foreground_extract_unknown_bounds (GeglBuffer          *trimap,
+                                   const GeglRectangle *area,
+                                   GeglRectangle       *bounds)
+{
+  GeglBufferIterator  *iter;
+  GeglRectangle       *roi;
+  gint                 x1 = G_MAXINT;
+  gint                 y1 = G_MAXINT;
+  gint                 x2 = G_MININT;
+  gint                 y2 = G_MININT;
+
+  iter = gegl_buffer_iterator_new (trimap, area, 0, babl_format ("Y float"),
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+  roi = &iter->roi[0];
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const gfloat *data = iter->data[0];
+      gint          x, y;
+
+      for (y = roi->y; y < roi->y + roi->height; y++)
+        for (x = roi->x; x < roi->x + roi->width; x++, data++)
+          {
+            if (*data > 0.0 && *data < 1.0)
+              {
+                x1 = MIN (x1, x);
+                y1 = MIN (y1, y);
+                x2 = MAX (x2, x);
+                y2 = MAX (y2, y);
+              }
+          }
+    }
+
+  if (x1 > x2)
+    return FALSE;
+
+  gegl_rectangle_set (bounds, x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+
+  return TRUE;
+}
+
+/*  the mean over a (2 * radius + 1) square window, clipped at the edges  */
+static void
+foreground_extract_box_filter (const gfloat *src,
+                               gfloat       *dest,
+                               gint          width,
+                               gint          height,
+                               gint          radius)
+{
+  gfloat *tmp = g_new (gfloat, width * height);
+  gint    x, y, i;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        gint   x1  = MAX (x - radius, 0);
+        gint   x2  = MIN (x + radius, width - 1);
+        gfloat sum = 0.0;
+
+        for (i = x1; i <= x2; i++)
+          sum += src[y * width + i];
+
+        tmp[y * width + x] = sum / (x2 - x1 + 1);
+      }
+
+  for (y = 0; y < height; y++)
+    {
+      gint y1 = MAX (y - radius, 0);
+      gint y2 = MIN (y + radius, height - 1);
+
+      for (x = 0; x < width; x++)
+        {
+          gfloat sum = 0.0;
+
+          for (i = y1; i <= y2; i++)
+            sum += tmp[i * width + x];
+
+          dest[y * width + x] = sum / (y2 - y1 + 1);
+        }
+    }
+
+  g_free (tmp);
+}
+
+/*  Fast guided filter: fit alpha = a * Y' + b locally on the proxy,
+ *  then evaluate the upsampled a and b against the full resolution
+ *  Y', so the alpha edges snap to the image edges instead of being
+ *  blurred by the upscale.
+ */
+static void
+foreground_extract_upsample (GeglBuffer          *input,
+                             GeglBuffer          *trimap,
+                             GeglBuffer          *output,
+                             const GeglRectangle *rect,
+                             const GeglRectangle *proxy_rect,
+                             gdouble              scale,
+                             const gfloat        *proxy_alpha)
+{
+  gint    pw = proxy_rect->width;
+  gint    ph = proxy_rect->height;
+  gint    n  = pw * ph;
+  gfloat *guide;
+  gfloat *mean_i;
+  gfloat *mean_p;
+  gfloat *mean_ip;
+  gfloat *mean_ii;
+  gfloat *a;
+  gfloat *b;
+  gint   *col_x0;
+  gint   *col_x1;
+  gfloat *col_fx;
+  gfloat *row_guide;
+  gfloat *row_trimap;
+  gfloat *row_alpha;
+  gint    x, y, i;
+
+  guide   = g_new (gfloat, n);
+  mean_i  = g_new (gfloat, n);
+  mean_p  = g_new (gfloat, n);
+  mean_ip = g_new (gfloat, n);
+  mean_ii = g_new (gfloat, n);
+  a       = g_new (gfloat, n);
+  b       = g_new (gfloat, n);
+
+  gegl_buffer_get (input, proxy_rect, scale,
+                   babl_format ("Y' float"), guide,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (i = 0; i < n; i++)
+    {
+      a[i] = guide[i] * proxy_alpha[i];
+      b[i] = guide[i] * guide[i];
+    }
+
+  foreground_extract_box_filter (guide,       mean_i,  pw, ph, GUIDED_RADIUS);
+  foreground_extract_box_filter (proxy_alpha, mean_p,  pw, ph, GUIDED_RADIUS);
+  foreground_extract_box_filter (a,           mean_ip, pw, ph, GUIDED_RADIUS);
+  foreground_extract_box_filter (b,           mean_ii, pw, ph, GUIDED_RADIUS);
+
+  for (i = 0; i < n; i++)
+    {
+      gfloat cov = mean_ip[i] - mean_i[i] * mean_p[i];
+      gfloat var = mean_ii[i] - mean_i[i] * mean_i[i];
+
+      mean_ip[i] = cov / (var + GUIDED_EPSILON);
+      mean_ii[i] = mean_p[i] - mean_ip[i] * mean_i[i];
+    }
+
+  foreground_extract_box_filter (mean_ip, a, pw, ph, GUIDED_RADIUS);
+  foreground_extract_box_filter (mean_ii, b, pw, ph, GUIDED_RADIUS);
+
+  g_free (guide);
+  g_free (mean_i);
+  g_free (mean_p);
+  g_free (mean_ip);
+  g_free (mean_ii);
+
+  /*  the proxy position of each full resolution column  */
+  col_x0 = g_new (gint,   rect->width);
+  col_x1 = g_new (gint,   rect->width);
+  col_fx = g_new (gfloat, rect->width);
+
+  for (x = 0; x < rect->width; x++)
+    {
+      gdouble u = (rect->x + x + 0.5) * scale - 0.5 - proxy_rect->x;
+
+      u = CLAMP (u, 0.0, pw - 1);
+
+      col_x0[x] = (gint) u;
+      col_x1[x] = MIN (col_x0[x] + 1, pw - 1);
+      col_fx[x] = u - col_x0[x];
+    }
+
+  row_guide  = g_new (gfloat, rect->width * STRIP_HEIGHT);
+  row_trimap = g_new (gfloat, rect->width * STRIP_HEIGHT);
+  row_alpha  = g_new (gfloat, rect->width * STRIP_HEIGHT);
+
+  for (y = rect->y; y < rect->y + rect->height; y += STRIP_HEIGHT)
+    {
+      GeglRectangle strip;
+      gint          sy;
+
+      gegl_rectangle_set (&strip,
+                          rect->x, y,
+                          rect->width,
+                          MIN (STRIP_HEIGHT, rect->y + rect->height - y));
+
+      gegl_buffer_get (input, &strip, 1.0,
+                       babl_format ("Y' float"), row_guide,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      gegl_buffer_get (trimap, &strip, 1.0,
+                       babl_format ("Y float"), row_trimap,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (sy = 0; sy < strip.height; sy++)
+        {
+          gdouble       v  = (y + sy + 0.5) * scale - 0.5 - proxy_rect->y;
+          gint          y0;
+          gint          y1;
+          gfloat        fy;
+          const gfloat *a0;
+          const gfloat *a1;
+          const gfloat *b0;
+          const gfloat *b1;
+          const gfloat *g  = row_guide  + sy * rect->width;
+          const gfloat *t  = row_trimap + sy * rect->width;
+          gfloat       *o  = row_alpha  + sy * rect->width;
+
+          v  = CLAMP (v, 0.0, ph - 1);
+          y0 = (gint) v;
+          y1 = MIN (y0 + 1, ph - 1);
+          fy = v - y0;
+
+          a0 = a + y0 * pw;
+          a1 = a + y1 * pw;
+          b0 = b + y0 * pw;
+          b1 = b + y1 * pw;
+
+          for (x = 0; x < rect->width; x++)
+            {
+              if (t[x] <= 0.0 || t[x] >= 1.0)
+                {
+                  o[x] = t[x];
+                }
+              else
+                {
+                  gint   x0 = col_x0[x];
+                  gint   x1 = col_x1[x];
+                  gfloat fx = col_fx[x];
+                  gfloat va;
+                  gfloat vb;
+
+                  va = ((a0[x0] * (1.0 - fx) + a0[x1] * fx) * (1.0 - fy) +
+                        (a1[x0] * (1.0 - fx) + a1[x1] * fx) * fy);
+                  vb = ((b0[x0] * (1.0 - fx) + b0[x1] * fx) * (1.0 - fy) +
+                        (b1[x0] * (1.0 - fx) + b1[x1] * fx) * fy);
+
+                  o[x] = CLAMP (va * g[x] + vb, 0.0, 1.0);
+                }
+            }
+        }
+
+      gegl_buffer_set (output, &strip, 0,
+                       babl_format ("Y float"), row_alpha,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (row_guide);
+  g_free (row_trimap);
+  g_free (row_alpha);
+
+  g_free (col_x0);
+  g_free (col_x1);
+  g_free (col_fx);
+
+  g_free (a);
+  g_free (b);
+}
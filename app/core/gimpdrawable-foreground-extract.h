@@ -26,6 +26,14 @@ GeglBuffer * gimp_drawable_foreground_extract (GimpDrawable       *drawable,
                                                gint                levin_active_levels,
                                                GeglBuffer         *trimap,
                                                GimpProgress       *progress);
+GeglBuffer * gimp_drawable_foreground_extract_preview
+                                              (GimpDrawable       *drawable,
+                                               GimpMattingEngine   engine,
+                                               gint                global_iterations,
+                                               gint                levin_levels,
+                                               gint                levin_active_levels,
+                                               GeglBuffer         *trimap,
+                                               GimpProgress       *progress);
 
 
 #endif  /*  __GIMP_DRAWABLE_FOREGROUND_EXTRACT_H__  */
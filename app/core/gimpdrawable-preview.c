@@ -43,6 +43,59 @@
 #include "gimptempbuf.h"
 
 
+/*  drawables smaller than this are previewed right away  */
+#define MIN_BACKGROUND_SIZE  (256 * 256)
+#define MAX_PREVIEW_THREADS  4
+#define MAX_PREVIEWS         4
+
+
+typedef struct _PreviewJob PreviewJob;
+
+struct _PreviewJob
+{
+  guint         serial;
+
+  GimpDrawable *drawable;  /* weak, NULL once the drawable is gone  */
+  GeglBuffer   *buffer;    /* a copy of the pixels at request time  */
+  guint         stamp;
+  volatile gint cancelled; /* drawable gone or exiting, don't render */
+
+  GimpTempBuf  *temp_buf;  /* filled by the worker                  */
+};
+
+typedef struct
+{
+  gint          width;
+  gint          height;
+  guint         stamp;     /* the drawable's preview_stamp when rendered */
+  GimpTempBuf  *temp_buf;  /* NULL until the first job is done           */
+  PreviewJob   *job;       /* the job rendering it, if any               */
+} DrawablePreview;
+
+
+/*  local function prototypes  */
+
+static void       gimp_drawable_preview_scale (GeglBuffer       *buffer,
+                                               gint              src_x,
+                                               gint              src_y,
+                                               gint              src_width,
+                                               gint              src_height,
+                                               GimpTempBuf      *preview);
+
+static void       preview_job_push            (PreviewJob       *job);
+static gint       preview_job_compare         (const PreviewJob *job1,
+                                               const PreviewJob *job2,
+                                               gpointer          data);
+static void       preview_job_run             (PreviewJob       *job,
+                                               gpointer          data);
+static gboolean   preview_job_done            (PreviewJob       *job);
+static void       preview_job_free            (PreviewJob       *job);
+
+
+static GThreadPool *preview_pool = NULL;
+static GList       *preview_jobs = NULL;  /* all jobs not done yet */
+
+
 /*  public functions  */
 
 GimpTempBuf *
@@ -51,18 +104,119 @@ gimp_drawable_get_new_preview (GimpViewable *viewable,
                                gint          width,
                                gint          height)
 {
-  GimpItem  *item  = GIMP_ITEM (viewable);
-  GimpImage *image = gimp_item_get_image (item);
+  GimpDrawable        *drawable = GIMP_DRAWABLE (viewable);
+  GimpDrawablePrivate *private  = drawable->private;
+  GimpItem            *item     = GIMP_ITEM (viewable);
+  GimpImage           *image    = gimp_item_get_image (item);
+  DrawablePreview     *preview  = NULL;
+  DrawablePreview     *other    = NULL;
+  GList               *list;
 
   if (! image->gimp->config->layer_previews)
     return NULL;
 
-  return gimp_drawable_get_sub_preview (GIMP_DRAWABLE (viewable),
-                                        0, 0,
-                                        gimp_item_get_width  (item),
-                                        gimp_item_get_height (item),
-                                        width,
-                                        height);
+  /*  small drawables are quick to preview, group layers render their
+   *  projection on demand, and floating selections invalidate the
+   *  drawable they are attached to, so do these right away
+   */
+  if ((gint64) gimp_item_get_width (item) * gimp_item_get_height (item) <=
+      MIN_BACKGROUND_SIZE                                                  ||
+      gimp_viewable_get_children (viewable)                                ||
+      (GIMP_IS_LAYER (drawable) &&
+       gimp_layer_is_floating_sel (GIMP_LAYER (drawable))))
+    {
+      return gimp_drawable_get_sub_preview (drawable,
+                                            0, 0,
+                                            gimp_item_get_width  (item),
+                                            gimp_item_get_height (item),
+                                            width,
+                                            height);
+    }
+
+  for (list = private->previews; list; list = g_list_next (list))
+    {
+      DrawablePreview *p = list->data;
+
+      if (p->width == width && p->height == height)
+        preview = p;
+      else if (! other && p->temp_buf)
+        other = p;
+    }
+
+  if (preview && preview->temp_buf && preview->stamp == private->preview_stamp)
+    return gimp_temp_buf_ref (preview->temp_buf);
+
+  if (! preview)
+    {
+      preview = g_slice_new0 (DrawablePreview);
+
+      preview->width  = width;
+      preview->height = height;
+
+      private->previews = g_list_prepend (private->previews, preview);
+
+      /*  forget the oldest previews nobody is waiting for  */
+      while (g_list_length (private->previews) > MAX_PREVIEWS)
+        {
+          DrawablePreview *last;
+
+          for (list = g_list_last (private->previews);
+               list;
+               list = g_list_previous (list))
+            {
+              last = list->data;
+
+              if (! last->job && last != preview)
+                break;
+            }
+
+          if (! list)
+            break;
+
+          if (last == other)
+            other = NULL;
+
+          if (last->temp_buf)
+            gimp_temp_buf_unref (last->temp_buf);
+
+          g_slice_free (DrawablePreview, last);
+
+          private->previews = g_list_delete_link (private->previews, list);
+        }
+    }
+
+  /*  render the preview in the background, the views are invalidated
+   *  once it is there.  a job of an outdated stamp is not restarted,
+   *  its result is stored as a placeholder and the views ask again
+   */
+  if (! preview->job)
+    {
+      static guint  serial = 0;
+      PreviewJob   *job    = g_slice_new0 (PreviewJob);
+
+      job->serial   = serial++;
+      job->drawable = drawable;
+      job->buffer   = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+      job->stamp    = private->preview_stamp;
+      job->temp_buf = gimp_temp_buf_new (width, height,
+                                         gimp_drawable_get_preview_format (drawable));
+
+      g_object_add_weak_pointer (G_OBJECT (drawable),
+                                 (gpointer) &job->drawable);
+
+      preview->job = job;
+
+      preview_job_push (job);
+    }
+
+  /*  meanwhile, show the outdated preview, or one of another size  */
+  if (preview->temp_buf)
+    return gimp_temp_buf_ref (preview->temp_buf);
+
+  if (other)
+    return gimp_temp_buf_scale (other->temp_buf, width, height);
+
+  return NULL;
 }
 
 GdkPixbuf *
@@ -120,6 +274,79 @@ gimp_drawable_get_preview_format (GimpDrawable *drawable)
   g_return_val_if_reached (NULL);
 }
 
+void
+gimp_drawable_clear_previews (GimpDrawable *drawable)
+{
+  GimpDrawablePrivate *private;
+  GList               *list;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  private = drawable->private;
+
+  for (list = private->previews; list; list = g_list_next (list))
+    {
+      DrawablePreview *preview = list->data;
+
+      /*  pending jobs only skip their work, and are freed when done  */
+      if (preview->job)
+        g_atomic_int_set (&preview->job->cancelled, TRUE);
+
+      if (preview->temp_buf)
+        gimp_temp_buf_unref (preview->temp_buf);
+
+      g_slice_free (DrawablePreview, preview);
+    }
+
+  g_list_free (private->previews);
+  private->previews = NULL;
+}
+
+/*  Called on exit: stops rendering, and frees all jobs right away
+ *  since their idle callbacks won't run any longer.
+ */
+void
+gimp_drawable_preview_exit (void)
+{
+  GList *list;
+
+  if (! preview_pool)
+    return;
+
+  for (list = preview_jobs; list; list = g_list_next (list))
+    {
+      PreviewJob *job = list->data;
+
+      g_atomic_int_set (&job->cancelled, TRUE);
+    }
+
+  /*  drops the queued jobs, and waits for the running ones  */
+  g_thread_pool_free (preview_pool, TRUE, TRUE);
+  preview_pool = NULL;
+
+  while (preview_jobs)
+    {
+      PreviewJob *job = preview_jobs->data;
+
+      g_idle_remove_by_data (job);
+
+      if (job->drawable)
+        {
+          GimpDrawablePrivate *private = job->drawable->private;
+
+          for (list = private->previews; list; list = g_list_next (list))
+            {
+              DrawablePreview *preview = list->data;
+
+              if (preview->job == job)
+                preview->job = NULL;
+            }
+        }
+
+      preview_job_free (job);
+    }
+}
+
 GimpTempBuf *
 gimp_drawable_get_sub_preview (GimpDrawable *drawable,
                                gint          src_x,
@@ -131,11 +358,7 @@ gimp_drawable_get_sub_preview (GimpDrawable *drawable,
 {
   GimpItem    *item;
   GimpImage   *image;
-  GeglBuffer  *buffer;
   GimpTempBuf *preview;
-  gdouble      scale;
-  gint         scaled_x;
-  gint         scaled_y;
 
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (src_x >= 0, NULL);
@@ -155,23 +378,12 @@ gimp_drawable_get_sub_preview (GimpDrawable *drawable,
   if (! image->gimp->config->layer_previews)
     return NULL;
 
-  buffer = gimp_drawable_get_buffer (drawable);
-
   preview = gimp_temp_buf_new (dest_width, dest_height,
                                gimp_drawable_get_preview_format (drawable));
 
-  scale = MIN ((gdouble) dest_width  / (gdouble) src_width,
-               (gdouble) dest_height / (gdouble) src_height);
-
-  scaled_x = RINT ((gdouble) src_x * scale);
-  scaled_y = RINT ((gdouble) src_y * scale);
-
-  gegl_buffer_get (buffer,
-                   GEGL_RECTANGLE (scaled_x, scaled_y, dest_width, dest_height),
-                   scale,
-                   gimp_temp_buf_get_format (preview),
-                   gimp_temp_buf_get_data (preview),
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gimp_drawable_preview_scale (gimp_drawable_get_buffer (drawable),
+                               src_x, src_y, src_width, src_height,
+                               preview);
 
   return preview;
 }
@@ -271,3 +483,139 @@ gimp_drawable_get_sub_pixbuf (GimpDrawable *drawable,
 
   return pixbuf;
 }
+
+
+/*  private functions  */
+
+/*  gegl_buffer_get() picks the buffer's mipmap level closest to the
+ *  scale, so this only reads full resolution tiles for large previews
+ */
+static void
+gimp_drawable_preview_scale (GeglBuffer  *buffer,
+                             gint         src_x,
+                             gint         src_y,
+                             gint         src_width,
+                             gint         src_height,
+                             GimpTempBuf *preview)
+{
+  gint    dest_width  = gimp_temp_buf_get_width  (preview);
+  gint    dest_height = gimp_temp_buf_get_height (preview);
+  gdouble scale;
+  gint    scaled_x;
+  gint    scaled_y;
+
+  scale = MIN ((gdouble) dest_width  / (gdouble) src_width,
+               (gdouble) dest_height / (gdouble) src_height);
+
+  scaled_x = RINT ((gdouble) src_x * scale);
+  scaled_y = RINT ((gdouble) src_y * scale);
+
+  gegl_buffer_get (buffer,
+                   GEGL_RECTANGLE (scaled_x, scaled_y, dest_width, dest_height),
+                   scale,
+                   gimp_temp_buf_get_format (preview),
+                   gimp_temp_buf_get_data (preview),
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+}
+
+static void
+preview_job_push (PreviewJob *job)
+{
+  if (! preview_pool)
+    {
+      gint n_threads;
+
+      g_object_get (gegl_config (),
+                    "threads", &n_threads,
+                    NULL);
+
+      preview_pool = g_thread_pool_new ((GFunc) preview_job_run, NULL,
+                                        CLAMP (n_threads, 1,
+                                               MAX_PREVIEW_THREADS),
+                                        FALSE, NULL);
+
+      g_thread_pool_set_sort_function (preview_pool,
+                                       (GCompareDataFunc) preview_job_compare,
+                                       NULL);
+    }
+
+  preview_jobs = g_list_prepend (preview_jobs, job);
+
+  g_thread_pool_push (preview_pool, job, NULL);
+}
+
+static gint
+preview_job_compare (const PreviewJob *job1,
+                     const PreviewJob *job2,
+                     gpointer          data)
+{
+  /*  the most recently requested previews are those on screen  */
+  return job1->serial > job2->serial ? -1 : 1;
+}
+
+static void
+preview_job_run (PreviewJob *job,
+                 gpointer    data)
+{
+  if (! g_atomic_int_get (&job->cancelled))
+    gimp_drawable_preview_scale (job->buffer,
+                                 0, 0,
+                                 gegl_buffer_get_width  (job->buffer),
+                                 gegl_buffer_get_height (job->buffer),
+                                 job->temp_buf);
+
+  g_idle_add ((GSourceFunc) preview_job_done, job);
+}
+
+static gboolean
+preview_job_done (PreviewJob *job)
+{
+  GimpDrawable *drawable = job->drawable;
+
+  /*  the drawable might have been freed while the job was queued  */
+  if (drawable)
+    {
+      GimpDrawablePrivate *private = drawable->private;
+      GList               *list;
+
+      for (list = private->previews; list; list = g_list_next (list))
+        {
+          DrawablePreview *preview = list->data;
+
+          if (preview->job == job)
+            {
+              preview->job = NULL;
+
+              if (preview->temp_buf)
+                gimp_temp_buf_unref (preview->temp_buf);
+
+              preview->temp_buf = gimp_temp_buf_ref (job->temp_buf);
+              preview->stamp    = job->stamp;
+              break;
+            }
+        }
+
+      private->previews_ready = TRUE;
+      gimp_viewable_invalidate_preview (GIMP_VIEWABLE (drawable));
+      private->previews_ready = FALSE;
+    }
+
+  preview_job_free (job);
+
+  return FALSE;
+}
+
+static void
+preview_job_free (PreviewJob *job)
+{
+  preview_jobs = g_list_remove (preview_jobs, job);
+
+  if (job->drawable)
+    g_object_remove_weak_pointer (G_OBJECT (job->drawable),
+                                  (gpointer) &job->drawable);
+
+  gimp_temp_buf_unref (job->temp_buf);
+  g_object_unref (job->buffer);
+
+  g_slice_free (PreviewJob, job);
+}
@@ -36,6 +36,9 @@ GdkPixbuf   * gimp_drawable_get_new_pixbuf     (GimpViewable *viewable,
  */
 const Babl  * gimp_drawable_get_preview_format (GimpDrawable *drawable);
 
+void          gimp_drawable_clear_previews     (GimpDrawable *drawable);
+void          gimp_drawable_preview_exit       (void);
+
 GimpTempBuf * gimp_drawable_get_sub_preview    (GimpDrawable *drawable,
                                                 gint          src_x,
                                                 gint          src_y,
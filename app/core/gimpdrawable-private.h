@@ -33,6 +33,10 @@ struct _GimpDrawablePrivate
   GimpApplicator *fs_applicator;
 
   GeglNode       *mode_node;
+
+  GList          *previews;       /* DrawablePreview, see gimpdrawable-preview.c */
+  guint           preview_stamp;  /* changes when the previews are outdated      */
+  gboolean        previews_ready; /* set while announcing a finished preview     */
 };
 
 #endif /* __GIMP_DRAWABLE_PRIVATE_H__ */
@@ -87,6 +87,8 @@ static void       gimp_drawable_get_property       (GObject           *object,
 static gint64     gimp_drawable_get_memsize        (GimpObject        *object,
                                                     gint64            *gui_size);
 
+static void       gimp_drawable_invalidate_preview (GimpViewable      *viewable);
+
 static gboolean   gimp_drawable_get_size           (GimpViewable      *viewable,
                                                     gint              *width,
                                                     gint              *height);
@@ -232,6 +234,7 @@ gimp_drawable_class_init (GimpDrawableClass *klass)
 
   gimp_object_class->get_memsize     = gimp_drawable_get_memsize;
 
+  viewable_class->invalidate_preview = gimp_drawable_invalidate_preview;
   viewable_class->get_size           = gimp_drawable_get_size;
   viewable_class->get_new_preview    = gimp_drawable_get_new_preview;
   viewable_class->get_new_pixbuf     = gimp_drawable_get_new_pixbuf;
@@ -332,6 +335,8 @@ gimp_drawable_finalize (GObject *object)
       drawable->private->filter_stack = NULL;
     }
 
+  gimp_drawable_clear_previews (drawable);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -384,6 +389,20 @@ gimp_drawable_get_memsize (GimpObject *object,
                                                                   gui_size);
 }
 
+static void
+gimp_drawable_invalidate_preview (GimpViewable *viewable)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (viewable);
+
+  GIMP_VIEWABLE_CLASS (parent_class)->invalidate_preview (viewable);
+
+  /*  the previews rendered in the background are outdated, unless
+   *  this is just announcing one of them
+   */
+  if (! drawable->private->previews_ready)
+    drawable->private->preview_stamp++;
+}
+
 static gboolean
 gimp_drawable_get_size (GimpViewable *viewable,
                         gint         *width,
@@ -51,6 +51,9 @@
 #include "gimp-intl.h"
 
 
+#define MAX_THUMB_THREADS 4
+
+
 enum
 {
   INFO_CHANGED,
@@ -58,6 +61,43 @@ enum
 };
 
 
+typedef enum
+{
+  THUMB_JOB_LOAD,
+  THUMB_JOB_SAVE
+} ThumbJobType;
+
+typedef struct _ThumbJob ThumbJob;
+
+struct _ThumbJob
+{
+  ThumbJobType   type;
+  guint          serial;
+
+  GimpImagefile *imagefile;
+  GimpImagefile *weak_imagefile; /* also updated when the job is done */
+  GimpThumbnail *thumbnail;      /* private copy used by the worker   */
+
+  gint           width;          /* requested preview size            */
+  gint           height;
+  gint           size;           /* thumbnail size to save            */
+  gboolean       replace;
+  guint          previews_stamp;
+
+  GdkPixbuf     *pixbuf;         /* loaded preview, or thumb to save  */
+  gboolean       cancelled;      /* superseded by a synchronous save  */
+  gboolean       success;
+  GError        *error;
+};
+
+typedef struct
+{
+  gint       width;
+  gint       height;
+  GdkPixbuf *pixbuf;
+} ThumbPreview;
+
+
 typedef struct _GimpImagefilePrivate GimpImagefilePrivate;
 
 struct _GimpImagefilePrivate
@@ -71,6 +111,12 @@ struct _GimpImagefilePrivate
 
   gchar         *description;
   gboolean       static_desc;
+
+  GList         *previews;       /* ThumbPreview, loaded in the background */
+  guint          previews_stamp; /* changes when previews are cleared */
+  ThumbJob      *load_job;
+  ThumbJob      *save_job;
+  ThumbJob      *next_save_job;  /* waits for save_job to finish */
 };
 
 #define GET_PRIVATE(imagefile) G_TYPE_INSTANCE_GET_PRIVATE (imagefile, \
@@ -98,14 +144,29 @@ static void        gimp_imagefile_icon_callback    (GObject        *source_objec
                                                     GAsyncResult   *result,
                                                     gpointer        data);
 
-static GdkPixbuf * gimp_imagefile_load_thumb       (GimpImagefile  *imagefile,
+static GdkPixbuf * gimp_imagefile_load_thumb       (GimpThumbnail  *thumbnail,
                                                     gint            width,
-                                                    gint            height);
+                                                    gint            height,
+                                                    GError        **error);
 static gboolean    gimp_imagefile_save_thumb       (GimpImagefile  *imagefile,
                                                     GimpImage      *image,
                                                     gint            size,
                                                     gboolean        replace,
+                                                    gboolean        async,
                                                     GError        **error);
+static void        gimp_imagefile_clear_previews   (GimpImagefile  *imagefile);
+
+static ThumbJob  * gimp_imagefile_thumb_job_new    (GimpImagefile  *imagefile,
+                                                    ThumbJobType    type);
+static void        gimp_imagefile_thumb_job_free   (ThumbJob       *job);
+static void        gimp_imagefile_thumb_job_push   (ThumbJob       *job);
+static gint        gimp_imagefile_thumb_job_compare
+                                                   (const ThumbJob *job1,
+                                                    const ThumbJob *job2,
+                                                    gpointer        data);
+static void        gimp_imagefile_thumb_job_run    (ThumbJob       *job,
+                                                    gpointer        data);
+static gboolean    gimp_imagefile_thumb_job_done   (ThumbJob       *job);
 
 static void     gimp_thumbnail_set_info_from_image (GimpThumbnail  *thumbnail,
                                                     const gchar    *mime_type,
@@ -124,6 +185,11 @@ G_DEFINE_TYPE (GimpImagefile, gimp_imagefile, GIMP_TYPE_VIEWABLE)
 
 static guint gimp_imagefile_signals[LAST_SIGNAL] = { 0 };
 
+static GThreadPool   *thumb_pool    = NULL;
+static GList         *thumb_jobs    = NULL;  /* pushed jobs not done yet   */
+static volatile gint  thumb_exiting = FALSE; /* loads are skipped on exit  */
+static GMutex         thumb_save_mutex;      /* held while writing a thumb */
+
 
 static void
 gimp_imagefile_class_init (GimpImagefileClass *klass)
@@ -203,6 +269,8 @@ gimp_imagefile_finalize (GObject *object)
       private->description = NULL;
     }
 
+  gimp_imagefile_clear_previews (GIMP_IMAGEFILE (object));
+
   if (private->thumbnail)
     {
       g_object_unref (private->thumbnail);
@@ -234,6 +302,8 @@ gimp_imagefile_name_changed (GimpObject *object)
 
   gimp_thumbnail_set_uri (private->thumbnail, gimp_object_get_name (object));
 
+  gimp_imagefile_clear_previews (GIMP_IMAGEFILE (object));
+
   if (private->file)
     {
       g_object_unref (private->file);
@@ -250,12 +320,47 @@ gimp_imagefile_get_new_pixbuf (GimpViewable *viewable,
                                gint          width,
                                gint          height)
 {
-  GimpImagefile *imagefile = GIMP_IMAGEFILE (viewable);
+  GimpImagefile        *imagefile = GIMP_IMAGEFILE (viewable);
+  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
+  GimpThumbnail        *thumbnail = private->thumbnail;
+  GList                *list;
 
   if (! gimp_object_get_name (imagefile))
     return NULL;
 
-  return gimp_imagefile_load_thumb (imagefile, width, height);
+  for (list = private->previews; list; list = g_list_next (list))
+    {
+      ThumbPreview *preview = list->data;
+
+      if (preview->width == width && preview->height == height)
+        return g_object_ref (preview->pixbuf);
+    }
+
+  if (gimp_thumbnail_peek_thumb (thumbnail,
+                                 MAX (width, height)) < GIMP_THUMB_STATE_EXISTS)
+    return NULL;
+
+  if (thumbnail->image_state == GIMP_THUMB_STATE_NOT_FOUND)
+    return NULL;
+
+  /*  load the thumbnail in the background, the preview is invalidated
+   *  once it is there.  only one load per imagefile is pending, which
+   *  is enough because only visible views ask for previews
+   */
+  if (! private->load_job)
+    {
+      ThumbJob *job = gimp_imagefile_thumb_job_new (imagefile,
+                                                    THUMB_JOB_LOAD);
+
+      job->width  = width;
+      job->height = height;
+
+      private->load_job = job;
+
+      gimp_imagefile_thumb_job_push (job);
+    }
+
+  return NULL;
 }
 
 static gchar *
@@ -404,6 +509,8 @@ gimp_imagefile_update (GimpImagefile *imagefile)
 
   private = GET_PRIVATE (imagefile);
 
+  gimp_imagefile_clear_previews (imagefile);
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
 
   g_object_get (private->thumbnail,
@@ -525,7 +632,7 @@ gimp_imagefile_create_thumbnail (GimpImagefile  *imagefile,
         {
           success = gimp_imagefile_save_thumb (imagefile,
                                                image, size, replace,
-                                               error);
+                                               TRUE, error);
 
           g_object_unref (image);
         }
@@ -596,11 +703,22 @@ gimp_imagefile_create_thumbnail_weak (GimpImagefile *imagefile,
 
   if (imagefile)
     {
-      GFile *file = gimp_imagefile_get_file (imagefile);
+      GFile                *file          = gimp_imagefile_get_file (imagefile);
+      GimpImagefilePrivate *local_private = GET_PRIVATE (local);
 
       if (file && g_file_equal (file, gimp_imagefile_get_file (local)))
         {
           gimp_imagefile_update (imagefile);
+
+          /*  the thumbnail is still being written, update again then  */
+          if (local_private->save_job)
+            {
+              ThumbJob *job = local_private->save_job;
+
+              job->weak_imagefile = imagefile;
+              g_object_add_weak_pointer (G_OBJECT (imagefile),
+                                         (gpointer) &job->weak_imagefile);
+            }
         }
 
       g_object_remove_weak_pointer (G_OBJECT (imagefile),
@@ -659,12 +777,42 @@ gimp_imagefile_save_thumbnail (GimpImagefile  *imagefile,
 
       success = gimp_imagefile_save_thumb (imagefile,
                                            image, size, FALSE,
-                                           error);
+                                           FALSE, error);
     }
 
   return success;
 }
 
+/*  Called on exit, waits until all thumbnails queued for saving are
+ *  written, they would be lost otherwise.  Pending previews are not
+ *  loaded any longer.
+ */
+void
+gimp_imagefile_flush_thumbnails (void)
+{
+  g_atomic_int_set (&thumb_exiting, TRUE);
+
+  if (! thumb_pool)
+    return;
+
+  /*  runs all queued jobs, and waits for them  */
+  g_thread_pool_free (thumb_pool, FALSE, TRUE);
+  thumb_pool = NULL;
+
+  /*  finish the jobs here instead of in their idle callbacks; saves
+   *  waiting for a previous one are run synchronously now, and end
+   *  up in the list again
+   */
+  while (thumb_jobs)
+    {
+      ThumbJob *job = thumb_jobs->data;
+
+      g_idle_remove_by_data (job);
+
+      gimp_imagefile_thumb_job_done (job);
+    }
+}
+
 
 /*  private functions  */
 
@@ -893,20 +1041,21 @@ gimp_imagefile_get_desc_string (GimpImagefile *imagefile)
   return (const gchar *) private->description;
 }
 
+/*  called from the thumbnail threads, on a thumbnail that is private
+ *  to the calling thread
+ */
 static GdkPixbuf *
-gimp_imagefile_load_thumb (GimpImagefile *imagefile,
-                           gint           width,
-                           gint           height)
+gimp_imagefile_load_thumb (GimpThumbnail  *thumbnail,
+                           gint            width,
+                           gint            height,
+                           GError        **error)
 {
-  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
-  GimpThumbnail        *thumbnail = private->thumbnail;
-  GdkPixbuf            *pixbuf    = NULL;
-  GError               *error     = NULL;
-  gint                  size      = MAX (width, height);
-  gint                  pixbuf_width;
-  gint                  pixbuf_height;
-  gint                  preview_width;
-  gint                  preview_height;
+  GdkPixbuf *pixbuf = NULL;
+  gint       size   = MAX (width, height);
+  gint       pixbuf_width;
+  gint       pixbuf_height;
+  gint       preview_width;
+  gint       preview_height;
 
   if (gimp_thumbnail_peek_thumb (thumbnail, size) < GIMP_THUMB_STATE_EXISTS)
     return NULL;
@@ -914,20 +1063,10 @@ gimp_imagefile_load_thumb (GimpImagefile *imagefile,
   if (thumbnail->image_state == GIMP_THUMB_STATE_NOT_FOUND)
     return NULL;
 
-  pixbuf = gimp_thumbnail_load_thumb (thumbnail, size, &error);
+  pixbuf = gimp_thumbnail_load_thumb (thumbnail, size, error);
 
   if (! pixbuf)
-    {
-      if (error)
-        {
-          gimp_message (private->gimp, NULL, GIMP_MESSAGE_ERROR,
-                        _("Could not open thumbnail '%s': %s"),
-                        thumbnail->thumb_filename, error->message);
-          g_clear_error (&error);
-        }
-
-      return NULL;
-    }
+    return NULL;
 
   pixbuf_width  = gdk_pixbuf_get_width  (pixbuf);
   pixbuf_height = gdk_pixbuf_get_height (pixbuf);
@@ -978,13 +1117,14 @@ gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
                            GimpImage      *image,
                            gint            size,
                            gboolean        replace,
+                           gboolean        async,
                            GError        **error)
 {
-  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
-  GimpThumbnail        *thumbnail = private->thumbnail;
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+  ThumbJob             *job;
   GdkPixbuf            *pixbuf;
   gint                  width, height;
-  gboolean              success = FALSE;
+  gboolean              success;
 
   if (size < 1)
     return TRUE;
@@ -1025,24 +1165,350 @@ gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
   if (! pixbuf)
     return TRUE;
 
-  success = gimp_thumbnail_save_thumb (thumbnail,
-                                       pixbuf,
-                                       "GIMP " GIMP_VERSION,
-                                       error);
+  if (! async)
+    {
+      /*  pending thumbnails of this imagefile are outdated now, make
+       *  sure none of them is written after this one
+       */
+      if (private->next_save_job)
+        {
+          gimp_imagefile_thumb_job_free (private->next_save_job);
+          private->next_save_job = NULL;
+        }
+
+      g_mutex_lock (&thumb_save_mutex);
+
+      if (private->save_job)
+        private->save_job->cancelled = TRUE;
 
-  g_object_unref (pixbuf);
+      success = gimp_thumbnail_save_thumb (private->thumbnail,
+                                           pixbuf,
+                                           "GIMP " GIMP_VERSION,
+                                           error);
+
+      g_mutex_unlock (&thumb_save_mutex);
+
+      g_object_unref (pixbuf);
+
+      if (success)
+        {
+          if (replace)
+            gimp_thumbnail_delete_others (private->thumbnail, size);
+          else
+            gimp_thumbnail_delete_failure (private->thumbnail);
+
+          gimp_imagefile_update (imagefile);
+        }
+
+      return success;
+    }
+
+  /*  encoding and writing the PNG is done in the background, errors
+   *  are reported when that is done
+   */
+  job = gimp_imagefile_thumb_job_new (imagefile, THUMB_JOB_SAVE);
+
+  job->size    = size;
+  job->replace = replace;
+  job->pixbuf  = pixbuf;
 
-  if (success)
+  if (private->save_job)
     {
-      if (replace)
-        gimp_thumbnail_delete_others (thumbnail, size);
-      else
-        gimp_thumbnail_delete_failure (thumbnail);
+      /*  don't write the same file from two threads, and let only the
+       *  latest of several pending thumbnails win
+       */
+      if (private->next_save_job)
+        gimp_imagefile_thumb_job_free (private->next_save_job);
 
-      gimp_imagefile_update (imagefile);
+      private->next_save_job = job;
     }
+  else
+    {
+      private->save_job = job;
 
-  return success;
+      gimp_imagefile_thumb_job_push (job);
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_imagefile_clear_previews (GimpImagefile *imagefile)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+  GList                *list;
+
+  for (list = private->previews; list; list = g_list_next (list))
+    {
+      ThumbPreview *preview = list->data;
+
+      g_object_unref (preview->pixbuf);
+      g_slice_free (ThumbPreview, preview);
+    }
+
+  g_list_free (private->previews);
+  private->previews = NULL;
+
+  /*  previews being loaded are outdated now  */
+  private->previews_stamp++;
+}
+
+static ThumbJob *
+gimp_imagefile_thumb_job_new (GimpImagefile *imagefile,
+                              ThumbJobType   type)
+{
+  static guint          serial    = 0;
+  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
+  GimpThumbnail        *thumbnail = private->thumbnail;
+  ThumbJob             *job;
+
+  job = g_slice_new0 (ThumbJob);
+
+  job->type           = type;
+  job->serial         = serial++;
+  job->imagefile      = g_object_ref (imagefile);
+  job->previews_stamp = private->previews_stamp;
+
+  /*  GimpThumbnail is not thread-safe, the worker gets its own copy  */
+  job->thumbnail = gimp_thumbnail_new ();
+
+  if (type == THUMB_JOB_LOAD)
+    {
+      gimp_thumbnail_set_uri (job->thumbnail, thumbnail->image_uri);
+    }
+  else
+    {
+      g_object_set (job->thumbnail,
+                    "image-uri",        thumbnail->image_uri,
+                    "image-mtime",      thumbnail->image_mtime,
+                    "image-filesize",   thumbnail->image_filesize,
+                    "image-mimetype",   thumbnail->image_mimetype,
+                    "image-width",      thumbnail->image_width,
+                    "image-height",     thumbnail->image_height,
+                    "image-type",       thumbnail->image_type,
+                    "image-num-layers", thumbnail->image_num_layers,
+                    NULL);
+    }
+
+  return job;
+}
+
+static void
+gimp_imagefile_thumb_job_free (ThumbJob *job)
+{
+  thumb_jobs = g_list_remove (thumb_jobs, job);
+
+  if (job->weak_imagefile)
+    g_object_remove_weak_pointer (G_OBJECT (job->weak_imagefile),
+                                  (gpointer) &job->weak_imagefile);
+
+  g_object_unref (job->imagefile);
+  g_object_unref (job->thumbnail);
+
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+
+  g_clear_error (&job->error);
+
+  g_slice_free (ThumbJob, job);
+}
+
+static void
+gimp_imagefile_thumb_job_push (ThumbJob *job)
+{
+  thumb_jobs = g_list_prepend (thumb_jobs, job);
+
+  /*  after gimp_imagefile_flush_thumbnails(), run jobs right here  */
+  if (g_atomic_int_get (&thumb_exiting))
+    {
+      gimp_imagefile_thumb_job_run (job, NULL);
+      return;
+    }
+
+  if (! thumb_pool)
+    {
+      gint n_threads;
+
+      g_object_get (gegl_config (),
+                    "threads", &n_threads,
+                    NULL);
+
+      thumb_pool = g_thread_pool_new ((GFunc) gimp_imagefile_thumb_job_run,
+                                      NULL,
+                                      CLAMP (n_threads, 1, MAX_THUMB_THREADS),
+                                      FALSE, NULL);
+
+      g_thread_pool_set_sort_function (thumb_pool,
+                                       (GCompareDataFunc) gimp_imagefile_thumb_job_compare,
+                                       NULL);
+    }
+
+  g_thread_pool_push (thumb_pool, job, NULL);
+}
+
+static gint
+gimp_imagefile_thumb_job_compare (const ThumbJob *job1,
+                                  const ThumbJob *job2,
+                                  gpointer        data)
+{
+  /*  previews first, the most recently requested ones are those
+   *  currently on screen; thumbnails are saved in order
+   */
+  if (job1->type != job2->type)
+    return job1->type == THUMB_JOB_LOAD ? -1 : 1;
+
+  if (job1->type == THUMB_JOB_LOAD)
+    return job1->serial > job2->serial ? -1 : 1;
+  else
+    return job1->serial < job2->serial ? -1 : 1;
+}
+
+static void
+gimp_imagefile_thumb_job_run (ThumbJob *job,
+                              gpointer  data)
+{
+  switch (job->type)
+    {
+    case THUMB_JOB_LOAD:
+      if (! g_atomic_int_get (&thumb_exiting))
+        job->pixbuf = gimp_imagefile_load_thumb (job->thumbnail,
+                                                 job->width, job->height,
+                                                 &job->error);
+      break;
+
+    case THUMB_JOB_SAVE:
+      g_mutex_lock (&thumb_save_mutex);
+
+      if (! job->cancelled)
+        job->success = gimp_thumbnail_save_thumb (job->thumbnail,
+                                                  job->pixbuf,
+                                                  "GIMP " GIMP_VERSION,
+                                                  &job->error);
+
+      g_mutex_unlock (&thumb_save_mutex);
+      break;
+    }
+
+  g_idle_add ((GSourceFunc) gimp_imagefile_thumb_job_done, job);
+}
+
+static gboolean
+gimp_imagefile_thumb_job_done (ThumbJob *job)
+{
+  GimpImagefile        *imagefile = job->imagefile;
+  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
+  GimpThumbnail        *thumbnail = private->thumbnail;
+  GimpThumbnail        *copy      = job->thumbnail;
+  gboolean              same_uri;
+
+  same_uri = ! g_strcmp0 (thumbnail->image_uri, copy->image_uri);
+
+  switch (job->type)
+    {
+    case THUMB_JOB_LOAD:
+      private->load_job = NULL;
+
+      /*  skipped, see gimp_imagefile_flush_thumbnails()  */
+      if (g_atomic_int_get (&thumb_exiting))
+        break;
+
+      if (! same_uri || job->previews_stamp != private->previews_stamp)
+        {
+          /*  outdated, have the views ask again  */
+          gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
+          break;
+        }
+
+      /*  loading the thumbnail also read the image info stored in it  */
+      g_object_set (thumbnail,
+                    "image-state",      copy->image_state,
+                    "image-mtime",      copy->image_mtime,
+                    "image-filesize",   copy->image_filesize,
+                    "image-mimetype",   copy->image_mimetype,
+                    "image-width",      copy->image_width,
+                    "image-height",     copy->image_height,
+                    "image-type",       copy->image_type,
+                    "image-num-layers", copy->image_num_layers,
+                    "thumb-state",      copy->thumb_state,
+                    NULL);
+
+      if (job->pixbuf)
+        {
+          ThumbPreview *preview = g_slice_new (ThumbPreview);
+
+          preview->width  = job->width;
+          preview->height = job->height;
+          preview->pixbuf = g_object_ref (job->pixbuf);
+
+          private->previews = g_list_prepend (private->previews, preview);
+
+          gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
+        }
+      else if (job->error)
+        {
+          gimp_message (private->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        _("Could not open thumbnail '%s': %s"),
+                        copy->thumb_filename, job->error->message);
+        }
+      break;
+
+    case THUMB_JOB_SAVE:
+      private->save_job = NULL;
+
+      if (job->success)
+        {
+          if (same_uri)
+            {
+              if (job->replace)
+                gimp_thumbnail_delete_others (thumbnail, job->size);
+              else
+                gimp_thumbnail_delete_failure (thumbnail);
+
+              if (gimp_thumbnail_peek_thumb (thumbnail, job->size) ==
+                  GIMP_THUMB_STATE_EXISTS &&
+                  copy->thumb_state == GIMP_THUMB_STATE_OK)
+                {
+                  g_object_set (thumbnail,
+                                "thumb-state", GIMP_THUMB_STATE_OK,
+                                NULL);
+                }
+            }
+
+          gimp_imagefile_update (imagefile);
+
+          if (job->weak_imagefile)
+            gimp_imagefile_update (job->weak_imagefile);
+        }
+      else if (! job->cancelled)
+        {
+          if (same_uri)
+            g_object_set (thumbnail,
+                          "thumb-state", GIMP_THUMB_STATE_FAILED,
+                          NULL);
+
+          if (job->weak_imagefile)
+            g_object_set (gimp_imagefile_get_thumbnail (job->weak_imagefile),
+                          "thumb-state", GIMP_THUMB_STATE_FAILED,
+                          NULL);
+
+          if (job->error)
+            gimp_message_literal (private->gimp, NULL, GIMP_MESSAGE_ERROR,
+                                  job->error->message);
+        }
+
+      if (private->next_save_job)
+        {
+          private->save_job      = private->next_save_job;
+          private->next_save_job = NULL;
+
+          gimp_imagefile_thumb_job_push (private->save_job);
+        }
+      break;
+    }
+
+  gimp_imagefile_thumb_job_free (job);
+
+  return FALSE;
 }
 
 static void
@@ -86,5 +86,7 @@ gboolean        gimp_imagefile_save_thumbnail        (GimpImagefile  *imagefile,
                                                       GError        **error);
 const gchar   * gimp_imagefile_get_desc_string       (GimpImagefile  *imagefile);
 
+void            gimp_imagefile_flush_thumbnails      (void);
+
 
 #endif /* __GIMP_IMAGEFILE_H__ */
@@ -30,68 +30,135 @@
 
 #include "gegl/gimp-babl.h"
 
+#include "gimp-parallel.h"
 #include "gimp-utils.h" /* GIMP_TIMER */
 #include "gimppickable.h"
 #include "gimppickable-contiguous-region.h"
 
 
+/*  the size of the square blocks the buffer is split into for the threads  */
+#define BLOCK_SIZE  256
+
+/*  the most region labels a block can have on its border  */
+#define BORDER_SIZE (4 * BLOCK_SIZE)
+
+
+typedef enum
+{
+  REGION_PASS_LABEL,
+  REGION_PASS_MASK
+} RegionPass;
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  GeglBuffer          *distance_map;
+  const Babl          *format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  const gfloat        *col;
+
+  GeglRectangle        extent;
+  gint                 n_blocks_x;
+  gint                 n_blocks;
+  volatile gint        next_block;
+} DistanceData;
+
+typedef struct
+{
+  GeglBuffer          *distance_map;
+  GeglBuffer          *mask_buffer;
+  gboolean             antialias;
+  gfloat               threshold;
+  gboolean             diagonal_neighbors;
+  RegionPass           pass;
+
+  gint                *row_labels;  /* the labels of each block row's top
+                                     * and bottom pixel rows
+                                     */
+  gint                *col_labels;  /* the labels of each block column's
+                                     * left and right pixel columns
+                                     */
+  gint                *parent;      /* union-find over the border labels */
+
+  gint                 seed_x;
+  gint                 seed_y;
+  gint                 seed_block;
+  gint                 seed_label;  /* the seed's label inside its block */
+  gint                 seed_id;     /* the seed's border label, or -1    */
+
+  GeglRectangle        extent;
+  gint                 n_blocks_x;
+  gint                 n_blocks_y;
+  gint                 n_blocks;
+  volatile gint        next_block;
+} RegionData;
+
+typedef struct
+{
+  gfloat *dist;
+  gint   *labels;
+  gint   *ids;
+} RegionScratch;
+
+
 /*  local function prototypes  */
 
 static const Babl * choose_format         (GeglBuffer          *buffer,
                                            GimpSelectCriterion  select_criterion,
                                            gint                *n_components,
                                            gboolean            *has_alpha);
-static gfloat   pixel_difference          (const gfloat        *col1,
+static gfloat   pixel_distance            (const gfloat        *col1,
                                            const gfloat        *col2,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
                                            gint                 n_components,
                                            gboolean             has_alpha,
                                            gboolean             select_transparent,
                                            GimpSelectCriterion  select_criterion);
-static void     push_segment              (GQueue              *segment_queue,
-                                           gint                 y,
-                                           gint                 old_y,
-                                           gint                 start,
-                                           gint                 end,
-                                           gint                 new_y,
-                                           gint                 new_start,
-                                           gint                 new_end);
-static void     pop_segment               (GQueue              *segment_queue,
-                                           gint                *y,
-                                           gint                *old_y,
-                                           gint                *start,
-                                           gint                *end);
-static gboolean find_contiguous_segment   (const gfloat        *col,
-                                           GeglBuffer          *src_buffer,
-                                           GeglBuffer          *mask_buffer,
-                                           const Babl          *src_format,
-                                           const Babl          *mask_format,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gint                 width,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
+static gfloat   pixel_difference          (gfloat               distance,
                                            gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 initial_x,
-                                           gint                 initial_y,
-                                           gint                *start,
-                                           gint                *end,
-                                           gfloat              *row);
-static void     find_contiguous_region    (GeglBuffer          *src_buffer,
+                                           gfloat               threshold);
+static void     get_block                 (const GeglRectangle *extent,
+                                           gint                 n_blocks_x,
+                                           gint                 index,
+                                           GeglRectangle       *block);
+static void     distance_thread           (gint                 part,
+                                           gint                 n_parts,
+                                           gpointer             user_data);
+static gint     find_root                 (gint                *parent,
+                                           gint                 i);
+static void     union_labels              (gint                *parent,
+                                           gint                 a,
+                                           gint                 b);
+static void     label_block               (RegionData          *data,
+                                           const GeglRectangle *block,
+                                           RegionScratch       *scratch);
+static gint     border_id                 (RegionScratch       *scratch,
+                                           gint                 i,
+                                           gint                 base,
+                                           gint                *n_ids);
+static void     assign_border_ids         (RegionData          *data,
+                                           const GeglRectangle *block,
+                                           gint                 index,
+                                           RegionScratch       *scratch);
+static void     reset_border_ids          (const GeglRectangle *block,
+                                           RegionScratch       *scratch);
+static void     mask_block                (RegionData          *data,
+                                           const GeglRectangle *block,
+                                           gint                 index,
+                                           RegionScratch       *scratch);
+static void     region_thread             (gint                 part,
+                                           gint                 n_parts,
+                                           gpointer             user_data);
+static void     merge_blocks              (RegionData          *data);
+static void     find_contiguous_region    (GeglBuffer          *distance_map,
                                            GeglBuffer          *mask_buffer,
-                                           const Babl          *format,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
                                            gboolean             antialias,
                                            gfloat               threshold,
                                            gboolean             diagonal_neighbors,
                                            gint                 x,
-                                           gint                 y,
-                                           const gfloat        *col);
+                                           gint                 y);
 
 
 /*  public functions  */
@@ -106,13 +173,67 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
                                          gint                 x,
                                          gint                 y)
 {
-  GeglBuffer    *src_buffer;
+  GeglBuffer    *distance_map;
   GeglBuffer    *mask_buffer;
-  const Babl    *format;
   GeglRectangle  extent;
-  gint           n_components;
-  gboolean       has_alpha;
-  gfloat         start_col[MAX_CHANNELS];
+
+  g_return_val_if_fail (GIMP_IS_PICKABLE (pickable), NULL);
+
+  gimp_pickable_flush (pickable);
+
+  extent = *gegl_buffer_get_extent (gimp_pickable_get_buffer (pickable));
+
+  if (x <  extent.x || x >= (extent.x + extent.width) ||
+      y <  extent.y || y >= (extent.y + extent.height))
+    {
+      return gegl_buffer_new (&extent, babl_format ("Y float"));
+    }
+
+  distance_map = gimp_pickable_contiguous_region_distance_map (pickable,
+                                                               select_transparent,
+                                                               select_criterion,
+                                                               x, y);
+
+  mask_buffer =
+    gimp_pickable_contiguous_region_by_distance_map (distance_map,
+                                                     antialias, threshold,
+                                                     diagonal_neighbors,
+                                                     x, y);
+
+  g_object_unref (distance_map);
+
+  return mask_buffer;
+}
+
+/**
+ * gimp_pickable_contiguous_region_distance_map:
+ * @pickable:           a #GimpPickable
+ * @select_transparent: whether transparent pixels are compared by alpha
+ * @select_criterion:   which channels to compare
+ * @x:                  the seed's x coordinate
+ * @y:                  the seed's y coordinate
+ *
+ * Computes how far the color of each pixel of @pickable is from the
+ * color at (@x, @y).  Pixels which must never be selected get
+ * G_MAXFLOAT.  The map does not depend on the threshold, so it can be
+ * reused while only the threshold changes.
+ *
+ * Return value: a new "Y float" buffer covering @pickable's extent.
+ **/
+GeglBuffer *
+gimp_pickable_contiguous_region_distance_map (GimpPickable        *pickable,
+                                              gboolean             select_transparent,
+                                              GimpSelectCriterion  select_criterion,
+                                              gint                 x,
+                                              gint                 y)
+{
+  DistanceData  data;
+  GeglBuffer   *src_buffer;
+  GeglBuffer   *distance_map;
+  const Babl   *format;
+  gint          n_components;
+  gboolean      has_alpha;
+  gfloat        start_col[MAX_CHANNELS];
 
   g_return_val_if_fail (GIMP_IS_PICKABLE (pickable), NULL);
 
@@ -142,7 +263,57 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
       select_transparent = FALSE;
     }
 
-  extent = *gegl_buffer_get_extent (src_buffer);
+  distance_map = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
+                                  babl_format ("Y float"));
+
+  data.src_buffer         = src_buffer;
+  data.distance_map       = distance_map;
+  data.format             = format;
+  data.n_components       = n_components;
+  data.has_alpha          = has_alpha;
+  data.select_transparent = select_transparent;
+  data.select_criterion   = select_criterion;
+  data.col                = start_col;
+  data.extent             = *gegl_buffer_get_extent (src_buffer);
+  data.n_blocks_x         = (data.extent.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  data.n_blocks           = (data.extent.height + BLOCK_SIZE - 1) / BLOCK_SIZE *
+                            data.n_blocks_x;
+  data.next_block         = 0;
+
+  gimp_parallel_distribute (data.n_blocks, distance_thread, &data);
+
+  return distance_map;
+}
+
+/**
+ * gimp_pickable_contiguous_region_by_distance_map:
+ * @distance_map:       a map returned by
+ *                      gimp_pickable_contiguous_region_distance_map()
+ * @antialias:          whether to antialias the region's edge
+ * @threshold:          the largest distance which is selected
+ * @diagonal_neighbors: whether diagonal pixels are connected
+ * @x:                  the seed's x coordinate
+ * @y:                  the seed's y coordinate
+ *
+ * Finds the region connected to (@x, @y) whose pixels are within
+ * @threshold in @distance_map.
+ *
+ * Return value: a new "Y float" mask buffer of @distance_map's extent.
+ **/
+GeglBuffer *
+gimp_pickable_contiguous_region_by_distance_map (GeglBuffer *distance_map,
+                                                 gboolean    antialias,
+                                                 gfloat      threshold,
+                                                 gboolean    diagonal_neighbors,
+                                                 gint        x,
+                                                 gint        y)
+{
+  GeglBuffer    *mask_buffer;
+  GeglRectangle  extent;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (distance_map), NULL);
+
+  extent = *gegl_buffer_get_extent (distance_map);
 
   mask_buffer = gegl_buffer_new (&extent, babl_format ("Y float"));
 
@@ -151,11 +322,9 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
     {
       GIMP_TIMER_START();
 
-      find_contiguous_region (src_buffer, mask_buffer,
-                              format, n_components, has_alpha,
-                              select_transparent, select_criterion,
+      find_contiguous_region (distance_map, mask_buffer,
                               antialias, threshold, diagonal_neighbors,
-                              x, y, start_col);
+                              x, y);
 
       GIMP_TIMER_END("foo");
     }
@@ -232,13 +401,13 @@ gimp_pickable_contiguous_region_by_color (GimpPickable        *pickable,
       while (count--)
         {
           /*  Find how closely the colors match  */
-          *dest = pixel_difference (start_col, src,
+          *dest = pixel_difference (pixel_distance (start_col, src,
+                                                    n_components,
+                                                    has_alpha,
+                                                    select_transparent,
+                                                    select_criterion),
                                     antialias,
-                                    threshold,
-                                    n_components,
-                                    has_alpha,
-                                    select_transparent,
-                                    select_criterion);
+                                    threshold);
 
           src  += n_components;
           dest += 1;
@@ -305,20 +474,18 @@ choose_format (GeglBuffer          *buffer,
 }
 
 static gfloat
-pixel_difference (const gfloat        *col1,
-                  const gfloat        *col2,
-                  gboolean             antialias,
-                  gfloat               threshold,
-                  gint                 n_components,
-                  gboolean             has_alpha,
-                  gboolean             select_transparent,
-                  GimpSelectCriterion  select_criterion)
+pixel_distance (const gfloat        *col1,
+                const gfloat        *col2,
+                gint                 n_components,
+                gboolean             has_alpha,
+                gboolean             select_transparent,
+                GimpSelectCriterion  select_criterion)
 {
   gfloat max = 0.0;
 
   /*  if there is an alpha channel, never select transparent regions  */
   if (! select_transparent && has_alpha && col2[n_components - 1] == 0.0)
-    return 0.0;
+    return G_MAXFLOAT;
 
   if (select_transparent && has_alpha)
     {
@@ -387,9 +554,17 @@ pixel_difference (const gfloat        *col1,
         }
     }
 
+  return max;
+}
+
+static gfloat
+pixel_difference (gfloat   distance,
+                  gboolean antialias,
+                  gfloat   threshold)
+{
   if (antialias && threshold > 0.0)
     {
-      gfloat aa = 1.5 - (max / threshold);
+      gfloat aa = 1.5 - (distance / threshold);
 
       if (aa <= 0.0)
         return 0.0;
@@ -400,7 +575,7 @@ pixel_difference (const gfloat        *col1,
     }
   else
     {
-      if (max > threshold)
+      if (distance > threshold)
         return 0.0;
       else
         return 1.0;
@@ -408,280 +583,463 @@ pixel_difference (const gfloat        *col1,
 }
 
 static void
-push_segment (GQueue *segment_queue,
-              gint    y,
-              gint    old_y,
-              gint    start,
-              gint    end,
-              gint    new_y,
-              gint    new_start,
-              gint    new_end)
+get_block (const GeglRectangle *extent,
+           gint                 n_blocks_x,
+           gint                 index,
+           GeglRectangle       *block)
 {
-  /* To avoid excessive memory allocation (y, old_y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [old_y1] [start1] [end1] [y2] [old_y2] [start2] [end2]
-   */
+  GeglRectangle rect;
+
+  rect.x      = extent->x + (index % n_blocks_x) * BLOCK_SIZE;
+  rect.y      = extent->y + (index / n_blocks_x) * BLOCK_SIZE;
+  rect.width  = BLOCK_SIZE;
+  rect.height = BLOCK_SIZE;
 
-  if (new_y != old_y)
+  gegl_rectangle_intersect (block, &rect, extent);
+}
+
+static void
+distance_thread (gint     part,
+                 gint     n_parts,
+                 gpointer user_data)
+{
+  DistanceData *data = user_data;
+  gint          i;
+
+  while ((i = g_atomic_int_add (&data->next_block, 1)) < data->n_blocks)
     {
-      /* If the new segment's y-coordinate is different than the old (source)
-       * segment's y-coordinate, push the entire segment.
-       */
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_start));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_end));
+      GeglBufferIterator *iter;
+      GeglRectangle       block;
+
+      get_block (&data->extent, data->n_blocks_x, i, &block);
+
+      iter = gegl_buffer_iterator_new (data->src_buffer,
+                                       &block, 0, data->format,
+                                       GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+      gegl_buffer_iterator_add (iter, data->distance_map,
+                                &block, 0, babl_format ("Y float"),
+                                GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          const gfloat *src   = iter->data[0];
+          gfloat       *dest  = iter->data[1];
+          gint          count = iter->length;
+
+          while (count--)
+            {
+              *dest = pixel_distance (data->col, src,
+                                      data->n_components,
+                                      data->has_alpha,
+                                      data->select_transparent,
+                                      data->select_criterion);
+
+              src  += data->n_components;
+              dest += 1;
+            }
+        }
     }
-  else
+}
+
+static gint
+find_root (gint *parent,
+           gint  i)
+{
+  while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+
+  return i;
+}
+
+static void
+union_labels (gint *parent,
+              gint  a,
+              gint  b)
+{
+  if (a < 0 || b < 0)
+    return;
+
+  a = find_root (parent, a);
+  b = find_root (parent, b);
+
+  /*  the smaller label always becomes the root, which keeps the
+   *  labeling of a block independent of the thread doing it
+   */
+  if (a < b)
+    parent[b] = a;
+  else if (b < a)
+    parent[a] = b;
+}
+
+static void
+label_block (RegionData          *data,
+             const GeglRectangle *block,
+             RegionScratch       *scratch)
+{
+  gfloat *dist   = scratch->dist;
+  gint   *labels = scratch->labels;
+  gint    width  = block->width;
+  gint    n      = block->width * block->height;
+  gint    i;
+
+  gegl_buffer_get (data->distance_map, block, 1.0,
+                   babl_format ("Y float"),
+                   dist, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  /*  every selected pixel starts as its own label, and is merged with
+   *  its already visited neighbors
+   */
+  for (i = 0; i < n; i++)
     {
-      /* Otherwise, only push the set-difference between the new segment and
-       * the source segment (since we've already scanned the source segment.)
-       * Note that the `+ 1` and `- 1` terms of the end/start coordinates below
-       * are only necessary when `diagonal_neighbors` is on (and otherwise make
-       * the segments slightly larger than necessary), but, meh...
-       */
-      if (new_start < start)
+      gint x = i % width;
+
+      if (pixel_difference (dist[i], data->antialias, data->threshold) == 0.0)
         {
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_start));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (start + 1));
+          labels[i] = -1;
+          continue;
         }
 
-      if (new_end > end)
+      labels[i] = i;
+
+      if (x > 0 && labels[i - 1] >= 0)
+        union_labels (labels, i, i - 1);
+
+      if (i >= width)
         {
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (end - 1));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_end));
+          if (labels[i - width] >= 0)
+            union_labels (labels, i, i - width);
+
+          if (data->diagonal_neighbors)
+            {
+              if (x > 0 && labels[i - width - 1] >= 0)
+                union_labels (labels, i, i - width - 1);
+
+              if (x < width - 1 && labels[i - width + 1] >= 0)
+                union_labels (labels, i, i - width + 1);
+            }
         }
     }
-}
 
-static void
-pop_segment (GQueue *segment_queue,
-             gint   *y,
-             gint   *old_y,
-             gint   *start,
-             gint   *end)
-{
-  *y     = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *old_y = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *start = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *end   = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
+  /*  resolve each pixel to its component's root label  */
+  for (i = 0; i < n; i++)
+    {
+      if (labels[i] >= 0)
+        labels[i] = find_root (labels, i);
+    }
 }
 
-/* #define FETCH_ROW 1 */
-
-static gboolean
-find_contiguous_segment (const gfloat        *col,
-                         GeglBuffer          *src_buffer,
-                         GeglBuffer          *mask_buffer,
-                         const Babl          *src_format,
-                         const Babl          *mask_format,
-                         gint                 n_components,
-                         gboolean             has_alpha,
-                         gint                 width,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gfloat               threshold,
-                         gint                 initial_x,
-                         gint                 initial_y,
-                         gint                *start,
-                         gint                *end,
-                         gfloat              *row)
+static gint
+border_id (RegionScratch *scratch,
+           gint           i,
+           gint           base,
+           gint          *n_ids)
 {
-  gfloat *s;
-  gfloat  mask_row[width];
-  gfloat  diff;
-
-#ifdef FETCH_ROW
-  gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, initial_y, width, 1), 1.0,
-                   src_format,
-                   row, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-  s = row + initial_x * n_components;
-#else
-  s = g_alloca (n_components * sizeof (gfloat));
-
-  gegl_buffer_sample (src_buffer, initial_x, initial_y, NULL, s, src_format,
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#endif
+  gint label = scratch->labels[i];
 
-  diff = pixel_difference (col, s, antialias, threshold,
-                           n_components, has_alpha, select_transparent,
-                           select_criterion);
+  if (label < 0)
+    return -1;
 
-  /* check the starting pixel */
-  if (! diff)
-    return FALSE;
+  if (scratch->ids[label] < 0)
+    scratch->ids[label] = base + (*n_ids)++;
 
-  mask_row[initial_x] = diff;
+  return scratch->ids[label];
+}
 
-  *start = initial_x - 1;
-#ifdef FETCH_ROW
-  s = row + *start * n_components;
-#endif
+static void
+assign_border_ids (RegionData          *data,
+                   const GeglRectangle *block,
+                   gint                 index,
+                   RegionScratch       *scratch)
+{
+  gint  width  = data->extent.width;
+  gint  height = data->extent.height;
+  gint  bx     = index % data->n_blocks_x;
+  gint  by     = index / data->n_blocks_x;
+  gint  base   = index * BORDER_SIZE;
+  gint  n_ids  = 0;
+  gint *top;
+  gint *bottom;
+  gint *left;
+  gint *right;
+  gint  i;
+
+  top    = data->row_labels + (2 * by)     * width + block->x - data->extent.x;
+  bottom = data->row_labels + (2 * by + 1) * width + block->x - data->extent.x;
+  left   = data->col_labels + (2 * bx)     * height + block->y - data->extent.y;
+  right  = data->col_labels + (2 * bx + 1) * height + block->y - data->extent.y;
+
+  /*  the components touching the block's border get labels which are
+   *  unique over the whole buffer; the pixel order is fixed, so both
+   *  passes hand out the same labels
+   */
+  for (i = 0; i < block->width; i++)
+    {
+      top[i]    = border_id (scratch, i, base, &n_ids);
+      bottom[i] = border_id (scratch, (block->height - 1) * block->width + i,
+                             base, &n_ids);
+    }
 
-  while (*start >= 0)
+  for (i = 0; i < block->height; i++)
     {
-#ifndef FETCH_ROW
-      gegl_buffer_sample (src_buffer, *start, initial_y, NULL, s, src_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#endif
-
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
-      if (diff == 0.0)
-        break;
-
-      mask_row[*start] = diff;
-
-      (*start)--;
-#ifdef FETCH_ROW
-      s -= n_components;
-#endif
+      left[i]  = border_id (scratch, i * block->width, base, &n_ids);
+      right[i] = border_id (scratch, i * block->width + block->width - 1,
+                            base, &n_ids);
     }
+}
 
-  *end = initial_x + 1;
-#ifdef FETCH_ROW
-  s = row + *end * n_components;
-#endif
+static void
+reset_border_ids (const GeglRectangle *block,
+                  RegionScratch       *scratch)
+{
+  gint i;
 
-  while (*end < width)
+  for (i = 0; i < block->width; i++)
     {
-#ifndef FETCH_ROW
-      gegl_buffer_sample (src_buffer, *end, initial_y, NULL, s, src_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#endif
-
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
-      if (diff == 0.0)
-        break;
-
-      mask_row[*end] = diff;
-
-      (*end)++;
-#ifdef FETCH_ROW
-      s += n_components;
-#endif
+      gint top    = scratch->labels[i];
+      gint bottom = scratch->labels[(block->height - 1) * block->width + i];
+
+      if (top >= 0)
+        scratch->ids[top] = -1;
+
+      if (bottom >= 0)
+        scratch->ids[bottom] = -1;
     }
 
-  gegl_buffer_set (mask_buffer, GEGL_RECTANGLE (*start + 1, initial_y,
-                                                *end - *start - 1, 1),
-                   0, mask_format, &mask_row[*start + 1],
-                   GEGL_AUTO_ROWSTRIDE);
+  for (i = 0; i < block->height; i++)
+    {
+      gint left  = scratch->labels[i * block->width];
+      gint right = scratch->labels[i * block->width + block->width - 1];
+
+      if (left >= 0)
+        scratch->ids[left] = -1;
 
-  return TRUE;
+      if (right >= 0)
+        scratch->ids[right] = -1;
+    }
 }
 
 static void
-find_contiguous_region (GeglBuffer          *src_buffer,
-                        GeglBuffer          *mask_buffer,
-                        const Babl          *format,
-                        gint                 n_components,
-                        gboolean             has_alpha,
-                        gboolean             select_transparent,
-                        GimpSelectCriterion  select_criterion,
-                        gboolean             antialias,
-                        gfloat               threshold,
-                        gboolean             diagonal_neighbors,
-                        gint                 x,
-                        gint                 y,
-                        const gfloat        *col)
+mask_block (RegionData          *data,
+            const GeglRectangle *block,
+            gint                 index,
+            RegionScratch       *scratch)
 {
-  const Babl *mask_format = babl_format ("Y float");
-  gint        old_y;
-  gint        start, end;
-  gint        new_start, new_end;
-  GQueue     *segment_queue;
-  gfloat     *row = NULL;
+  gfloat   *dist     = scratch->dist;
+  gint     *labels   = scratch->labels;
+  gint      n        = block->width * block->height;
+  gboolean  selected = FALSE;
+  gint      i;
+
+  for (i = 0; i < n; i++)
+    {
+      gint label = labels[i];
+
+      if (label < 0)
+        {
+          dist[i] = 0.0;
+        }
+      else if (data->seed_id >= 0 ?
+               (scratch->ids[label] >= 0 &&
+                data->parent[scratch->ids[label]] == data->seed_id) :
+               (index == data->seed_block && label == data->seed_label))
+        {
+          dist[i] = pixel_difference (dist[i],
+                                      data->antialias, data->threshold);
+          selected = TRUE;
+        }
+      else
+        {
+          dist[i] = 0.0;
+        }
+    }
 
-#ifdef FETCH_ROW
-  row = g_new (gfloat, gegl_buffer_get_width (src_buffer) * n_components);
-#endif
+  if (selected)
+    gegl_buffer_set (data->mask_buffer, block, 0, babl_format ("Y float"),
+                     dist, GEGL_AUTO_ROWSTRIDE);
+}
 
-  segment_queue = g_queue_new ();
+static void
+region_thread (gint     part,
+               gint     n_parts,
+               gpointer user_data)
+{
+  RegionData    *data = user_data;
+  RegionScratch  scratch;
+  gint           i;
+
+  scratch.dist   = g_new  (gfloat, BLOCK_SIZE * BLOCK_SIZE);
+  scratch.labels = g_new  (gint,   BLOCK_SIZE * BLOCK_SIZE);
+  scratch.ids    = g_new  (gint,   BLOCK_SIZE * BLOCK_SIZE);
 
-  push_segment (segment_queue,
-                y, /* dummy values: */ -1, 0, 0,
-                y, x - 1, x + 1);
+  for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++)
+    scratch.ids[i] = -1;
 
-  do
+  while ((i = g_atomic_int_add (&data->next_block, 1)) < data->n_blocks)
     {
-      pop_segment (segment_queue,
-                   &y, &old_y, &start, &end);
+      GeglRectangle block;
 
-      for (x = start + 1; x < end; x++)
-        {
-          gfloat val;
+      get_block (&data->extent, data->n_blocks_x, i, &block);
+
+      label_block (data, &block, &scratch);
+
+      assign_border_ids (data, &block, i, &scratch);
 
-          gegl_buffer_sample (mask_buffer, x, y, NULL, &val,
-                              mask_format,
-                              GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-          if (val != 0.0)
+      if (data->pass == REGION_PASS_LABEL)
+        {
+          if (data->seed_x >= block.x && data->seed_x < block.x + block.width &&
+              data->seed_y >= block.y && data->seed_y < block.y + block.height)
             {
-              /* If the current pixel is selected, then we've already visited
-               * the next pixel.  (Note that we assume that the maximal image
-               * width is sufficiently low that `x` won't overflow.)
-               */
-              x++;
-              continue;
+              gint label = scratch.labels[(data->seed_y - block.y) * block.width +
+                                          (data->seed_x - block.x)];
+
+              data->seed_block = i;
+              data->seed_label = label;
+              data->seed_id    = label >= 0 ? scratch.ids[label] : -1;
             }
+        }
+      else
+        {
+          mask_block (data, &block, i, &scratch);
+        }
 
-          if (! find_contiguous_segment (col, src_buffer, mask_buffer,
-                                         format, mask_format,
-                                         n_components,
-                                         has_alpha,
-                                         gegl_buffer_get_width (src_buffer),
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x, y,
-                                         &new_start, &new_end,
-                                         row))
+      reset_border_ids (&block, &scratch);
+    }
+
+  g_free (scratch.dist);
+  g_free (scratch.labels);
+  g_free (scratch.ids);
+}
+
+static void
+merge_blocks (RegionData *data)
+{
+  gint width  = data->extent.width;
+  gint height = data->extent.height;
+  gint i, j;
+
+  /*  join the components which touch across horizontal block borders;
+   *  the label rows span the whole buffer, so this also joins the
+   *  diagonal neighbors at block corners
+   */
+  for (i = 1; i < data->n_blocks_y; i++)
+    {
+      const gint *above = data->row_labels + (2 * i - 1) * width;
+      const gint *below = data->row_labels + (2 * i)     * width;
+
+      for (j = 0; j < width; j++)
+        {
+          if (above[j] < 0)
             continue;
 
-          /* We can skip directly to `new_end + 1` on the next iteration, since
-           * we've just selected all pixels in the range `[x, new_end)`, and
-           * the pixel at `new_end` is above threshold.  (Note that we assume
-           * that the maximal image width is sufficiently low that `x` won't
-           * overflow.)
-           */
-          x = new_end;
+          union_labels (data->parent, above[j], below[j]);
 
-          if (diagonal_neighbors)
+          if (data->diagonal_neighbors)
             {
-              if (new_start >= 0)
-                new_start--;
+              if (j > 0)
+                union_labels (data->parent, above[j], below[j - 1]);
 
-              if (new_end < gegl_buffer_get_width (src_buffer))
-                new_end++;
+              if (j < width - 1)
+                union_labels (data->parent, above[j], below[j + 1]);
             }
+        }
+    }
 
-          if (y + 1 < gegl_buffer_get_height (src_buffer))
-            {
-              push_segment (segment_queue,
-                            y, old_y, start, end,
-                            y + 1, new_start, new_end);
-            }
+  /*  and across vertical block borders  */
+  for (i = 1; i < data->n_blocks_x; i++)
+    {
+      const gint *left  = data->col_labels + (2 * i - 1) * height;
+      const gint *right = data->col_labels + (2 * i)     * height;
 
-          if (y - 1 >= 0)
+      for (j = 0; j < height; j++)
+        {
+          if (left[j] < 0)
+            continue;
+
+          union_labels (data->parent, left[j], right[j]);
+
+          if (data->diagonal_neighbors)
             {
-              push_segment (segment_queue,
-                            y, old_y, start, end,
-                            y - 1, new_start, new_end);
-            }
+              if (j > 0)
+                union_labels (data->parent, left[j], right[j - 1]);
 
+              if (j < height - 1)
+                union_labels (data->parent, left[j], right[j + 1]);
+            }
         }
     }
-  while (! g_queue_is_empty (segment_queue));
+}
+
+/*  The region is found as a connected component: each block is labeled
+ *  on its own, the labels touching block borders are joined in a small
+ *  union-find, and the blocks containing the seed's component write the
+ *  mask.  Both block passes run on as many threads as GEGL uses.
+ */
+static void
+find_contiguous_region (GeglBuffer *distance_map,
+                        GeglBuffer *mask_buffer,
+                        gboolean    antialias,
+                        gfloat      threshold,
+                        gboolean    diagonal_neighbors,
+                        gint        x,
+                        gint        y)
+{
+  RegionData data;
+  gint       n_ids;
+  gint       i;
+
+  data.distance_map       = distance_map;
+  data.mask_buffer        = mask_buffer;
+  data.antialias          = antialias;
+  data.threshold          = threshold;
+  data.diagonal_neighbors = diagonal_neighbors;
+  data.seed_x             = x;
+  data.seed_y             = y;
+  data.seed_block         = -1;
+  data.seed_label         = -1;
+  data.seed_id            = -1;
+  data.extent             = *gegl_buffer_get_extent (distance_map);
+  data.n_blocks_x         = (data.extent.width  + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  data.n_blocks_y         = (data.extent.height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  data.n_blocks           = data.n_blocks_x * data.n_blocks_y;
+
+  n_ids = data.n_blocks * BORDER_SIZE;
+
+  data.row_labels = g_new (gint, 2 * data.n_blocks_y * data.extent.width);
+  data.col_labels = g_new (gint, 2 * data.n_blocks_x * data.extent.height);
+  data.parent     = g_new (gint, n_ids);
+
+  for (i = 0; i < n_ids; i++)
+    data.parent[i] = i;
+
+  data.pass       = REGION_PASS_LABEL;
+  data.next_block = 0;
+
+  gimp_parallel_distribute (data.n_blocks, region_thread, &data);
+
+  /*  the seed pixel itself is not selected  */
+  if (data.seed_label < 0)
+    goto out;
+
+  merge_blocks (&data);
+
+  /*  flatten the union-find, so the mask pass only reads it  */
+  for (i = 0; i < n_ids; i++)
+    data.parent[i] = find_root (data.parent, i);
+
+  if (data.seed_id >= 0)
+    data.seed_id = data.parent[data.seed_id];
+
+  data.pass       = REGION_PASS_MASK;
+  data.next_block = 0;
 
-  g_queue_free (segment_queue);
+  gimp_parallel_distribute (data.n_blocks, region_thread, &data);
 
-#ifdef FETCH_ROW
-  g_free (row);
-#endif
+ out:
+  g_free (data.row_labels);
+  g_free (data.col_labels);
+  g_free (data.parent);
 }
@@ -28,6 +28,20 @@ GeglBuffer * gimp_pickable_contiguous_region_by_seed  (GimpPickable        *pick
                                                        gint                 x,
                                                        gint                 y);
 
+GeglBuffer * gimp_pickable_contiguous_region_distance_map
+                                                      (GimpPickable        *pickable,
+                                                       gboolean             select_transparent,
+                                                       GimpSelectCriterion  select_criterion,
+                                                       gint                 x,
+                                                       gint                 y);
+GeglBuffer * gimp_pickable_contiguous_region_by_distance_map
+                                                      (GeglBuffer          *distance_map,
+                                                       gboolean             antialias,
+                                                       gfloat               threshold,
+                                                       gboolean             diagonal_neighbors,
+                                                       gint                 x,
+                                                       gint                 y);
+
 GeglBuffer * gimp_pickable_contiguous_region_by_color (GimpPickable        *pickable,
                                                        gboolean             antialias,
                                                        gfloat               threshold,
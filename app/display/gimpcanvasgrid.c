@@ -35,6 +35,7 @@
 #include "gimpcanvas-style.h"
 #include "gimpcanvasgrid.h"
 #include "gimpdisplayshell.h"
+#include "gimpdisplayshell-transform.h"
 
 
 enum
@@ -73,6 +74,13 @@ static void             gimp_canvas_grid_get_property (GObject        *object,
 static void             gimp_canvas_grid_draw         (GimpCanvasItem *item,
                                                        cairo_t        *cr);
 static cairo_region_t * gimp_canvas_grid_get_extents  (GimpCanvasItem *item);
+static void             gimp_canvas_grid_get_lines    (gdouble         offset,
+                                                       gdouble         spacing,
+                                                       gdouble         size,
+                                                       gdouble         min,
+                                                       gdouble         max,
+                                                       gint           *first,
+                                                       gint           *last);
 static void             gimp_canvas_grid_stroke       (GimpCanvasItem *item,
                                                        cairo_t        *cr);
 
@@ -198,6 +206,10 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
   gint                   y0, y1, y2, y3;
   gint                   x_real, y_real;
   gint                   width, height;
+  gdouble                ix1, iy1, ix2, iy2;
+  gint                   first_x = 0, last_x = -1;
+  gint                   first_y = 0, last_y = -1;
+  gint                   i, j;
 
 #define CROSSHAIR 2
 
@@ -229,14 +241,32 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
   xoffset = fmod (xoffset, xspacing);
   yoffset = fmod (yoffset, yspacing);
 
+  /*  only visit the grid lines that can touch the exposed area  */
+  gimp_display_shell_unzoom_xy_f (shell,
+                                  x1 - CROSSHAIR - 1, y1 - CROSSHAIR - 1,
+                                  &ix1, &iy1);
+  gimp_display_shell_unzoom_xy_f (shell,
+                                  x2 + CROSSHAIR + 1, y2 + CROSSHAIR + 1,
+                                  &ix2, &iy2);
+
+  if (vert)
+    gimp_canvas_grid_get_lines (xoffset, xspacing, width, ix1, ix2,
+                                &first_x, &last_x);
+
+  if (horz)
+    gimp_canvas_grid_get_lines (yoffset, yspacing, height, iy1, iy2,
+                                &first_y, &last_y);
+
   switch (gimp_grid_get_style (private->grid))
     {
     case GIMP_GRID_DOTS:
       if (vert && horz)
         {
-          for (x = xoffset; x <= width; x += xspacing)
+          for (i = first_x; i <= last_x; i++)
             {
-              if (x < 0)
+              x = xoffset + i * xspacing;
+
+              if (x < 0 || x > width)
                 continue;
 
               gimp_canvas_item_transform_xy (item, x, 0, &x_real, &y_real);
@@ -244,9 +274,11 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
               if (x_real < x1 || x_real >= x2)
                 continue;
 
-              for (y = yoffset; y <= height; y += yspacing)
+              for (j = first_y; j <= last_y; j++)
                 {
-                  if (y < 0)
+                  y = yoffset + j * yspacing;
+
+                  if (y < 0 || y > height)
                     continue;
 
                   gimp_canvas_item_transform_xy (item, x, y, &x_real, &y_real);
@@ -264,9 +296,11 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
     case GIMP_GRID_INTERSECTIONS:
       if (vert && horz)
         {
-          for (x = xoffset; x <= width; x += xspacing)
+          for (i = first_x; i <= last_x; i++)
             {
-              if (x < 0)
+              x = xoffset + i * xspacing;
+
+              if (x < 0 || x > width)
                 continue;
 
               gimp_canvas_item_transform_xy (item, x, 0, &x_real, &y_real);
@@ -274,9 +308,11 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
               if (x_real + CROSSHAIR < x1 || x_real - CROSSHAIR >= x2)
                 continue;
 
-              for (y = yoffset; y <= height; y += yspacing)
+              for (j = first_y; j <= last_y; j++)
                 {
-                  if (y < 0)
+                  y = yoffset + j * yspacing;
+
+                  if (y < 0 || y > height)
                     continue;
 
                   gimp_canvas_item_transform_xy (item, x, y, &x_real, &y_real);
@@ -320,9 +356,11 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
 
       if (vert)
         {
-          for (x = xoffset; x < width; x += xspacing)
+          for (i = first_x; i <= last_x; i++)
             {
-              if (x < 0)
+              x = xoffset + i * xspacing;
+
+              if (x < 0 || x >= width)
                 continue;
 
               gimp_canvas_item_transform_xy (item, x, 0, &x_real, &y_real);
@@ -337,9 +375,11 @@ gimp_canvas_grid_draw (GimpCanvasItem *item,
 
       if (horz)
         {
-          for (y = yoffset; y < height; y += yspacing)
+          for (j = first_y; j <= last_y; j++)
             {
-              if (y < 0)
+              y = yoffset + j * yspacing;
+
+              if (y < 0 || y >= height)
                 continue;
 
               gimp_canvas_item_transform_xy (item, 0, y, &x_real, &y_real);
@@ -383,6 +423,25 @@ gimp_canvas_grid_get_extents (GimpCanvasItem *item)
   return cairo_region_create_rectangle (&rectangle);
 }
 
+/*  the range of line indices i, for lines at offset + i * spacing,
+ *  that lie within [min, max] and inside the image
+ */
+static void
+gimp_canvas_grid_get_lines (gdouble  offset,
+                            gdouble  spacing,
+                            gdouble  size,
+                            gdouble  min,
+                            gdouble  max,
+                            gint    *first,
+                            gint    *last)
+{
+  min = MAX (min, 0.0);
+  max = MIN (max, size);
+
+  *first = MAX (0, floor ((min - offset) / spacing));
+  *last  = ceil ((max - offset) / spacing);
+}
+
 static void
 gimp_canvas_grid_stroke (GimpCanvasItem *item,
                          cairo_t        *cr)
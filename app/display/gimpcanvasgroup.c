@@ -28,7 +28,10 @@
 
 #include "display-types.h"
 
+#include "core/gimpimage.h"
+
 #include "gimpcanvasgroup.h"
+#include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
 
 
@@ -42,12 +45,34 @@ enum
 
 struct _GimpCanvasGroupPrivate
 {
-  GQueue   *items;
-  gboolean  group_stroking;
-  gboolean  group_filling;
+  GQueue     *items;
+  gboolean    group_stroking;
+  gboolean    group_filling;
+
+  /*  the bounding box of each item's extents, so drawing can skip the
+   *  items outside the exposed area without asking them each time.
+   *  Entries are dropped when the item updates or changes, and all of
+   *  them when the shell's view or the image size changed since they
+   *  were computed.
+   */
+  GHashTable *extents;
+  gint        extents_offset_x;
+  gint        extents_offset_y;
+  gdouble     extents_scale_x;
+  gdouble     extents_scale_y;
+  gint        extents_width;
+  gint        extents_height;
+  gint        extents_image_width;
+  gint        extents_image_height;
 };
 
 
+typedef struct
+{
+  cairo_rectangle_int_t rect;
+} ItemExtents;
+
+
 /*  local function prototypes  */
 
 static void             gimp_canvas_group_finalize     (GObject         *object);
@@ -69,6 +94,19 @@ static gboolean         gimp_canvas_group_hit          (GimpCanvasItem  *item,
 static void             gimp_canvas_group_child_update (GimpCanvasItem  *item,
                                                         cairo_region_t  *region,
                                                         GimpCanvasGroup *group);
+static void             gimp_canvas_group_child_notify (GimpCanvasItem  *item,
+                                                        GParamSpec      *pspec,
+                                                        GimpCanvasGroup *group);
+
+static void             gimp_canvas_group_validate_extents
+                                                       (GimpCanvasGroup *group);
+static gboolean         gimp_canvas_group_item_exposed (GimpCanvasGroup *group,
+                                                        GimpCanvasItem  *item,
+                                                        gdouble          x1,
+                                                        gdouble          y1,
+                                                        gdouble          x2,
+                                                        gdouble          y2);
+static void             gimp_canvas_group_extents_free (ItemExtents     *extents);
 
 
 G_DEFINE_TYPE (GimpCanvasGroup, gimp_canvas_group, GIMP_TYPE_CANVAS_ITEM)
@@ -112,7 +150,11 @@ gimp_canvas_group_init (GimpCanvasGroup *group)
                                              GIMP_TYPE_CANVAS_GROUP,
                                              GimpCanvasGroupPrivate);
 
-  group->priv->items = g_queue_new ();
+  group->priv->items   = g_queue_new ();
+  group->priv->extents = g_hash_table_new_full (g_direct_hash,
+                                                g_direct_equal,
+                                                NULL,
+                                                (GDestroyNotify) gimp_canvas_group_extents_free);
 }
 
 static void
@@ -127,6 +169,9 @@ gimp_canvas_group_finalize (GObject *object)
   g_queue_free (group->priv->items);
   group->priv->items = NULL;
 
+  g_hash_table_unref (group->priv->extents);
+  group->priv->extents = NULL;
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -182,12 +227,18 @@ gimp_canvas_group_draw (GimpCanvasItem *item,
 {
   GimpCanvasGroup *group = GIMP_CANVAS_GROUP (item);
   GList           *list;
+  gdouble          x1, y1, x2, y2;
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+
+  gimp_canvas_group_validate_extents (group);
 
   for (list = group->priv->items->head; list; list = g_list_next (list))
     {
       GimpCanvasItem *sub_item = list->data;
 
-      gimp_canvas_item_draw (sub_item, cr);
+      if (gimp_canvas_group_item_exposed (group, sub_item, x1, y1, x2, y2))
+        gimp_canvas_item_draw (sub_item, cr);
     }
 
   if (group->priv->group_stroking)
@@ -245,10 +296,115 @@ gimp_canvas_group_child_update (GimpCanvasItem  *item,
                                 cairo_region_t  *region,
                                 GimpCanvasGroup *group)
 {
+  g_hash_table_remove (group->priv->extents, item);
+
   if (_gimp_canvas_item_needs_update (GIMP_CANVAS_ITEM (group)))
     _gimp_canvas_item_update (GIMP_CANVAS_ITEM (group), region);
 }
 
+static void
+gimp_canvas_group_child_notify (GimpCanvasItem  *item,
+                                GParamSpec      *pspec,
+                                GimpCanvasGroup *group)
+{
+  /*  items whose new extents are NULL don't emit "update", so drop
+   *  the cached extents on any property change instead
+   */
+  g_hash_table_remove (group->priv->extents, item);
+}
+
+static void
+gimp_canvas_group_validate_extents (GimpCanvasGroup *group)
+{
+  GimpCanvasGroupPrivate *private = group->priv;
+  GimpDisplayShell       *shell;
+  GtkWidget              *canvas;
+  GimpImage              *image;
+  GtkAllocation           allocation;
+  gint                    image_width  = 0;
+  gint                    image_height = 0;
+
+  shell  = gimp_canvas_item_get_shell  (GIMP_CANVAS_ITEM (group));
+  canvas = gimp_canvas_item_get_canvas (GIMP_CANVAS_ITEM (group));
+  image  = gimp_display_get_image (shell->display);
+
+  gtk_widget_get_allocation (canvas, &allocation);
+
+  /*  some items, like the grid and the passe-partout, depend on the
+   *  image size
+   */
+  if (image)
+    {
+      image_width  = gimp_image_get_width  (image);
+      image_height = gimp_image_get_height (image);
+    }
+
+  if (shell->offset_x   != private->extents_offset_x     ||
+      shell->offset_y   != private->extents_offset_y     ||
+      shell->scale_x    != private->extents_scale_x      ||
+      shell->scale_y    != private->extents_scale_y      ||
+      allocation.width  != private->extents_width        ||
+      allocation.height != private->extents_height       ||
+      image_width       != private->extents_image_width  ||
+      image_height      != private->extents_image_height)
+    {
+      g_hash_table_remove_all (private->extents);
+
+      private->extents_offset_x = shell->offset_x;
+      private->extents_offset_y = shell->offset_y;
+      private->extents_scale_x  = shell->scale_x;
+      private->extents_scale_y  = shell->scale_y;
+      private->extents_width    = allocation.width;
+      private->extents_height   = allocation.height;
+
+      private->extents_image_width  = image_width;
+      private->extents_image_height = image_height;
+    }
+}
+
+static gboolean
+gimp_canvas_group_item_exposed (GimpCanvasGroup *group,
+                                GimpCanvasItem  *item,
+                                gdouble          x1,
+                                gdouble          y1,
+                                gdouble          x2,
+                                gdouble          y2)
+{
+  ItemExtents *extents;
+
+  extents = g_hash_table_lookup (group->priv->extents, item);
+
+  if (! extents)
+    {
+      cairo_region_t *region = gimp_canvas_item_get_extents (item);
+
+      /*  items without extents are either invisible, and draw nothing
+       *  anyway, or don't know where they draw, so always draw them,
+       *  and don't keep an entry for them
+       */
+      if (! region)
+        return TRUE;
+
+      extents = g_slice_new (ItemExtents);
+
+      cairo_region_get_extents (region, &extents->rect);
+      cairo_region_destroy (region);
+
+      g_hash_table_insert (group->priv->extents, item, extents);
+    }
+
+  return (extents->rect.x                        < x2 &&
+          extents->rect.y                        < y2 &&
+          extents->rect.x + extents->rect.width  > x1 &&
+          extents->rect.y + extents->rect.height > y1);
+}
+
+static void
+gimp_canvas_group_extents_free (ItemExtents *extents)
+{
+  g_slice_free (ItemExtents, extents);
+}
+
 
 /*  public functions  */
 
@@ -292,6 +448,9 @@ gimp_canvas_group_add_item (GimpCanvasGroup *group,
   g_signal_connect (item, "update",
                     G_CALLBACK (gimp_canvas_group_child_update),
                     group);
+  g_signal_connect (item, "notify",
+                    G_CALLBACK (gimp_canvas_group_child_notify),
+                    group);
 }
 
 void
@@ -309,6 +468,8 @@ gimp_canvas_group_remove_item (GimpCanvasGroup *group,
 
   g_queue_delete_link (group->priv->items, list);
 
+  g_hash_table_remove (group->priv->extents, item);
+
   if (group->priv->group_stroking)
     gimp_canvas_item_resume_stroking (item);
 
@@ -329,10 +490,29 @@ gimp_canvas_group_remove_item (GimpCanvasGroup *group,
   g_signal_handlers_disconnect_by_func (item,
                                         gimp_canvas_group_child_update,
                                         group);
+  g_signal_handlers_disconnect_by_func (item,
+                                        gimp_canvas_group_child_notify,
+                                        group);
 
   g_object_unref (item);
 }
 
+void
+gimp_canvas_group_clear_extents (GimpCanvasGroup *group)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_CANVAS_GROUP (group));
+
+  g_hash_table_remove_all (group->priv->extents);
+
+  for (list = group->priv->items->head; list; list = g_list_next (list))
+    {
+      if (GIMP_IS_CANVAS_GROUP (list->data))
+        gimp_canvas_group_clear_extents (list->data);
+    }
+}
+
 void
 gimp_canvas_group_set_group_stroking (GimpCanvasGroup *group,
                                       gboolean         group_stroking)
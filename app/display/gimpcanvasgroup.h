@@ -58,6 +58,7 @@ void             gimp_canvas_group_add_item           (GimpCanvasGroup  *group,
                                                        GimpCanvasItem   *item);
 void             gimp_canvas_group_remove_item        (GimpCanvasGroup  *group,
                                                        GimpCanvasItem   *item);
+void             gimp_canvas_group_clear_extents      (GimpCanvasGroup  *group);
 
 void             gimp_canvas_group_set_group_stroking (GimpCanvasGroup  *group,
                                                        gboolean          group_stroking);
@@ -44,6 +44,7 @@
 #include "gimpdisplayshell-expose.h"
 #include "gimpdisplayshell-handlers.h"
 #include "gimpdisplayshell-icon.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-transform.h"
 #include "gimpimagewindow.h"
 
@@ -897,6 +898,9 @@ gimp_display_paint_area (GimpDisplay *display,
   w = (x2 - x1);
   h = (y2 - y1);
 
+  /*  drop the area from the shell's cache of rendered tiles  */
+  gimp_display_shell_render_invalidate_area (shell, x, y, w, h);
+
   /*  display the area  */
   gimp_display_shell_transform_bounds (shell,
                                        x, y, x + w, y + h,
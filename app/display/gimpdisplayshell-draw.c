@@ -42,6 +42,13 @@
 #include "gimpdisplayxfer.h"
 
 
+/*  the time an expose may spend rendering at full quality before the
+ *  remaining chunks are rendered coarsely and refined later, in
+ *  microseconds
+ */
+#define GIMP_DISPLAY_RENDER_BUDGET  (G_USEC_PER_SEC / 25)
+
+
 /*  public functions  */
 
 void
@@ -137,10 +144,11 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
                                gint              w,
                                gint              h)
 {
-  gint x1, y1, x2, y2;
-  gint i, j;
-  gint chunk_width;
-  gint chunk_height;
+  gint   x1, y1, x2, y2;
+  gint   i, j;
+  gint   chunk_width;
+  gint   chunk_height;
+  gint64 deadline;
 
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
   g_return_if_fail (gimp_display_get_image (shell->display));
@@ -198,6 +206,8 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
         chunk_width /= 2;
     }
 
+  deadline = g_get_monotonic_time () + GIMP_DISPLAY_RENDER_BUDGET;
+
   for (i = y1; i < y2; i += chunk_height)
     {
       for (j = x1; j < x2; j += chunk_width)
@@ -207,7 +217,8 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
           dx = MIN (x2 - j, chunk_width);
           dy = MIN (y2 - i, chunk_height);
 
-          gimp_display_shell_render (shell, cr, j, i, dx, dy);
+          gimp_display_shell_render (shell, cr, j, i, dx, dy,
+                                     g_get_monotonic_time () > deadline);
         }
     }
 }
@@ -22,6 +22,7 @@
 
 #include "display-types.h"
 
+#include "gimpcanvasgroup.h"
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-expose.h"
 
@@ -72,5 +73,12 @@ gimp_display_shell_expose_full (GimpDisplayShell *shell)
 {
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
 
+  /*  whatever changed, the items' cached extents may be outdated  */
+  if (shell->canvas_item)
+    {
+      gimp_canvas_group_clear_extents (GIMP_CANVAS_GROUP (shell->canvas_item));
+      gimp_canvas_group_clear_extents (GIMP_CANVAS_GROUP (shell->unrotated_item));
+    }
+
   gtk_widget_queue_draw (shell->canvas);
 }
@@ -48,6 +48,7 @@
 
 #include "widgets/gimpwidgets-utils.h"
 
+#include "gimpcanvasgroup.h"
 #include "gimpcanvasguide.h"
 #include "gimpcanvaslayerboundary.h"
 #include "gimpcanvaspath.h"
@@ -61,6 +62,7 @@
 #include "gimpdisplayshell-handlers.h"
 #include "gimpdisplayshell-icon.h"
 #include "gimpdisplayshell-profile.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-rulers.h"
 #include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-scroll.h"
@@ -784,6 +786,10 @@ gimp_display_shell_size_changed_detailed_handler (GimpImage        *image,
   GimpDisplayConfig *config = shell->display->config;
   gboolean           resize_window;
 
+  gimp_display_shell_render_invalidate_full (shell);
+
+  gimp_canvas_group_clear_extents (GIMP_CANVAS_GROUP (shell->canvas_item));
+
   /* Resize windows only in multi-window mode */
   resize_window = (config->resize_windows_on_resize &&
                    ! GIMP_GUI_CONFIG (config)->single_window_mode);
@@ -1117,6 +1123,7 @@ gimp_display_shell_quality_notify_handler (GObject          *config,
                                            GParamSpec       *param_spec,
                                            GimpDisplayShell *shell)
 {
+  gimp_display_shell_render_invalidate_full (shell);
   gimp_display_shell_expose_full (shell);
 }
 
@@ -40,6 +40,7 @@
 #include "gimpdisplayshell-actions.h"
 #include "gimpdisplayshell-filter.h"
 #include "gimpdisplayshell-profile.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayxfer.h"
 
 #include "gimp-intl.h"
@@ -95,6 +96,9 @@ gimp_display_shell_profile_update (GimpDisplayShell *shell)
 
   gimp_display_shell_profile_free (shell);
 
+  /*  the cached display tiles are color managed, drop them  */
+  gimp_display_shell_render_invalidate_full (shell);
+
   image = gimp_display_get_image (shell->display);
 
   g_printerr ("gimp_display_shell_profile_update\n");
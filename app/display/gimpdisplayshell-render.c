@@ -17,6 +17,8 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
@@ -37,6 +39,7 @@
 
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
+#include "gimpdisplayshell-expose.h"
 #include "gimpdisplayshell-transform.h"
 #include "gimpdisplayshell-filter.h"
 #include "gimpdisplayshell-profile.h"
@@ -47,6 +50,235 @@
 
 /* #define GIMP_DISPLAY_RENDER_ENABLE_SCALING 1 */
 
+#define GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE   256
+
+/*  the maximum number of cached tiles per shell, 256 tiles of
+ *  256x256 ARGB32 pixels are 64 MB, enough for a 4K screen
+ */
+#define GIMP_DISPLAY_RENDER_CACHE_MAX_TILES   256
+
+/*  invalid regions with more rectangles are re-rendered in one piece
+ */
+#define GIMP_DISPLAY_RENDER_CACHE_MAX_RECTS   16
+
+/*  tiles rendered while the expose's time budget is exhausted are
+ *  first rendered at 1/GIMP_DISPLAY_RENDER_COARSE_FACTOR of their
+ *  resolution, and refined from an idle
+ */
+#define GIMP_DISPLAY_RENDER_COARSE_FACTOR     4
+
+
+typedef struct _GimpDisplayRenderTile GimpDisplayRenderTile;
+
+struct _GimpDisplayRenderTile
+{
+  gint64           key;
+  gint             x;        /*  tile origin in render coordinates  */
+  gint             y;
+  cairo_surface_t *surface;  /*  rendered, color managed pixels     */
+  cairo_region_t  *invalid;  /*  tile-local area that needs render  */
+  gboolean         coarse;   /*  invalid area has a coarse preview  */
+  GList            link;     /*  link in the LRU queue              */
+};
+
+
+/*  local function prototypes  */
+
+static gint     gimp_display_shell_render_cache_max_tiles
+                                                      (void);
+
+static GimpDisplayRenderTile *
+                gimp_display_shell_render_cache_get_tile
+                                                      (GimpDisplayShell      *shell,
+                                                       cairo_t               *cr,
+                                                       gint                   tile_x,
+                                                       gint                   tile_y);
+static void     gimp_display_shell_render_cache_set_scale
+                                                      (GimpDisplayShell      *shell,
+                                                       gdouble                scale_x,
+                                                       gdouble                scale_y,
+                                                       gdouble                buffer_scale);
+static void     gimp_display_shell_render_tile_free   (GimpDisplayRenderTile *tile);
+static void     gimp_display_shell_render_tile_invalidate
+                                                      (GimpDisplayRenderTile *tile,
+                                                       gint                   x1,
+                                                       gint                   y1,
+                                                       gint                   x2,
+                                                       gint                   y2);
+static void     gimp_display_shell_render_tile_validate
+                                                      (GimpDisplayShell      *shell,
+                                                       GimpDisplayRenderTile *tile,
+                                                       gdouble                buffer_scale);
+static void     gimp_display_shell_render_tile_coarse (GimpDisplayShell      *shell,
+                                                       GimpDisplayRenderTile *tile,
+                                                       gdouble                buffer_scale);
+static gboolean gimp_display_shell_render_tile_is_visible
+                                                      (GimpDisplayShell      *shell,
+                                                       GimpDisplayRenderTile *tile);
+static void     gimp_display_shell_render_tile_expose (GimpDisplayShell      *shell,
+                                                       GimpDisplayRenderTile *tile);
+static gboolean gimp_display_shell_render_refine_idle (GimpDisplayShell      *shell);
+
+static void     gimp_display_shell_render_area        (GimpDisplayShell      *shell,
+                                                       gdouble                buffer_scale,
+                                                       gint                   scaled_x,
+                                                       gint                   scaled_y,
+                                                       gint                   scaled_width,
+                                                       gint                   scaled_height,
+                                                       guchar                *cairo_data,
+                                                       gint                   cairo_stride);
+static void     gimp_display_shell_render_paint       (GimpDisplayShell      *shell,
+                                                       cairo_t               *cr,
+                                                       cairo_surface_t       *surface,
+                                                       gdouble                surface_x,
+                                                       gdouble                surface_y,
+                                                       gdouble                x,
+                                                       gdouble                y,
+                                                       gdouble                w,
+                                                       gdouble                h,
+                                                       gdouble                scale_x,
+                                                       gdouble                scale_y);
+
+
+#define TILE_INDEX(coord) \
+  ((gint) floor ((gdouble) (coord) / GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE))
+
+#define TILE_KEY(tile_x, tile_y) \
+  ((gint64) (((guint64) (guint32) (tile_y) << 32) | (guint32) (tile_x)))
+
+
+/*  public functions  */
+
+void
+gimp_display_shell_render_init (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  shell->render_cache =
+    g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                           NULL,
+                           (GDestroyNotify) gimp_display_shell_render_tile_free);
+
+  shell->render_cache_lru = g_queue_new ();
+
+  shell->render_refine_idle_id = 0;
+
+  shell->render_cache_scale   = 0.0;
+  shell->render_cache_scale_x = 0.0;
+  shell->render_cache_scale_y = 0.0;
+}
+
+void
+gimp_display_shell_render_finalize (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_refine_idle_id)
+    {
+      g_source_remove (shell->render_refine_idle_id);
+      shell->render_refine_idle_id = 0;
+    }
+
+  if (shell->render_cache_lru)
+    {
+      g_queue_free (shell->render_cache_lru);
+      shell->render_cache_lru = NULL;
+    }
+
+  if (shell->render_cache)
+    {
+      g_hash_table_unref (shell->render_cache);
+      shell->render_cache = NULL;
+    }
+}
+
+void
+gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_cache)
+    return;
+
+  /*  cancel any pending refinement, there is nothing left to refine  */
+  if (shell->render_refine_idle_id)
+    {
+      g_source_remove (shell->render_refine_idle_id);
+      shell->render_refine_idle_id = 0;
+    }
+
+  /*  the tiles' links are embedded in the tiles, so clear the queue
+   *  before the tiles are freed
+   */
+  g_queue_init (shell->render_cache_lru);
+  g_hash_table_remove_all (shell->render_cache);
+}
+
+void
+gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
+                                           gint              x,
+                                           gint              y,
+                                           gint              w,
+                                           gint              h)
+{
+  gdouble scale;
+  gint    x1, y1, x2, y2;
+  gint    tile_x1, tile_y1, tile_x2, tile_y2;
+  gint    n_tiles;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_cache                          ||
+      g_hash_table_size (shell->render_cache) == 0 ||
+      w <= 0 || h <= 0)
+    return;
+
+  /*  render coordinates are image coordinates multiplied by the
+   *  buffer scale, add one pixel of spill for the projection's
+   *  interpolation and box filtering
+   */
+  scale = shell->render_cache_scale;
+
+  x1 = floor (x * scale) - 1;
+  y1 = floor (y * scale) - 1;
+  x2 = ceil ((x + w) * scale) + 1;
+  y2 = ceil ((y + h) * scale) + 1;
+
+  tile_x1 = TILE_INDEX (x1);
+  tile_y1 = TILE_INDEX (y1);
+  tile_x2 = TILE_INDEX (x2 - 1);
+  tile_y2 = TILE_INDEX (y2 - 1);
+
+  n_tiles = (tile_x2 - tile_x1 + 1) * (tile_y2 - tile_y1 + 1);
+
+  if (n_tiles <= g_hash_table_size (shell->render_cache))
+    {
+      gint tile_x, tile_y;
+
+      for (tile_y = tile_y1; tile_y <= tile_y2; tile_y++)
+        for (tile_x = tile_x1; tile_x <= tile_x2; tile_x++)
+          {
+            GimpDisplayRenderTile *tile;
+            gint64                 key = TILE_KEY (tile_x, tile_y);
+
+            tile = g_hash_table_lookup (shell->render_cache, &key);
+
+            if (tile)
+              gimp_display_shell_render_tile_invalidate (tile,
+                                                         x1, y1, x2, y2);
+          }
+    }
+  else
+    {
+      GHashTableIter iter;
+      gpointer       value;
+
+      g_hash_table_iter_init (&iter, shell->render_cache);
+
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        gimp_display_shell_render_tile_invalidate (value, x1, y1, x2, y2);
+    }
+}
 
 void
 gimp_display_shell_render (GimpDisplayShell *shell,
@@ -54,13 +286,9 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                            gint              x,
                            gint              y,
                            gint              w,
-                           gint              h)
+                           gint              h,
+                           gboolean          coarse)
 {
-  GimpImage       *image;
-  GeglBuffer      *buffer;
-#ifdef USE_NODE_BLIT
-  GeglNode        *node;
-#endif
   gdouble          scale_x       = 1.0;
   gdouble          scale_y       = 1.0;
   gdouble          buffer_scale  = 1.0;
@@ -72,25 +300,15 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   gint             scaled_y;
   gint             scaled_width;
   gint             scaled_height;
-  cairo_surface_t *xfer;
-  gint             xfer_src_x;
-  gint             xfer_src_y;
   gint             mask_src_x = 0;
   gint             mask_src_y = 0;
   gint             cairo_stride;
   guchar          *cairo_data;
-  GeglBuffer      *cairo_buffer;
 
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
   g_return_if_fail (cr != NULL);
   g_return_if_fail (w > 0 && h > 0);
 
-  image  = gimp_display_get_image (shell->display);
-  buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (image));
-#ifdef USE_NODE_BLIT
-  node   = gimp_projectable_get_graph (GIMP_PROJECTABLE (image));
-#endif
-
 #ifdef GIMP_DISPLAY_RENDER_ENABLE_SCALING
   /* if we had this future API, things would look pretty on hires (retina) */
   scale_x = gdk_window_get_scale_factor (gtk_widget_get_window (gtk_widget_get_toplevel (GTK_WIDGET (shell))));
@@ -127,28 +345,552 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   scaled_width  = ceil (w * scale_x);
   scaled_height = ceil (h * scale_y);
 
-  if (shell->rotate_transform)
+  if (shell->render_cache && gimp_display_shell_render_cache_max_tiles () > 0)
     {
-      xfer = cairo_surface_create_similar_image (cairo_get_target (cr),
-                                                 CAIRO_FORMAT_ARGB32,
-                                                 scaled_width,
-                                                 scaled_height);
-      cairo_surface_mark_dirty (xfer);
-      xfer_src_x = 0;
-      xfer_src_y = 0;
+      gint tile_x1, tile_y1, tile_x2, tile_y2;
+      gint tile_x, tile_y;
+
+      /*  render coordinates don't depend on the scroll offset or the
+       *  rotation, so cached tiles survive panning and rotating and
+       *  only need to be dropped when the scale changes
+       */
+      gimp_display_shell_render_cache_set_scale (shell,
+                                                 scale_x, scale_y,
+                                                 buffer_scale);
+
+      tile_x1 = TILE_INDEX (scaled_x);
+      tile_y1 = TILE_INDEX (scaled_y);
+      tile_x2 = TILE_INDEX (scaled_x + scaled_width  - 1);
+      tile_y2 = TILE_INDEX (scaled_y + scaled_height - 1);
+
+      for (tile_y = tile_y1; tile_y <= tile_y2; tile_y++)
+        for (tile_x = tile_x1; tile_x <= tile_x2; tile_x++)
+          {
+            GimpDisplayRenderTile *tile;
+            gdouble                tile_x1_w, tile_y1_w;
+            gdouble                tile_x2_w, tile_y2_w;
+            gdouble                clip_x1, clip_y1;
+            gdouble                clip_x2, clip_y2;
+
+            tile = gimp_display_shell_render_cache_get_tile (shell, cr,
+                                                             tile_x, tile_y);
+
+            if (coarse)
+              gimp_display_shell_render_tile_coarse (shell, tile,
+                                                     buffer_scale);
+            else
+              gimp_display_shell_render_tile_validate (shell, tile,
+                                                       buffer_scale);
+
+            /*  the tile's extents in widget coordinates  */
+            tile_x1_w = tile->x / scale_x - viewport_offset_x;
+            tile_y1_w = tile->y / scale_y - viewport_offset_y;
+            tile_x2_w = tile_x1_w +
+                        GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE / scale_x;
+            tile_y2_w = tile_y1_w +
+                        GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE / scale_y;
+
+            clip_x1 = MAX (x,     tile_x1_w);
+            clip_y1 = MAX (y,     tile_y1_w);
+            clip_x2 = MIN (x + w, tile_x2_w);
+            clip_y2 = MIN (y + h, tile_y2_w);
+
+            if (clip_x2 > clip_x1 && clip_y2 > clip_y1)
+              {
+                gimp_display_shell_render_paint (shell, cr, tile->surface,
+                                                 tile_x1_w * scale_x,
+                                                 tile_y1_w * scale_y,
+                                                 clip_x1, clip_y1,
+                                                 clip_x2 - clip_x1,
+                                                 clip_y2 - clip_y1,
+                                                 scale_x, scale_y);
+              }
+          }
     }
   else
     {
-      xfer = gimp_display_xfer_get_surface (shell->xfer,
-                                            scaled_width,
-                                            scaled_height,
-                                            &xfer_src_x,
-                                            &xfer_src_y);
+      cairo_surface_t *xfer;
+      gint             xfer_src_x;
+      gint             xfer_src_y;
+
+      if (shell->rotate_transform)
+        {
+          xfer = cairo_surface_create_similar_image (cairo_get_target (cr),
+                                                     CAIRO_FORMAT_ARGB32,
+                                                     scaled_width,
+                                                     scaled_height);
+          cairo_surface_mark_dirty (xfer);
+          xfer_src_x = 0;
+          xfer_src_y = 0;
+        }
+      else
+        {
+          xfer = gimp_display_xfer_get_surface (shell->xfer,
+                                                scaled_width,
+                                                scaled_height,
+                                                &xfer_src_x,
+                                                &xfer_src_y);
+        }
+
+      cairo_stride = cairo_image_surface_get_stride (xfer);
+      cairo_data   = cairo_image_surface_get_data (xfer) +
+                     xfer_src_y * cairo_stride + xfer_src_x * 4;
+
+      gimp_display_shell_render_area (shell, buffer_scale,
+                                      scaled_x, scaled_y,
+                                      scaled_width, scaled_height,
+                                      cairo_data, cairo_stride);
+
+      gimp_display_shell_render_paint (shell, cr, xfer,
+                                       x * scale_x - xfer_src_x,
+                                       y * scale_y - xfer_src_y,
+                                       x, y, w, h,
+                                       scale_x, scale_y);
+
+      if (shell->rotate_transform)
+        cairo_surface_destroy (xfer);
+    }
+
+  if (shell->mask)
+    {
+      if (! shell->mask_surface)
+        {
+          shell->mask_surface =
+            cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                        GIMP_DISPLAY_RENDER_BUF_WIDTH  *
+                                        GIMP_DISPLAY_RENDER_MAX_SCALE,
+                                        GIMP_DISPLAY_RENDER_BUF_HEIGHT *
+                                        GIMP_DISPLAY_RENDER_MAX_SCALE);
+        }
+
+      cairo_surface_mark_dirty (shell->mask_surface);
+
+      cairo_stride = cairo_image_surface_get_stride (shell->mask_surface);
+      cairo_data   = cairo_image_surface_get_data (shell->mask_surface) +
+                     mask_src_y * cairo_stride + mask_src_x * 4;
+
+      gegl_buffer_get (shell->mask,
+                       GEGL_RECTANGLE (scaled_x - shell->mask_offset_x,
+                                       scaled_y - shell->mask_offset_y,
+                                       scaled_width, scaled_height),
+                       buffer_scale,
+                       babl_format ("Y u8"),
+                       cairo_data, cairo_stride,
+                       GEGL_ABYSS_NONE);
+
+      if (shell->mask_inverted)
+        {
+          gint mask_height = scaled_height;
+
+          while (mask_height--)
+            {
+              gint    mask_width = scaled_width;
+              guchar *d          = cairo_data;
+
+              while (mask_width--)
+                {
+                  guchar inv = 255 - *d;
+
+                  *d++ = inv;
+                }
+
+              cairo_data += cairo_stride;
+            }
+        }
+
+      cairo_save (cr);
+
+      cairo_rectangle (cr, x, y, w, h);
+      cairo_clip (cr);
+
+      cairo_scale (cr, 1.0 / scale_x, 1.0 / scale_y);
+
+      gimp_cairo_set_source_rgba (cr, &shell->mask_color);
+      cairo_mask_surface (cr, shell->mask_surface,
+                          (x - mask_src_x) * scale_x,
+                          (y - mask_src_y) * scale_y);
+
+      cairo_restore (cr);
+    }
+}
+
+
+/*  private functions  */
+
+static gint
+gimp_display_shell_render_cache_max_tiles (void)
+{
+  static gint max_tiles = -1;
+
+  if (max_tiles < 0)
+    {
+      const gchar *env = g_getenv ("GIMP_DISPLAY_RENDER_CACHE_SIZE");
+
+      max_tiles = GIMP_DISPLAY_RENDER_CACHE_MAX_TILES;
+
+      /*  0 disables the cache  */
+      if (env)
+        max_tiles = CLAMP (atoi (env), 0, 65536);
+    }
+
+  return max_tiles;
+}
+
+static GimpDisplayRenderTile *
+gimp_display_shell_render_cache_get_tile (GimpDisplayShell *shell,
+                                          cairo_t          *cr,
+                                          gint              tile_x,
+                                          gint              tile_y)
+{
+  GimpDisplayRenderTile *tile;
+  cairo_rectangle_int_t  rect;
+  gint64                 key = TILE_KEY (tile_x, tile_y);
+
+  tile = g_hash_table_lookup (shell->render_cache, &key);
+
+  if (tile)
+    {
+      /*  move the tile to the head of the LRU queue  */
+      g_queue_unlink (shell->render_cache_lru, &tile->link);
+      g_queue_push_head_link (shell->render_cache_lru, &tile->link);
+
+      return tile;
+    }
+
+  while (g_hash_table_size (shell->render_cache) >=
+         gimp_display_shell_render_cache_max_tiles ())
+    {
+      GList                 *last = g_queue_pop_tail_link (shell->render_cache_lru);
+      GimpDisplayRenderTile *old  = last->data;
+
+      g_hash_table_remove (shell->render_cache, &old->key);
+    }
+
+  tile = g_slice_new0 (GimpDisplayRenderTile);
+
+  tile->key     = key;
+  tile->x       = tile_x * GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE;
+  tile->y       = tile_y * GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE;
+  tile->surface =
+    cairo_surface_create_similar_image (cairo_get_target (cr),
+                                        CAIRO_FORMAT_ARGB32,
+                                        GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE,
+                                        GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE);
+
+  rect.x      = 0;
+  rect.y      = 0;
+  rect.width  = GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE;
+  rect.height = GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE;
+
+  tile->invalid = cairo_region_create_rectangle (&rect);
+  tile->link.data = tile;
+
+  g_hash_table_insert (shell->render_cache, &tile->key, tile);
+  g_queue_push_head_link (shell->render_cache_lru, &tile->link);
+
+  return tile;
+}
+
+static void
+gimp_display_shell_render_cache_set_scale (GimpDisplayShell *shell,
+                                           gdouble           scale_x,
+                                           gdouble           scale_y,
+                                           gdouble           buffer_scale)
+{
+  if (buffer_scale != shell->render_cache_scale   ||
+      scale_x      != shell->render_cache_scale_x ||
+      scale_y      != shell->render_cache_scale_y)
+    {
+      gimp_display_shell_render_invalidate_full (shell);
+
+      shell->render_cache_scale   = buffer_scale;
+      shell->render_cache_scale_x = scale_x;
+      shell->render_cache_scale_y = scale_y;
+    }
+}
+
+static void
+gimp_display_shell_render_tile_free (GimpDisplayRenderTile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+  cairo_region_destroy (tile->invalid);
+
+  g_slice_free (GimpDisplayRenderTile, tile);
+}
+
+static void
+gimp_display_shell_render_tile_invalidate (GimpDisplayRenderTile *tile,
+                                           gint                   x1,
+                                           gint                   y1,
+                                           gint                   x2,
+                                           gint                   y2)
+{
+  cairo_rectangle_int_t rect;
+
+  x1 = MAX (x1, tile->x);
+  y1 = MAX (y1, tile->y);
+  x2 = MIN (x2, tile->x + GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE);
+  y2 = MIN (y2, tile->y + GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE);
+
+  if (x2 <= x1 || y2 <= y1)
+    return;
+
+  rect.x      = x1 - tile->x;
+  rect.y      = y1 - tile->y;
+  rect.width  = x2 - x1;
+  rect.height = y2 - y1;
+
+  cairo_region_union_rectangle (tile->invalid, &rect);
+
+  /*  the coarse preview doesn't cover the new area  */
+  tile->coarse = FALSE;
+}
+
+static void
+gimp_display_shell_render_tile_validate (GimpDisplayShell      *shell,
+                                         GimpDisplayRenderTile *tile,
+                                         gdouble                buffer_scale)
+{
+  guchar *data;
+  gint    stride;
+  gint    n_rects;
+  gint    i;
+
+  if (cairo_region_is_empty (tile->invalid))
+    return;
+
+  cairo_surface_flush (tile->surface);
+
+  data   = cairo_image_surface_get_data (tile->surface);
+  stride = cairo_image_surface_get_stride (tile->surface);
+
+  n_rects = cairo_region_num_rectangles (tile->invalid);
+
+  if (n_rects > GIMP_DISPLAY_RENDER_CACHE_MAX_RECTS)
+    {
+      cairo_rectangle_int_t extents;
+
+      cairo_region_get_extents (tile->invalid, &extents);
+      cairo_region_destroy (tile->invalid);
+      tile->invalid = cairo_region_create_rectangle (&extents);
+
+      n_rects = 1;
+    }
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (tile->invalid, i, &rect);
+
+      gimp_display_shell_render_area (shell, buffer_scale,
+                                      tile->x + rect.x,
+                                      tile->y + rect.y,
+                                      rect.width,
+                                      rect.height,
+                                      data + rect.y * stride + rect.x * 4,
+                                      stride);
+
+      cairo_surface_mark_dirty_rectangle (tile->surface,
+                                          rect.x, rect.y,
+                                          rect.width, rect.height);
+    }
+
+  cairo_region_destroy (tile->invalid);
+  tile->invalid = cairo_region_create ();
+  tile->coarse  = FALSE;
+}
+
+/*  fills the tile's invalid area with a quick, low resolution render
+ *  and schedules its refinement
+ */
+static void
+gimp_display_shell_render_tile_coarse (GimpDisplayShell      *shell,
+                                       GimpDisplayRenderTile *tile,
+                                       gdouble                buffer_scale)
+{
+  cairo_surface_t       *surface;
+  cairo_t               *cr;
+  cairo_rectangle_int_t  extents;
+  const gint             factor = GIMP_DISPLAY_RENDER_COARSE_FACTOR;
+  gint                   coarse_x;
+  gint                   coarse_y;
+  gint                   coarse_width;
+  gint                   coarse_height;
+  gint                   n_rects;
+  gint                   i;
+
+  if (cairo_region_is_empty (tile->invalid) || tile->coarse)
+    return;
+
+  cairo_region_get_extents (tile->invalid, &extents);
+
+  coarse_x      = floor ((gdouble) (tile->x + extents.x) / factor);
+  coarse_y      = floor ((gdouble) (tile->y + extents.y) / factor);
+  coarse_width  = ceil ((gdouble) (tile->x + extents.x + extents.width)  /
+                        factor) - coarse_x;
+  coarse_height = ceil ((gdouble) (tile->y + extents.y + extents.height) /
+                        factor) - coarse_y;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        coarse_width, coarse_height);
+
+  cairo_surface_flush (surface);
+
+  gimp_display_shell_render_area (shell, buffer_scale / factor,
+                                  coarse_x, coarse_y,
+                                  coarse_width, coarse_height,
+                                  cairo_image_surface_get_data (surface),
+                                  cairo_image_surface_get_stride (surface));
+
+  cairo_surface_mark_dirty (surface);
+
+  /*  scale the coarse pixels up into the tile's invalid area  */
+  cr = cairo_create (tile->surface);
+
+  n_rects = cairo_region_num_rectangles (tile->invalid);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (tile->invalid, i, &rect);
+
+      cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+    }
+
+  cairo_clip (cr);
+
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+  cairo_scale (cr, factor, factor);
+  cairo_set_source_surface (cr, surface,
+                            coarse_x - (gdouble) tile->x / factor,
+                            coarse_y - (gdouble) tile->y / factor);
+  cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_PAD);
+  cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_BILINEAR);
+  cairo_paint (cr);
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  tile->coarse = TRUE;
+
+  if (! shell->render_refine_idle_id)
+    {
+      shell->render_refine_idle_id =
+        g_idle_add_full (G_PRIORITY_LOW,
+                         (GSourceFunc) gimp_display_shell_render_refine_idle,
+                         shell, NULL);
+    }
+}
+
+static gboolean
+gimp_display_shell_render_tile_is_visible (GimpDisplayShell      *shell,
+                                           GimpDisplayRenderTile *tile)
+{
+  gdouble scale = shell->render_cache_scale;
+  gdouble x1, y1, x2, y2;
+
+  /*  the viewport in image coordinates  */
+  gimp_display_shell_untransform_bounds (shell,
+                                         0, 0,
+                                         shell->disp_width,
+                                         shell->disp_height,
+                                         &x1, &y1, &x2, &y2);
+
+  return (tile->x / scale < x2 &&
+          tile->y / scale < y2 &&
+          (tile->x + GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE) / scale > x1 &&
+          (tile->y + GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE) / scale > y1);
+}
+
+static void
+gimp_display_shell_render_tile_expose (GimpDisplayShell      *shell,
+                                       GimpDisplayRenderTile *tile)
+{
+  gdouble scale = shell->render_cache_scale;
+  gdouble x1, y1, x2, y2;
+
+  gimp_display_shell_transform_bounds (shell,
+                                       tile->x / scale,
+                                       tile->y / scale,
+                                       (tile->x +
+                                        GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE) /
+                                       scale,
+                                       (tile->y +
+                                        GIMP_DISPLAY_RENDER_CACHE_TILE_SIZE) /
+                                       scale,
+                                       &x1, &y1, &x2, &y2);
+
+  x1 = floor (x1 - 0.5);
+  y1 = floor (y1 - 0.5);
+  x2 = ceil (x2 + 0.5);
+  y2 = ceil (y2 + 0.5);
+
+  gimp_display_shell_expose_area (shell, x1, y1, x2 - x1, y2 - y1);
+}
+
+/*  refines one visible coarse tile per call; coarse tiles that were
+ *  scrolled out of view are left alone until they are exposed again
+ */
+static gboolean
+gimp_display_shell_render_refine_idle (GimpDisplayShell *shell)
+{
+  GHashTableIter iter;
+  gpointer       value;
+
+  if (gimp_display_get_image (shell->display))
+    {
+      g_hash_table_iter_init (&iter, shell->render_cache);
+
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          GimpDisplayRenderTile *tile = value;
+
+          if (tile->coarse &&
+              gimp_display_shell_render_tile_is_visible (shell, tile))
+            {
+              gimp_display_shell_render_tile_validate (shell, tile,
+                                                       shell->render_cache_scale);
+              gimp_display_shell_render_tile_expose (shell, tile);
+
+              return TRUE;
+            }
+        }
     }
 
-  cairo_stride = cairo_image_surface_get_stride (xfer);
-  cairo_data   = cairo_image_surface_get_data (xfer) +
-                 xfer_src_y * cairo_stride + xfer_src_x * 4;
+  shell->render_refine_idle_id = 0;
+
+  return FALSE;
+}
+
+/*  renders the projection's pixels at the given render coordinates
+ *  into cairo_data, applying the profile transform and display
+ *  filters
+ */
+static void
+gimp_display_shell_render_area (GimpDisplayShell *shell,
+                                gdouble           buffer_scale,
+                                gint              scaled_x,
+                                gint              scaled_y,
+                                gint              scaled_width,
+                                gint              scaled_height,
+                                guchar           *cairo_data,
+                                gint              cairo_stride)
+{
+  GimpImage  *image;
+  GeglBuffer *buffer;
+#ifdef USE_NODE_BLIT
+  GeglNode   *node;
+#endif
+  GeglBuffer *cairo_buffer;
+
+  image  = gimp_display_get_image (shell->display);
+  buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (image));
+#ifdef USE_NODE_BLIT
+  node   = gimp_projectable_get_graph (GIMP_PROJECTABLE (image));
+#endif
 
   cairo_buffer = gegl_buffer_linear_new_from_data (cairo_data,
                                                    babl_format ("cairo-ARGB32"),
@@ -320,55 +1062,21 @@ gimp_display_shell_render (GimpDisplayShell *shell,
     }
 
   g_object_unref (cairo_buffer);
+}
 
-  if (shell->mask)
-    {
-      if (! shell->mask_surface)
-        {
-          shell->mask_surface =
-            cairo_image_surface_create (CAIRO_FORMAT_A8,
-                                        GIMP_DISPLAY_RENDER_BUF_WIDTH  *
-                                        GIMP_DISPLAY_RENDER_MAX_SCALE,
-                                        GIMP_DISPLAY_RENDER_BUF_HEIGHT *
-                                        GIMP_DISPLAY_RENDER_MAX_SCALE);
-        }
-
-      cairo_surface_mark_dirty (shell->mask_surface);
-
-      cairo_stride = cairo_image_surface_get_stride (shell->mask_surface);
-      cairo_data   = cairo_image_surface_get_data (shell->mask_surface) +
-                     mask_src_y * cairo_stride + mask_src_x * 4;
-
-      gegl_buffer_get (shell->mask,
-                       GEGL_RECTANGLE (scaled_x - shell->mask_offset_x,
-                                       scaled_y - shell->mask_offset_y,
-                                       scaled_width, scaled_height),
-                       buffer_scale,
-                       babl_format ("Y u8"),
-                       cairo_data, cairo_stride,
-                       GEGL_ABYSS_NONE);
-
-      if (shell->mask_inverted)
-        {
-          gint mask_height = scaled_height;
-
-          while (mask_height--)
-            {
-              gint    mask_width = scaled_width;
-              guchar *d          = cairo_data;
-
-              while (mask_width--)
-                {
-                  guchar inv = 255 - *d;
-
-                  *d++ = inv;
-                }
-
-              cairo_data += cairo_stride;
-            }
-        }
-    }
-
+static void
+gimp_display_shell_render_paint (GimpDisplayShell *shell,
+                                 cairo_t          *cr,
+                                 cairo_surface_t  *surface,
+                                 gdouble           surface_x,
+                                 gdouble           surface_y,
+                                 gdouble           x,
+                                 gdouble           y,
+                                 gdouble           w,
+                                 gdouble           h,
+                                 gdouble           scale_x,
+                                 gdouble           scale_y)
+{
   /*  put it to the screen  */
   cairo_save (cr);
 
@@ -376,9 +1084,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
   cairo_scale (cr, 1.0 / scale_x, 1.0 / scale_y);
 
-  cairo_set_source_surface (cr, xfer,
-                            x * scale_x - xfer_src_x,
-                            y * scale_y - xfer_src_y);
+  cairo_set_source_surface (cr, surface, surface_x, surface_y);
 
   if (shell->rotate_transform)
     {
@@ -389,20 +1095,10 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
       cairo_set_line_width (cr, 1.0);
       cairo_stroke_preserve (cr);
-
-      cairo_surface_destroy (xfer);
     }
 
   cairo_clip (cr);
   cairo_paint (cr);
 
-  if (shell->mask)
-    {
-      gimp_cairo_set_source_rgba (cr, &shell->mask_color);
-      cairo_mask_surface (cr, shell->mask_surface,
-                          (x - mask_src_x) * scale_x,
-                          (y - mask_src_y) * scale_y);
-    }
-
   cairo_restore (cr);
 }
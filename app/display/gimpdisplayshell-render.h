@@ -18,11 +18,22 @@
 #ifndef __GIMP_DISPLAY_SHELL_RENDER_H__
 #define __GIMP_DISPLAY_SHELL_RENDER_H__
 
-void  gimp_display_shell_render (GimpDisplayShell *shell,
-                                 cairo_t          *cr,
-                                 gint              x,
-                                 gint              y,
-                                 gint              w,
-                                 gint              h);
+void   gimp_display_shell_render_init            (GimpDisplayShell *shell);
+void   gimp_display_shell_render_finalize        (GimpDisplayShell *shell);
+
+void   gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell);
+void   gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
+                                                  gint              x,
+                                                  gint              y,
+                                                  gint              w,
+                                                  gint              h);
+
+void   gimp_display_shell_render                 (GimpDisplayShell *shell,
+                                                  cairo_t          *cr,
+                                                  gint              x,
+                                                  gint              y,
+                                                  gint              w,
+                                                  gint              h,
+                                                  gboolean          coarse);
 
 #endif  /*  __GIMP_DISPLAY_SHELL_RENDER_H__  */
@@ -337,6 +337,8 @@ gimp_display_shell_init (GimpDisplayShell *shell)
 
   shell->filter_format     = babl_format ("R'G'B'A float");
 
+  gimp_display_shell_render_init (shell);
+
   shell->motion_buffer   = gimp_motion_buffer_new ();
 
   g_signal_connect (shell->motion_buffer, "stroke",
@@ -833,6 +835,8 @@ gimp_display_shell_dispose (GObject *object)
 
   gimp_display_shell_profile_finalize (shell);
 
+  gimp_display_shell_render_finalize (shell);
+
   if (shell->filter_buffer)
     {
       g_object_unref (shell->filter_buffer);
@@ -1495,6 +1499,8 @@ gimp_display_shell_empty (GimpDisplayShell *shell)
   shell->rotate_angle      = 0.0;
   gimp_display_shell_rotate_update_transform (shell);
 
+  gimp_display_shell_render_invalidate_full (shell);
+
   gimp_display_shell_expose_full (shell);
 
   user_context = gimp_get_user_context (shell->display->gimp);
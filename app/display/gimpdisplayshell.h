@@ -166,6 +166,12 @@ struct _GimpDisplayShell
   gint               filter_stride;    /*  filter_buffer's stride             */
 
   GimpDisplayXfer   *xfer;             /*  manages image buffer transfers     */
+  GHashTable        *render_cache;     /*  rendered display tiles             */
+  GQueue            *render_cache_lru; /*  render_cache's tiles, MRU first    */
+  gdouble            render_cache_scale;   /*  scales of the cached tiles     */
+  gdouble            render_cache_scale_x;
+  gdouble            render_cache_scale_y;
+  guint              render_refine_idle_id; /*  coarse tile refinement     */
   cairo_surface_t   *mask_surface;     /*  buffer for rendering the mask      */
   cairo_pattern_t   *checkerboard;     /*  checkerboard pattern               */
 
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <cairo.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
@@ -32,9 +34,188 @@
 #include "gimp-babl.h"
 #include "gimp-gegl-loops.h"
 
+#include "core/gimp-parallel.h"
 #include "core/gimpprogress.h"
 
 
+/*  areas smaller than this are processed on the calling thread  */
+#define MIN_PARALLEL_PIXELS (256 * 256)
+
+typedef struct
+{
+  const gfloat        *src;
+  gint                 src_rowstride;
+  gint                 src_width;
+  gint                 src_height;
+  gint                 components;
+  gint                 dest_components;
+  const gfloat        *kernel;
+  gint                 kernel_size;
+  gdouble              divisor;
+  GimpConvolutionType  mode;
+  gfloat               offset;
+  gboolean             alpha_weighting;
+
+  gfloat              *dest;        /* dest_rect, when processing in parallel */
+  GeglRectangle        dest_rect;
+} ConvolveData;
+
+typedef struct
+{
+  gfloat            *pixels;
+  gint               width;
+  GimpTransferMode   mode;
+  gdouble            exposure;
+  gfloat             factor;
+} DodgeBurnData;
+
+typedef struct
+{
+  gfloat            *top;           /* also receives the result */
+  const gfloat      *bottom;
+  gint               width;
+  gfloat             blend;
+} SmudgeBlendData;
+
+
+static gboolean
+gimp_gegl_loops_is_parallel (const GeglRectangle *rect)
+{
+  return rect->width * rect->height >= MIN_PARALLEL_PIXELS;
+}
+
+/*  Convolve the part of the src image below @rect, which is in src
+ *  coordinates, writing rows of @dest_rowstride floats to @dest
+ */
+static void
+gimp_gegl_convolve_rect (const ConvolveData  *data,
+                         const GeglRectangle *rect,
+                         gfloat              *dest,
+                         gint                 dest_rowstride)
+{
+  const gfloat        *src         = data->src;
+  const gint           components  = data->components;
+  const gint           a_component = components - 1;
+  const gint           margin      = data->kernel_size / 2;
+  const gint           x1          = 0;
+  const gint           y1          = 0;
+  const gint           x2          = data->src_width  - 1;
+  const gint           y2          = data->src_height - 1;
+  const gint           dest_x1     = rect->x;
+  const gint           dest_y1     = rect->y;
+  const gint           dest_x2     = rect->x + rect->width;
+  const gint           dest_y2     = rect->y + rect->height;
+  const gdouble        divisor     = data->divisor;
+  const gfloat         offset      = data->offset;
+  GimpConvolutionType  mode        = data->mode;
+  gint                 x, y;
+
+  for (y = dest_y1; y < dest_y2; y++)
+    {
+      gfloat *d = dest;
+
+      if (data->alpha_weighting)
+        {
+          for (x = dest_x1; x < dest_x2; x++)
+            {
+              const gfloat *m                = data->kernel;
+              gdouble       total[4]         = { 0.0, 0.0, 0.0, 0.0 };
+              gdouble       weighted_divisor = 0.0;
+              gint          i, j, b;
+
+              for (j = y - margin; j <= y + margin; j++)
+                {
+                  for (i = x - margin; i <= x + margin; i++, m++)
+                    {
+                      gint          xx = CLAMP (i, x1, x2);
+                      gint          yy = CLAMP (j, y1, y2);
+                      const gfloat *s  = src + yy * data->src_rowstride + xx * components;
+                      const gfloat  a  = s[a_component];
+
+                      if (a)
+                        {
+                          gdouble mult_alpha = *m * a;
+
+                          weighted_divisor += mult_alpha;
+
+                          for (b = 0; b < a_component; b++)
+                            total[b] += mult_alpha * s[b];
+
+                          total[a_component] += mult_alpha;
+                        }
+                    }
+                }
+
+              if (weighted_divisor == 0.0)
+                weighted_divisor = divisor;
+
+              for (b = 0; b < a_component; b++)
+                total[b] /= weighted_divisor;
+
+              total[a_component] /= divisor;
+
+              for (b = 0; b < components; b++)
+                {
+                  total[b] += offset;
+
+                  if (mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
+                    total[b] = - total[b];
+
+                  *d++ = CLAMP (total[b], 0.0, 1.0);
+                }
+            }
+        }
+      else
+        {
+          for (x = dest_x1; x < dest_x2; x++)
+            {
+              const gfloat *m        = data->kernel;
+              gdouble       total[4] = { 0.0, 0.0, 0.0, 0.0 };
+              gint          i, j, b;
+
+              for (j = y - margin; j <= y + margin; j++)
+                {
+                  for (i = x - margin; i <= x + margin; i++, m++)
+                    {
+                      gint          xx = CLAMP (i, x1, x2);
+                      gint          yy = CLAMP (j, y1, y2);
+                      const gfloat *s  = src + yy * data->src_rowstride + xx * components;
+
+                      for (b = 0; b < components; b++)
+                        total[b] += *m * s[b];
+                    }
+                }
+
+              for (b = 0; b < components; b++)
+                {
+                  total[b] = total[b] / divisor + offset;
+
+                  if (mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
+                    total[b] = - total[b];
+
+                  *d++ = CLAMP (total[b], 0.0, 1.0);
+                }
+            }
+        }
+
+      dest += dest_rowstride;
+    }
+}
+
+static void
+gimp_gegl_convolve_band (gint          y,
+                         gint          height,
+                         ConvolveData *data)
+{
+  GeglRectangle rect  = data->dest_rect;
+  gint          width = data->dest_rect.width * data->dest_components;
+
+  rect.y      += y;
+  rect.height  = height;
+
+  gimp_gegl_convolve_rect (data, &rect, data->dest + y * width, width);
+}
+
 void
 gimp_gegl_convolve (GeglBuffer          *src_buffer,
                     const GeglRectangle *src_rect,
@@ -46,14 +227,11 @@ gimp_gegl_convolve (GeglBuffer          *src_buffer,
                     GimpConvolutionType  mode,
                     gboolean             alpha_weighting)
 {
-  GeglBufferIterator *dest_iter;
+  ConvolveData        data;
   gfloat             *src;
-  gint                src_rowstride;
 
   const Babl         *src_format;
   const Babl         *dest_format;
-  gint                src_components;
-  gint                dest_components;
 
   src_format = gegl_buffer_get_format (src_buffer);
 
@@ -77,153 +255,210 @@ gimp_gegl_convolve (GeglBuffer          *src_buffer,
                                     GIMP_PRECISION_FLOAT_LINEAR,
                                     babl_format_has_alpha (dest_format));
 
-  src_components  = babl_format_get_n_components (src_format);
-  dest_components = babl_format_get_n_components (dest_format);
-
-  /* Set up dest iterator */
-  dest_iter = gegl_buffer_iterator_new (dest_buffer, dest_rect, 0, dest_format,
-                                        GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+  data.components      = babl_format_get_n_components (src_format);
+  data.dest_components = babl_format_get_n_components (dest_format);
+  data.src_width       = src_rect->width;
+  data.src_height      = src_rect->height;
+  data.src_rowstride   = data.components * src_rect->width;
+  data.kernel          = kernel;
+  data.kernel_size     = kernel_size;
+  data.divisor         = divisor;
+  data.alpha_weighting = alpha_weighting;
+
+  /*  If the mode is NEGATIVE_CONVOL, the offset should be 128  */
+  if (mode == GIMP_NEGATIVE_CONVOL)
+    {
+      data.offset = 0.5;
+      data.mode   = GIMP_NORMAL_CONVOL;
+    }
+  else
+    {
+      data.offset = 0.0;
+      data.mode   = mode;
+    }
 
   /* Get source pixel data */
-  src_rowstride = src_components * src_rect->width;
-  src = g_malloc (sizeof(gfloat) * src_rowstride * src_rect->height);
+  src = g_malloc (sizeof(gfloat) * data.src_rowstride * src_rect->height);
   gegl_buffer_get (src_buffer, src_rect, 1.0, src_format, src,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  while (gegl_buffer_iterator_next (dest_iter))
+  data.src = src;
+
+  if (gimp_gegl_loops_is_parallel (dest_rect))
     {
-      /*  Convolve the src image using the convolution kernel, writing
-       *  to dest Convolve is not tile-enabled--use accordingly
-       */
-      gfloat       *dest        = dest_iter->data[0];
-      const gint    components  = src_components;
-      const gint    a_component = components - 1;
-      const gint    margin      = kernel_size / 2;
-      const gint    x1          = 0;
-      const gint    y1          = 0;
-      const gint    x2          = src_rect->width  - 1;
-      const gint    y2          = src_rect->height - 1;
-      const gint    dest_x1     = dest_iter->roi[0].x;
-      const gint    dest_y1     = dest_iter->roi[0].y;
-      const gint    dest_x2     = dest_iter->roi[0].x + dest_iter->roi[0].width;
-      const gint    dest_y2     = dest_iter->roi[0].y + dest_iter->roi[0].height;
-      gint          x, y;
-      gfloat        offset;
-
-      /*  If the mode is NEGATIVE_CONVOL, the offset should be 128  */
-      if (mode == GIMP_NEGATIVE_CONVOL)
-        {
-          offset = 0.5;
-          mode = GIMP_NORMAL_CONVOL;
-        }
-      else
-        {
-          offset = 0.0;
-        }
+      data.dest_rect = *dest_rect;
+      data.dest      = g_new (gfloat, (dest_rect->width  *
+                                       dest_rect->height *
+                                       data.dest_components));
 
-      for (y = dest_y1; y < dest_y2; y++)
-        {
-          gfloat *d = dest;
+      gimp_parallel_distribute_range (dest_rect->height, 1,
+                                      (GimpParallelDistributeRangeFunc)
+                                      gimp_gegl_convolve_band,
+                                      &data);
 
-          if (alpha_weighting)
-            {
-              for (x = dest_x1; x < dest_x2; x++)
-                {
-                  const gfloat *m                = kernel;
-                  gdouble       total[4]         = { 0.0, 0.0, 0.0, 0.0 };
-                  gdouble       weighted_divisor = 0.0;
-                  gint          i, j, b;
+      gegl_buffer_set (dest_buffer, dest_rect, 0, dest_format, data.dest,
+                       GEGL_AUTO_ROWSTRIDE);
 
-                  for (j = y - margin; j <= y + margin; j++)
-                    {
-                      for (i = x - margin; i <= x + margin; i++, m++)
-                        {
-                          gint          xx = CLAMP (i, x1, x2);
-                          gint          yy = CLAMP (j, y1, y2);
-                          const gfloat *s  = src + yy * src_rowstride + xx * components;
-                          const gfloat  a  = s[a_component];
-
-                          if (a)
-                            {
-                              gdouble mult_alpha = *m * a;
+      g_free (data.dest);
+    }
+  else
+    {
+      GeglBufferIterator *dest_iter;
 
-                              weighted_divisor += mult_alpha;
+      /* Set up dest iterator */
+      dest_iter = gegl_buffer_iterator_new (dest_buffer, dest_rect, 0,
+                                            dest_format,
+                                            GEGL_ACCESS_WRITE,
+                                            GEGL_ABYSS_NONE);
 
-                              for (b = 0; b < a_component; b++)
-                                total[b] += mult_alpha * s[b];
+      while (gegl_buffer_iterator_next (dest_iter))
+        {
+          /*  Convolve the src image using the convolution kernel, writing
+           *  to dest Convolve is not tile-enabled--use accordingly
+           */
+          gimp_gegl_convolve_rect (&data, &dest_iter->roi[0],
+                                   dest_iter->data[0],
+                                   dest_iter->roi[0].width *
+                                   data.dest_components);
+        }
+    }
 
-                              total[a_component] += mult_alpha;
-                            }
-                        }
-                    }
+  g_free (src);
+}
 
-                  if (weighted_divisor == 0.0)
-                    weighted_divisor = divisor;
+static inline gfloat
+odd_powf (gfloat x,
+          gfloat y)
+{
+  if (x >= 0.0f)
+    return  powf ( x, y);
+  else
+    return -powf (-x, y);
+}
 
-                  for (b = 0; b < a_component; b++)
-                    total[b] /= weighted_divisor;
+static void
+gimp_gegl_dodgeburn_pixels (const gfloat     *src,
+                            gfloat           *dest,
+                            gint              count,
+                            GimpTransferMode  mode,
+                            gdouble           exposure,
+                            gfloat            factor)
+{
+  switch (mode)
+    {
+    case GIMP_TRANSFER_HIGHLIGHTS:
+      {
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+        typedef float v4sf __attribute__((vector_size(16)));
+        const v4sf f = { factor, factor, factor, 1.0f };
+
+        while (count--)
+          {
+            v4sf s;
+
+            memcpy (&s, src, sizeof (v4sf));
+            s *= f;
+            memcpy (dest, &s, sizeof (v4sf));
+
+            src  += 4;
+            dest += 4;
+          }
+#else
+        while (count--)
+          {
+            *dest++ = *src++ * factor;
+            *dest++ = *src++ * factor;
+            *dest++ = *src++ * factor;
+
+            *dest++ = *src++;
+          }
+#endif
+      }
+      break;
 
-                  total[a_component] /= divisor;
+    case GIMP_TRANSFER_MIDTONES:
+      while (count--)
+        {
+          *dest++ = odd_powf (*src++, factor);
+          *dest++ = odd_powf (*src++, factor);
+          *dest++ = odd_powf (*src++, factor);
 
-                  for (b = 0; b < components; b++)
-                    {
-                      total[b] += offset;
+          *dest++ = *src++;
+        }
+      break;
 
-                      if (mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
-                        total[b] = - total[b];
+    case GIMP_TRANSFER_SHADOWS:
+      if (exposure >= 0)
+        {
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+          typedef float v4sf __attribute__((vector_size(16)));
+          /*  a zero factor keeps the alpha  */
+          const v4sf f = { factor, factor, factor, 0.0f };
 
-                      *d++ = CLAMP (total[b], 0.0, 1.0);
-                    }
-                }
-            }
-          else
+          while (count--)
             {
-              for (x = dest_x1; x < dest_x2; x++)
-                {
-                  const gfloat *m        = kernel;
-                  gdouble       total[4] = { 0.0, 0.0, 0.0, 0.0 };
-                  gint          i, j, b;
+              v4sf s;
 
-                  for (j = y - margin; j <= y + margin; j++)
-                    {
-                      for (i = x - margin; i <= x + margin; i++, m++)
-                        {
-                          gint          xx = CLAMP (i, x1, x2);
-                          gint          yy = CLAMP (j, y1, y2);
-                          const gfloat *s  = src + yy * src_rowstride + xx * components;
+              memcpy (&s, src, sizeof (v4sf));
+              s = f + s - f * s;
+              memcpy (dest, &s, sizeof (v4sf));
 
-                          for (b = 0; b < components; b++)
-                            total[b] += *m * s[b];
-                        }
-                    }
-
-                  for (b = 0; b < components; b++)
-                    {
-                      total[b] = total[b] / divisor + offset;
+              src  += 4;
+              dest += 4;
+            }
+#else
+          while (count--)
+            {
+              gfloat s;
 
-                      if (mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
-                        total[b] = - total[b];
+              s = *src++; *dest++ = factor + s - factor * s;
+              s = *src++; *dest++ = factor + s - factor * s;
+              s = *src++; *dest++ = factor + s - factor * s;
 
-                      *d++ = CLAMP (total[b], 0.0, 1.0);
-                    }
-                }
+              *dest++ = *src++;
             }
+#endif
+        }
+      else
+        {
+          while (count--)
+            {
+              gfloat s;
+
+              s = *src++;
+              if (s < factor)
+                *dest++ = 0;
+              else /* factor <= value <=1 */
+                *dest++ = (s - factor) / (1.0 - factor);
+
+              s = *src++;
+              if (s < factor)
+                *dest++ = 0;
+              else /* factor <= value <=1 */
+                *dest++ = (s - factor) / (1.0 - factor);
+
+              s = *src++;
+              if (s < factor)
+                *dest++ = 0;
+              else /* factor <= value <=1 */
+                *dest++ = (s - factor) / (1.0 - factor);
 
-          dest += dest_iter->roi[0].width * dest_components;
+              *dest++ = *src++;
+            }
         }
+      break;
     }
-
-  g_free (src);
 }
 
-static inline gfloat
-odd_powf (gfloat x,
-          gfloat y)
+static void
+gimp_gegl_dodgeburn_band (gint           y,
+                          gint           height,
+                          DodgeBurnData *data)
 {
-  if (x >= 0.0f)
-    return  powf ( x, y);
-  else
-    return -powf (-x, y);
+  gfloat *pixels = data->pixels + y * data->width * 4;
+
+  gimp_gegl_dodgeburn_pixels (pixels, pixels, height * data->width,
+                              data->mode, data->exposure, data->factor);
 }
 
 void
@@ -235,41 +470,16 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
                      GimpDodgeBurnType    type,
                      GimpTransferMode     mode)
 {
-  GeglBufferIterator *iter;
+  const Babl *format = babl_format ("R'G'B'A float");
+  gfloat      factor = 0.0;
 
   if (type == GIMP_DODGE_BURN_TYPE_BURN)
     exposure = -exposure;
 
-  iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                   babl_format ("R'G'B'A float"),
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-
-  gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                            babl_format ("R'G'B'A float"),
-                            GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
   switch (mode)
     {
-      gfloat factor;
-
     case GIMP_TRANSFER_HIGHLIGHTS:
       factor = 1.0 + exposure * (0.333333);
-
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat *src   = iter->data[0];
-          gfloat *dest  = iter->data[1];
-          gint    count = iter->length;
-
-          while (count--)
-            {
-              *dest++ = *src++ * factor;
-              *dest++ = *src++ * factor;
-              *dest++ = *src++ * factor;
-
-              *dest++ = *src++;
-            }
-        }
       break;
 
     case GIMP_TRANSFER_MIDTONES:
@@ -277,22 +487,6 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
         factor = 1.0 - exposure * (0.333333);
       else
         factor = 1.0 / (1.0 + exposure);
-
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat *src   = iter->data[0];
-          gfloat *dest  = iter->data[1];
-          gint    count = iter->length;
-
-          while (count--)
-            {
-              *dest++ = odd_powf (*src++, factor);
-              *dest++ = odd_powf (*src++, factor);
-              *dest++ = odd_powf (*src++, factor);
-
-              *dest++ = *src++;
-            }
-        }
       break;
 
     case GIMP_TRANSFER_SHADOWS:
@@ -300,50 +494,48 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
         factor = 0.333333 * exposure;
       else
         factor = -0.333333 * exposure;
+      break;
+    }
 
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat *src   = iter->data[0];
-          gfloat *dest  = iter->data[1];
-          gint    count = iter->length;
+  if (gimp_gegl_loops_is_parallel (src_rect))
+    {
+      DodgeBurnData data;
 
-          while (count--)
-            {
-              if (exposure >= 0)
-                {
-                  gfloat s;
+      data.pixels   = g_new (gfloat, src_rect->width * src_rect->height * 4);
+      data.width    = src_rect->width;
+      data.mode     = mode;
+      data.exposure = exposure;
+      data.factor   = factor;
 
-                  s = *src++; *dest++ = factor + s - factor * s;
-                  s = *src++; *dest++ = factor + s - factor * s;
-                  s = *src++; *dest++ = factor + s - factor * s;
-                }
-              else
-                {
-                  gfloat s;
-
-                  s = *src++;
-                  if (s < factor)
-                    *dest++ = 0;
-                  else /* factor <= value <=1 */
-                    *dest++ = (s - factor) / (1.0 - factor);
-
-                  s = *src++;
-                  if (s < factor)
-                    *dest++ = 0;
-                  else /* factor <= value <=1 */
-                    *dest++ = (s - factor) / (1.0 - factor);
-
-                  s = *src++;
-                  if (s < factor)
-                    *dest++ = 0;
-                  else /* factor <= value <=1 */
-                    *dest++ = (s - factor) / (1.0 - factor);
-                }
+      gegl_buffer_get (src_buffer, src_rect, 1.0, format, data.pixels,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-              *dest++ = *src++;
-           }
+      gimp_parallel_distribute_range (src_rect->height, 1,
+                                      (GimpParallelDistributeRangeFunc)
+                                      gimp_gegl_dodgeburn_band,
+                                      &data);
+
+      gegl_buffer_set (dest_buffer, dest_rect, 0, format, data.pixels,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      g_free (data.pixels);
+    }
+  else
+    {
+      GeglBufferIterator *iter;
+
+      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0, format,
+                                       GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+      gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0, format,
+                                GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          gimp_gegl_dodgeburn_pixels (iter->data[0], iter->data[1],
+                                      iter->length,
+                                      mode, exposure, factor);
         }
-      break;
     }
 }
 
@@ -353,7 +545,71 @@ gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
  * right behavior for the smudge tool, which is the only user of this function
  * at the time of patching.  If you want to use the function for something
  * else, caveat emptor.
+ *
+ * @dest may be the same as @top.
  */
+static void
+gimp_gegl_smudge_blend_pixels (const gfloat *top,
+                               const gfloat *bottom,
+                               gfloat       *dest,
+                               gint          count,
+                               gfloat        blend)
+{
+  const gfloat blend1 = 1.0 - blend;
+  const gfloat blend2 = blend;
+
+  while (count--)
+    {
+      const gfloat a1 = blend1 * bottom[3];
+      const gfloat a2 = blend2 * top[3];
+      const gfloat a  = a1 + a2;
+      gint         b;
+
+      if (a == 0)
+        {
+          for (b = 0; b < 4; b++)
+            dest[b] = 0;
+        }
+      else
+        {
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+          typedef float v4sf __attribute__((vector_size(16)));
+          const v4sf va1 = { a1, a1, a1, a1 };
+          const v4sf va2 = { a2, a2, a2, a2 };
+          const v4sf va  = { a,  a,  a,  a  };
+          v4sf       t, s;
+
+          memcpy (&t, top,    sizeof (v4sf));
+          memcpy (&s, bottom, sizeof (v4sf));
+          s = s + (s * va1 + t * va2 - va * s) / va;
+          memcpy (dest, &s, sizeof (v4sf));
+#else
+          for (b = 0; b < 3; b++)
+            dest[b] =
+              bottom[b] + (bottom[b] * a1 + top[b] * a2 - a * bottom[b]) / a;
+#endif
+
+          dest[3] = a;
+        }
+
+      top    += 4;
+      bottom += 4;
+      dest   += 4;
+    }
+}
+
+static void
+gimp_gegl_smudge_blend_band (gint             y,
+                             gint             height,
+                             SmudgeBlendData *data)
+{
+  gint offset = y * data->width * 4;
+
+  gimp_gegl_smudge_blend_pixels (data->top + offset, data->bottom + offset,
+                                 data->top + offset,
+                                 height * data->width, data->blend);
+}
+
 void
 gimp_gegl_smudge_blend (GeglBuffer          *top_buffer,
                         const GeglRectangle *top_rect,
@@ -363,53 +619,54 @@ gimp_gegl_smudge_blend (GeglBuffer          *top_buffer,
                         const GeglRectangle *dest_rect,
                         gdouble              blend)
 {
-  GeglBufferIterator *iter;
+  const Babl *format = babl_format ("RGBA float");
 
-  iter = gegl_buffer_iterator_new (top_buffer, top_rect, 0,
-                                   babl_format ("RGBA float"),
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+  if (gimp_gegl_loops_is_parallel (top_rect))
+    {
+      SmudgeBlendData  data;
+      gfloat          *bottom;
 
-  gegl_buffer_iterator_add (iter, bottom_buffer, bottom_rect, 0,
-                            babl_format ("RGBA float"),
-                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+      data.top   = g_new (gfloat, top_rect->width * top_rect->height * 4);
+      bottom     = g_new (gfloat, top_rect->width * top_rect->height * 4);
+      data.width = top_rect->width;
+      data.blend = blend;
 
-  gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                            babl_format ("RGBA float"),
-                            GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+      gegl_buffer_get (top_buffer, top_rect, 1.0, format, data.top,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      gegl_buffer_get (bottom_buffer, bottom_rect, 1.0, format, bottom,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  while (gegl_buffer_iterator_next (iter))
+      data.bottom = bottom;
+
+      gimp_parallel_distribute_range (top_rect->height, 1,
+                                      (GimpParallelDistributeRangeFunc)
+                                      gimp_gegl_smudge_blend_band,
+                                      &data);
+
+      gegl_buffer_set (dest_buffer, dest_rect, 0, format, data.top,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      g_free (data.top);
+      g_free (bottom);
+    }
+  else
     {
-      const gfloat *top    = iter->data[0];
-      const gfloat *bottom = iter->data[1];
-      gfloat       *dest   = iter->data[2];
-      gint          count  = iter->length;
-      const gfloat  blend1 = 1.0 - blend;
-      const gfloat  blend2 = blend;
+      GeglBufferIterator *iter;
 
-      while (count--)
-        {
-          const gfloat a1 = blend1 * bottom[3];
-          const gfloat a2 = blend2 * top[3];
-          const gfloat a  = a1 + a2;
-          gint         b;
+      iter = gegl_buffer_iterator_new (top_buffer, top_rect, 0, format,
+                                       GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
-          if (a == 0)
-            {
-              for (b = 0; b < 4; b++)
-                dest[b] = 0;
-            }
-          else
-            {
-              for (b = 0; b < 3; b++)
-                dest[b] =
-                  bottom[b] + (bottom[b] * a1 + top[b] * a2 - a * bottom[b]) / a;
+      gegl_buffer_iterator_add (iter, bottom_buffer, bottom_rect, 0, format,
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
-              dest[3] = a;
-            }
+      gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0, format,
+                                GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-          top    += 4;
-          bottom += 4;
-          dest   += 4;
+      while (gegl_buffer_iterator_next (iter))
+        {
+          gimp_gegl_smudge_blend_pixels (iter->data[0], iter->data[1],
+                                         iter->data[2],
+                                         iter->length, blend);
         }
     }
 }
@@ -58,6 +58,7 @@
 #include "config/gimpconfig-dump.h"
 
 #include "core/gimp.h"
+#include "core/gimp-batch.h"
 
 #include "pdb/gimppdb.h"
 #include "pdb/gimpprocedure.h"
@@ -125,6 +126,8 @@ static const gchar        *user_gimprc       = NULL;
 static const gchar        *session_name      = NULL;
 static const gchar        *batch_interpreter = NULL;
 static const gchar       **batch_commands    = NULL;
+static gint                batch_jobs        = 0;
+static gint                batch_job_memory  = 0;
 static const gchar       **filenames         = NULL;
 static gboolean            as_new            = FALSE;
 static gboolean            no_interface      = FALSE;
@@ -234,6 +237,17 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_STRING, &batch_interpreter,
     N_("The procedure to process batch commands with"), "<proc>"
   },
+  {
+    "batch-jobs", 0, 0,
+    G_OPTION_ARG_INT, &batch_jobs,
+    N_("Run the batch commands for each file, in this many parallel jobs"),
+    "<n>"
+  },
+  {
+    "batch-job-memory", 0, 0,
+    G_OPTION_ARG_INT, &batch_job_memory,
+    N_("Memory limit of each batch job, in megabytes"), "<size>"
+  },
   {
     "console-messages", 'c', 0,
     G_OPTION_ARG_NONE, &console_messages,
@@ -514,9 +528,67 @@ main (int    argc,
       app_exit (EXIT_FAILURE);
     }
 
+  if (batch_job_memory < 0)
+    {
+      gimp_open_console_window ();
+      g_print ("%s\n",
+               _("The memory limit of batch jobs can't be negative."));
+
+      app_exit (EXIT_FAILURE);
+    }
+
   if (no_interface || be_verbose || console_messages || batch_commands != NULL)
     gimp_open_console_window ();
 
+  /*  with batch jobs, the files are inputs for new GIMP processes  */
+  if (batch_jobs > 0)
+    {
+      GPtrArray *args = g_ptr_array_new ();
+      gint       status;
+
+      g_ptr_array_add (args, "--no-interface");
+
+      if (no_data)
+        g_ptr_array_add (args, "--no-data");
+
+      if (no_fonts)
+        g_ptr_array_add (args, "--no-fonts");
+
+      if (be_verbose)
+        g_ptr_array_add (args, "--verbose");
+
+      if (user_gimprc)
+        {
+          g_ptr_array_add (args, "--gimprc");
+          g_ptr_array_add (args, (gpointer) user_gimprc);
+        }
+
+      if (system_gimprc)
+        {
+          g_ptr_array_add (args, "--system-gimprc");
+          g_ptr_array_add (args, (gpointer) system_gimprc);
+        }
+
+      if (batch_interpreter)
+        {
+          g_ptr_array_add (args, "--batch-interpreter");
+          g_ptr_array_add (args, (gpointer) batch_interpreter);
+        }
+
+      g_ptr_array_add (args, NULL);
+
+      status = gimp_batch_run_jobs (argv[0],
+                                    (const gchar **) args->pdata,
+                                    batch_commands,
+                                    filenames,
+                                    batch_jobs,
+                                    (gint64) batch_job_memory << 20);
+
+      g_ptr_array_free (args, TRUE);
+
+      app_exit (status);
+    }
+
   if (no_interface)
     new_instance = TRUE;
 
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -56,8 +58,9 @@ gimp_operation_border_get_required_for_output (GeglOperation       *self,
                                                const gchar         *input_pad,
                                                const GeglRectangle *roi);
 static GeglRectangle
-      gimp_operation_border_get_cached_region (GeglOperation       *self,
-                                               const GeglRectangle *roi);
+gimp_operation_border_get_invalidated_by_change (GeglOperation       *self,
+                                                 const gchar         *input_pad,
+                                                 const GeglRectangle *input_region);
 static void     gimp_operation_border_prepare (GeglOperation       *operation);
 static gboolean gimp_operation_border_process (GeglOperation       *operation,
                                                GeglBuffer          *input,
@@ -88,11 +91,11 @@ gimp_operation_border_class_init (GimpOperationBorderClass *klass)
                                  "description", "GIMP Border operation",
                                  NULL);
 
-  operation_class->prepare                 = gimp_operation_border_prepare;
-  operation_class->get_required_for_output = gimp_operation_border_get_required_for_output;
-  operation_class->get_cached_region       = gimp_operation_border_get_cached_region;
+  operation_class->prepare                   = gimp_operation_border_prepare;
+  operation_class->get_required_for_output   = gimp_operation_border_get_required_for_output;
+  operation_class->get_invalidated_by_change = gimp_operation_border_get_invalidated_by_change;
 
-  filter_class->process                    = gimp_operation_border_process;
+  filter_class->process                      = gimp_operation_border_process;
 
   g_object_class_install_property (object_class, PROP_RADIUS_X,
                                    g_param_spec_int ("radius-x",
@@ -208,122 +211,68 @@ gimp_operation_border_get_required_for_output (GeglOperation       *self,
                                                const gchar         *input_pad,
                                                const GeglRectangle *roi)
 {
-  return *gegl_operation_source_get_bounding_box (self, "input");
-}
+  GimpOperationBorder *border = GIMP_OPERATION_BORDER (self);
 
-static GeglRectangle
-gimp_operation_border_get_cached_region (GeglOperation       *self,
-                                         const GeglRectangle *roi)
-{
-  return *gegl_operation_source_get_bounding_box (self, "input");
+  /*  one more pixel than the radius to find the transitions  */
+  return *GEGL_RECTANGLE (roi->x      - border->radius_x - 1,
+                          roi->y      - border->radius_y - 1,
+                          roi->width  + 2 * border->radius_x + 2,
+                          roi->height + 2 * border->radius_y + 2);
 }
 
-static inline void
-rotate_pointers (gfloat  **p,
-                 guint32   n)
+static GeglRectangle
+gimp_operation_border_get_invalidated_by_change (GeglOperation       *self,
+                                                 const gchar         *input_pad,
+                                                 const GeglRectangle *input_region)
 {
-  guint32  i;
-  gfloat  *tmp;
-
-  tmp = p[0];
-
-  for (i = 0; i < n - 1; i++)
-    p[i] = p[i + 1];
-
-  p[i] = tmp;
+  return gimp_operation_border_get_required_for_output (self, input_pad,
+                                                        input_region);
 }
 
-/* Computes whether pixels in `buf[1]', if they are selected, have neighbouring
-   pixels that are unselected. Put result in `transition'. */
+/* Computes whether the pixels of `src' inside `bbox', if they are
+   selected, have neighbouring pixels that are unselected, for the
+   `width' by `height' pixels starting one pixel inside `src_rect'. Put
+   result in `transition'. */
 static void
-compute_transition (gfloat    *transition,
-                    gfloat   **buf,
-                    gint32     width,
-                    gboolean   edge_lock)
+compute_transition (guchar              *transition,
+                    const gfloat        *src,
+                    const GeglRectangle *src_rect,
+                    const GeglRectangle *bbox,
+                    gint                 width,
+                    gint                 height)
 {
-  register gint32 x = 0;
+  gint src_width = src_rect->width;
+  gint x, y;
 
-  if (width == 1)
-    {
-      if (buf[1][0] >= 0.5 && (buf[0][0] < 0.5 || buf[2][0] < 0.5))
-        transition[0] = 1.0;
-      else
-        transition[0] = 0.0;
-      return;
-    }
+  memset (transition, 0, width * height);
 
-  if (buf[1][0] >= 0.5 && edge_lock)
-    {
-      /* The pixel to the left (outside of the canvas) is considered selected,
-         so we check if there are any unselected pixels in neighbouring pixels
-         _on_ the canvas. */
-      if (buf[0][x] < 0.5 || buf[0][x + 1] < 0.5 ||
-                             buf[1][x + 1] < 0.5 ||
-          buf[2][x] < 0.5 || buf[2][x + 1] < 0.5 )
-        {
-          transition[x] = 1.0;
-        }
-      else
-        {
-          transition[x] = 0.0;
-        }
-    }
-  else if (buf[1][0] >= 0.5 && !edge_lock)
+  for (y = 0; y < height; y++)
     {
-      /* We must not care about neighbouring pixels on the image canvas since
-         there always are unselected pixels to the left (which is outside of
-         the image canvas). */
-      transition[x] = 1.0;
-    }
-  else
-    {
-      transition[x] = 0.0;
-    }
+      const gfloat *above = src + y * src_width + 1;
+      const gfloat *row   = above + src_width;
+      const gfloat *below = row   + src_width;
+      guchar       *t     = transition + y * width;
+      gint          src_y = src_rect->y + y + 1;
+      gint          x0, x1;
 
-  for (x = 1; x < width - 1; x++)
-    {
-      if (buf[1][x] >= 0.5)
-        {
-          if (buf[0][x - 1] < 0.5 || buf[0][x] < 0.5 || buf[0][x + 1] < 0.5 ||
-              buf[1][x - 1] < 0.5 ||                    buf[1][x + 1] < 0.5 ||
-              buf[2][x - 1] < 0.5 || buf[2][x] < 0.5 || buf[2][x + 1] < 0.5)
-            transition[x] = 1.0;
-          else
-            transition[x] = 0.0;
-        }
-      else
-        {
-          transition[x] = 0.0;
-        }
-    }
+      if (src_y < bbox->y || src_y >= bbox->y + bbox->height)
+        continue;
 
-  if (buf[1][width - 1] >= 0.5 && edge_lock)
-    {
-      /* The pixel to the right (outside of the canvas) is considered selected,
-         so we check if there are any unselected pixels in neighbouring pixels
-         _on_ the canvas. */
-      if ( buf[0][x - 1] < 0.5 || buf[0][x] < 0.5 ||
-           buf[1][x - 1] < 0.5 ||
-           buf[2][x - 1] < 0.5 || buf[2][x] < 0.5)
-        {
-          transition[width - 1] = 1.0;
-        }
-      else
+      /*  pixels outside of the input are never transitions  */
+      x0 = CLAMP (bbox->x - src_rect->x - 1, 0, width);
+      x1 = CLAMP (bbox->x + bbox->width - src_rect->x - 1, 0, width);
+
+      for (x = x0; x < x1; x++)
         {
-          transition[width - 1] = 0.0;
+          if (row[x] >= 0.5 &&
+              (above[x - 1] < 0.5 || above[x] < 0.5 || above[x + 1] < 0.5 ||
+               row[x - 1]   < 0.5 ||                   row[x + 1]   < 0.5 ||
+               below[x - 1] < 0.5 || below[x] < 0.5 || below[x + 1] < 0.5))
+            {
+              t[x] = 1;
+            }
         }
     }
-  else if (buf[1][width - 1] >= 0.5 && !edge_lock)
-    {
-      /* We must not care about neighbouring pixels on the image canvas since
-         there always are unselected pixels to the right (which is outside of
-         the image canvas). */
-      transition[width - 1] = 1.0;
-    }
-  else
-    {
-      transition[width - 1] = 0.0;
-    }
 }
 
 static gboolean
@@ -333,189 +282,142 @@ gimp_operation_border_process (GeglOperation       *operation,
                                const GeglRectangle *roi,
                                gint                 level)
 {
-  /* This function has no bugs, but if you imagine some you can blame
-   * them on jaycox@gimp.org
+  /* A pixel is on the border if there is a transition pixel (a
+   * selected pixel with unselected neighbours) inside the ellipse
+   * around it.  The density of the ellipse only depends on |dx| and
+   * |dy|, and falls off with |dy|, so for each column we only need the
+   * vertical distance to the nearest transition, which a linear sweep
+   * down and up the columns gives us.  Each output pixel then takes
+   * the maximum density over the row of its ellipse.
+   *
+   * If edge_lock is true, pixels outside the input are considered
+   * selected, otherwise they are considered unselected.
    */
-  GimpOperationBorder *self          = GIMP_OPERATION_BORDER (operation);
-  const Babl          *input_format  = babl_format ("Y float");
-  const Babl          *output_format = babl_format ("Y float");
-
-  gint32 i, j, x, y;
-
-  /* A cache used in the algorithm as it works its way down. `buf[1]' is the
-     current row. Thus, at algorithm initialization, `buf[0]' represents the
-     row 'above' the first row of the region. */
-  gfloat  *buf[3];
-
-  /* The resulting selection is calculated row by row, and this buffer holds the
-     output for each individual row, on each iteration. */
-  gfloat  *out;
+  GimpOperationBorder *self   = GIMP_OPERATION_BORDER (operation);
+  const Babl          *format = babl_format ("Y float");
+  const GeglRectangle *bbox;
+  GeglRectangle        src_rect;
+  GeglRectangle        read_rect;
+  gint                 rx     = self->radius_x;
+  gint                 ry     = self->radius_y;
+  gint                 t_width;
+  gint                 t_height;
+  gfloat              *src;        /* roi plus the radius plus one pixel */
+  guchar              *transition; /* roi plus the radius */
+  gint16              *dist;       /* vertical distance to a transition */
+  gint16              *sweep;
+  gfloat              *density;
+  gfloat              *out;
+  gint                 i, x, y, dx;
+
+  bbox = gegl_operation_source_get_bounding_box (operation, "input");
+
+  src_rect = gimp_operation_border_get_required_for_output (operation,
+                                                            "input", roi);
+
+  src = g_new (gfloat, src_rect.width * src_rect.height);
+
+  for (i = 0; i < src_rect.width * src_rect.height; i++)
+    src[i] = self->edge_lock ? 1.0 : 0.0;
+
+  if (gegl_rectangle_intersect (&read_rect, &src_rect, bbox))
+    {
+      gegl_buffer_get (input, &read_rect, 1.0, format,
+                       src + (read_rect.y - src_rect.y) * src_rect.width +
+                             (read_rect.x - src_rect.x),
+                       src_rect.width * sizeof (gfloat), GEGL_ABYSS_NONE);
+    }
 
-  /* Keeps track of transitional pixels (pixels that are selected and have
-     unselected neighbouring pixels). */
-  gfloat **transition;
+  t_width  = src_rect.width  - 2;
+  t_height = src_rect.height - 2;
 
-  /* TODO: Figure out role clearly in algorithm. */
-  gint16  *max;
+  transition = g_new (guchar, t_width * t_height);
+  compute_transition (transition, src, &src_rect, bbox, t_width, t_height);
 
-  /* TODO: Figure out role clearly in algorithm. */
-  gfloat **density;
+  g_free (src);
 
-  gint16   last_index;
+  out = g_new0 (gfloat, roi->width * roi->height);
 
   /* optimize this case specifically */
-  if (self->radius_x == 1 && self->radius_y == 1)
+  if (rx == 1 && ry == 1)
     {
-      gfloat *transition;
-      gfloat *source[3];
-
-      for (i = 0; i < 3; i++)
-        source[i] = g_new (gfloat, roi->width);
-
-      transition = g_new (gfloat, roi->width);
-
-      /* With `self->edge_lock', initialize row above image as
-       * selected, otherwise, initialize as unselected.
-       */
-      if (self->edge_lock)
-        {
-          for (i = 0; i < roi->width; i++)
-            source[0][i] = 1.0;
-        }
-      else
-        {
-          memset (source[0], 0, roi->width * sizeof (gfloat));
-        }
-
-      gegl_buffer_get (input,
-                       GEGL_RECTANGLE (roi->x, roi->y + 0,
-                                       roi->width, 1),
-                       1.0, input_format, source[1],
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-      if (roi->height > 1)
-        gegl_buffer_get (input,
-                         GEGL_RECTANGLE (roi->x, roi->y + 1,
-                                         roi->width, 1),
-                         1.0, input_format, source[2],
-                         GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      else
-        memcpy (source[2], source[1], roi->width * sizeof (gfloat));
-
-      compute_transition (transition, source, roi->width, self->edge_lock);
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y,
-                                       roi->width, 1),
-                       0, output_format, transition,
-                       GEGL_AUTO_ROWSTRIDE);
-
-      for (y = 1; y < roi->height; y++)
+      for (y = 0; y < roi->height; y++)
         {
-          rotate_pointers (source, 3);
-
-          if (y + 1 < roi->height)
-            {
-              gegl_buffer_get (input,
-                               GEGL_RECTANGLE (roi->x, roi->y + y + 1,
-                                               roi->width, 1),
-                               1.0, input_format, source[2],
-                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-            }
-          else
-            {
-              /* Depending on `self->edge_lock', set the row below the
-               * image as either selected or non-selected.
-               */
-              if (self->edge_lock)
-                {
-                  for (i = 0; i < roi->width; i++)
-                    source[2][i] = 1.0;
-                }
-              else
-                {
-                  memset (source[2], 0, roi->width * sizeof (gfloat));
-                }
-            }
+          const guchar *t = transition + (y + 1) * t_width + 1;
+          gfloat       *o = out + y * roi->width;
 
-          compute_transition (transition, source, roi->width, self->edge_lock);
-          gegl_buffer_set (output,
-                           GEGL_RECTANGLE (roi->x, roi->y + y,
-                                           roi->width, 1),
-                           0, output_format, transition,
-                           GEGL_AUTO_ROWSTRIDE);
+          for (x = 0; x < roi->width; x++)
+            o[x] = t[x];
         }
 
-      for (i = 0; i < 3; i++)
-        g_free (source[i]);
+      gegl_buffer_set (output, roi, 0, format, out, GEGL_AUTO_ROWSTRIDE);
 
+      g_free (out);
       g_free (transition);
 
-      /* Finnished handling the radius = 1 special case, return here. */
       return TRUE;
     }
 
-  max = g_new (gint16, roi->width + 2 * self->radius_x);
+  /* compute the distances, ry + 1 meaning no transition in reach */
+  dist  = g_new (gint16, t_width * roi->height);
+  sweep = g_new (gint16, t_width);
 
-  for (i = 0; i < (roi->width + 2 * self->radius_x); i++)
-    max[i] = self->radius_y + 2;
+  for (x = 0; x < t_width; x++)
+    sweep[x] = ry + 1;
 
-  max += self->radius_x;
+  for (y = 0; y < ry + roi->height; y++)
+    {
+      const guchar *t = transition + y * t_width;
+
+      for (x = 0; x < t_width; x++)
+        sweep[x] = t[x] ? 0 : MIN (sweep[x] + 1, ry + 1);
 
-  for (i = 0; i < 3; i++)
-    buf[i] = g_new (gfloat, roi->width);
+      if (y >= ry)
+        memcpy (dist + (y - ry) * t_width, sweep, t_width * sizeof (gint16));
+    }
 
-  transition = g_new (gfloat *, self->radius_y + 1);
+  for (x = 0; x < t_width; x++)
+    sweep[x] = ry + 1;
 
-  for (i = 0; i < self->radius_y + 1; i++)
+  for (y = t_height - 1; y >= ry; y--)
     {
-      transition[i] = g_new (gfloat, roi->width + 2 * self->radius_x);
-      memset (transition[i], 0,
-              (roi->width + 2 * self->radius_x) * sizeof (gfloat));
-      transition[i] += self->radius_x;
-    }
+      const guchar *t = transition + y * t_width;
 
-  out = g_new (gfloat, roi->width);
+      for (x = 0; x < t_width; x++)
+        sweep[x] = t[x] ? 0 : MIN (sweep[x] + 1, ry + 1);
 
-  density = g_new (gfloat *, 2 * self->radius_x + 1);
-  density += self->radius_x;
+      if (y < ry + roi->height)
+        {
+          gint16 *d = dist + (y - ry) * t_width;
 
-  /* allocate density[][] */
-  for (x = 0; x < (self->radius_x + 1); x++)
-    {
-      density[ x]  = g_new (gfloat, 2 * self->radius_y + 1);
-      density[ x] += self->radius_y;
-      density[-x]  = density[x];
+          for (x = 0; x < t_width; x++)
+            d[x] = MIN (d[x], sweep[x]);
+        }
     }
 
-  /* compute density[][] */
-  for (x = 0; x < (self->radius_x + 1); x++)
-    {
-      gdouble tmpx, tmpy, dist;
-      gfloat  a;
+  g_free (sweep);
+  g_free (transition);
+
+  /* compute density[|dx|][|dy|], with an empty slot for no transition */
+  density = g_new (gfloat, (rx + 1) * (ry + 2));
 
-      if (x > 0)
-        tmpx = x - 0.5;
-      else if (x < 0)
-        tmpx = x + 0.5;
-      else
-        tmpx = 0.0;
+  for (x = 0; x < rx + 1; x++)
+    {
+      gdouble tmpx = x > 0 ? x - 0.5 : 0.0;
 
-      for (y = 0; y < (self->radius_y + 1); y++)
+      for (y = 0; y < ry + 1; y++)
         {
-          if (y > 0)
-            tmpy = y - 0.5;
-          else if (y < 0)
-            tmpy = y + 0.5;
-          else
-            tmpy = 0.0;
+          gdouble tmpy = y > 0 ? y - 0.5 : 0.0;
+          gdouble r;
+          gfloat  a;
 
-          dist = ((tmpy * tmpy) / (self->radius_y * self->radius_y) +
-                  (tmpx * tmpx) / (self->radius_x * self->radius_x));
+          r = ((tmpy * tmpy) / (ry * ry) +
+               (tmpx * tmpx) / (rx * rx));
 
-          if (dist < 1.0)
+          if (r < 1.0)
             {
               if (self->feather)
-                a = 1.0 - sqrt (dist);
+                a = 1.0 - sqrt (r);
               else
                 a = 1.0;
             }
@@ -524,223 +426,32 @@ gimp_operation_border_process (GeglOperation       *operation,
               a = 0.0;
             }
 
-          density[ x][ y] = a;
-          density[ x][-y] = a;
-          density[-x][ y] = a;
-          density[-x][-y] = a;
+          density[x * (ry + 2) + y] = a;
         }
-    }
 
-  /* Since the algorithm considerers `buf[0]' to be 'over' the row
-   * currently calculated, we must start with `buf[0]' as non-selected
-   * if there is no `self->edge_lock. If there is an
-   * 'self->edge_lock', initialize the first row to 'selected'. Refer
-   * to bug #350009.
-   */
-  if (self->edge_lock)
-    {
-      for (i = 0; i < roi->width; i++)
-        buf[0][i] = 1.0;
-    }
-  else
-    {
-      memset (buf[0], 0, roi->width * sizeof (gfloat));
+      density[x * (ry + 2) + ry + 1] = 0.0;
     }
 
-  gegl_buffer_get (input,
-                   GEGL_RECTANGLE (roi->x, roi->y + 0,
-                                   roi->width, 1),
-                   1.0, input_format, buf[1],
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  if (roi->height > 1)
-    gegl_buffer_get (input,
-                     GEGL_RECTANGLE (roi->x, roi->y + 1,
-                                     roi->width, 1),
-                     1.0, input_format, buf[2],
-                     GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-  else
-    memcpy (buf[2], buf[1], roi->width * sizeof (gfloat));
-
-  compute_transition (transition[1], buf, roi->width, self->edge_lock);
-
-   /* set up top of image */
-  for (y = 1; y < self->radius_y && y + 1 < roi->height; y++)
+  /* render the rows */
+  for (dx = -rx; dx <= rx; dx++)
     {
-      rotate_pointers (buf, 3);
-      gegl_buffer_get (input,
-                       GEGL_RECTANGLE (roi->x, roi->y + y + 1,
-                                       roi->width, 1),
-                       1.0, input_format, buf[2],
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      compute_transition (transition[y + 1], buf, roi->width, self->edge_lock);
-    }
-
-  /* set up max[] for top of image */
-  for (x = 0; x < roi->width; x++)
-    {
-      max[x] = -(self->radius_y + 7);
-
-      for (j = 1; j < self->radius_y + 1; j++)
-        if (transition[j][x])
-          {
-            max[x] = j;
-            break;
-          }
-    }
+      const gfloat *dens = density + ABS (dx) * (ry + 2);
 
-  /* main calculation loop */
-  for (y = 0; y < roi->height; y++)
-    {
-      rotate_pointers (buf, 3);
-      rotate_pointers (transition, self->radius_y + 1);
-
-      if (y < roi->height - (self->radius_y + 1))
-        {
-          gegl_buffer_get (input,
-                           GEGL_RECTANGLE (roi->x,
-                                           roi->y + y + self->radius_y + 1,
-                                           roi->width, 1),
-                           1.0, input_format, buf[2],
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-          compute_transition (transition[self->radius_y], buf, roi->width, self->edge_lock);
-        }
-      else
+      for (y = 0; y < roi->height; y++)
         {
-          if (self->edge_lock)
-            {
-              memcpy (transition[self->radius_y], transition[self->radius_y - 1], roi->width * sizeof (gfloat));
-            }
-          else
-            {
-              /* No edge lock, set everything 'below canvas' as seen
-               * from the algorithm as unselected.
-               */
-              memset (buf[2], 0, roi->width * sizeof (gfloat));
-              compute_transition (transition[self->radius_y], buf, roi->width, self->edge_lock);
-            }
-        }
-
-      /* update max array */
-      for (x = 0; x < roi->width; x++)
-        {
-          if (max[x] < 1)
-            {
-              if (max[x] <= -self->radius_y)
-                {
-                  if (transition[self->radius_y][x])
-                    max[x] = self->radius_y;
-                  else
-                    max[x]--;
-                }
-              else
-                {
-                  if (transition[-max[x]][x])
-                    max[x] = -max[x];
-                  else if (transition[-max[x] + 1][x])
-                    max[x] = -max[x] + 1;
-                  else
-                    max[x]--;
-                }
-            }
-          else
-            {
-              max[x]--;
-            }
+          const gint16 *d = dist + y * t_width + rx + dx;
+          gfloat       *o = out  + y * roi->width;
 
-          if (max[x] < -self->radius_y - 1)
-            max[x] = -self->radius_y - 1;
+          for (x = 0; x < roi->width; x++)
+            o[x] = MAX (o[x], dens[d[x]]);
         }
-
-      last_index = 1;
-
-       /* render scan line */
-      for (x = 0 ; x < roi->width; x++)
-        {
-          gfloat last_max;
-
-          last_index--;
-
-          if (last_index >= 0)
-            {
-              last_max = 0.0;
-
-              for (i = self->radius_x; i >= 0; i--)
-                if (max[x + i] <= self->radius_y && max[x + i] >= -self->radius_y &&
-                    density[i][max[x+i]] > last_max)
-                  {
-                    last_max = density[i][max[x + i]];
-                    last_index = i;
-                  }
-
-              out[x] = last_max;
-            }
-          else
-            {
-              last_max = 0.0;
-
-              for (i = self->radius_x; i >= -self->radius_x; i--)
-                if (max[x + i] <= self->radius_y && max[x + i] >= -self->radius_y &&
-                    density[i][max[x + i]] > last_max)
-                  {
-                    last_max = density[i][max[x + i]];
-                    last_index = i;
-                  }
-
-              out[x] = last_max;
-            }
-
-          if (last_max <= 0.0)
-            {
-              for (i = x + 1; i < roi->width; i++)
-                {
-                  if (max[i] >= -self->radius_y)
-                    break;
-                }
-
-              if (i - x > self->radius_x)
-                {
-                  for (; x < i - self->radius_x; x++)
-                    out[x] = 0;
-
-                  x--;
-                }
-
-              last_index = self->radius_x;
-            }
-        }
-
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y + y,
-                                       roi->width, 1),
-                       0, output_format, out,
-                       GEGL_AUTO_ROWSTRIDE);
-    }
-
-  g_free (out);
-
-  for (i = 0; i < 3; i++)
-    g_free (buf[i]);
-
-  max -= self->radius_x;
-  g_free (max);
-
-  for (i = 0; i < self->radius_y + 1; i++)
-    {
-      transition[i] -= self->radius_x;
-      g_free (transition[i]);
     }
 
-  g_free (transition);
-
-  for (i = 0; i < self->radius_x + 1 ; i++)
-    {
-      density[i] -= self->radius_y;
-      g_free (density[i]);
-    }
+  gegl_buffer_set (output, roi, 0, format, out, GEGL_AUTO_ROWSTRIDE);
 
-  density -= self->radius_x;
   g_free (density);
+  g_free (dist);
+  g_free (out);
 
   return TRUE;
 }
@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -26,12 +28,57 @@
 
 #include "operations-types.h"
 
+#include "core/gimp-parallel.h"
+
 #include "gimpoperationcagecoefcalc.h"
 #include "gimpcageconfig.h"
 
 #include "gimp-intl.h"
 
 
+/*  the size of the square blocks the roi is split into for the threads  */
+#define BLOCK_SIZE   64
+
+/*  the grid spacing of the exactly computed coefficients in preview mode  */
+#define PREVIEW_STEP 8
+
+
+typedef struct
+{
+  gdouble x;             /* the edge's first vertex               */
+  gdouble y;
+  gfloat  ax;            /* the vector to the edge's second vertex */
+  gfloat  ay;
+  gfloat  q;             /* its squared length                    */
+  gfloat  length;
+  gfloat  edge_factor;
+  gfloat  vertex_factor;
+} CoefEdge;
+
+typedef struct
+{
+  GeglBuffer    *output;
+  const Babl    *format;
+  GeglRectangle  roi;
+  gboolean       preview;
+  gint           n_vertices;
+  CoefEdge      *edges;
+
+  volatile gint  next_block;
+  gint           n_blocks_x;
+  gint           n_blocks;
+} CoefCalcData;
+
+typedef struct
+{
+  gfloat   *coef;        /* one block of output coefficients        */
+  gfloat   *point;       /* per-vertex values of the current point  */
+  gdouble  *crossings;   /* the cage outline's crossings of a row   */
+  gfloat   *grid;        /* the preview grid's coefficients         */
+  gboolean *grid_inside;
+} CoefCalcScratch;
+
+
 static void           gimp_operation_cage_coef_calc_finalize         (GObject              *object);
 static void           gimp_operation_cage_coef_calc_get_property     (GObject              *object,
                                                                       guint                 property_id,
@@ -42,6 +89,31 @@ static void           gimp_operation_cage_coef_calc_set_property     (GObject
                                                                       const GValue         *value,
                                                                       GParamSpec           *pspec);
 
+static void           gimp_operation_cage_coef_calc_point            (const CoefCalcData   *data,
+                                                                      gdouble               x,
+                                                                      gdouble               y,
+                                                                      gfloat               *coef,
+                                                                      gfloat               *scratch);
+static gint           gimp_operation_cage_coef_calc_crossings        (const CoefCalcData   *data,
+                                                                      gdouble               y,
+                                                                      gdouble              *crossings);
+static gdouble        gimp_operation_cage_coef_calc_distance         (const CoefCalcData   *data,
+                                                                      gdouble               x,
+                                                                      gdouble               y);
+static gboolean       gimp_operation_cage_coef_calc_inside           (const CoefCalcData   *data,
+                                                                      gdouble               x,
+                                                                      gdouble               y,
+                                                                      gdouble              *crossings);
+static void           gimp_operation_cage_coef_calc_block            (CoefCalcData         *data,
+                                                                      const GeglRectangle  *block,
+                                                                      CoefCalcScratch      *scratch);
+static CoefCalcScratch *
+                      gimp_operation_cage_coef_calc_scratch_new      (CoefCalcData         *data);
+static void           gimp_operation_cage_coef_calc_scratch_free     (CoefCalcScratch      *scratch);
+static void           gimp_operation_cage_coef_calc_thread           (gint                  part,
+                                                                      gint                  n_parts,
+                                                                      gpointer              user_data);
+
 static void           gimp_operation_cage_coef_calc_prepare          (GeglOperation        *operation);
 static GeglRectangle  gimp_operation_cage_coef_calc_get_bounding_box (GeglOperation        *operation);
 static gboolean       gimp_operation_cage_coef_calc_process          (GeglOperation        *operation,
@@ -88,6 +160,15 @@ gimp_operation_cage_coef_calc_class_init (GimpOperationCageCoefCalcClass *klass)
                                                         GIMP_TYPE_CAGE_CONFIG,
                                                         G_PARAM_READWRITE |
                                                         G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (object_class,
+                                   GIMP_OPERATION_CAGE_COEF_CALC_PROP_PREVIEW,
+                                   g_param_spec_boolean ("preview",
+                                                         "Preview",
+                                                         "Interpolate the coefficients from a coarse grid, for interactive previews",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT));
 }
 
 static void
@@ -123,6 +204,10 @@ gimp_operation_cage_coef_calc_get_property (GObject    *object,
       g_value_set_object (value, self->config);
       break;
 
+    case GIMP_OPERATION_CAGE_COEF_CALC_PROP_PREVIEW:
+      g_value_set_boolean (value, self->preview);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -145,33 +230,16 @@ gimp_operation_cage_coef_calc_set_property (GObject      *object,
       self->config = g_value_dup_object (value);
       break;
 
+    case GIMP_OPERATION_CAGE_COEF_CALC_PROP_PREVIEW:
+      self->preview = g_value_get_boolean (value);
+      break;
+
    default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
 }
 
-static gboolean
-gimp_operation_cage_coef_calc_is_on_straight (GimpVector2 *d1,
-                                              GimpVector2 *d2,
-                                              GimpVector2 *p)
-{
-  GimpVector2 v1, v2;
-  gfloat      deter;
-
-  v1.x = p->x - d1->x;
-  v1.y = p->y - d1->y;
-  v2.x = d2->x - d1->x;
-  v2.y = d2->y - d1->y;
-
-  gimp_vector2_normalize (&v1);
-  gimp_vector2_normalize (&v2);
-
-  deter = v1.x * v2.y - v2.x * v1.y;
-
-  return (deter < 0.000000001) && (deter > -0.000000001);
-}
-
 static void
 gimp_operation_cage_coef_calc_prepare (GeglOperation *operation)
 {
@@ -193,106 +261,396 @@ gimp_operation_cage_coef_calc_get_bounding_box (GeglOperation *operation)
   return gimp_cage_config_get_bounding_box (config);
 }
 
-static gboolean
-gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
-                                       GeglBuffer          *output,
-                                       const GeglRectangle *roi,
-                                       gint                 level)
+/*  Mean value coordinates of a point p, for the cage edge from vertex
+ *  v1 to v2, with a = v2 - v1, b = v1 - p, c = v2 - p.  The usual form
+ *
+ *    SRT = sqrt (4 |b|^2 |a|^2 - (2 a.b)^2)
+ *    A10 = (atan2 (2 a.c, SRT) - atan2 (2 a.b, SRT)) / SRT
+ *
+ *  cancels badly, so it is evaluated through the equivalent SRT = 2 |a x b|
+ *  and SRT * A10 = angle subtended by the edge, which is accurate in
+ *  single precision.
+ */
+static void
+gimp_operation_cage_coef_calc_point (const CoefCalcData *data,
+                                     gdouble             x,
+                                     gdouble             y,
+                                     gfloat             *coef,
+                                     gfloat             *scratch)
 {
-  GimpOperationCageCoefCalc *occc   = GIMP_OPERATION_CAGE_COEF_CALC (operation);
-  GimpCageConfig            *config = GIMP_CAGE_CONFIG (occc->config);
+  const gint  n_vertices = data->n_vertices;
+  gfloat     *bx         = scratch;
+  gfloat     *by         = bx + n_vertices + 1;
+  gfloat     *s          = by + n_vertices + 1;
+  gfloat     *log_s      = s  + n_vertices + 1;
+  gint        j;
+
+  /*  the vectors from p to each vertex, with the first one repeated
+   *  at the end so that edge j always goes from vertex j to j + 1
+   */
+  for (j = 0; j < n_vertices; j++)
+    {
+      bx[j] = data->edges[j].x - x;
+      by[j] = data->edges[j].y - y;
+      s[j]  = bx[j] * bx[j] + by[j] * by[j];
+    }
 
-  const Babl *format;
+  for (j = 0; j < n_vertices; j++)
+    log_s[j] = logf (s[j]);
 
-  GeglBufferIterator *it;
-  guint               n_cage_vertices;
-  GimpCagePoint      *current, *last;
+  bx[n_vertices]    = bx[0];
+  by[n_vertices]    = by[0];
+  s[n_vertices]     = s[0];
+  log_s[n_vertices] = log_s[0];
 
-  if (! config)
-    return FALSE;
+  memset (coef, 0, n_vertices * sizeof (gfloat));
+
+  for (j = 0; j < n_vertices; j++)
+    {
+      const CoefEdge *edge = &data->edges[j];
+      gfloat          ab, ac, ba, bc;
+      gfloat          l10, phi;
+
+      ab  = edge->ax * bx[j]     + edge->ay * by[j];
+      ac  = edge->ax * bx[j + 1] + edge->ay * by[j + 1];
+      ba  = bx[j] * edge->ay     - by[j] * edge->ax;
+      bc  = bx[j] * bx[j + 1]    + by[j] * by[j + 1];
+
+      l10 = logf (s[j + 1] / s[j]);
+      phi = atan2f (ba, bc);
+
+      /* edge coef */
+      coef[j + n_vertices] = edge->edge_factor * (2.0f * ba * phi +
+                                                  ab * l10 +
+                                                  edge->q * (log_s[j + 1] -
+                                                             2.0f));
+
+      if (isnan (coef[j + n_vertices]))
+        coef[j + n_vertices] = 0.0f;
+
+      /* vertice coef, unless p is on the straight line of the edge */
+      if (fabsf (ba) > 1e-6f * edge->length * sqrtf (s[j]))
+        {
+          coef[j] += edge->vertex_factor * (ba * l10 / 2.0f - phi * ac);
+          coef[(j + 1) % n_vertices] -= edge->vertex_factor * (ba * l10 / 2.0f -
+                                                               phi * ab);
+        }
+    }
+}
+
+/*  Rasterize the cage outline on row y: the sorted x coordinates where
+ *  it is crossed, with the same rule as gimp_cage_config_point_inside(),
+ *  so a pixel is inside if an odd number of crossings lie to its right.
+ */
+static gint
+gimp_operation_cage_coef_calc_crossings (const CoefCalcData *data,
+                                         gdouble             y,
+                                         gdouble            *crossings)
+{
+  const CoefEdge *last;
+  gint            n_crossings = 0;
+  gint            i;
+
+  last = &data->edges[data->n_vertices - 1];
+
+  for (i = 0; i < data->n_vertices; i++)
+    {
+      const CoefEdge *current = &data->edges[i];
+
+      if (((current->y <= y) && (y < last->y)) ||
+          ((last->y <= y) && (y < current->y)))
+        {
+          gdouble cross = ((last->x - current->x) * (y - current->y) /
+                           (last->y - current->y) + current->x);
+          gint    k;
+
+          for (k = n_crossings; k > 0 && crossings[k - 1] > cross; k--)
+            crossings[k] = crossings[k - 1];
+
+          crossings[k] = cross;
+          n_crossings++;
+        }
+
+      last = current;
+    }
+
+  return n_crossings;
+}
+
+static gdouble
+gimp_operation_cage_coef_calc_distance (const CoefCalcData *data,
+                                        gdouble             x,
+                                        gdouble             y)
+{
+  gdouble min = G_MAXDOUBLE;
+  gint    i;
+
+  for (i = 0; i < data->n_vertices; i++)
+    {
+      const CoefEdge *edge = &data->edges[i];
+      gdouble         bx   = x - edge->x;
+      gdouble         by   = y - edge->y;
+      gdouble         t    = 0.0;
+
+      if (edge->q > 0.0)
+        t = CLAMP ((bx * edge->ax + by * edge->ay) / edge->q, 0.0, 1.0);
+
+      bx -= t * edge->ax;
+      by -= t * edge->ay;
 
-  format = babl_format_n (babl_type ("float"), 2 * gimp_cage_config_get_n_points (config));
+      min = MIN (min, bx * bx + by * by);
+    }
+
+  return sqrt (min);
+}
+
+static gboolean
+gimp_operation_cage_coef_calc_inside (const CoefCalcData *data,
+                                      gdouble             x,
+                                      gdouble             y,
+                                      gdouble            *crossings)
+{
+  gint n_crossings;
+  gint n_right = 0;
+  gint i;
+
+  n_crossings = gimp_operation_cage_coef_calc_crossings (data, y, crossings);
+
+  for (i = 0; i < n_crossings; i++)
+    {
+      if (x < crossings[i])
+        n_right++;
+    }
 
-  n_cage_vertices   = gimp_cage_config_get_n_points (config);
+  return (n_right & 1);
+}
 
-  it = gegl_buffer_iterator_new (output, roi, 0, format,
-                                 GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
+static void
+gimp_operation_cage_coef_calc_block (CoefCalcData        *data,
+                                     const GeglRectangle *block,
+                                     CoefCalcScratch     *scratch)
+{
+  const gint  n_coefs = 2 * data->n_vertices;
+  gfloat     *coef    = scratch->coef;
+  gint        grid_x  = 0;
+  gint        grid_y  = 0;
+  gint        grid_width = 0;
+  gint        y;
+
+  if (data->preview)
+    {
+      gint gx, gy;
+
+      /*  evaluate the coefficients on a grid aligned to image
+       *  coordinates, so neighbouring blocks interpolate alike
+       */
+      grid_x     = floor ((gdouble) block->x / PREVIEW_STEP) * PREVIEW_STEP;
+      grid_y     = floor ((gdouble) block->y / PREVIEW_STEP) * PREVIEW_STEP;
+      grid_width = (block->x + block->width - grid_x +
+                    PREVIEW_STEP - 1) / PREVIEW_STEP + 1;
+
+      for (gy = 0; gy * PREVIEW_STEP + grid_y <
+                   block->y + block->height + PREVIEW_STEP; gy++)
+        {
+          for (gx = 0; gx < grid_width; gx++)
+            {
+              gint    i  = gy * grid_width + gx;
+              gdouble px = grid_x + gx * PREVIEW_STEP;
+              gdouble py = grid_y + gy * PREVIEW_STEP;
+
+              /*  the coefficients change fast close to the cage, only
+               *  interpolate them well inside of it
+               */
+              scratch->grid_inside[i] =
+                (gimp_operation_cage_coef_calc_inside (data, px, py,
+                                                       scratch->crossings) &&
+                 gimp_operation_cage_coef_calc_distance (data, px, py) >=
+                 2 * PREVIEW_STEP);
+
+              if (scratch->grid_inside[i])
+                gimp_operation_cage_coef_calc_point (data, px, py,
+                                                     scratch->grid +
+                                                     i * n_coefs,
+                                                     scratch->point);
+            }
+        }
+    }
 
-  while (gegl_buffer_iterator_next (it))
+  for (y = block->y; y < block->y + block->height; y++)
     {
-      /* iterate inside the roi */
-      gint  n_pixels = it->length;
-      gint  x = it->roi->x; /* initial x                   */
-      gint  y = it->roi->y; /*           and y coordinates */
-      gint  j;
+      gint n_crossings;
+      gint k = 0;
+      gint x;
 
-      gfloat      *coef = it->data[0];
+      n_crossings = gimp_operation_cage_coef_calc_crossings (data, y,
+                                                             scratch->crossings);
 
-      while(n_pixels--)
+      for (x = block->x; x < block->x + block->width; x++, coef += n_coefs)
         {
-          if (gimp_cage_config_point_inside(config, x, y))
+          while (k < n_crossings && scratch->crossings[k] <= x)
+            k++;
+
+          if (! ((n_crossings - k) & 1))
             {
-              last = &(g_array_index (config->cage_points, GimpCagePoint, 0));
+              memset (coef, 0, n_coefs * sizeof (gfloat));
+              continue;
+            }
 
-              for( j = 0; j < n_cage_vertices; j++)
+          if (data->preview)
+            {
+              gint gx = (x - grid_x) / PREVIEW_STEP;
+              gint gy = (y - grid_y) / PREVIEW_STEP;
+              gint i  = gy * grid_width + gx;
+
+              if (scratch->grid_inside[i]                  &&
+                  scratch->grid_inside[i + 1]              &&
+                  scratch->grid_inside[i + grid_width]     &&
+                  scratch->grid_inside[i + grid_width + 1])
                 {
-                  GimpVector2 v1,v2,a,b,p;
-                  gdouble BA,SRT,L0,L1,A0,A1,A10,L10, Q,S,R, absa;
-
-                  current = &(g_array_index (config->cage_points, GimpCagePoint, (j+1) % n_cage_vertices));
-                  v1 = last->src_point;
-                  v2 = current->src_point;
-                  p.x = x;
-                  p.y = y;
-                  a.x = v2.x - v1.x;
-                  a.y = v2.y - v1.y;
-                  absa = gimp_vector2_length (&a);
-
-                  b.x = v1.x - x;
-                  b.y = v1.y - y;
-                  Q = a.x * a.x + a.y * a.y;
-                  S = b.x * b.x + b.y * b.y;
-                  R = 2.0 * (a.x * b.x + a.y * b.y);
-                  BA = b.x * a.y - b.y * a.x;
-                  SRT = sqrt(4.0 * S * Q - R * R);
-
-                  L0 = log(S);
-                  L1 = log(S + Q + R);
-                  A0 = atan2(R, SRT) / SRT;
-                  A1 = atan2(2.0 * Q + R, SRT) / SRT;
-                  A10 = A1 - A0;
-                  L10 = L1 - L0;
-
-                  /* edge coef */
-                  coef[j + n_cage_vertices] = (-absa / (4.0 * G_PI)) * ((4.0*S-(R*R)/Q) * A10 + (R / (2.0 * Q)) * L10 + L1 - 2.0);
-
-                  if (isnan(coef[j + n_cage_vertices]))
+                  const gfloat *c00 = scratch->grid + i * n_coefs;
+                  const gfloat *c10 = c00 + n_coefs;
+                  const gfloat *c01 = c00 + grid_width * n_coefs;
+                  const gfloat *c11 = c01 + n_coefs;
+                  gfloat        fx;
+                  gfloat        fy;
+                  gint          j;
+
+                  fx = (gfloat) ((x - grid_x) % PREVIEW_STEP) / PREVIEW_STEP;
+                  fy = (gfloat) ((y - grid_y) % PREVIEW_STEP) / PREVIEW_STEP;
+
+                  for (j = 0; j < n_coefs; j++)
                     {
-                      coef[j + n_cage_vertices] = 0.0;
-                    }
+                      gfloat top    = c00[j] + fx * (c10[j] - c00[j]);
+                      gfloat bottom = c01[j] + fx * (c11[j] - c01[j]);
 
-                  /* vertice coef */
-                  if (!gimp_operation_cage_coef_calc_is_on_straight (&v1, &v2, &p))
-                    {
-                      coef[j] += (BA / (2.0 * G_PI)) * (L10 /(2.0*Q) - A10 * (2.0 + R / Q));
-                      coef[(j+1)%n_cage_vertices] -= (BA / (2.0 * G_PI)) * (L10 / (2.0 * Q) - A10 * (R / Q));
+                      coef[j] = top + fy * (bottom - top);
                     }
 
-                  last = current;
+                  continue;
                 }
             }
 
-          coef += 2 * n_cage_vertices;
-
-          /* update x and y coordinates */
-          x++;
-          if (x >= (it->roi->x + it->roi->width))
-            {
-              x = it->roi->x;
-              y++;
-            }
+          gimp_operation_cage_coef_calc_point (data, x, y, coef,
+                                               scratch->point);
         }
     }
 
+  gegl_buffer_set (data->output, block, 0, data->format,
+                   scratch->coef, GEGL_AUTO_ROWSTRIDE);
+}
+
+static CoefCalcScratch *
+gimp_operation_cage_coef_calc_scratch_new (CoefCalcData *data)
+{
+  CoefCalcScratch *scratch  = g_slice_new0 (CoefCalcScratch);
+  gint             n_coefs  = 2 * data->n_vertices;
+  gint             n_grid   = BLOCK_SIZE / PREVIEW_STEP + 3;
+
+  scratch->coef      = g_new (gfloat, BLOCK_SIZE * BLOCK_SIZE * n_coefs);
+  scratch->point     = g_new (gfloat, 4 * (data->n_vertices + 1));
+  scratch->crossings = g_new (gdouble, data->n_vertices);
+
+  if (data->preview)
+    {
+      scratch->grid        = g_new (gfloat, n_grid * n_grid * n_coefs);
+      scratch->grid_inside = g_new (gboolean, n_grid * n_grid);
+    }
+
+  return scratch;
+}
+
+static void
+gimp_operation_cage_coef_calc_scratch_free (CoefCalcScratch *scratch)
+{
+  g_free (scratch->coef);
+  g_free (scratch->point);
+  g_free (scratch->crossings);
+  g_free (scratch->grid);
+  g_free (scratch->grid_inside);
+
+  g_slice_free (CoefCalcScratch, scratch);
+}
+
+static void
+gimp_operation_cage_coef_calc_thread (gint     part,
+                                      gint     n_parts,
+                                      gpointer user_data)
+{
+  CoefCalcData    *data    = user_data;
+  CoefCalcScratch *scratch = gimp_operation_cage_coef_calc_scratch_new (data);
+  gint             i;
+
+  while ((i = g_atomic_int_add (&data->next_block, 1)) < data->n_blocks)
+    {
+      GeglRectangle block;
+
+      block.x      = data->roi.x + (i % data->n_blocks_x) * BLOCK_SIZE;
+      block.y      = data->roi.y + (i / data->n_blocks_x) * BLOCK_SIZE;
+      block.width  = MIN (BLOCK_SIZE, data->roi.x + data->roi.width  - block.x);
+      block.height = MIN (BLOCK_SIZE, data->roi.y + data->roi.height - block.y);
+
+      gimp_operation_cage_coef_calc_block (data, &block, scratch);
+    }
+
+  gimp_operation_cage_coef_calc_scratch_free (scratch);
+}
+
+static gboolean
+gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
+                                       GeglBuffer          *output,
+                                       const GeglRectangle *roi,
+                                       gint                 level)
+{
+  GimpOperationCageCoefCalc *occc   = GIMP_OPERATION_CAGE_COEF_CALC (operation);
+  GimpCageConfig            *config = GIMP_CAGE_CONFIG (occc->config);
+  CoefCalcData               data;
+  gint                       i;
+
+  if (! config)
+    return FALSE;
+
+  data.n_vertices = gimp_cage_config_get_n_points (config);
+
+  if (data.n_vertices < 1)
+    return TRUE;
+
+  data.output     = output;
+  data.format     = babl_format_n (babl_type ("float"), 2 * data.n_vertices);
+  data.roi        = *roi;
+  data.preview    = occc->preview;
+  data.edges      = g_new (CoefEdge, data.n_vertices);
+  data.next_block = 0;
+  data.n_blocks_x = (roi->width  + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  data.n_blocks   = (roi->height + BLOCK_SIZE - 1) / BLOCK_SIZE *
+                    data.n_blocks_x;
+
+  /*  everything that only depends on the edge is computed once  */
+  for (i = 0; i < data.n_vertices; i++)
+    {
+      GimpCagePoint *v1;
+      GimpCagePoint *v2;
+      CoefEdge      *edge = &data.edges[i];
+
+      v1 = &g_array_index (config->cage_points, GimpCagePoint, i);
+      v2 = &g_array_index (config->cage_points, GimpCagePoint,
+                           (i + 1) % data.n_vertices);
+
+      edge->x      = v1->src_point.x;
+      edge->y      = v1->src_point.y;
+      edge->ax     = v2->src_point.x - v1->src_point.x;
+      edge->ay     = v2->src_point.y - v1->src_point.y;
+      edge->q      = edge->ax * edge->ax + edge->ay * edge->ay;
+      edge->length = sqrtf (edge->q);
+
+      edge->edge_factor   = -edge->length / (4.0f * G_PI * edge->q);
+      edge->vertex_factor = 1.0f / (2.0f * G_PI * edge->q);
+    }
+
+  gimp_parallel_distribute (data.n_blocks,
+                            gimp_operation_cage_coef_calc_thread,
+                            &data);
+
+  g_free (data.edges);
+
   return TRUE;
 }
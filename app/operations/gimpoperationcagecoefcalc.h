@@ -28,7 +28,8 @@
 enum
 {
   GIMP_OPERATION_CAGE_COEF_CALC_PROP_0,
-  GIMP_OPERATION_CAGE_COEF_CALC_PROP_CONFIG
+  GIMP_OPERATION_CAGE_COEF_CALC_PROP_CONFIG,
+  GIMP_OPERATION_CAGE_COEF_CALC_PROP_PREVIEW
 };
 
 
@@ -48,6 +49,7 @@ struct _GimpOperationCageCoefCalc
   GeglOperationSource  parent_instance;
 
   GimpCageConfig      *config;
+  gboolean             preview;
 };
 
 struct _GimpOperationCageCoefCalcClass
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -55,8 +57,9 @@ static GeglRectangle
                                                        const gchar         *input_pad,
                                                        const GeglRectangle *roi);
 static GeglRectangle
-                gimp_operation_grow_get_cached_region (GeglOperation       *self,
-                                                       const GeglRectangle *roi);
+        gimp_operation_grow_get_invalidated_by_change (GeglOperation       *self,
+                                                       const gchar         *input_pad,
+                                                       const GeglRectangle *input_region);
 
 static gboolean gimp_operation_grow_process           (GeglOperation       *operation,
                                                        GeglBuffer          *input,
@@ -87,11 +90,11 @@ gimp_operation_grow_class_init (GimpOperationGrowClass *klass)
                                  "description", "GIMP Grow operation",
                                  NULL);
 
-  operation_class->prepare                 = gimp_operation_grow_prepare;
-  operation_class->get_required_for_output = gimp_operation_grow_get_required_for_output;
-  operation_class->get_cached_region       = gimp_operation_grow_get_cached_region;
+  operation_class->prepare                   = gimp_operation_grow_prepare;
+  operation_class->get_required_for_output   = gimp_operation_grow_get_required_for_output;
+  operation_class->get_invalidated_by_change = gimp_operation_grow_get_invalidated_by_change;
 
-  filter_class->process                    = gimp_operation_grow_process;
+  filter_class->process                      = gimp_operation_grow_process;
 
   g_object_class_install_property (object_class, PROP_RADIUS_X,
                                    g_param_spec_int ("radius-x",
@@ -175,14 +178,21 @@ gimp_operation_grow_get_required_for_output (GeglOperation       *self,
                                              const gchar         *input_pad,
                                              const GeglRectangle *roi)
 {
-  return *gegl_operation_source_get_bounding_box (self, "input");
+  GimpOperationGrow *grow = GIMP_OPERATION_GROW (self);
+
+  return *GEGL_RECTANGLE (roi->x      - grow->radius_x,
+                          roi->y      - grow->radius_y,
+                          roi->width  + 2 * grow->radius_x,
+                          roi->height + 2 * grow->radius_y);
 }
 
 static GeglRectangle
-gimp_operation_grow_get_cached_region (GeglOperation       *self,
-                                       const GeglRectangle *roi)
+gimp_operation_grow_get_invalidated_by_change (GeglOperation       *self,
+                                               const gchar         *input_pad,
+                                               const GeglRectangle *input_region)
 {
-  return *gegl_operation_source_get_bounding_box (self, "input");
+  return gimp_operation_grow_get_required_for_output (self, input_pad,
+                                                      input_region);
 }
 
 static void
@@ -208,21 +218,6 @@ compute_border (gint16  *circ,
     }
 }
 
-static inline void
-rotate_pointers (gfloat  **p,
-                 guint32   n)
-{
-  guint32  i;
-  gfloat  *tmp;
-
-  tmp = p[0];
-
-  for (i = 0; i < n - 1; i++)
-    p[i] = p[i + 1];
-
-  p[i] = tmp;
-}
-
 static gboolean
 gimp_operation_grow_process (GeglOperation       *operation,
                              GeglBuffer          *input,
@@ -230,160 +225,100 @@ gimp_operation_grow_process (GeglOperation       *operation,
                              const GeglRectangle *roi,
                              gint                 level)
 {
-  /* Any bugs in this fuction are probably also in thin_region.
-   * Blame all bugs in this function on jaycox@gimp.org
+  /* The ellipse is the union of a vertical run of 2 * circ[dx] + 1
+   * pixels for each column offset dx, and circ[] has at most radius_y
+   * + 1 different values.  So we grow all columns vertically one
+   * pixel at a time, and each time the run reaches the height of some
+   * circ[dx], shift those columns by dx into the output.  All loops
+   * run along rows, and only roi plus the radius is read.
    */
-  GimpOperationGrow *self          = GIMP_OPERATION_GROW (operation);
-  const Babl        *input_format  = babl_format ("Y float");
-  const Babl        *output_format = babl_format ("Y float");
-  gint32             i, j, x, y;
-  gfloat           **buf;  /* caches the region's pixel data */
-  gfloat            *out;  /* holds the new scan line we are computing */
-  gfloat           **max;  /* caches the largest values for each column */
-  gint16            *circ; /* holds the y coords of the filter's mask */
-  gfloat             last_max;
-  gint16             last_index;
-  gfloat            *buffer;
-
-  max = g_new (gfloat *, roi->width + 2 * self->radius_x);
-  buf = g_new (gfloat *, self->radius_y + 1);
-
-  for (i = 0; i < self->radius_y + 1; i++)
-    buf[i] = g_new (gfloat, roi->width);
-
-  buffer = g_new (gfloat,
-                  (roi->width + 2 * self->radius_x) * (self->radius_y + 1));
-
-  for (i = 0; i < roi->width + 2 * self->radius_x; i++)
+  GimpOperationGrow   *self   = GIMP_OPERATION_GROW (operation);
+  const Babl          *format = babl_format ("Y float");
+  const GeglRectangle *bbox;
+  GeglRectangle        src_rect;
+  GeglRectangle        read_rect;
+  gint                 rx     = self->radius_x;
+  gint                 ry     = self->radius_y;
+  gint                 src_width;
+  gfloat              *src;   /* roi plus the radius, 0 outside of input */
+  gfloat              *cols;  /* the vertical runs, for each roi row */
+  gfloat              *out;
+  gint16              *circ;
+  gint                 h, x, y, dx;
+
+  bbox = gegl_operation_source_get_bounding_box (operation, "input");
+
+  src_rect = *GEGL_RECTANGLE (roi->x      - rx,
+                              roi->y      - ry,
+                              roi->width  + 2 * rx,
+                              roi->height + 2 * ry);
+  src_width = src_rect.width;
+
+  src  = g_new0 (gfloat, src_rect.width * src_rect.height);
+  cols = g_new (gfloat, src_rect.width * roi->height);
+  out  = g_new (gfloat, roi->width * roi->height);
+
+  if (gegl_rectangle_intersect (&read_rect, &src_rect, bbox))
     {
-      if (i < self->radius_x)
-        max[i] = buffer;
-      else if (i < roi->width + self->radius_x)
-        max[i] = &buffer[(self->radius_y + 1) * (i - self->radius_x)];
-      else
-        max[i] = &buffer[(self->radius_y + 1) * (roi->width + self->radius_x - 1)];
-
-      for (j = 0; j < self->radius_y + 1; j++)
-        max[i][j] = 0.0;
+      gegl_buffer_get (input, &read_rect, 1.0, format,
+                       src + (read_rect.y - src_rect.y) * src_width +
+                             (read_rect.x - src_rect.x),
+                       src_width * sizeof (gfloat), GEGL_ABYSS_NONE);
     }
 
-  /* offset the max pointer by self->radius_x so the range of the
-   * array is [-self->radius_x] to [roi->width + self->radius_x]
-   */
-  max += self->radius_x;
-
-  out =  g_new (gfloat, roi->width);
+  circ = g_new (gint16, 2 * rx + 1);
+  compute_border (circ, rx, ry);
 
-  circ = g_new (gint16, 2 * self->radius_x + 1);
-  compute_border (circ, self->radius_x, self->radius_y);
-
-  /* offset the circ pointer by self->radius_x so the range of the
-   * array is [-self->radius_x] to [self->radius_x]
+  /* offset the circ pointer by rx so the range of the array is [-rx]
+   * to [rx]
    */
-  circ += self->radius_x;
+  circ += rx;
 
-  memset (buf[0], 0, roi->width * sizeof (gfloat));
+  memcpy (cols, src + ry * src_width,
+          src_width * roi->height * sizeof (gfloat));
 
-  for (i = 0; i < self->radius_y && i < roi->height; i++) /* load top of image */
-    gegl_buffer_get (input,
-                     GEGL_RECTANGLE (roi->x, roi->y + i,
-                                     roi->width, 1),
-                     1.0, input_format, buf[i + 1],
-                     GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  for (x = 0; x < roi->width * roi->height; x++)
+    out[x] = -G_MAXFLOAT;
 
-  for (x = 0; x < roi->width; x++) /* set up max for top of image */
+  for (h = 0; h <= ry; h++)
     {
-      max[x][0] = 0.0;       /* buf[0][x] is always 0 */
-      max[x][1] = buf[1][x]; /* MAX (buf[1][x], max[x][0]) always = buf[1][x]*/
-
-      for (j = 2; j < self->radius_y + 1; j++)
-        max[x][j] = MAX (buf[j][x], max[x][j - 1]);
-    }
-
-  for (y = 0; y < roi->height; y++)
-    {
-      rotate_pointers (buf, self->radius_y + 1);
-
-      if (y < roi->height - (self->radius_y))
-        gegl_buffer_get (input,
-                         GEGL_RECTANGLE (roi->x,  roi->y + y + self->radius_y,
-                                         roi->width, 1),
-                         1.0, input_format, buf[self->radius_y],
-                         GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      else
-        memset (buf[self->radius_y], 0, roi->width * sizeof (gfloat));
-
-      for (x = 0; x < roi->width; x++) /* update max array */
+      if (h > 0)
         {
-          for (i = self->radius_y; i > 0; i--)
-            max[x][i] = MAX (MAX (max[x][i - 1], buf[i - 1][x]), buf[i][x]);
+          for (y = 0; y < roi->height; y++)
+            {
+              gfloat       *c     = cols + y * src_width;
+              const gfloat *above = src + (ry + y - h) * src_width;
+              const gfloat *below = src + (ry + y + h) * src_width;
 
-          max[x][0] = buf[0][x];
+              for (x = 0; x < src_width; x++)
+                c[x] = MAX (c[x], MAX (above[x], below[x]));
+            }
         }
 
-      last_max = max[0][circ[-1]];
-      last_index = 1;
-
-      for (x = 0; x < roi->width; x++) /* render scan line */
+      for (dx = -rx; dx <= rx; dx++)
         {
-          last_index--;
+          if (circ[dx] != h)
+            continue;
 
-          if (last_index >= 0)
+          for (y = 0; y < roi->height; y++)
             {
-              if (last_max >= 1.0)
-                {
-                  out[x] = 1.0;
-                }
-              else
-                {
-                  last_max = 0.0;
-
-                  for (i = self->radius_x; i >= 0; i--)
-                    if (last_max < max[x + i][circ[i]])
-                      {
-                        last_max = max[x + i][circ[i]];
-                        last_index = i;
-                      }
-
-                  out[x] = last_max;
-                }
-            }
-          else
-            {
-              last_index = self->radius_x;
-              last_max = max[x + self->radius_x][circ[self->radius_x]];
+              gfloat       *o = out + y * roi->width;
+              const gfloat *c = cols + y * src_width + rx + dx;
 
-              for (i = self->radius_x - 1; i >= -self->radius_x; i--)
-                if (last_max < max[x + i][circ[i]])
-                  {
-                    last_max = max[x + i][circ[i]];
-                    last_index = i;
-                  }
-
-              out[x] = last_max;
+              for (x = 0; x < roi->width; x++)
+                o[x] = MAX (o[x], c[x]);
             }
         }
-
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y + y,
-                                       roi->width, 1),
-                       0, output_format, out,
-                       GEGL_AUTO_ROWSTRIDE);
     }
 
-  /* undo the offsets to the pointers so we can free the malloced memmory */
-  circ -= self->radius_x;
-  max -= self->radius_x;
+  gegl_buffer_set (output, roi, 0, format, out, GEGL_AUTO_ROWSTRIDE);
 
-  g_free (circ);
-  g_free (buffer);
-  g_free (max);
-
-  for (i = 0; i < self->radius_y + 1; i++)
-    g_free (buf[i]);
+  circ -= rx;
 
-  g_free (buf);
+  g_free (circ);
   g_free (out);
+  g_free (cols);
+  g_free (src);
 
   return TRUE;
 }
@@ -176,9 +176,18 @@ gimp_operation_shapeburst_process (GeglOperation       *operation,
   const Babl *input_format   = babl_format ("Y float");
   const Babl *output_format  = babl_format ("Y float");
   gfloat      max_dist = 0.0;
+  gfloat     *srcbuf;
   gfloat     *distbuf;
   gint        x, y;
 
+  /*  the diagonals below can reach anywhere below and right of the
+   *  current pixel, so fetch all of the input at once
+   */
+  srcbuf = g_new (gfloat, roi->width * roi->height);
+
+  gegl_buffer_get (input, roi, 1.0, input_format, srcbuf,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
   distbuf = g_new0 (gfloat, (roi->width + 1) * 2);
 
   for (y = 0; y < roi->height; y++)
@@ -244,12 +253,7 @@ gimp_operation_shapeburst_process (GeglOperation       *operation,
 
               while (y1 >= y)
                 {
-                  /* FIXME: this should be much faster, it converts to
-                   * 32 bit rgba intermediately, bah...
-                   */
-                  gegl_buffer_sample (input, x1 + roi->x, y1 + roi->y,
-                                      NULL, &src, input_format,
-                                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+                  src = srcbuf[y1 * roi->width + x1];
 
                   if (src < EPSILON)
                     {
@@ -298,6 +302,7 @@ gimp_operation_shapeburst_process (GeglOperation       *operation,
     }
 
   g_free (distbuf);
+  g_free (srcbuf);
 
   if (GIMP_OPERATION_SHAPEBURST (operation)->normalize && max_dist > 0.0)
     {
@@ -0,0 +1,663 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpheal-laplace.c
+ * Copyright (C) Jean-Yves Couleaud <cjyves@free.fr>
+ * Copyright (C) 2013 Loren Merritt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "gimpheal-laplace.h"
+
+
+/* Both solvers solve DeltaI=0 (Laplace) on the pixels inside the mask,
+ * with Dirichlet conditions given by the pixels outside of it, and
+ * Neumann conditions at the edges of the canvas.
+ *
+ * The system of equations is the same for both: each unknown pixel
+ * has a diagonal coefficient equal to its number of neighbors on the
+ * canvas, and -1 for each of these neighbors.
+ */
+
+/* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
+#define EPSILON       (0.1/255)
+
+/* Limits of the SOR solver */
+#define MAX_ITER      500
+
+/* Limits of the multigrid solver */
+#define MAX_CYCLES    30
+#define PRE_SWEEPS    2
+#define POST_SWEEPS   2
+#define COARSE_CYCLES 2
+#define COARSE_SWEEPS 50
+#define COARSE_SIZE   3
+
+
+typedef struct
+{
+  gint    width;
+  gint    height;
+  gint    nmask;
+  gint   *Aidx;    /* the pixel and its 4 neighbors, for each unknown */
+  gfloat *Adiag;   /* the number of neighbors, for each unknown */
+  gfloat *Ainv;    /* the inverse of Adiag */
+  gint   *Acoarse; /* the 4 closest coarse pixels, for each unknown */
+  gfloat *x;       /* the pixels, followed by a zero pixel */
+  gfloat *b;       /* the right hand side, laid out like x */
+  gfloat *r;       /* the residual, for each unknown */
+} HealLevel;
+
+
+/* Construct the system of equations.
+ *
+ * All off-diagonal elements of A are either -1 or 0. We could store it as a
+ * general-purpose sparse matrix, but that adds some unnecessary overhead to
+ * the inner loop. Instead, assume exactly 4 off-diagonal elements in each
+ * row, all of which have value -1. Any row that in fact wants less than 4
+ * coefs can put them in a dummy column to be multiplied by an empty pixel.
+ *
+ * Arrange Aidx in checkerboard order, so that a single linear pass over that
+ * array results updating all of the red cells and then all of the black cells.
+ *
+ * Returns the number of unknowns.
+ */
+static gint
+gimp_heal_laplace_matrix (const guchar *mask,
+                          gint          width,
+                          gint          height,
+                          gint          depth,
+                          gint         *Aidx,
+                          gfloat       *Adiag)
+{
+  gint i, j, parity;
+  gint zero  = depth * width * height;
+  gint nmask = 0;
+
+  for (parity = 0; parity < 2; parity++)
+    for (i = 0; i < height; i++)
+      for (j = (i&1)^parity; j < width; j+=2)
+        if (mask[j + i * width])
+          {
+#define A_NEIGHBOR(o,di,dj) \
+            if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
+              Aidx[o + nmask * 5] = zero; \
+            else                                               \
+              Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
+
+            /* Omit Dirichlet conditions for any neighbors off the
+             * edge of the canvas.
+             */
+            Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
+            A_NEIGHBOR (0,  0,  0);
+            A_NEIGHBOR (1,  0,  1);
+            A_NEIGHBOR (2,  1,  0);
+            A_NEIGHBOR (3,  0, -1);
+            A_NEIGHBOR (4, -1,  0);
+            nmask++;
+
+#undef A_NEIGHBOR
+          }
+
+  return nmask;
+}
+
+
+/*  successive over-relaxation  */
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+static float
+gimp_heal_laplace_iteration_sse (gfloat *pixels,
+                                 gfloat *Adiag,
+                                 gint   *Aidx,
+                                 gfloat  w,
+                                 gint    nmask)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint i;
+  v4sf wv  = { w, w, w, w };
+  v4sf err = { 0, 0, 0, 0 };
+  union { v4sf v; float f[4]; } erru;
+
+#define Xv(j) (*(v4sf*)&pixels[Aidx[i * 5 + j]])
+
+  for (i = 0; i < nmask; i++)
+    {
+      v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+      v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
+
+      Xv(0) -= diff;
+      err += diff * diff;
+    }
+
+#undef Xv
+
+  erru.v = err;
+
+  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
+}
+#endif
+
+/* Perform one iteration of Gauss-Seidel, and return the sum squared residual.
+ */
+static float
+gimp_heal_laplace_iteration (gfloat *pixels,
+                             gfloat *Adiag,
+                             gint   *Aidx,
+                             gfloat  w,
+                             gint    nmask,
+                             gint    depth)
+{
+  gint   i, k;
+  gfloat err = 0;
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+  if (depth == 4)
+    return gimp_heal_laplace_iteration_sse (pixels, Adiag, Aidx, w, nmask);
+#endif
+
+  for (i = 0; i < nmask; i++)
+    {
+      gint   j0 = Aidx[i * 5 + 0];
+      gint   j1 = Aidx[i * 5 + 1];
+      gint   j2 = Aidx[i * 5 + 2];
+      gint   j3 = Aidx[i * 5 + 3];
+      gint   j4 = Aidx[i * 5 + 4];
+      gfloat a  = Adiag[i];
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat diff = (a * pixels[j0 + k] -
+                         w * (pixels[j1 + k] +
+                              pixels[j2 + k] +
+                              pixels[j3 + k] +
+                              pixels[j4 + k]));
+
+          pixels[j0 + k] -= diff;
+          err += diff * diff;
+        }
+    }
+
+  return err;
+}
+
+/* Solve the laplace equation for pixels with Gauss-Seidel and successive
+ * over-relaxation, and store the result in-place.  The pixels need to be
+ * 16-byte aligned.
+ */
+void
+gimp_heal_laplace_sor (gfloat       *pixels,
+                       gint          width,
+                       gint          height,
+                       gint          depth,
+                       const guchar *mask)
+{
+  gint    i, iter, nmask;
+  gfloat *Adiag;
+  gint   *Aidx;
+  gfloat  w;
+
+  g_return_if_fail (pixels != NULL);
+  g_return_if_fail (mask != NULL);
+
+  Adiag = g_new (gfloat, width * height);
+  Aidx  = g_new (gint, 5 * width * height);
+
+  memset (pixels + depth * width * height, 0, depth * sizeof (gfloat));
+
+  nmask = gimp_heal_laplace_matrix (mask, width, height, depth,
+                                    Aidx, Adiag);
+
+  /* Empirically optimal over-relaxation factor. (Benchmarked on
+   * round brushes, at least. I don't know whether aspect ratio
+   * affects it.)
+   */
+  w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
+  w *= 0.25;
+  for (i = 0; i < nmask; i++)
+    Adiag[i] *= w;
+
+  /* Gauss-Seidel with successive over-relaxation */
+  for (iter = 0; iter < MAX_ITER; iter++)
+    {
+      gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
+                                                w, nmask, depth);
+      if (err < EPSILON * EPSILON * w * w)
+        break;
+    }
+
+  g_free (Adiag);
+  g_free (Aidx);
+}
+
+
+/*  multigrid  */
+
+/* The coarser levels solve the residual equation A e = r of the level
+ * above them.  A coarse cell is unknown only if all of the fine cells
+ * it covers are, so that the coarse problem keeps Dirichlet conditions
+ * (the known pixels' error is zero) even when the ring of known pixels
+ * is thinner than a coarse cell.
+ */
+static void
+gimp_heal_level_init (HealLevel    *level,
+                      const guchar *mask,
+                      gint          width,
+                      gint          height,
+                      gint          depth,
+                      gfloat       *pixels)
+{
+  gint i;
+
+  level->width  = width;
+  level->height = height;
+
+  level->Aidx  = g_new (gint, 5 * width * height);
+  level->Adiag = g_new (gfloat, width * height);
+
+  level->nmask = gimp_heal_laplace_matrix (mask, width, height, depth,
+                                           level->Aidx, level->Adiag);
+
+  level->Ainv = g_new (gfloat, level->nmask);
+
+  for (i = 0; i < level->nmask; i++)
+    level->Ainv[i] = 1.0f / level->Adiag[i];
+
+  level->Acoarse = NULL;
+
+  if (pixels)
+    level->x = pixels;
+  else
+    level->x = g_new0 (gfloat, (width * height + 1) * depth);
+
+  level->b = g_new0 (gfloat, (width * height + 1) * depth);
+  level->r = g_new (gfloat, level->nmask * depth);
+
+  memset (level->x + depth * width * height, 0, depth * sizeof (gfloat));
+}
+
+/* Find the coarse pixels each unknown of the fine level interpolates
+ * its correction from: the coarse pixel covering it, and the three
+ * closest to it in the direction of the unknown's position within that
+ * pixel.  They are clamped to the coarse grid, which keeps the edges
+ * of the canvas free of Dirichlet conditions.
+ */
+static void
+gimp_heal_level_link (HealLevel       *fine,
+                      const HealLevel *coarse,
+                      gint             depth)
+{
+  gint cw = coarse->width;
+  gint ch = coarse->height;
+  gint i;
+
+  fine->Acoarse = g_new (gint, 4 * fine->nmask);
+
+  for (i = 0; i < fine->nmask; i++)
+    {
+      gint p  = fine->Aidx[i * 5] / depth;
+      gint px = p % fine->width;
+      gint py = p / fine->width;
+      gint cx = px / 2;
+      gint cy = py / 2;
+      gint nx = CLAMP (cx + ((px & 1) ? 1 : -1), 0, cw - 1);
+      gint ny = CLAMP (cy + ((py & 1) ? 1 : -1), 0, ch - 1);
+
+      fine->Acoarse[i * 4 + 0] = (cy * cw + cx) * depth;
+      fine->Acoarse[i * 4 + 1] = (cy * cw + nx) * depth;
+      fine->Acoarse[i * 4 + 2] = (ny * cw + cx) * depth;
+      fine->Acoarse[i * 4 + 3] = (ny * cw + nx) * depth;
+    }
+}
+
+static void
+gimp_heal_level_free (HealLevel *level,
+                      gboolean   free_pixels)
+{
+  g_free (level->Aidx);
+  g_free (level->Adiag);
+  g_free (level->Ainv);
+  g_free (level->Acoarse);
+  g_free (level->b);
+  g_free (level->r);
+
+  if (free_pixels)
+    g_free (level->x);
+}
+
+/* Perform red/black Gauss-Seidel sweeps on A x = b.  Inlined with a
+ * constant depth, the inner loop gets unrolled and vectorized.
+ */
+static inline void
+gimp_heal_level_smooth_depth (HealLevel  *level,
+                              const gint  depth,
+                              gint        n_sweeps)
+{
+  const gint   *Aidx = level->Aidx;
+  const gfloat *Ainv = level->Ainv;
+  const gfloat *b    = level->b;
+  gfloat       *x    = level->x;
+  gint          sweep, i, k;
+
+  for (sweep = 0; sweep < n_sweeps; sweep++)
+    {
+      for (i = 0; i < level->nmask; i++)
+        {
+          const gint *idx = Aidx + i * 5;
+          gfloat      a   = Ainv[i];
+
+          for (k = 0; k < depth; k++)
+            {
+              x[idx[0] + k] = (b[idx[0] + k] +
+                               x[idx[1] + k] + x[idx[2] + k] +
+                               x[idx[3] + k] + x[idx[4] + k]) * a;
+            }
+        }
+    }
+}
+
+static void
+gimp_heal_level_smooth (HealLevel *level,
+                        gint       depth,
+                        gint       n_sweeps)
+{
+  if (depth == 4)
+    gimp_heal_level_smooth_depth (level, 4, n_sweeps);
+  else
+    gimp_heal_level_smooth_depth (level, depth, n_sweeps);
+}
+
+/* Compute r = b - A x, and return its sum of squares.
+ */
+static inline gdouble
+gimp_heal_level_residual_depth (HealLevel  *level,
+                                const gint  depth)
+{
+  const gint   *Aidx  = level->Aidx;
+  const gfloat *Adiag = level->Adiag;
+  const gfloat *b     = level->b;
+  const gfloat *x     = level->x;
+  gfloat       *r     = level->r;
+  gdouble       err   = 0.0;
+  gint          i, k;
+
+  for (i = 0; i < level->nmask; i++)
+    {
+      const gint *idx = Aidx + i * 5;
+      gfloat      sum = 0.0f;
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat res = (b[idx[0] + k] +
+                        x[idx[1] + k] + x[idx[2] + k] +
+                        x[idx[3] + k] + x[idx[4] + k] -
+                        Adiag[i] * x[idx[0] + k]);
+
+          r[i * depth + k] = res;
+          sum += res * res;
+        }
+
+      err += sum;
+    }
+
+  return err;
+}
+
+static gdouble
+gimp_heal_level_residual (HealLevel *level,
+                          gint       depth)
+{
+  if (depth == 4)
+    return gimp_heal_level_residual_depth (level, 4);
+  else
+    return gimp_heal_level_residual_depth (level, depth);
+}
+
+/* Distribute the residual of each fine unknown to its coarse pixels,
+ * with the weights gimp_heal_level_prolongate() interpolates them back
+ * with.  Whatever lands on known coarse pixels is never read.
+ */
+static inline void
+gimp_heal_level_restrict_depth (const HealLevel *fine,
+                                HealLevel       *coarse,
+                                const gint       depth)
+{
+  const gint   *Acoarse = fine->Acoarse;
+  const gfloat *r       = fine->r;
+  gfloat       *b       = coarse->b;
+  gint          size    = coarse->width * coarse->height * depth;
+  gint          i, k;
+
+  memset (coarse->x, 0, size * sizeof (gfloat));
+  memset (coarse->b, 0, size * sizeof (gfloat));
+
+  for (i = 0; i < fine->nmask; i++)
+    {
+      const gint *c = Acoarse + i * 4;
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat res = r[i * depth + k] * (1.0f / 16.0f);
+
+          b[c[0] + k] += 9.0f * res;
+          b[c[1] + k] += 3.0f * res;
+          b[c[2] + k] += 3.0f * res;
+          b[c[3] + k] += res;
+        }
+    }
+}
+
+static void
+gimp_heal_level_restrict (const HealLevel *fine,
+                          HealLevel       *coarse,
+                          gint             depth)
+{
+  if (depth == 4)
+    gimp_heal_level_restrict_depth (fine, coarse, 4);
+  else
+    gimp_heal_level_restrict_depth (fine, coarse, depth);
+}
+
+/* Add the bilinear interpolation of the coarse error to the unknowns
+ * of the fine level.  The known coarse pixels hold zero.
+ */
+static inline void
+gimp_heal_level_prolongate_depth (const HealLevel *coarse,
+                                  HealLevel       *fine,
+                                  const gint       depth)
+{
+  const gint   *Aidx    = fine->Aidx;
+  const gint   *Acoarse = fine->Acoarse;
+  const gfloat *e       = coarse->x;
+  gfloat       *x       = fine->x;
+  gint          i, k;
+
+  for (i = 0; i < fine->nmask; i++)
+    {
+      const gint *c = Acoarse + i * 4;
+      gint        p = Aidx[i * 5];
+
+      for (k = 0; k < depth; k++)
+        {
+          x[p + k] += (9.0f * e[c[0] + k] +
+                       3.0f * (e[c[1] + k] + e[c[2] + k]) +
+                       e[c[3] + k]) * (1.0f / 16.0f);
+        }
+    }
+}
+
+static void
+gimp_heal_level_prolongate (const HealLevel *coarse,
+                            HealLevel       *fine,
+                            gint             depth)
+{
+  if (depth == 4)
+    gimp_heal_level_prolongate_depth (coarse, fine, 4);
+  else
+    gimp_heal_level_prolongate_depth (coarse, fine, depth);
+}
+
+/* Perform one multigrid W-cycle on A x = b: the coarse correction of
+ * each level is itself computed with two cycles, which keeps the
+ * convergence rate independent of the number of levels even though the
+ * coarse grids only approximate the shape of the mask.
+ */
+static void
+gimp_heal_cycle (HealLevel *levels,
+                 gint       n_levels,
+                 gint       depth)
+{
+  HealLevel *level = levels;
+  gint       i;
+
+  if (n_levels == 1)
+    {
+      gimp_heal_level_smooth (level, depth, COARSE_SWEEPS);
+      return;
+    }
+
+  gimp_heal_level_smooth (level, depth, PRE_SWEEPS);
+
+  gimp_heal_level_residual (level, depth);
+  gimp_heal_level_restrict (level, level + 1, depth);
+
+  for (i = 0; i < COARSE_CYCLES; i++)
+    gimp_heal_cycle (levels + 1, n_levels - 1, depth);
+
+  gimp_heal_level_prolongate (level + 1, level, depth);
+
+  gimp_heal_level_smooth (level, depth, POST_SWEEPS);
+}
+
+/* Solve the laplace equation for pixels with multigrid, and store the
+ * result in-place.  Unlike SOR, whose number of iterations grows with
+ * the size of the mask, this converges in a small number of cycles
+ * whatever the brush size.
+ */
+void
+gimp_heal_laplace_multigrid (gfloat       *pixels,
+                             gint          width,
+                             gint          height,
+                             gint          depth,
+                             const guchar *mask)
+{
+  GArray *levels;
+  guchar *level_mask;
+  gint    n_levels;
+  gint    cycle;
+  gint    i;
+
+  g_return_if_fail (pixels != NULL);
+  g_return_if_fail (mask != NULL);
+
+  levels     = g_array_new (FALSE, TRUE, sizeof (HealLevel));
+  level_mask = (guchar *) mask;
+
+  while (TRUE)
+    {
+      HealLevel level;
+      guchar   *coarse_mask;
+      gint      coarse_width;
+      gint      coarse_height;
+      gint      x, y;
+
+      gimp_heal_level_init (&level, level_mask, width, height, depth,
+                            levels->len ? NULL : pixels);
+
+      g_array_append_val (levels, level);
+
+      if (MAX (width, height) <= COARSE_SIZE || level.nmask == 0)
+        break;
+
+      coarse_width  = (width  + 1) / 2;
+      coarse_height = (height + 1) / 2;
+
+      coarse_mask = g_new (guchar, coarse_width * coarse_height);
+      memset (coarse_mask, 1, coarse_width * coarse_height);
+
+      for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+          if (! level_mask[y * width + x])
+            coarse_mask[(y / 2) * coarse_width + x / 2] = 0;
+
+      if (level_mask != mask)
+        g_free (level_mask);
+
+      level_mask = coarse_mask;
+      width      = coarse_width;
+      height     = coarse_height;
+    }
+
+  if (level_mask != mask)
+    g_free (level_mask);
+
+  n_levels = levels->len;
+
+  for (i = 0; i + 1 < n_levels; i++)
+    gimp_heal_level_link (&g_array_index (levels, HealLevel, i),
+                          &g_array_index (levels, HealLevel, i + 1),
+                          depth);
+
+  for (cycle = 0; cycle < MAX_CYCLES; cycle++)
+    {
+      HealLevel *finest = &g_array_index (levels, HealLevel, 0);
+
+      if (gimp_heal_level_residual (finest, depth) < EPSILON * EPSILON)
+        break;
+
+      gimp_heal_cycle (finest, n_levels, depth);
+    }
+
+  for (i = 0; i < n_levels; i++)
+    gimp_heal_level_free (&g_array_index (levels, HealLevel, i), i > 0);
+
+  g_array_free (levels, TRUE);
+}
+
+
+/*  utilities  */
+
+/* Return the sum squared residual of the laplace equation for pixels,
+ * the quantity both solvers bring below their tolerance.
+ */
+gdouble
+gimp_heal_laplace_residual (gfloat       *pixels,
+                            gint          width,
+                            gint          height,
+                            gint          depth,
+                            const guchar *mask)
+{
+  HealLevel level;
+  gdouble   err;
+
+  g_return_val_if_fail (pixels != NULL, 0.0);
+  g_return_val_if_fail (mask != NULL, 0.0);
+
+  gimp_heal_level_init (&level, mask, width, height, depth, pixels);
+
+  err = gimp_heal_level_residual (&level, depth);
+
+  gimp_heal_level_free (&level, FALSE);
+
+  return err;
+}
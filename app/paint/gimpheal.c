@@ -22,7 +22,6 @@
 #include "config.h"
 
 #include <stdint.h>
-#include <string.h>
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
@@ -41,6 +40,7 @@
 #include "core/gimptempbuf.h"
 
 #include "gimpheal.h"
+#include "gimpheal-laplace.h"
 #include "gimpsourceoptions.h"
 
 #include "gimp-intl.h"
@@ -54,9 +54,9 @@
  * but subtract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * mask. Small masks are solved with a red/black checker Gauss-Seidel
+ * with over-relaxation, large ones with multigrid, whose number of
+ * cycles does not grow with the brush size (see gimpheal-laplace.c).
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -64,6 +64,12 @@
  * Jean-Yves Couleaud cjyves@free.fr
  */
 
+/* Below this many pixels, SOR converges in fewer iterations than it
+ * takes multigrid to pay for its setup (see benchmark-heal-laplace).
+ */
+#define MULTIGRID_MIN_SIZE (192 * 192)
+
+
 static gboolean     gimp_heal_start              (GimpPaintCore    *paint_core,
                                                   GimpDrawable     *drawable,
                                                   GimpPaintOptions *paint_options,
@@ -236,160 +242,6 @@ gimp_heal_add (GeglBuffer          *first_buffer,
     }
 }
 
-#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
-static float
-gimp_heal_laplace_iteration_sse (gfloat *pixels,
-                                 gfloat *Adiag,
-                                 gint   *Aidx,
-                                 gfloat  w,
-                                 gint    nmask)
-{
-  typedef float v4sf __attribute__((vector_size(16)));
-  gint i;
-  v4sf wv  = { w, w, w, w };
-  v4sf err = { 0, 0, 0, 0 };
-  union { v4sf v; float f[4]; } erru;
-
-#define Xv(j) (*(v4sf*)&pixels[Aidx[i * 5 + j]])
-
-  for (i = 0; i < nmask; i++)
-    {
-      v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
-      v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
-
-      Xv(0) -= diff;
-      err += diff * diff;
-    }
-
-  erru.v = err;
-
-  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
-}
-#endif
-
-/* Perform one iteration of Gauss-Seidel, and return the sum squared residual.
- */
-static float
-gimp_heal_laplace_iteration (gfloat *pixels,
-                             gfloat *Adiag,
-                             gint   *Aidx,
-                             gfloat  w,
-                             gint    nmask,
-                             gint    depth)
-{
-  gint   i, k;
-  gfloat err = 0;
-
-#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
-  if (depth == 4)
-    return gimp_heal_laplace_iteration_sse (pixels, Adiag, Aidx, w, nmask);
-#endif
-
-  for (i = 0; i < nmask; i++)
-    {
-      gint   j0 = Aidx[i * 5 + 0];
-      gint   j1 = Aidx[i * 5 + 1];
-      gint   j2 = Aidx[i * 5 + 2];
-      gint   j3 = Aidx[i * 5 + 3];
-      gint   j4 = Aidx[i * 5 + 4];
-      gfloat a  = Adiag[i];
-
-      for (k = 0; k < depth; k++)
-        {
-          gfloat diff = (a * pixels[j0 + k] -
-                         w * (pixels[j1 + k] +
-                              pixels[j2 + k] +
-                              pixels[j3 + k] +
-                              pixels[j4 + k]));
-
-          pixels[j0 + k] -= diff;
-          err += diff * diff;
-        }
-    }
-
-  return err;
-}
-
-/* Solve the laplace equation for pixels and store the result in-place.
- */
-static void
-gimp_heal_laplace_loop (gfloat *pixels,
-                        gint    height,
-                        gint    depth,
-                        gint    width,
-                        guchar *mask)
-{
-  /* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
-#define EPSILON  (0.1/255)
-#define MAX_ITER 500
-
-  gint    i, j, iter, parity, nmask, zero;
-  gfloat *Adiag;
-  gint   *Aidx;
-  gfloat  w;
-
-  Adiag = g_new (gfloat, width * height);
-  Aidx  = g_new (gint, 5 * width * height);
-
-  /* All off-diagonal elements of A are either -1 or 0. We could store it as a
-   * general-purpose sparse matrix, but that adds some unnecessary overhead to
-   * the inner loop. Instead, assume exactly 4 off-diagonal elements in each
-   * row, all of which have value -1. Any row that in fact wants less than 4
-   * coefs can put them in a dummy column to be multiplied by an empty pixel.
-   */
-  zero = depth * width * height;
-  memset (pixels + zero, 0, depth * sizeof (gfloat));
-
-  /* Construct the system of equations.
-   * Arrange Aidx in checkerboard order, so that a single linear pass over that
-   * array results updating all of the red cells and then all of the black cells.
-   */
-  nmask = 0;
-  for (parity = 0; parity < 2; parity++)
-    for (i = 0; i < height; i++)
-      for (j = (i&1)^parity; j < width; j+=2)
-        if (mask[j + i * width])
-          {
-#define A_NEIGHBOR(o,di,dj) \
-            if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
-              Aidx[o + nmask * 5] = zero; \
-            else                                               \
-              Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
-
-            /* Omit Dirichlet conditions for any neighbors off the
-             * edge of the canvas.
-             */
-            Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
-            A_NEIGHBOR (0,  0,  0);
-            A_NEIGHBOR (1,  0,  1);
-            A_NEIGHBOR (2,  1,  0);
-            A_NEIGHBOR (3,  0, -1);
-            A_NEIGHBOR (4, -1,  0);
-            nmask++;
-          }
-
-  /* Empirically optimal over-relaxation factor. (Benchmarked on
-   * round brushes, at least. I don't know whether aspect ratio
-   * affects it.)
-   */
-  w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
-  w *= 0.25;
-  for (i = 0; i < nmask; i++)
-    Adiag[i] *= w;
-
-  /* Gauss-Seidel with successive over-relaxation */
-  for (iter = 0; iter < MAX_ITER; iter++)
-    {
-      gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
-                                                w, nmask, depth);
-      if (err < EPSILON * EPSILON * w * w)
-        break;
-    }
-
-  g_free (Adiag);
-  g_free (Aidx);
-}
-
 /* Original Algorithm Design:
  *
  * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
@@ -445,7 +297,10 @@ gimp_heal (GeglBuffer          *src_buffer,
   gegl_buffer_get (mask_buffer, mask_rect, 1.0, babl_format ("Y u8"),
                    mask, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  gimp_heal_laplace_loop (diff, height, src_components, width, mask);
+  if (width * height < MULTIGRID_MIN_SIZE)
+    gimp_heal_laplace_sor (diff, width, height, src_components, mask);
+  else
+    gimp_heal_laplace_multigrid (diff, width, height, src_components, mask);
 
   g_free (mask);
 
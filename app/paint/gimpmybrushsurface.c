@@ -32,6 +32,31 @@
 #include "gimpmybrushsurface.h"
 
 
+/* the size of the blocks queued dabs are rendered in */
+#define BLOCK_SIZE 64
+
+typedef struct
+{
+  GeglRectangle roi;
+  float x;
+  float y;
+  float radius;
+  float color_r;
+  float color_g;
+  float color_b;
+  float color_a;
+  float hardness;
+  float aspect_ratio;
+  float one_over_radius2;
+  float cs;
+  float sn;
+  float segment1_slope;
+  float segment2_slope;
+  float r_aa_start;
+  float normal_mode;
+  float colorize;
+} GimpMybrushDab;
+
 struct _GimpMybrushSurface
 {
   MyPaintSurface surface;
@@ -41,6 +66,17 @@ struct _GimpMybrushSurface
   gint        paint_mask_y;
   GeglRectangle dirty;
   GimpComponentMask component_mask;
+
+  /* dabs are queued between begin_atomic() and end_atomic(), and
+   * rendered block by block, so each block is converted only once
+   */
+  gint        atomic;
+  GArray     *dabs;
+  float      *block;        /* R'G'B'A float pixels of one block */
+  float      *block_mask;   /* the paint mask of the same block  */
+  float      *row_alpha;    /* a dab's alpha along one row       */
+  float      *sample;       /* pixels read by get_color()        */
+  gint        sample_size;
 };
 
 /* --- Taken from mypaint-tiled-surface.c --- */
@@ -228,6 +264,8 @@ calculate_dab_roi (float x,
   return *GEGL_RECTANGLE (x0, y0, x1 - x0, y1 - y0);
 }
 
+static void gimp_mypaint_surface_flush (GimpMybrushSurface *surface);
+
 static void
 gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
                                 float           x,
@@ -241,6 +279,9 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
   GeglRectangle dabRect;
 
+  /* the color has to include the dabs drawn so far */
+  gimp_mypaint_surface_flush (surface);
+
   if (radius < 1.0f)
     radius = 1.0f;
 
@@ -254,62 +295,64 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
   if (dabRect.width > 0 || dabRect.height > 0)
   {
     const float one_over_radius2 = 1.0f / (radius * radius);
+    const gint n_pixels = dabRect.width * dabRect.height;
     float sum_weight = 0.0f;
     float sum_r = 0.0f;
     float sum_g = 0.0f;
     float sum_b = 0.0f;
     float sum_a = 0.0f;
+    float *pixel;
+    float *mask = NULL;
+    int iy, ix;
+
+    if (n_pixels > surface->sample_size)
+      {
+        surface->sample_size = n_pixels;
+        surface->sample = g_renew (float, surface->sample, 5 * n_pixels);
+      }
+
+    pixel = surface->sample;
 
      /* Read in clamp mode to avoid transparency bleeding in at the edges */
-    GeglBufferIterator *iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
-                                                         babl_format ("R'aG'aB'aA float"),
-                                                         GEGL_BUFFER_READ,
-                                                         GEGL_ABYSS_CLAMP);
+    gegl_buffer_get (surface->buffer, &dabRect, 1.0,
+                     babl_format ("R'aG'aB'aA float"),
+                     pixel, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+
     if (surface->paint_mask)
       {
         GeglRectangle mask_roi = dabRect;
         mask_roi.x -= surface->paint_mask_x;
         mask_roi.y -= surface->paint_mask_y;
-        gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
-                                  babl_format ("Y float"),
-                                  GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+        mask = surface->sample + 4 * n_pixels;
+        gegl_buffer_get (surface->paint_mask, &mask_roi, 1.0,
+                         babl_format ("Y float"),
+                         mask, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
       }
 
-    while (gegl_buffer_iterator_next (iter))
+    for (iy = dabRect.y; iy < dabRect.y + dabRect.height; iy++)
       {
-        float *pixel = (float *)iter->data[0];
-        float *mask;
-        int iy, ix;
-
-        if (surface->paint_mask)
-          mask = iter->data[1];
-        else
-          mask = NULL;
-
-        for (iy = iter->roi[0].y; iy < iter->roi[0].y + iter->roi[0].height; iy++)
+        float yy = (iy + 0.5f - y);
+        for (ix = dabRect.x; ix < dabRect.x + dabRect.width; ix++)
           {
-            float yy = (iy + 0.5f - y);
-            for (ix = iter->roi[0].x; ix < iter->roi[0].x +  iter->roi[0].width; ix++)
-              {
-                /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
-                float xx = (ix + 0.5f - x);
-                float rr = (yy * yy + xx * xx) * one_over_radius2;
-                float pixel_weight = 0.0f;
-                if (rr <= 1.0f)
-                  pixel_weight = 1.0f - rr;
-                if (mask)
-                  pixel_weight *= *mask;
-
-                sum_r += pixel_weight * pixel[RED];
-                sum_g += pixel_weight * pixel[GREEN];
-                sum_b += pixel_weight * pixel[BLUE];
-                sum_a += pixel_weight * pixel[ALPHA];
-                sum_weight += pixel_weight;
-
-                pixel += 4;
-                if (mask)
-                  mask += 1;
-              }
+            /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
+            float xx = (ix + 0.5f - x);
+            float rr = (yy * yy + xx * xx) * one_over_radius2;
+            float pixel_weight = 0.0f;
+            if (rr <= 1.0f)
+              pixel_weight = 1.0f - rr;
+            if (mask)
+              pixel_weight *= *mask;
+
+            sum_r += pixel_weight * pixel[RED];
+            sum_g += pixel_weight * pixel[GREEN];
+            sum_b += pixel_weight * pixel[BLUE];
+            sum_a += pixel_weight * pixel[ALPHA];
+            sum_weight += pixel_weight;
+
+            pixel += 4;
+            if (mask)
+              mask += 1;
           }
       }
 
@@ -334,6 +377,265 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
 
 }
 
+/* Renders one dab into the part @rect of the block at @block_rect */
+static void
+gimp_mypaint_surface_render_dab (GimpMybrushSurface   *surface,
+                                 const GimpMybrushDab *dab,
+                                 const GeglRectangle  *block_rect,
+                                 const GeglRectangle  *rect)
+{
+  GimpComponentMask  component_mask = surface->component_mask;
+  float             *row_alpha      = surface->row_alpha;
+  int iy, ix;
+
+  for (iy = rect->y; iy < rect->y + rect->height; iy++)
+    {
+      gint   offset = (iy - block_rect->y) * block_rect->width +
+                      (rect->x - block_rect->x);
+      float *pixel  = surface->block + 4 * offset;
+      float *mask   = NULL;
+      gint   i;
+
+      if (surface->paint_mask)
+        mask = surface->block_mask + offset;
+
+      /* the dab's shape along the row, computed in a loop of its own
+       * which the compiler can vectorize
+       */
+      if (dab->radius < 3.0f)
+        {
+          for (i = 0; i < rect->width; i++)
+            row_alpha[i] = calculate_rr_antialiased (rect->x + i, iy,
+                                                     dab->x, dab->y,
+                                                     dab->aspect_ratio,
+                                                     dab->sn, dab->cs,
+                                                     dab->one_over_radius2,
+                                                     dab->r_aa_start);
+        }
+      else
+        {
+          for (i = 0; i < rect->width; i++)
+            row_alpha[i] = calculate_rr (rect->x + i, iy,
+                                         dab->x, dab->y,
+                                         dab->aspect_ratio,
+                                         dab->sn, dab->cs,
+                                         dab->one_over_radius2);
+        }
+
+      for (i = 0; i < rect->width; i++)
+        row_alpha[i] = calculate_alpha_for_rr (row_alpha[i], dab->hardness,
+                                               dab->segment1_slope,
+                                               dab->segment2_slope);
+
+      for (ix = 0; ix < rect->width; ix++)
+        {
+          float base_alpha, alpha, dst_alpha, r, g, b, a;
+
+          base_alpha = row_alpha[ix];
+
+          if (base_alpha == 0.0f)
+            {
+              pixel += 4;
+              if (mask)
+                mask += 1;
+              continue;
+            }
+
+          alpha = base_alpha * dab->normal_mode;
+          if (mask)
+            alpha *= *mask;
+          dst_alpha = pixel[ALPHA];
+          /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
+           * which converts to: */
+          a = alpha * (dab->color_a - dst_alpha) + dst_alpha;
+          r = pixel[RED];
+          g = pixel[GREEN];
+          b = pixel[BLUE];
+
+          if (a > 0.0f)
+            {
+              /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
+               * Originaly this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
+               * instead we only calculate the cheaper term. */
+              float src_term = (alpha * dab->color_a) / a;
+              float dst_term = 1.0f - src_term;
+              r = dab->color_r * src_term + r * dst_term;
+              g = dab->color_g * src_term + g * dst_term;
+              b = dab->color_b * src_term + b * dst_term;
+            }
+
+          if (dab->colorize > 0.0f)
+            {
+              alpha = base_alpha * dab->colorize;
+              a = alpha + dst_alpha - alpha * dst_alpha;
+              if (a > 0.0f)
+                {
+                  GimpHSL pixel_hsl, out_hsl;
+                  GimpRGB pixel_rgb = {dab->color_r, dab->color_g, dab->color_b};
+                  GimpRGB out_rgb   = {r, g, b};
+                  float src_term = alpha / a;
+                  float dst_term = 1.0f - src_term;
+
+                  gimp_rgb_to_hsl (&pixel_rgb, &pixel_hsl);
+                  gimp_rgb_to_hsl (&out_rgb, &out_hsl);
+
+                  out_hsl.h = pixel_hsl.h;
+                  out_hsl.s = pixel_hsl.s;
+                  gimp_hsl_to_rgb (&out_hsl, &out_rgb);
+
+                  r = (float)out_rgb.r * src_term + r * dst_term;
+                  g = (float)out_rgb.g * src_term + g * dst_term;
+                  b = (float)out_rgb.b * src_term + b * dst_term;
+                }
+            }
+
+          if (component_mask != GIMP_COMPONENT_MASK_ALL)
+            {
+              if (component_mask & GIMP_COMPONENT_MASK_RED)
+                pixel[RED]   = r;
+              if (component_mask & GIMP_COMPONENT_MASK_GREEN)
+                pixel[GREEN] = g;
+              if (component_mask & GIMP_COMPONENT_MASK_BLUE)
+                pixel[BLUE]  = b;
+              if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
+                pixel[ALPHA] = a;
+            }
+          else
+            {
+              pixel[RED]   = r;
+              pixel[GREEN] = g;
+              pixel[BLUE]  = b;
+              pixel[ALPHA] = a;
+            }
+
+          pixel += 4;
+          if (mask)
+            mask += 1;
+        }
+    }
+}
+
+/* Renders all queued dabs.  The dabs are binned by the blocks they
+ * touch, and each block is read, painted with its dabs in the order
+ * they were queued, and written back once.
+ */
+static void
+gimp_mypaint_surface_flush (GimpMybrushSurface *surface)
+{
+  GeglRectangle   area = { 0, 0, 0, 0 };
+  GArray        **bins;
+  gint            bx0, by0, bx1, by1;
+  gint            n_bins_x;
+  gint            n_bins;
+  guint           i;
+  gint            j;
+
+  if (surface->dabs->len == 0)
+    return;
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      GimpMybrushDab *dab = &g_array_index (surface->dabs, GimpMybrushDab, i);
+
+      gegl_rectangle_bounding_box (&area, &area, &dab->roi);
+    }
+
+  bx0 = floor ((gdouble) area.x / BLOCK_SIZE);
+  by0 = floor ((gdouble) area.y / BLOCK_SIZE);
+  bx1 = floor ((gdouble) (area.x + area.width  - 1) / BLOCK_SIZE);
+  by1 = floor ((gdouble) (area.y + area.height - 1) / BLOCK_SIZE);
+
+  n_bins_x = bx1 - bx0 + 1;
+  n_bins   = n_bins_x * (by1 - by0 + 1);
+
+  bins = g_new0 (GArray *, n_bins);
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      GimpMybrushDab *dab = &g_array_index (surface->dabs, GimpMybrushDab, i);
+      gint            x0, y0, x1, y1;
+      gint            bx, by;
+
+      x0 = floor ((gdouble) dab->roi.x / BLOCK_SIZE);
+      y0 = floor ((gdouble) dab->roi.y / BLOCK_SIZE);
+      x1 = floor ((gdouble) (dab->roi.x + dab->roi.width  - 1) / BLOCK_SIZE);
+      y1 = floor ((gdouble) (dab->roi.y + dab->roi.height - 1) / BLOCK_SIZE);
+
+      for (by = y0; by <= y1; by++)
+        for (bx = x0; bx <= x1; bx++)
+          {
+            gint bin = (by - by0) * n_bins_x + (bx - bx0);
+
+            if (! bins[bin])
+              bins[bin] = g_array_new (FALSE, FALSE, sizeof (guint));
+
+            g_array_append_val (bins[bin], i);
+          }
+    }
+
+  for (j = 0; j < n_bins; j++)
+    {
+      GeglRectangle block_rect = { 0, 0, 0, 0 };
+      GeglRectangle block;
+
+      if (! bins[j])
+        continue;
+
+      block.x      = (bx0 + j % n_bins_x) * BLOCK_SIZE;
+      block.y      = (by0 + j / n_bins_x) * BLOCK_SIZE;
+      block.width  = BLOCK_SIZE;
+      block.height = BLOCK_SIZE;
+
+      /* only the part of the block covered by its dabs is read */
+      for (i = 0; i < bins[j]->len; i++)
+        {
+          GimpMybrushDab *dab = &g_array_index (surface->dabs, GimpMybrushDab,
+                                                g_array_index (bins[j], guint, i));
+          GeglRectangle   rect;
+
+          gegl_rectangle_intersect (&rect, &dab->roi, &block);
+          gegl_rectangle_bounding_box (&block_rect, &block_rect, &rect);
+        }
+
+      gegl_buffer_get (surface->buffer, &block_rect, 1.0,
+                       babl_format ("R'G'B'A float"),
+                       surface->block, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      if (surface->paint_mask)
+        {
+          GeglRectangle mask_roi = block_rect;
+          mask_roi.x -= surface->paint_mask_x;
+          mask_roi.y -= surface->paint_mask_y;
+
+          gegl_buffer_get (surface->paint_mask, &mask_roi, 1.0,
+                           babl_format ("Y float"),
+                           surface->block_mask, GEGL_AUTO_ROWSTRIDE,
+                           GEGL_ABYSS_NONE);
+        }
+
+      for (i = 0; i < bins[j]->len; i++)
+        {
+          GimpMybrushDab *dab = &g_array_index (surface->dabs, GimpMybrushDab,
+                                                g_array_index (bins[j], guint, i));
+          GeglRectangle   rect;
+
+          gegl_rectangle_intersect (&rect, &dab->roi, &block_rect);
+
+          gimp_mypaint_surface_render_dab (surface, dab, &block_rect, &rect);
+        }
+
+      gegl_buffer_set (surface->buffer, &block_rect, 0,
+                       babl_format ("R'G'B'A float"),
+                       surface->block, GEGL_AUTO_ROWSTRIDE);
+
+      g_array_free (bins[j], TRUE);
+    }
+
+  g_free (bins);
+
+  g_array_set_size (surface->dabs, 0);
+}
+
 static int
 gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
                                float           x,
@@ -351,30 +653,10 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
                                float           colorize)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
-  GeglBufferIterator *iter;
+  GimpMybrushDab      dab;
   GeglRectangle       dabRect;
-  GimpComponentMask   component_mask = surface->component_mask;
 
-  const float one_over_radius2 = 1.0f / (radius * radius);
   const double angle_rad = angle / 360 * 2 * M_PI;
-  const float cs = cos(angle_rad);
-  const float sn = sin(angle_rad);
-  float normal_mode;
-  float segment1_slope;
-  float segment2_slope;
-  float r_aa_start;
-
-  hardness = CLAMP (hardness, 0.0f, 1.0f);
-  segment1_slope = -(1.0f / hardness - 1.0f);
-  segment2_slope = -hardness / (1.0f - hardness);
-  aspect_ratio = MAX (1.0f, aspect_ratio);
-
-  r_aa_start = radius - 1.0f;
-  r_aa_start = MAX (r_aa_start, 0);
-  r_aa_start = (r_aa_start * r_aa_start) / aspect_ratio;
-
-  normal_mode = opaque * (1.0f - colorize);
-  colorize = opaque * colorize;
 
   /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
   dabRect = calculate_dab_roi (x, y, radius);
@@ -385,114 +667,34 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 
   gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
 
-  iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
-                                   babl_format ("R'G'B'A float"),
-                                   GEGL_BUFFER_READWRITE,
-                                   GEGL_ABYSS_NONE);
-  if (surface->paint_mask)
-    {
-      GeglRectangle mask_roi = dabRect;
-      mask_roi.x -= surface->paint_mask_x;
-      mask_roi.y -= surface->paint_mask_y;
-      gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
-                                babl_format ("Y float"),
-                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-    }
-
-  while (gegl_buffer_iterator_next (iter))
-    {
-      float *pixel = (float *)iter->data[0];
-      float *mask;
-      int iy, ix;
+  dab.roi              = dabRect;
+  dab.x                = x;
+  dab.y                = y;
+  dab.radius           = radius;
+  dab.color_r          = color_r;
+  dab.color_g          = color_g;
+  dab.color_b          = color_b;
+  dab.color_a          = color_a;
+  dab.one_over_radius2 = 1.0f / (radius * radius);
+  dab.cs               = cos (angle_rad);
+  dab.sn               = sin (angle_rad);
 
-      if (surface->paint_mask)
-        mask = iter->data[1];
-      else
-        mask = NULL;
+  dab.hardness       = CLAMP (hardness, 0.0f, 1.0f);
+  dab.segment1_slope = -(1.0f / dab.hardness - 1.0f);
+  dab.segment2_slope = -dab.hardness / (1.0f - dab.hardness);
+  dab.aspect_ratio   = MAX (1.0f, aspect_ratio);
 
-      for (iy = iter->roi[0].y; iy < iter->roi[0].y + iter->roi[0].height; iy++)
-        {
-          for (ix = iter->roi[0].x; ix < iter->roi[0].x +  iter->roi[0].width; ix++)
-            {
-              float rr, base_alpha, alpha, dst_alpha, r, g, b, a;
-              if (radius < 3.0f)
-                rr = calculate_rr_antialiased (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2, r_aa_start);
-              else
-                rr = calculate_rr (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2);
-              base_alpha = calculate_alpha_for_rr (rr, hardness, segment1_slope, segment2_slope);
-              alpha = base_alpha * normal_mode;
-              if (mask)
-                alpha *= *mask;
-              dst_alpha = pixel[ALPHA];
-              /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
-               * which converts to: */
-              a = alpha * (color_a - dst_alpha) + dst_alpha;
-              r = pixel[RED];
-              g = pixel[GREEN];
-              b = pixel[BLUE];
-
-              if (a > 0.0f)
-                {
-                  /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
-                   * Originaly this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
-                   * instead we only calculate the cheaper term. */
-                  float src_term = (alpha * color_a) / a;
-                  float dst_term = 1.0f - src_term;
-                  r = color_r * src_term + r * dst_term;
-                  g = color_g * src_term + g * dst_term;
-                  b = color_b * src_term + b * dst_term;
-                }
+  dab.r_aa_start = radius - 1.0f;
+  dab.r_aa_start = MAX (dab.r_aa_start, 0);
+  dab.r_aa_start = (dab.r_aa_start * dab.r_aa_start) / dab.aspect_ratio;
 
-              if (colorize > 0.0f && base_alpha > 0.0f)
-                {
-                  alpha = base_alpha * colorize;
-                  a = alpha + dst_alpha - alpha * dst_alpha;
-                  if (a > 0.0f)
-                    {
-                      GimpHSL pixel_hsl, out_hsl;
-                      GimpRGB pixel_rgb = {color_r, color_g, color_b};
-                      GimpRGB out_rgb   = {r, g, b};
-                      float src_term = alpha / a;
-                      float dst_term = 1.0f - src_term;
-
-                      gimp_rgb_to_hsl (&pixel_rgb, &pixel_hsl);
-                      gimp_rgb_to_hsl (&out_rgb, &out_hsl);
-
-                      out_hsl.h = pixel_hsl.h;
-                      out_hsl.s = pixel_hsl.s;
-                      gimp_hsl_to_rgb (&out_hsl, &out_rgb);
-
-                      r = (float)out_rgb.r * src_term + r * dst_term;
-                      g = (float)out_rgb.g * src_term + g * dst_term;
-                      b = (float)out_rgb.b * src_term + b * dst_term;
-                    }
-                }
+  dab.normal_mode = opaque * (1.0f - colorize);
+  dab.colorize    = opaque * colorize;
 
-              if (component_mask != GIMP_COMPONENT_MASK_ALL)
-                {
-                  if (component_mask & GIMP_COMPONENT_MASK_RED)
-                    pixel[RED]   = r;
-                  if (component_mask & GIMP_COMPONENT_MASK_GREEN)
-                    pixel[GREEN] = g;
-                  if (component_mask & GIMP_COMPONENT_MASK_BLUE)
-                    pixel[BLUE]  = b;
-                  if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
-                    pixel[ALPHA] = a;
-                }
-              else
-                {
-                  pixel[RED]   = r;
-                  pixel[GREEN] = g;
-                  pixel[BLUE]  = b;
-                  pixel[ALPHA] = a;
-                }
+  g_array_append_val (surface->dabs, dab);
 
-              pixel += 4;
-              if (mask)
-                mask += 1;
-            }
-        }
-    }
+  if (! surface->atomic)
+    gimp_mypaint_surface_flush (surface);
 
   return 1;
 }
@@ -500,7 +702,9 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 static void
 gimp_mypaint_surface_begin_atomic (MyPaintSurface *base_surface)
 {
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  surface->atomic++;
 }
 
 static void
@@ -508,6 +712,13 @@ gimp_mypaint_surface_end_atomic (MyPaintSurface   *base_surface,
                                  MyPaintRectangle *roi)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+
+  if (surface->atomic > 0)
+    surface->atomic--;
+
+  if (! surface->atomic)
+    gimp_mypaint_surface_flush (surface);
+
   roi->x = surface->dirty.x;
   roi->y = surface->dirty.y;
   roi->width = surface->dirty.width;
@@ -519,11 +730,22 @@ static void
 gimp_mypaint_surface_destroy (MyPaintSurface *base_surface)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+  gimp_mypaint_surface_flush (surface);
   g_object_unref (surface->buffer);
   surface->buffer = NULL;
   if (surface->paint_mask)
     g_object_unref (surface->paint_mask);
   surface->paint_mask = NULL;
+  g_array_free (surface->dabs, TRUE);
+  surface->dabs = NULL;
+  g_free (surface->block);
+  g_free (surface->block_mask);
+  g_free (surface->row_alpha);
+  g_free (surface->sample);
+  surface->block = NULL;
+  surface->block_mask = NULL;
+  surface->row_alpha = NULL;
+  surface->sample = NULL;
 }
 
 GimpMybrushSurface *
@@ -549,6 +771,10 @@ gimp_mypaint_surface_new (GeglBuffer        *buffer,
   surface->paint_mask_x = paint_mask_x;
   surface->paint_mask_y = paint_mask_y;
   surface->dirty = *GEGL_RECTANGLE (0, 0, 0, 0);
+  surface->dabs = g_array_new (FALSE, FALSE, sizeof (GimpMybrushDab));
+  surface->block = g_new (float, 4 * BLOCK_SIZE * BLOCK_SIZE);
+  surface->block_mask = g_new (float, BLOCK_SIZE * BLOCK_SIZE);
+  surface->row_alpha = g_new (float, BLOCK_SIZE);
 
   return surface;
 }
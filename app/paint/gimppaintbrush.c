@@ -138,6 +138,7 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
   GimpImage                *image;
   GimpLayerMode             paint_mode;
   GimpRGB                   gradient_color;
+  GeglColor                *paint_color = NULL;
   GeglBuffer               *paint_buffer;
   gint                      paint_buffer_x;
   gint                      paint_buffer_y;
@@ -184,6 +185,43 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
 
   paint_mode = gimp_context_get_paint_mode (context);
 
+  /*  the color is the same for all strokes, only a pixmap brush has to
+   *  color each stroke's area on its own
+   */
+  if (gimp_paint_options_get_gradient_color (paint_options, image,
+                                             grad_point,
+                                             paint_core->pixel_dist,
+                                             &gradient_color))
+    {
+      /* optionally take the color from the current gradient */
+
+      opacity *= gradient_color.a;
+      gimp_rgb_set_alpha (&gradient_color, GIMP_OPACITY_OPAQUE);
+
+      paint_color = gimp_gegl_color_new (&gradient_color);
+
+      paint_appl_mode = GIMP_PAINT_INCREMENTAL;
+    }
+  else if (brush_core->brush && gimp_brush_get_pixmap (brush_core->brush))
+    {
+      /* otherwise check if the brush has a pixmap and use that to
+       * color the area
+       */
+      paint_appl_mode = GIMP_PAINT_INCREMENTAL;
+    }
+  else
+    {
+      /* otherwise fill the area with the foreground color */
+
+      GimpRGB foreground;
+
+      gimp_context_get_foreground (context, &foreground);
+      gimp_pickable_srgb_to_image_color (GIMP_PICKABLE (drawable),
+                                         &foreground, &foreground);
+
+      paint_color = gimp_gegl_color_new (&foreground);
+    }
+
   n_strokes = gimp_symmetry_get_size (sym);
   for (i = 0; i < n_strokes; i++)
     {
@@ -205,53 +243,19 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
       op = gimp_symmetry_get_operation (sym, i,
                                         paint_width,
                                         paint_height);
-      if (gimp_paint_options_get_gradient_color (paint_options, image,
-                                                 grad_point,
-                                                 paint_core->pixel_dist,
-                                                 &gradient_color))
-        {
-          /* optionally take the color from the current gradient */
 
-          GeglColor *color;
-
-          opacity *= gradient_color.a;
-          gimp_rgb_set_alpha (&gradient_color, GIMP_OPACITY_OPAQUE);
-
-          color = gimp_gegl_color_new (&gradient_color);
-
-          gegl_buffer_set_color (paint_buffer, NULL, color);
-          g_object_unref (color);
-
-          paint_appl_mode = GIMP_PAINT_INCREMENTAL;
+      if (paint_color)
+        {
+          gegl_buffer_set_color (paint_buffer, NULL, paint_color);
         }
-      else if (brush_core->brush && gimp_brush_get_pixmap (brush_core->brush))
+      else
         {
-          /* otherwise check if the brush has a pixmap and use that to
-           * color the area
-           */
           gimp_brush_core_color_area_with_pixmap (brush_core, drawable,
                                                   coords, op,
                                                   paint_buffer,
                                                   paint_buffer_x,
                                                   paint_buffer_y,
                                                   gimp_paint_options_get_brush_mode (paint_options));
-
-          paint_appl_mode = GIMP_PAINT_INCREMENTAL;
-        }
-      else
-        {
-          /* otherwise fill the area with the foreground color */
-
-          GimpRGB    foreground;
-          GeglColor *color;
-
-          gimp_context_get_foreground (context, &foreground);
-          gimp_pickable_srgb_to_image_color (GIMP_PICKABLE (drawable),
-                                             &foreground, &foreground);
-          color = gimp_gegl_color_new (&foreground);
-
-          gegl_buffer_set_color (paint_buffer, NULL, color);
-          g_object_unref (color);
         }
 
       if (gimp_dynamics_is_output_enabled (dynamics, GIMP_DYNAMICS_OUTPUT_FORCE))
@@ -273,4 +277,7 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
                                     force,
                                     paint_appl_mode, op);
     }
+
+  if (paint_color)
+    g_object_unref (paint_color);
 }
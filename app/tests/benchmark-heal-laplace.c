@@ -0,0 +1,173 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compares the time the heal tool's laplace solvers take, and the
+ * residual they leave, for round and elongated brushes of growing size.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint/gimpheal-laplace.h"
+
+
+#define DEPTH    4
+#define MIN_TIME 0.25
+
+
+typedef void (* SolveFunc) (gfloat       *pixels,
+                            gint          width,
+                            gint          height,
+                            gint          depth,
+                            const guchar *mask);
+
+typedef struct
+{
+  const gchar *name;
+  gdouble      aspect;
+} Shape;
+
+
+static const Shape shapes[] =
+{
+  { "round",     1.0 },
+  { "elongated", 4.0 }
+};
+
+static const gint sizes[] = { 16, 32, 64, 128, 256, 512 };
+
+
+/* Fill the pixels with a smooth gradient plus some noise, and clear
+ * the ones inside an ellipse, like the heal tool does with the
+ * difference between the source and the destination.
+ */
+static void
+benchmark_init (gfloat       *pixels,
+                guchar       *mask,
+                gint          size,
+                const Shape  *shape)
+{
+  GRand   *rand = g_rand_new_with_seed (size);
+  gdouble  rx   = size / 2.0 - 1.0;
+  gdouble  ry   = rx / shape->aspect;
+  gint     x, y, k;
+
+  for (y = 0; y < size; y++)
+    for (x = 0; x < size; x++)
+      {
+        gdouble  dx     = (x + 0.5 - size / 2.0) / rx;
+        gdouble  dy     = (y + 0.5 - size / 2.0) / ry;
+        gboolean inside = dx * dx + dy * dy < 1.0;
+
+        mask[y * size + x] = inside ? 255 : 0;
+
+        for (k = 0; k < DEPTH; k++)
+          {
+            gfloat *p = &pixels[(y * size + x) * DEPTH + k];
+
+            if (inside)
+              *p = 0.0;
+            else
+              *p = (sin (x * 0.05 * (k + 1)) + cos (y * 0.03) +
+                    g_rand_double_range (rand, -0.05, 0.05));
+          }
+      }
+
+  g_rand_free (rand);
+}
+
+static void
+benchmark_solver (const gchar  *name,
+                  SolveFunc     solve,
+                  const gfloat *input,
+                  gfloat       *pixels,
+                  const guchar *mask,
+                  gint          size)
+{
+  GTimer  *timer = g_timer_new ();
+  gint     n     = 0;
+  gdouble  elapsed;
+  gdouble  residual;
+
+  g_timer_stop (timer);
+
+  do
+    {
+      memcpy (pixels, input, size * size * DEPTH * sizeof (gfloat));
+
+      g_timer_continue (timer);
+      solve (pixels, size, size, DEPTH, mask);
+      g_timer_stop (timer);
+
+      n++;
+    }
+  while (g_timer_elapsed (timer, NULL) < MIN_TIME);
+
+  elapsed  = g_timer_elapsed (timer, NULL) / n;
+  residual = gimp_heal_laplace_residual (pixels, size, size, DEPTH, mask);
+
+  g_print ("  %-10s %10.3f ms   residual %.3g\n",
+           name, elapsed * 1000.0, residual);
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint i, j;
+
+  g_print ("tolerance: residual < %.3g\n", (0.1 / 255) * (0.1 / 255));
+
+  for (i = 0; i < G_N_ELEMENTS (shapes); i++)
+    for (j = 0; j < G_N_ELEMENTS (sizes); j++)
+      {
+        gint    size = sizes[j];
+        gfloat *input;
+        gfloat *pixels;
+        gfloat *pixels_alloc;
+        guchar *mask;
+
+        /*  the SSE path of the SOR solver needs aligned pixels  */
+        input        = g_new (gfloat, size * size * DEPTH);
+        pixels_alloc = g_new (gfloat, 4 + (size * size + 1) * DEPTH);
+        pixels       = (gfloat *) (((uintptr_t) pixels_alloc + 15) & ~15);
+        mask         = g_new (guchar, size * size);
+
+        benchmark_init (input, mask, size, &shapes[i]);
+
+        g_print ("%s brush, %d x %d:\n", shapes[i].name, size, size);
+
+        benchmark_solver ("sor", gimp_heal_laplace_sor,
+                          input, pixels, mask, size);
+        benchmark_solver ("multigrid", gimp_heal_laplace_multigrid,
+                          input, pixels, mask, size);
+
+        g_free (input);
+        g_free (pixels_alloc);
+        g_free (mask);
+      }
+
+  return 0;
+}
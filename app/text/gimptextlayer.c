@@ -112,6 +112,12 @@ static void       gimp_text_layer_text_changed   (GimpTextLayer     *layer);
 static gboolean   gimp_text_layer_render         (GimpTextLayer     *layer);
 static void       gimp_text_layer_render_layout  (GimpTextLayer     *layer,
                                                   GimpTextLayout    *layout);
+static gboolean   gimp_text_layer_get_changed_rect
+                                                 (GimpTextLayer     *layer,
+                                                  GimpTextLayout    *layout,
+                                                  GeglRectangle     *rect);
+static void       gimp_text_layer_set_render     (GimpTextLayer     *layer,
+                                                  GimpTextLayout    *layout);
 
 
 G_DEFINE_TYPE (GimpTextLayer, gimp_text_layer, GIMP_TYPE_LAYER)
@@ -192,6 +198,8 @@ gimp_text_layer_finalize (GObject *object)
 {
   GimpTextLayer *layer = GIMP_TEXT_LAYER (object);
 
+  gimp_text_layer_set_render (layer, NULL);
+
   if (layer->text)
     {
       g_object_unref (layer->text);
@@ -328,6 +336,8 @@ gimp_text_layer_set_buffer (GimpDrawable *drawable,
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  gimp_text_layer_set_render (layer, NULL);
+
   if (push_undo && ! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE_MOD,
                                  undo_desc);
@@ -359,6 +369,9 @@ gimp_text_layer_push_undo (GimpDrawable *drawable,
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  /*  the pixels are about to be changed by something else  */
+  gimp_text_layer_set_render (layer, NULL);
+
   if (! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE, undo_desc);
 
@@ -466,6 +479,8 @@ gimp_text_layer_set_text (GimpTextLayer *layer,
   if (layer->text == text)
     return;
 
+  gimp_text_layer_set_render (layer, NULL);
+
   if (layer->text)
     {
       g_signal_handlers_disconnect_by_func (layer->text,
@@ -734,16 +749,25 @@ gimp_text_layer_render_layout (GimpTextLayer  *layer,
   GimpColorTransform *transform;
   cairo_t            *cr;
   cairo_surface_t    *surface;
-  gint                width;
-  gint                height;
+  GeglRectangle       rect;
   cairo_status_t      status;
 
   g_return_if_fail (gimp_drawable_has_alpha (drawable));
 
-  width  = gimp_item_get_width  (item);
-  height = gimp_item_get_height (item);
+  rect = *GEGL_RECTANGLE (0, 0,
+                          gimp_item_get_width  (item),
+                          gimp_item_get_height (item));
+
+  if (gimp_text_layer_get_changed_rect (layer, layout, &rect) &&
+      gegl_rectangle_is_empty (&rect))
+    {
+      /*  nothing changed that shows  */
+      gimp_text_layer_set_render (layer, layout);
+      return;
+    }
 
-  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        rect.width, rect.height);
   status = cairo_surface_status (surface);
 
   if (status != CAIRO_STATUS_SUCCESS)
@@ -754,10 +778,12 @@ gimp_text_layer_render_layout (GimpTextLayer  *layer,
                             _("Your text cannot be rendered. It is likely too big. "
                               "Please make it shorter or use a smaller font."));
       cairo_surface_destroy (surface);
+      gimp_text_layer_set_render (layer, NULL);
       return;
     }
 
   cr = cairo_create (surface);
+  cairo_translate (cr, -rect.x, -rect.y);
   gimp_text_layout_render (layout, cr, layer->text->base_dir, FALSE);
   cairo_destroy (cr);
 
@@ -773,16 +799,104 @@ gimp_text_layer_render_layout (GimpTextLayer  *layer,
                                            buffer,
                                            NULL,
                                            gimp_drawable_get_buffer (drawable),
-                                           NULL);
+                                           &rect);
     }
   else
     {
       gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE,
-                        gimp_drawable_get_buffer (drawable), NULL);
+                        gimp_drawable_get_buffer (drawable), &rect);
     }
 
   g_object_unref (buffer);
   cairo_surface_destroy (surface);
 
-  gimp_drawable_update (drawable, 0, 0, width, height);
+  gimp_drawable_update (drawable, rect.x, rect.y, rect.width, rect.height);
+
+  gimp_text_layer_set_render (layer, layout);
+}
+
+/*  Finds the part of the layer that changes when rendering @layout
+ *  instead of the layout the pixels were last rendered from, clipped
+ *  to the layer.  Returns FALSE and leaves @rect alone if all of the
+ *  layer needs rendering.
+ */
+static gboolean
+gimp_text_layer_get_changed_rect (GimpTextLayer  *layer,
+                                  GimpTextLayout *layout,
+                                  GeglRectangle  *rect)
+{
+  GimpItem              *item       = GIMP_ITEM (layer);
+  cairo_rectangle_int_t  changed;
+  GList                 *diff;
+  GList                 *list;
+  gboolean               lines_only = TRUE;
+
+  if (! layer->render_text || ! layer->render_layout || layer->modified)
+    return FALSE;
+
+  /*  only a change of the text itself can be limited to some lines  */
+  diff = gimp_config_diff (G_OBJECT (layer->render_text),
+                           G_OBJECT (layer->text), 0);
+
+  for (list = diff; list; list = g_list_next (list))
+    {
+      GParamSpec *pspec = list->data;
+
+      if (strcmp (pspec->name, "text") && strcmp (pspec->name, "markup"))
+        {
+          lines_only = FALSE;
+          break;
+        }
+    }
+
+  g_list_free (diff);
+
+  if (! lines_only ||
+      ! gimp_text_layout_get_changed_rect (layout, layer->render_layout,
+                                           &changed))
+    return FALSE;
+
+  /*  leaves @rect empty if the lines changed outside of the layer  */
+  gegl_rectangle_intersect (rect,
+                            GEGL_RECTANGLE (changed.x,     changed.y,
+                                            changed.width, changed.height),
+                            GEGL_RECTANGLE (0, 0,
+                                            gimp_item_get_width  (item),
+                                            gimp_item_get_height (item)));
+
+  return TRUE;
+}
+
+/*  Remembers that the layer's pixels show @layout of the current
+ *  text, or forgets what they show if @layout is %NULL.
+ */
+static void
+gimp_text_layer_set_render (GimpTextLayer  *layer,
+                            GimpTextLayout *layout)
+{
+  if (layout)
+    g_object_ref (layout);
+
+  if (layer->render_layout)
+    g_object_unref (layer->render_layout);
+
+  layer->render_layout = layout;
+
+  if (! layout)
+    {
+      if (layer->render_text)
+        {
+          g_object_unref (layer->render_text);
+          layer->render_text = NULL;
+        }
+    }
+  else if (layer->render_text)
+    {
+      gimp_config_sync (G_OBJECT (layer->text),
+                        G_OBJECT (layer->render_text), 0);
+    }
+  else
+    {
+      layer->render_text = gimp_config_duplicate (GIMP_CONFIG (layer->text));
+    }
 }
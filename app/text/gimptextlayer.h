@@ -48,6 +48,12 @@ struct _GimpTextLayer
   gboolean      modified;
 
   const Babl   *convert_format;
+
+  /*  the text and layout the layer's pixels were last rendered from,
+   *  so a text change only needs to render the lines that changed
+   */
+  GimpText       *render_text;
+  GimpTextLayout *render_layout;
 };
 
 struct _GimpTextLayerClass
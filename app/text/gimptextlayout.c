@@ -61,6 +61,13 @@ static PangoContext * gimp_text_get_pango_context (GimpText       *text,
                                                    gdouble         xres,
                                                    gdouble         yres);
 
+static void           gimp_text_layout_rect_union (PangoRectangle  *dest,
+                                                   PangoRectangle  *rect);
+static gboolean       gimp_text_layout_line_equal (PangoLayoutLine *line,
+                                                   const gchar     *text,
+                                                   PangoLayoutLine *other,
+                                                   const gchar     *other_text);
+
 
 G_DEFINE_TYPE (GimpTextLayout, gimp_text_layout, G_TYPE_OBJECT)
 
@@ -450,6 +457,236 @@ gimp_text_layout_untransform_distance (GimpTextLayout *layout,
     }
 }
 
+/**
+ * gimp_text_layout_get_changed_rect:
+ * @layout:     a #GimpTextLayout
+ * @old_layout: the #GimpTextLayout of the same text before it changed
+ * @rect:       returns the changed area
+ *
+ * Compares the lines of @layout with the lines of @old_layout and
+ * returns the area in layer coordinates covered by the lines that
+ * changed, moved, appeared or went away. Everything outside of it
+ * renders the same for both layouts. @rect is empty if no line
+ * changed.
+ *
+ * The layouts must have been created from the same text settings
+ * apart from the text itself.
+ *
+ * Return value: %FALSE if the layouts are positioned differently and
+ *               can't be compared line by line.
+ **/
+gboolean
+gimp_text_layout_get_changed_rect (GimpTextLayout        *layout,
+                                   GimpTextLayout        *old_layout,
+                                   cairo_rectangle_int_t *rect)
+{
+  PangoLayoutIter *iter;
+  PangoLayoutIter *old_iter;
+  const gchar     *text;
+  const gchar     *old_text;
+  PangoRectangle   changed = { 0, };
+  cairo_matrix_t   trafo;
+  gdouble          x1, y1, x2, y2;
+  gboolean         more;
+  gboolean         old_more;
+  gint             i;
+
+  g_return_val_if_fail (GIMP_IS_TEXT_LAYOUT (layout), FALSE);
+  g_return_val_if_fail (GIMP_IS_TEXT_LAYOUT (old_layout), FALSE);
+  g_return_val_if_fail (rect != NULL, FALSE);
+
+  if (layout->xres      != old_layout->xres      ||
+      layout->yres      != old_layout->yres      ||
+      layout->extents.x != old_layout->extents.x ||
+      layout->extents.y != old_layout->extents.y)
+    return FALSE;
+
+  text     = pango_layout_get_text (layout->layout);
+  old_text = pango_layout_get_text (old_layout->layout);
+
+  iter     = pango_layout_get_iter (layout->layout);
+  old_iter = pango_layout_get_iter (old_layout->layout);
+
+  more     = TRUE;
+  old_more = TRUE;
+
+  while (more || old_more)
+    {
+      PangoRectangle ink,     logical;
+      PangoRectangle old_ink, old_logical;
+      gboolean       equal = more && old_more;
+
+      if (more)
+        pango_layout_iter_get_line_extents (iter, &ink, &logical);
+
+      if (old_more)
+        pango_layout_iter_get_line_extents (old_iter, &old_ink, &old_logical);
+
+      if (equal)
+        {
+          equal = (pango_layout_iter_get_baseline (iter) ==
+                   pango_layout_iter_get_baseline (old_iter) &&
+                   ! memcmp (&ink,     &old_ink,     sizeof (PangoRectangle)) &&
+                   ! memcmp (&logical, &old_logical, sizeof (PangoRectangle)) &&
+                   gimp_text_layout_line_equal
+                   (pango_layout_iter_get_line_readonly (iter),     text,
+                    pango_layout_iter_get_line_readonly (old_iter), old_text));
+        }
+
+      if (! equal)
+        {
+          if (more)
+            {
+              gimp_text_layout_rect_union (&changed, &ink);
+              gimp_text_layout_rect_union (&changed, &logical);
+            }
+
+          if (old_more)
+            {
+              gimp_text_layout_rect_union (&changed, &old_ink);
+              gimp_text_layout_rect_union (&changed, &old_logical);
+            }
+        }
+
+      if (more)
+        more = pango_layout_iter_next_line (iter);
+
+      if (old_more)
+        old_more = pango_layout_iter_next_line (old_iter);
+    }
+
+  pango_layout_iter_free (iter);
+  pango_layout_iter_free (old_iter);
+
+  if (changed.width <= 0 || changed.height <= 0)
+    {
+      rect->x      = 0;
+      rect->y      = 0;
+      rect->width  = 0;
+      rect->height = 0;
+
+      return TRUE;
+    }
+
+  /*  transform the corners the same way gimp_text_layout_render() does  */
+  gimp_text_layout_get_transform (layout, &trafo);
+
+  x1 = y1 = G_MAXDOUBLE;
+  x2 = y2 = -G_MAXDOUBLE;
+
+  for (i = 0; i < 4; i++)
+    {
+      gdouble x = (gdouble) (changed.x + (i & 1 ? changed.width  : 0)) / PANGO_SCALE;
+      gdouble y = (gdouble) (changed.y + (i & 2 ? changed.height : 0)) / PANGO_SCALE;
+
+      cairo_matrix_transform_point (&trafo, &x, &y);
+
+      x1 = MIN (x1, x);
+      y1 = MIN (y1, y);
+      x2 = MAX (x2, x);
+      y2 = MAX (y2, y);
+    }
+
+  /*  one more pixel for antialiasing and hinting  */
+  rect->x      = layout->extents.x + floor (x1) - 1;
+  rect->y      = layout->extents.y + floor (y1) - 1;
+  rect->width  = layout->extents.x + ceil (x2) + 1 - rect->x;
+  rect->height = layout->extents.y + ceil (y2) + 1 - rect->y;
+
+  return TRUE;
+}
+
+static void
+gimp_text_layout_rect_union (PangoRectangle *dest,
+                             PangoRectangle *rect)
+{
+  gint x1, y1;
+  gint x2, y2;
+
+  if (rect->width <= 0 || rect->height <= 0)
+    return;
+
+  if (dest->width <= 0 || dest->height <= 0)
+    {
+      *dest = *rect;
+      return;
+    }
+
+  x1 = MIN (dest->x, rect->x);
+  y1 = MIN (dest->y, rect->y);
+  x2 = MAX (dest->x + dest->width,  rect->x + rect->width);
+  y2 = MAX (dest->y + dest->height, rect->y + rect->height);
+
+  dest->x      = x1;
+  dest->y      = y1;
+  dest->width  = x2 - x1;
+  dest->height = y2 - y1;
+}
+
+static gboolean
+gimp_text_layout_line_equal (PangoLayoutLine *line,
+                             const gchar     *text,
+                             PangoLayoutLine *other,
+                             const gchar     *other_text)
+{
+  GSList *run;
+  GSList *other_run;
+
+  if (line->length            != other->length            ||
+      line->is_paragraph_start != other->is_paragraph_start ||
+      line->resolved_dir      != other->resolved_dir)
+    return FALSE;
+
+  if (memcmp (text       + line->start_index,
+              other_text + other->start_index, line->length))
+    return FALSE;
+
+  for (run = line->runs, other_run = other->runs;
+       run && other_run;
+       run = g_slist_next (run), other_run = g_slist_next (other_run))
+    {
+      PangoGlyphItem   *item         = run->data;
+      PangoGlyphItem   *other_item   = other_run->data;
+      PangoGlyphString *glyphs       = item->glyphs;
+      PangoGlyphString *other_glyphs = other_item->glyphs;
+      GSList           *attr;
+      GSList           *other_attr;
+      gint              i;
+
+      if (item->item->analysis.font  != other_item->item->analysis.font  ||
+          item->item->analysis.level != other_item->item->analysis.level ||
+          glyphs->num_glyphs         != other_glyphs->num_glyphs)
+        return FALSE;
+
+      for (i = 0; i < glyphs->num_glyphs; i++)
+        {
+          PangoGlyphInfo *info       = &glyphs->glyphs[i];
+          PangoGlyphInfo *other_info = &other_glyphs->glyphs[i];
+
+          if (info->glyph             != other_info->glyph             ||
+              info->geometry.width    != other_info->geometry.width    ||
+              info->geometry.x_offset != other_info->geometry.x_offset ||
+              info->geometry.y_offset != other_info->geometry.y_offset)
+            return FALSE;
+        }
+
+      /*  the colors and decorations from the markup  */
+      for (attr = item->item->analysis.extra_attrs,
+           other_attr = other_item->item->analysis.extra_attrs;
+           attr && other_attr;
+           attr = g_slist_next (attr), other_attr = g_slist_next (other_attr))
+        {
+          if (! pango_attribute_equal (attr->data, other_attr->data))
+            return FALSE;
+        }
+
+      if (attr || other_attr)
+        return FALSE;
+    }
+
+  return (run == NULL && other_run == NULL);
+}
+
 static gboolean
 gimp_text_layout_split_markup (const gchar  *markup,
                                gchar       **open_tag,
@@ -75,5 +75,9 @@ void             gimp_text_layout_untransform_distance (GimpTextLayout *layout,
                                                         gdouble        *x,
                                                         gdouble        *y);
 
+gboolean         gimp_text_layout_get_changed_rect     (GimpTextLayout        *layout,
+                                                        GimpTextLayout        *old_layout,
+                                                        cairo_rectangle_int_t *rect);
+
 
 #endif /* __GIMP_TEXT_LAYOUT_H__ */
@@ -130,7 +130,8 @@ static gint       gimp_cage_tool_is_on_edge         (GimpCageTool          *ct,
 
 static gboolean   gimp_cage_tool_is_complete        (GimpCageTool          *ct);
 static void       gimp_cage_tool_remove_last_handle (GimpCageTool          *ct);
-static void       gimp_cage_tool_compute_coef       (GimpCageTool          *ct);
+static void       gimp_cage_tool_compute_coef       (GimpCageTool          *ct,
+                                                     gboolean               preview);
 static void       gimp_cage_tool_create_filter      (GimpCageTool          *ct);
 static void       gimp_cage_tool_filter_flush       (GimpDrawableFilter    *filter,
                                                      GimpTool              *tool);
@@ -587,7 +588,7 @@ gimp_cage_tool_key_press (GimpTool    *tool,
               ct->tool_state = CAGE_STATE_WAIT;
             }
 
-          gimp_cage_tool_compute_coef (ct);
+          gimp_cage_tool_compute_coef (ct, TRUE);
           gimp_cage_tool_render_node_update (ct);
         }
       return TRUE;
@@ -739,7 +740,7 @@ gimp_cage_tool_options_notify (GimpTool         *tool,
 
               if (ct->dirty_coef)
                 {
-                  gimp_cage_tool_compute_coef (ct);
+                  gimp_cage_tool_compute_coef (ct, TRUE);
                   gimp_cage_tool_render_node_update (ct);
                 }
 
@@ -1003,6 +1004,13 @@ gimp_cage_tool_commit (GimpCageTool *ct)
 
       gimp_tool_control_push_preserve (tool->control, TRUE);
 
+      /* the preview's coefficients are interpolated, apply exact ones */
+      if (ct->preview_coef)
+        {
+          gimp_cage_tool_compute_coef (ct, FALSE);
+          gimp_cage_tool_render_node_update (ct);
+        }
+
       gimp_drawable_filter_commit (ct->filter, GIMP_PROGRESS (tool), FALSE);
       g_object_unref (ct->filter);
       ct->filter = NULL;
@@ -1128,7 +1136,8 @@ gimp_cage_tool_remove_last_handle (GimpCageTool *ct)
 }
 
 static void
-gimp_cage_tool_compute_coef (GimpCageTool *ct)
+gimp_cage_tool_compute_coef (GimpCageTool *ct,
+                             gboolean      preview)
 {
   GimpCageConfig *config = ct->config;
   GimpProgress   *progress;
@@ -1158,6 +1167,7 @@ gimp_cage_tool_compute_coef (GimpCageTool *ct)
   input = gegl_node_new_child (gegl,
                                "operation", "gimp:cage-coef-calc",
                                "config",    ct->config,
+                               "preview",   preview,
                                NULL);
 
   output = gegl_node_new_child (gegl,
@@ -1185,7 +1195,8 @@ gimp_cage_tool_compute_coef (GimpCageTool *ct)
   ct->coef = buffer;
   g_object_unref (gegl);
 
-  ct->dirty_coef = FALSE;
+  ct->dirty_coef   = FALSE;
+  ct->preview_coef = preview;
 }
 
 static void
@@ -60,6 +60,7 @@ struct _GimpCageTool
 
   GeglBuffer     *coef; /* Gegl buffer where the coefficient of the transformation are stored */
   gboolean        dirty_coef; /* Indicate if the coef are still valid */
+  gboolean        preview_coef; /* Indicate if the coef are interpolated from a coarse grid */
 
   GeglNode       *render_node; /* Gegl node graph to render the transfromation */
   GeglNode       *cage_node; /* Gegl node that compute the cage transform */
@@ -977,19 +977,32 @@ gimp_foreground_select_tool_halt (GimpForegroundSelectTool *fg_select)
 static void
 gimp_foreground_select_tool_commit (GimpForegroundSelectTool *fg_select)
 {
-  GimpTool             *tool    = GIMP_TOOL (fg_select);
-  GimpSelectionOptions *options = GIMP_SELECTION_TOOL_GET_OPTIONS (fg_select);
+  GimpTool                    *tool    = GIMP_TOOL (fg_select);
+  GimpSelectionOptions        *options = GIMP_SELECTION_TOOL_GET_OPTIONS (fg_select);
+  GimpForegroundSelectOptions *fg_options;
+
+  fg_options = GIMP_FOREGROUND_SELECT_TOOL_GET_OPTIONS (fg_select);
 
   if (tool->display && fg_select->state != MATTING_STATE_FREE_SELECT)
     {
-      GimpImage *image = gimp_display_get_image (tool->display);
-
-      if (fg_select->state != MATTING_STATE_PREVIEW_MASK)
-        gimp_foreground_select_tool_preview (fg_select);
+      GimpImage    *image    = gimp_display_get_image (tool->display);
+      GimpDrawable *drawable = gimp_image_get_active_drawable (image);
+      GeglBuffer   *mask;
+
+      /*  the preview mask is only an approximation, the selection
+       *  gets the full resolution solve
+       */
+      mask = gimp_drawable_foreground_extract (drawable,
+                                               fg_options->engine,
+                                               fg_options->iterations,
+                                               fg_options->levels,
+                                               fg_options->active_levels,
+                                               fg_select->trimap,
+                                               GIMP_PROGRESS (fg_select));
 
       gimp_channel_select_buffer (gimp_image_get_mask (image),
                                   C_("command", "Foreground Select"),
-                                  fg_select->mask,
+                                  mask,
                                   0, /* x offset */
                                   0, /* y offset */
                                   options->operation,
@@ -997,6 +1010,8 @@ gimp_foreground_select_tool_commit (GimpForegroundSelectTool *fg_select)
                                   options->feather_radius,
                                   options->feather_radius);
 
+      g_object_unref (mask);
+
       gimp_image_flush (image);
     }
 }
@@ -1072,13 +1087,14 @@ gimp_foreground_select_tool_preview (GimpForegroundSelectTool *fg_select)
       fg_select->mask = NULL;
     }
 
-  fg_select->mask = gimp_drawable_foreground_extract (drawable,
-                                                      options->engine,
-                                                      options->iterations,
-                                                      options->levels,
-                                                      options->active_levels,
-                                                      fg_select->trimap,
-                                                      GIMP_PROGRESS (fg_select));
+  fg_select->mask =
+    gimp_drawable_foreground_extract_preview (drawable,
+                                              options->engine,
+                                              options->iterations,
+                                              options->levels,
+                                              options->active_levels,
+                                              fg_select->trimap,
+                                              GIMP_PROGRESS (fg_select));
 
   gimp_foreground_select_tool_set_preview (fg_select);
 }
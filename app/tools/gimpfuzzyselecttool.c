@@ -44,8 +44,26 @@
 #include "gimp-intl.h"
 
 
-static GeglBuffer * gimp_fuzzy_select_tool_get_mask (GimpRegionSelectTool *region_select,
-                                                     GimpDisplay          *display);
+static void         gimp_fuzzy_select_tool_finalize       (GObject               *object);
+
+static void         gimp_fuzzy_select_tool_button_press   (GimpTool              *tool,
+                                                           const GimpCoords      *coords,
+                                                           guint32                time,
+                                                           GdkModifierType        state,
+                                                           GimpButtonPressType    press_type,
+                                                           GimpDisplay           *display);
+static void         gimp_fuzzy_select_tool_button_release (GimpTool              *tool,
+                                                           const GimpCoords      *coords,
+                                                           guint32                time,
+                                                           GdkModifierType        state,
+                                                           GimpButtonReleaseType  release_type,
+                                                           GimpDisplay           *display);
+
+static GeglBuffer * gimp_fuzzy_select_tool_get_mask       (GimpRegionSelectTool  *region_select,
+                                                           GimpDisplay           *display);
+
+static void         gimp_fuzzy_select_tool_clear_distance_map
+                                                          (GimpFuzzySelectTool   *fuzzy_select);
 
 
 G_DEFINE_TYPE (GimpFuzzySelectTool, gimp_fuzzy_select_tool,
@@ -74,10 +92,17 @@ gimp_fuzzy_select_tool_register (GimpToolRegisterCallback  callback,
 static void
 gimp_fuzzy_select_tool_class_init (GimpFuzzySelectToolClass *klass)
 {
+  GObjectClass              *object_class = G_OBJECT_CLASS (klass);
+  GimpToolClass             *tool_class   = GIMP_TOOL_CLASS (klass);
   GimpRegionSelectToolClass *region_class;
 
   region_class = GIMP_REGION_SELECT_TOOL_CLASS (klass);
 
+  object_class->finalize     = gimp_fuzzy_select_tool_finalize;
+
+  tool_class->button_press   = gimp_fuzzy_select_tool_button_press;
+  tool_class->button_release = gimp_fuzzy_select_tool_button_release;
+
   region_class->undo_desc = C_("command", "Fuzzy Select");
   region_class->get_mask  = gimp_fuzzy_select_tool_get_mask;
 }
@@ -91,10 +116,48 @@ gimp_fuzzy_select_tool_init (GimpFuzzySelectTool *fuzzy_select)
                                      GIMP_TOOL_CURSOR_FUZZY_SELECT);
 }
 
+static void
+gimp_fuzzy_select_tool_finalize (GObject *object)
+{
+  gimp_fuzzy_select_tool_clear_distance_map (GIMP_FUZZY_SELECT_TOOL (object));
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_fuzzy_select_tool_button_press (GimpTool            *tool,
+                                     const GimpCoords    *coords,
+                                     guint32              time,
+                                     GdkModifierType      state,
+                                     GimpButtonPressType  press_type,
+                                     GimpDisplay         *display)
+{
+  /*  the image may have changed since the last click  */
+  gimp_fuzzy_select_tool_clear_distance_map (GIMP_FUZZY_SELECT_TOOL (tool));
+
+  GIMP_TOOL_CLASS (parent_class)->button_press (tool, coords, time, state,
+                                                press_type, display);
+}
+
+static void
+gimp_fuzzy_select_tool_button_release (GimpTool              *tool,
+                                       const GimpCoords      *coords,
+                                       guint32                time,
+                                       GdkModifierType        state,
+                                       GimpButtonReleaseType  release_type,
+                                       GimpDisplay           *display)
+{
+  GIMP_TOOL_CLASS (parent_class)->button_release (tool, coords, time, state,
+                                                  release_type, display);
+
+  gimp_fuzzy_select_tool_clear_distance_map (GIMP_FUZZY_SELECT_TOOL (tool));
+}
+
 static GeglBuffer *
 gimp_fuzzy_select_tool_get_mask (GimpRegionSelectTool *region_select,
                                  GimpDisplay          *display)
 {
+  GimpFuzzySelectTool     *fuzzy_sel   = GIMP_FUZZY_SELECT_TOOL (region_select);
   GimpTool                *tool        = GIMP_TOOL (region_select);
   GimpSelectionOptions    *sel_options = GIMP_SELECTION_TOOL_GET_OPTIONS (tool);
   GimpRegionSelectOptions *options     = GIMP_REGION_SELECT_TOOL_GET_OPTIONS (tool);
@@ -122,11 +185,61 @@ gimp_fuzzy_select_tool_get_mask (GimpRegionSelectTool *region_select,
       pickable = GIMP_PICKABLE (image);
     }
 
-  return gimp_pickable_contiguous_region_by_seed (pickable,
-                                                  sel_options->antialias,
-                                                  options->threshold / 255.0,
-                                                  options->select_transparent,
-                                                  options->select_criterion,
-                                                  options->diagonal_neighbors,
-                                                  x, y);
+  if (fuzzy_sel->distance_map                                              &&
+      (fuzzy_sel->distance_pickable           != pickable                   ||
+       fuzzy_sel->distance_x                  != x                          ||
+       fuzzy_sel->distance_y                  != y                          ||
+       fuzzy_sel->distance_select_transparent != options->select_transparent ||
+       fuzzy_sel->distance_select_criterion   != options->select_criterion))
+    {
+      gimp_fuzzy_select_tool_clear_distance_map (fuzzy_sel);
+    }
+
+  if (! fuzzy_sel->distance_map)
+    {
+      const GeglRectangle *extent;
+
+      gimp_pickable_flush (pickable);
+
+      extent = gegl_buffer_get_extent (gimp_pickable_get_buffer (pickable));
+
+      if (x <  extent->x || x >= extent->x + extent->width ||
+          y <  extent->y || y >= extent->y + extent->height)
+        {
+          return gegl_buffer_new (extent, babl_format ("Y float"));
+        }
+
+      /*  only the threshold changes while dragging, so the distances
+       *  from the seed color are computed once per click
+       */
+      fuzzy_sel->distance_map =
+        gimp_pickable_contiguous_region_distance_map (pickable,
+                                                      options->select_transparent,
+                                                      options->select_criterion,
+                                                      x, y);
+
+      fuzzy_sel->distance_pickable           = pickable;
+      fuzzy_sel->distance_x                  = x;
+      fuzzy_sel->distance_y                  = y;
+      fuzzy_sel->distance_select_transparent = options->select_transparent;
+      fuzzy_sel->distance_select_criterion   = options->select_criterion;
+    }
+
+  return gimp_pickable_contiguous_region_by_distance_map (fuzzy_sel->distance_map,
+                                                          sel_options->antialias,
+                                                          options->threshold / 255.0,
+                                                          options->diagonal_neighbors,
+                                                          x, y);
+}
+
+static void
+gimp_fuzzy_select_tool_clear_distance_map (GimpFuzzySelectTool *fuzzy_select)
+{
+  if (fuzzy_select->distance_map)
+    {
+      g_object_unref (fuzzy_select->distance_map);
+      fuzzy_select->distance_map = NULL;
+    }
+
+  fuzzy_select->distance_pickable = NULL;
 }
@@ -38,6 +38,16 @@ typedef struct _GimpFuzzySelectToolClass GimpFuzzySelectToolClass;
 struct _GimpFuzzySelectTool
 {
   GimpRegionSelectTool  parent_instance;
+
+  /*  the color distances from the seed, kept while the threshold is
+   *  dragged
+   */
+  GeglBuffer           *distance_map;
+  GimpPickable         *distance_pickable;
+  gint                  distance_x;
+  gint                  distance_y;
+  gboolean              distance_select_transparent;
+  GimpSelectCriterion   distance_select_criterion;
 };
 
 struct _GimpFuzzySelectToolClass
@@ -45,6 +45,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <gegl.h>
 #include <gtk/gtk.h>
@@ -62,7 +63,6 @@
 #include "core/gimpimage.h"
 #include "core/gimppickable.h"
 #include "core/gimpscanconvert.h"
-#include "core/gimptempbuf.h"
 #include "core/gimptoolinfo.h"
 
 #include "widgets/gimphelp-ids.h"
@@ -81,8 +81,8 @@
 
 /*  defines  */
 #define  GRADIENT_SEARCH   32  /* how far to look when snapping to an edge */
-#define  EXTEND_BY         0.2 /* proportion to expand cost map by */
-#define  FIXED             5   /* additional fixed size to expand cost map */
+#define  SEARCH_TILE_SIZE  64  /* size of the tiles the search is stored in */
+#define  N_SEARCHES        2   /* number of searches to keep around */
 
 #define  COST_WIDTH        2   /* number of bytes for each pixel in cost map  */
 
@@ -93,9 +93,11 @@
 /* sentinel to mark seed point in ?cost? map */
 #define  SEED_POINT        9
 
-/*  Functional defines  */
-#define  PIXEL_COST(x)     ((x) >> 8)
-#define  PIXEL_DIR(x)      ((x) & 0x000000ff)
+/* sentinel to mark pixels the search didn't reach yet */
+#define  UNREACHED         10
+
+/* flag for pixels whose lowest cost is known */
+#define  SETTLED           0x80
 
 
 struct _ISegment
@@ -112,6 +114,36 @@ struct _ICurve
   gboolean  closed;
 };
 
+typedef struct
+{
+  guint32 cost[SEARCH_TILE_SIZE * SEARCH_TILE_SIZE];
+  guint8  link[SEARCH_TILE_SIZE * SEARCH_TILE_SIZE];
+  guint8  gradient[SEARCH_TILE_SIZE * SEARCH_TILE_SIZE * COST_WIDTH];
+} ISearchTile;
+
+typedef struct
+{
+  guint32 cost;
+  gint    x, y;
+} ISearchNode;
+
+/*  A search for the lowest cost paths from the seed point to all other
+ *  pixels.  It only settles as many pixels as it needs to reach the
+ *  pixels asked for so far, and continues from there when asked for
+ *  more, so a live-wire following the pointer reuses all the work done
+ *  for the previous pointer positions.
+ */
+struct _ISearch
+{
+  gint          seed_x, seed_y;
+  gint          width, height;
+  GeglBuffer   *gradient_map;
+  gint          n_tiles_x;
+  gint          n_tiles_y;
+  ISearchTile **tiles;  /*  allocated as the search reaches them        */
+  GArray       *queue;  /*  binary heap of the pixels to settle next    */
+};
+
 
 /*  local function prototypes  */
 
@@ -173,14 +205,6 @@ static void          iscissors_convert         (GimpIscissorsTool *iscissors,
                                                 GimpDisplay       *display);
 static GeglBuffer  * gradient_map_new          (GimpPickable      *pickable);
 
-static void          find_optimal_path         (GeglBuffer        *gradient_map,
-                                                GimpTempBuf       *dp_buf,
-                                                gint               x1,
-                                                gint               y1,
-                                                gint               x2,
-                                                gint               y2,
-                                                gint               xs,
-                                                gint               ys);
 static void          find_max_gradient         (GimpIscissorsTool *iscissors,
                                                 GimpPickable      *pickable,
                                                 gint              *x,
@@ -203,13 +227,21 @@ static gboolean      clicked_on_segment        (GimpIscissorsTool *iscissors,
                                                 gdouble            x,
                                                 gdouble            y);
 
-static GPtrArray   * plot_pixels               (GimpTempBuf       *dp_buf,
-                                                gint               x1,
-                                                gint               y1,
-                                                gint               xs,
-                                                gint               ys,
-                                                gint               xe,
-                                                gint               ye);
+static ISearch     * isearch_new               (GeglBuffer        *gradient_map,
+                                                gint               seed_x,
+                                                gint               seed_y);
+static void          isearch_free              (ISearch           *search);
+static void          isearch_run               (ISearch           *search,
+                                                gint               x,
+                                                gint               y);
+static GPtrArray   * isearch_plot              (ISearch           *search,
+                                                gint               x,
+                                                gint               y);
+static ISearch     * iscissors_get_search      (GimpIscissorsTool *iscissors,
+                                                gint               x,
+                                                gint               y,
+                                                gboolean           create);
+static void          iscissors_free_searches   (GimpIscissorsTool *iscissors);
 
 static ISegment    * isegment_new              (gint               x1,
                                                 gint               y1,
@@ -1250,6 +1282,8 @@ gimp_iscissors_tool_halt (GimpIscissorsTool *iscissors,
       iscissors->redo_stack = NULL;
     }
 
+  iscissors_free_searches (iscissors);
+
   if (iscissors->gradient_map)
     {
       g_object_unref (iscissors->gradient_map);
@@ -1479,11 +1513,10 @@ calculate_segment (GimpIscissorsTool *iscissors,
 {
   GimpDisplay  *display  = GIMP_TOOL (iscissors)->display;
   GimpPickable *pickable = GIMP_PICKABLE (gimp_display_get_image (display));
+  ISearch      *search;
   gint          width;
   gint          height;
   gint          xs, ys, xe, ye;
-  gint          x1, y1, x2, y2;
-  gint          ewidth, eheight;
 
   /* Initialise the gradient map buffer for this pickable if we don't
    * already have one.
@@ -1494,45 +1527,11 @@ calculate_segment (GimpIscissorsTool *iscissors,
   width  = gegl_buffer_get_width  (iscissors->gradient_map);
   height = gegl_buffer_get_height (iscissors->gradient_map);
 
-  /*  Calculate the lowest cost path from one vertex to the next as specified
-   *  by the parameter "segment".
-   *    Here are the steps:
-   *      1)  Calculate the appropriate working area for this operation
-   *      2)  Allocate a temp buf for the dynamic programming array
-   *      3)  Run the dynamic programming algorithm to find the optimal path
-   *      4)  Translate the optimal path into pixels in the isegment data
-   *            structure.
-   */
-
-  /*  Get the bounding box  */
+  /*  Get the end points  */
   xs = CLAMP (segment->x1, 0, width  - 1);
   ys = CLAMP (segment->y1, 0, height - 1);
   xe = CLAMP (segment->x2, 0, width  - 1);
   ye = CLAMP (segment->y2, 0, height - 1);
-  x1 = MIN (xs, xe);
-  y1 = MIN (ys, ye);
-  x2 = MAX (xs, xe) + 1;  /*  +1 because if xe = 199 & xs = 0, x2 - x1, width = 200  */
-  y2 = MAX (ys, ye) + 1;
-
-  /*  expand the boundaries past the ending points by
-   *  some percentage of width and height.  This serves the following purpose:
-   *  It gives the algorithm more area to search so better solutions
-   *  are found.  This is particularly helpful in finding "bumps" which
-   *  fall outside the bounding box represented by the start and end
-   *  coordinates of the "segment".
-   */
-  ewidth  = (x2 - x1) * EXTEND_BY + FIXED;
-  eheight = (y2 - y1) * EXTEND_BY + FIXED;
-
-  if (xe >= xs)
-    x2 += CLAMP (ewidth, 0, width - x2);
-  else
-    x1 -= CLAMP (ewidth, 0, x1);
-
-  if (ye >= ys)
-    y2 += CLAMP (eheight, 0, height - y2);
-  else
-    y1 -= CLAMP (eheight, 0, y1);
 
   /* blow away any previous points list we might have */
   if (segment->points)
@@ -1541,83 +1540,105 @@ calculate_segment (GimpIscissorsTool *iscissors,
       segment->points = NULL;
     }
 
-  if ((x2 - x1) && (y2 - y1))
-    {
-      /*  If the bounding box has width and height...  */
-
-      GimpTempBuf *dp_buf; /*  dynamic programming buffer  */
-      gint         dp_width  = (x2 - x1);
-      gint         dp_height = (y2 - y1);
-
-      dp_buf = gimp_temp_buf_new (dp_width, dp_height,
-                                  babl_format ("Y u32"));
+  /*  Reuse a search from either end point.  Otherwise search from the
+   *  end point that doesn't follow the pointer, so the search can be
+   *  continued when the pointer moves on.
+   */
+  search = iscissors_get_search (iscissors, xs, ys, FALSE);
 
-      /*  find the optimal path of pixels from (x1, y1) to (x2, y2)  */
-      find_optimal_path (iscissors->gradient_map, dp_buf,
-                         x1, y1, x2, y2, xs, ys);
+  if (! search)
+    {
+      search = iscissors_get_search (iscissors, xe, ye, FALSE);
 
-      /*  get a list of the pixels in the optimal path  */
-      segment->points = plot_pixels (dp_buf, x1, y1, xs, ys, xe, ye);
+      if (! search && xs == iscissors->x && ys == iscissors->y)
+        search = iscissors_get_search (iscissors, xe, ye, TRUE);
 
-      gimp_temp_buf_unref (dp_buf);
+      if (! search)
+        search = iscissors_get_search (iscissors, xs, ys, TRUE);
     }
-  else if ((x2 - x1) == 0)
-    {
-      /*  If the bounding box has no width  */
 
-      /*  plot a vertical line  */
-      gint y   = ys;
-      gint dir = (ys > ye) ? -1 : 1;
+  if (search->seed_x == xs && search->seed_y == ys)
+    {
+      isearch_run (search, xe, ye);
 
-      segment->points = g_ptr_array_new ();
-      while (y != ye)
-        {
-          g_ptr_array_add (segment->points, GINT_TO_POINTER ((y << 16) + xs));
-          y += dir;
-        }
+      segment->points = isearch_plot (search, xe, ye);
     }
-  else if ((y2 - y1) == 0)
+  else
     {
-      /*  If the bounding box has no height  */
+      GPtrArray *points;
+      gint       i;
+
+      isearch_run (search, xs, ys);
 
-      /*  plot a horizontal line  */
-      gint x   = xs;
-      gint dir = (xs > xe) ? -1 : 1;
+      points = isearch_plot (search, xs, ys);
 
-      segment->points = g_ptr_array_new ();
-      while (x != xe)
+      /*  the points run from the second end point to the first one  */
+      for (i = 0; i < points->len / 2; i++)
         {
-          g_ptr_array_add (segment->points, GINT_TO_POINTER ((ys << 16) + x));
-          x += dir;
+          gpointer tmp = points->pdata[i];
+
+          points->pdata[i] = points->pdata[points->len - 1 - i];
+          points->pdata[points->len - 1 - i] = tmp;
         }
+
+      segment->points = points;
     }
 }
 
 
-/* badly need to get a replacement - this is _way_ too expensive */
-static gboolean
-gradient_map_value (GeglBuffer *map,
-                    gint        x,
-                    gint        y,
-                    guint8     *grad,
-                    guint8     *dir)
+static ISearchTile *
+isearch_get_tile (ISearch *search,
+                  gint     x,
+                  gint     y)
 {
-  const GeglRectangle *extents;
+  ISearchTile **tile;
+  gint          tile_x = x / SEARCH_TILE_SIZE;
+  gint          tile_y = y / SEARCH_TILE_SIZE;
 
-  extents = gegl_buffer_get_extent (map);
+  tile = &search->tiles[tile_y * search->n_tiles_x + tile_x];
 
-  if (x >= extents->x     &&
-      y >= extents->y     &&
-      x <  extents->width &&
-      y <  extents->height)
+  if (! *tile)
     {
-      guint8 sample[2];
+      *tile = g_new (ISearchTile, 1);
+
+      memset ((*tile)->cost, 0xff, sizeof ((*tile)->cost));
+      memset ((*tile)->link, UNREACHED, sizeof ((*tile)->link));
+
+      /*  fetch the gradient map once per tile, this computes it as
+       *  needed
+       */
+      gegl_buffer_get (search->gradient_map,
+                       GEGL_RECTANGLE (tile_x * SEARCH_TILE_SIZE,
+                                       tile_y * SEARCH_TILE_SIZE,
+                                       SEARCH_TILE_SIZE,
+                                       SEARCH_TILE_SIZE),
+                       1.0, NULL, (*tile)->gradient,
+                       SEARCH_TILE_SIZE * COST_WIDTH, GEGL_ABYSS_NONE);
+    }
 
-      gegl_buffer_sample (map, x, y, NULL, sample, NULL,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  return *tile;
+}
+
+#define TILE_INDEX(x, y) (((y) % SEARCH_TILE_SIZE) * SEARCH_TILE_SIZE + \
+                          ((x) % SEARCH_TILE_SIZE))
+
+static inline gboolean
+isearch_get_gradient (ISearch *search,
+                      gint     x,
+                      gint     y,
+                      guint8  *grad,
+                      guint8  *dir)
+{
+  if (x >= 0             &&
+      y >= 0             &&
+      x <  search->width &&
+      y <  search->height)
+    {
+      ISearchTile *tile = isearch_get_tile (search, x, y);
+      gint         i    = TILE_INDEX (x, y) * COST_WIDTH;
 
-      *grad = sample[0];
-      *dir  = sample[1];
+      *grad = tile->gradient[i];
+      *dir  = tile->gradient[i + 1];
 
       return TRUE;
     }
@@ -1625,17 +1646,17 @@ gradient_map_value (GeglBuffer *map,
   return FALSE;
 }
 
+/*  the cost of moving from (x, y) to its neighbour in direction @link  */
 static gint
-calculate_link (GeglBuffer *gradient_map,
-                gint        x,
-                gint        y,
-                guint32     pixel,
-                gint        link)
+calculate_link (ISearch *search,
+                gint     x,
+                gint     y,
+                gint     link)
 {
   gint   value = 0;
   guint8 grad1, dir1, grad2, dir2;
 
-  if (! gradient_map_value (gradient_map, x, y, &grad1, &dir1))
+  if (! isearch_get_gradient (search, x, y, &grad1, &dir1))
     {
       grad1 = 0;
       dir1 = 255;
@@ -1646,212 +1667,255 @@ calculate_link (GeglBuffer *gradient_map,
   grad1 = 255 - grad1;
 
   /*  calculate the contribution of the gradient magnitude  */
-  if (link > 1)
+  if ((link & 3) > 1)
     value += diagonal_weight[grad1] * OMEGA_G;
   else
     value += grad1 * OMEGA_G;
 
   /*  calculate the contribution of the gradient direction  */
-  x += (gint8)(pixel & 0xff);
-  y += (gint8)((pixel & 0xff00) >> 8);
+  x += move[link][0];
+  y += move[link][1];
 
-  if (! gradient_map_value (gradient_map, x, y, &grad2, &dir2))
+  if (! isearch_get_gradient (search, x, y, &grad2, &dir2))
     {
       grad2 = 0;
       dir2 = 255;
     }
 
   value +=
-    (direction_value[dir1][link] + direction_value[dir2][link]) * OMEGA_D;
+    (direction_value[dir1][link & 3] + direction_value[dir2][link & 3]) * OMEGA_D;
 
   return value;
 }
 
+static void
+isearch_push (ISearch *search,
+              guint32  cost,
+              gint     x,
+              gint     y)
+{
+  ISearchNode *nodes;
+  ISearchNode  node = { cost, x, y };
+  gint         i;
 
-static GPtrArray *
-plot_pixels (GimpTempBuf *dp_buf,
-             gint         x1,
-             gint         y1,
-             gint         xs,
-             gint         ys,
-             gint         xe,
-             gint         ye)
+  g_array_set_size (search->queue, search->queue->len + 1);
+
+  nodes = (ISearchNode *) search->queue->data;
+
+  for (i = search->queue->len - 1; i > 0; i = (i - 1) / 2)
+    {
+      if (nodes[(i - 1) / 2].cost <= cost)
+        break;
+
+      nodes[i] = nodes[(i - 1) / 2];
+    }
+
+  nodes[i] = node;
+}
+
+static ISearchNode
+isearch_pop (ISearch *search)
 {
-  gint       x, y;
-  guint32    coords;
-  gint       link;
-  gint       width = gimp_temp_buf_get_width (dp_buf);
-  guint     *data;
-  GPtrArray *list;
+  ISearchNode *nodes = (ISearchNode *) search->queue->data;
+  ISearchNode  top   = nodes[0];
+  ISearchNode  last  = nodes[search->queue->len - 1];
+  gint         len   = search->queue->len - 1;
+  gint         i     = 0;
+
+  while (2 * i + 1 < len)
+    {
+      gint child = 2 * i + 1;
+
+      if (child + 1 < len && nodes[child + 1].cost < nodes[child].cost)
+        child++;
+
+      if (last.cost <= nodes[child].cost)
+        break;
 
-  /*  Start the data pointer at the correct location  */
-  data = (guint *) gimp_temp_buf_get_data (dp_buf) + (ye - y1) * width + (xe - x1);
+      nodes[i] = nodes[child];
+      i = child;
+    }
+
+  nodes[i] = last;
+
+  g_array_set_size (search->queue, len);
+
+  return top;
+}
+
+static ISearch *
+isearch_new (GeglBuffer *gradient_map,
+             gint        seed_x,
+             gint        seed_y)
+{
+  ISearch     *search = g_slice_new0 (ISearch);
+  ISearchTile *tile;
 
-  x = xe;
-  y = ye;
+  search->seed_x       = seed_x;
+  search->seed_y       = seed_y;
+  search->width        = gegl_buffer_get_width  (gradient_map);
+  search->height       = gegl_buffer_get_height (gradient_map);
+  search->gradient_map = g_object_ref (gradient_map);
 
-  list = g_ptr_array_new ();
+  search->n_tiles_x = (search->width  + SEARCH_TILE_SIZE - 1) / SEARCH_TILE_SIZE;
+  search->n_tiles_y = (search->height + SEARCH_TILE_SIZE - 1) / SEARCH_TILE_SIZE;
+
+  search->tiles = g_new0 (ISearchTile *,
+                          search->n_tiles_x * search->n_tiles_y);
+  search->queue = g_array_new (FALSE, FALSE, sizeof (ISearchNode));
+
+  tile = isearch_get_tile (search, seed_x, seed_y);
+
+  tile->cost[TILE_INDEX (seed_x, seed_y)] = 0;
+  tile->link[TILE_INDEX (seed_x, seed_y)] = SEED_POINT;
+
+  isearch_push (search, 0, seed_x, seed_y);
+
+  return search;
+}
+
+static void
+isearch_free (ISearch *search)
+{
+  gint i;
+
+  for (i = 0; i < search->n_tiles_x * search->n_tiles_y; i++)
+    g_free (search->tiles[i]);
+
+  g_free (search->tiles);
+  g_array_free (search->queue, TRUE);
+  g_object_unref (search->gradient_map);
+
+  g_slice_free (ISearch, search);
+}
+
+/*  Settles pixels in the order of their cost from the seed point,
+ *  until the lowest cost path to (x, y) is known.
+ */
+static void
+isearch_run (ISearch *search,
+             gint     x,
+             gint     y)
+{
+  ISearchTile *target = isearch_get_tile (search, x, y);
+  gint         index  = TILE_INDEX (x, y);
+
+  while (! (target->link[index] & SETTLED) && search->queue->len > 0)
+    {
+      ISearchNode  node = isearch_pop (search);
+      ISearchTile *tile = isearch_get_tile (search, node.x, node.y);
+      gint         link;
+
+      /*  skip the pixels that were queued again with a lower cost  */
+      if (tile->link[TILE_INDEX (node.x, node.y)] & SETTLED)
+        continue;
+
+      tile->link[TILE_INDEX (node.x, node.y)] |= SETTLED;
+
+      /*  relax the neighbours whose link back to this pixel is @link  */
+      for (link = 0; link < 8; link++)
+        {
+          ISearchTile *neighbor;
+          gint         nx = node.x - move[link][0];
+          gint         ny = node.y - move[link][1];
+          gint         i;
+          guint32      cost;
+
+          if (nx < 0 || ny < 0 || nx >= search->width || ny >= search->height)
+            continue;
+
+          neighbor = isearch_get_tile (search, nx, ny);
+          i        = TILE_INDEX (nx, ny);
+
+          if (neighbor->link[i] & SETTLED)
+            continue;
+
+          cost = node.cost + calculate_link (search, nx, ny, link);
+
+          if (cost < neighbor->cost[i])
+            {
+              neighbor->cost[i] = cost;
+              neighbor->link[i] = link;
+
+              isearch_push (search, cost, nx, ny);
+            }
+        }
+    }
+}
+
+static GPtrArray *
+isearch_plot (ISearch *search,
+              gint     x,
+              gint     y)
+{
+  GPtrArray *list = g_ptr_array_new ();
 
   while (TRUE)
     {
-      coords = (y << 16) + x;
-      g_ptr_array_add (list, GINT_TO_POINTER (coords));
+      ISearchTile *tile = isearch_get_tile (search, x, y);
+      gint         link = tile->link[TILE_INDEX (x, y)] & ~SETTLED;
+
+      g_ptr_array_add (list, GINT_TO_POINTER ((y << 16) + x));
 
-      link = PIXEL_DIR (*data);
-      if (link == SEED_POINT)
+      if (link == SEED_POINT || link == UNREACHED)
         return list;
 
       x += move[link][0];
       y += move[link][1];
-      data += move[link][1] * width + move[link][0];
     }
 
   /*  won't get here  */
   return NULL;
 }
 
+#undef TILE_INDEX
 
-#define PACK(x, y)    ((((y) & 0xff) << 8) | ((x) & 0xff))
-#define OFFSET(pixel) ((gint8)((pixel) & 0xff) + \
-                       ((gint8)(((pixel) & 0xff00) >> 8)) * \
-                       gimp_temp_buf_get_width (dp_buf))
-
-static void
-find_optimal_path (GeglBuffer  *gradient_map,
-                   GimpTempBuf *dp_buf,
-                   gint         x1,
-                   gint         y1,
-                   gint         x2,
-                   gint         y2,
-                   gint         xs,
-                   gint         ys)
+static ISearch *
+iscissors_get_search (GimpIscissorsTool *iscissors,
+                      gint               x,
+                      gint               y,
+                      gboolean           create)
 {
-  gint     i, j, k;
-  gint     x, y;
-  gint     link;
-  gint     linkdir;
-  gint     dirx, diry;
-  gint     min_cost;
-  gint     new_cost;
-  gint     offset;
-  gint     cum_cost[8];
-  gint     link_cost[8];
-  gint     pixel_cost[8];
-  guint32  pixel[8];
-  guint32 *data;
-  guint32 *d;
-  gint     dp_buf_width  = gimp_temp_buf_get_width  (dp_buf);
-  gint     dp_buf_height = gimp_temp_buf_get_height (dp_buf);
-
-  /*  initialize the dynamic programming buffer  */
-  data = (guint32 *) gimp_temp_buf_data_clear (dp_buf);
-
-  /*  what directions are we filling the array in according to?  */
-  dirx = (xs - x1 == 0) ? 1 : -1;
-  diry = (ys - y1 == 0) ? 1 : -1;
-  linkdir = (dirx * diry);
-
-  y = ys;
-
-  for (i = 0; i < dp_buf_height; i++)
-    {
-      x = xs;
+  ISearch *search;
+  GList   *list;
 
-      d = data + (y-y1) * dp_buf_width + (x-x1);
+  for (list = iscissors->searches; list; list = g_list_next (list))
+    {
+      search = list->data;
 
-      for (j = 0; j < dp_buf_width; j++)
+      if (search->seed_x == x && search->seed_y == y)
         {
-          min_cost = G_MAXINT;
-
-          /* pixel[] array encodes how to get to a neighbour, if possible.
-           * 0 means no connection (eg edge).
-           * Rest packed as bottom two bytes: y offset then x offset.
-           * Initially, we assume we can't get anywhere.
-           */
-          for (k = 0; k < 8; k++)
-            pixel[k] = 0;
-
-          /*  Find the valid neighboring pixels  */
-          /*  the previous pixel  */
-          if (j)
-            pixel[((dirx == 1) ? 4 : 0)] = PACK (-dirx, 0);
-
-          /*  the previous row of pixels  */
-          if (i)
-            {
-              pixel[((diry == 1) ? 5 : 1)] = PACK (0, -diry);
+          /*  keep the most recently used searches at the front  */
+          iscissors->searches = g_list_remove_link (iscissors->searches, list);
+          iscissors->searches = g_list_concat (list, iscissors->searches);
 
-              link = (linkdir == 1) ? 3 : 2;
-              if (j)
-                pixel[((diry == 1) ? (link + 4) : link)] = PACK (-dirx, -diry);
+          return search;
+        }
+    }
 
-              link = (linkdir == 1) ? 2 : 3;
-              if (j != dp_buf_width - 1)
-                pixel[((diry == 1) ? (link + 4) : link)] = PACK (dirx, -diry);
-            }
+  if (! create)
+    return NULL;
 
-          /*  find the minimum cost of going through each neighbor to reach the
-           *  seed point...
-           */
-          link = -1;
-          for (k = 0; k < 8; k ++)
-            if (pixel[k])
-              {
-                link_cost[k] = calculate_link (gradient_map,
-                                               xs + j*dirx, ys + i*diry,
-                                               pixel [k],
-                                               ((k > 3) ? k - 4 : k));
-                offset = OFFSET (pixel [k]);
-                pixel_cost[k] = PIXEL_COST (d[offset]);
-                cum_cost[k] = pixel_cost[k] + link_cost[k];
-                if (cum_cost[k] < min_cost)
-                  {
-                    min_cost = cum_cost[k];
-                    link = k;
-                  }
-              }
-
-          /*  If anything can be done...  */
-          if (link >= 0)
-            {
-              /*  set the cumulative cost of this pixel and the new direction
-               */
-              *d = (cum_cost[link] << 8) + link;
-
-              /*  possibly change the links from the other pixels to this pixel...
-               *  these changes occur if a neighboring pixel will receive a lower
-               *  cumulative cost by going through this pixel.
-               */
-              for (k = 0; k < 8; k ++)
-                if (pixel[k] && k != link)
-                  {
-                    /*  if the cumulative cost at the neighbor is greater than
-                     *  the cost through the link to the current pixel, change the
-                     *  neighbor's link to point to the current pixel.
-                     */
-                    new_cost = link_cost[k] + cum_cost[link];
-                    if (pixel_cost[k] > new_cost)
-                    {
-                      /*  reverse the link direction   /--------------------\ */
-                      offset = OFFSET (pixel[k]);
-                      d[offset] = (new_cost << 8) + ((k > 3) ? k - 4 : k + 4);
-                    }
-                  }
-            }
-          /*  Set the seed point  */
-          else if (!i && !j)
-            {
-              *d = SEED_POINT;
-            }
+  search = isearch_new (iscissors->gradient_map, x, y);
 
-          /*  increment the data pointer and the x counter  */
-          d += dirx;
-          x += dirx;
-        }
+  iscissors->searches = g_list_prepend (iscissors->searches, search);
 
-      /*  increment the y counter  */
-      y += diry;
+  if (g_list_length (iscissors->searches) > N_SEARCHES)
+    {
+      list = g_list_last (iscissors->searches);
+
+      isearch_free (list->data);
+      iscissors->searches = g_list_delete_link (iscissors->searches, list);
     }
+
+  return search;
+}
+
+static void
+iscissors_free_searches (GimpIscissorsTool *iscissors)
+{
+  g_list_free_full (iscissors->searches, (GDestroyNotify) isearch_free);
+  iscissors->searches = NULL;
 }
 
 static GeglBuffer *
@@ -54,8 +54,36 @@
 
 #define STROKE_TIMER_MAX_FPS 20
 #define PREVIEW_SAMPLER      GEGL_SAMPLER_NEAREST
+#define PROXY_MAX_PIXELS     (1024 * 1024)
 
 
+typedef enum
+{
+  PROXY_JOB_STROKE,  /* redo the current stroke on top of the base */
+  PROXY_JOB_FINISH,  /* merge the current stroke into the base     */
+  PROXY_JOB_REBUILD  /* redo all strokes from scratch              */
+} ProxyJobType;
+
+typedef struct
+{
+  gint           behavior;
+  gdouble        size;
+  gdouble        hardness;
+  gdouble        strength;
+  gdouble        spacing;
+  GeglPath      *stroke;   /* in proxy coordinates */
+} ProxyStroke;
+
+typedef struct
+{
+  ProxyJobType   type;
+  GList         *strokes;  /* oldest first */
+  GeglRectangle  area;     /* layer area to update when done */
+} ProxyJob;
+
+
+static void       gimp_warp_tool_finalize           (GObject               *object);
+
 static void       gimp_warp_tool_control            (GimpTool              *tool,
                                                      GimpToolAction         action,
                                                      GimpDisplay           *display);
@@ -116,12 +144,20 @@ static void       gimp_warp_tool_stop_stroke_timer  (GimpWarpTool          *wt);
 static gboolean   gimp_warp_tool_stroke_timer       (GimpWarpTool          *wt);
 
 static void       gimp_warp_tool_create_graph       (GimpWarpTool          *wt);
+static void       gimp_warp_tool_create_preview_graph
+                                                    (GimpWarpTool          *wt);
 static void       gimp_warp_tool_create_filter      (GimpWarpTool          *wt,
                                                      GimpDrawable          *drawable);
 static void       gimp_warp_tool_set_sampler        (GimpWarpTool          *wt,
                                                      gboolean               commit);
+static GeglRectangle
+                  gimp_warp_tool_get_path_bounds    (GeglPath              *stroke,
+                                                     gdouble                size);
 static GeglRectangle
                   gimp_warp_tool_get_stroke_bounds  (GeglNode              *node);
+static GeglRectangle
+                  gimp_warp_tool_get_bounds         (GimpWarpTool          *wt,
+                                                     GeglNode              *node);
 static void       gimp_warp_tool_update_stroke      (GimpWarpTool          *wt,
                                                      GeglNode              *node);
 static void       gimp_warp_tool_stroke_changed     (GeglPath              *stroke,
@@ -137,6 +173,26 @@ static void       gimp_warp_tool_free_op            (GeglNode              *op);
 
 static void       gimp_warp_tool_animate            (GimpWarpTool          *wt);
 
+static void       gimp_warp_tool_proxy_start        (GimpWarpTool          *wt);
+static void       gimp_warp_tool_proxy_stop         (GimpWarpTool          *wt);
+static void       gimp_warp_tool_proxy_queue        (GimpWarpTool          *wt,
+                                                     ProxyJobType           type,
+                                                     const GeglRectangle   *area);
+static void       gimp_warp_tool_proxy_rebuild      (GimpWarpTool          *wt,
+                                                     GeglNode              *node);
+static ProxyStroke *
+                  gimp_warp_tool_proxy_stroke_new   (GimpWarpTool          *wt,
+                                                     GeglNode              *node);
+static void       gimp_warp_tool_proxy_stroke_free  (ProxyStroke           *stroke);
+static void       gimp_warp_tool_proxy_job_free     (ProxyJob              *job);
+static void       gimp_warp_tool_proxy_apply_stroke (ProxyStroke           *stroke,
+                                                     GeglBuffer            *src,
+                                                     GeglBuffer            *dest);
+static void       gimp_warp_tool_proxy_run_job      (GimpWarpTool          *wt,
+                                                     ProxyJob              *job);
+static gpointer   gimp_warp_tool_proxy_thread       (GimpWarpTool          *wt);
+static gboolean   gimp_warp_tool_proxy_idle         (GimpWarpTool          *wt);
+
 
 G_DEFINE_TYPE (GimpWarpTool, gimp_warp_tool, GIMP_TYPE_DRAW_TOOL)
 
@@ -163,9 +219,12 @@ gimp_warp_tool_register (GimpToolRegisterCallback  callback,
 static void
 gimp_warp_tool_class_init (GimpWarpToolClass *klass)
 {
+  GObjectClass      *object_class    = G_OBJECT_CLASS (klass);
   GimpToolClass     *tool_class      = GIMP_TOOL_CLASS (klass);
   GimpDrawToolClass *draw_tool_class = GIMP_DRAW_TOOL_CLASS (klass);
 
+  object_class->finalize     = gimp_warp_tool_finalize;
+
   tool_class->control        = gimp_warp_tool_control;
   tool_class->button_press   = gimp_warp_tool_button_press;
   tool_class->button_release = gimp_warp_tool_button_release;
@@ -200,6 +259,26 @@ gimp_warp_tool_init (GimpWarpTool *self)
                                          "tools/tools-warp-effect-size-set");
   gimp_tool_control_set_action_hardness (tool->control,
                                          "tools/tools-warp-effect-hardness-set");
+
+  g_mutex_init (&self->proxy_mutex);
+  g_cond_init (&self->proxy_cond);
+
+  self->proxy_jobs = g_queue_new ();
+}
+
+static void
+gimp_warp_tool_finalize (GObject *object)
+{
+  GimpWarpTool *wt = GIMP_WARP_TOOL (object);
+
+  gimp_warp_tool_proxy_stop (wt);
+
+  g_queue_free (wt->proxy_jobs);
+
+  g_cond_clear (&wt->proxy_cond);
+  g_mutex_clear (&wt->proxy_mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -304,6 +383,16 @@ gimp_warp_tool_button_release (GimpTool              *tool,
                                         gimp_warp_tool_stroke_changed,
                                         wt);
 
+  /*  the preview already shows the finished stroke, so there is
+   *  nothing to update, unless the job supersedes a pending one
+   */
+  if (release_type != GIMP_BUTTON_RELEASE_CANCEL)
+    {
+      GeglRectangle empty = { 0, 0, 0, 0 };
+
+      gimp_warp_tool_proxy_queue (wt, PROXY_JOB_FINISH, &empty);
+    }
+
 #ifdef WARP_DEBUG
   g_printerr ("%s\n", gegl_path_to_string (wt->current_stroke));
 #endif
@@ -530,7 +619,7 @@ gimp_warp_tool_undo (GimpTool    *tool,
   gegl_node_connect_to (prev_node,       "output",
                         wt->render_node, "aux");
 
-  gimp_warp_tool_update_stroke (wt, to_delete);
+  gimp_warp_tool_proxy_rebuild (wt, to_delete);
 
   return TRUE;
 }
@@ -552,7 +641,7 @@ gimp_warp_tool_redo (GimpTool    *tool,
 
   wt->redo_stack = g_list_remove_link (wt->redo_stack, wt->redo_stack);
 
-  gimp_warp_tool_update_stroke (wt, to_add);
+  gimp_warp_tool_proxy_rebuild (wt, to_add);
 
   return TRUE;
 }
@@ -588,6 +677,9 @@ gimp_warp_tool_options_notify (GimpTool         *tool,
           gegl_node_set (wt->render_node,
                          "abyss-policy", wt_options->abyss_policy,
                          NULL);
+          gegl_node_set (wt->preview_render_node,
+                         "abyss-policy", wt_options->abyss_policy,
+                         NULL);
 
           gimp_warp_tool_update_stroke (wt, NULL);
         }
@@ -596,7 +688,14 @@ gimp_warp_tool_options_notify (GimpTool         *tool,
     {
       gimp_warp_tool_set_sampler (wt, /* commit = */ FALSE);
 
-      gimp_warp_tool_update_stroke (wt, NULL);
+      /*  the proxy resolution depends on the preview quality  */
+      if (wt->proxy_thread)
+        {
+          gimp_warp_tool_proxy_stop (wt);
+          gimp_warp_tool_proxy_start (wt);
+
+          gimp_warp_tool_proxy_rebuild (wt, NULL);
+        }
     }
 }
 
@@ -703,6 +802,8 @@ gimp_warp_tool_start (GimpWarpTool *wt,
 
   wt->coords_buffer = gegl_buffer_new (&bbox, format);
 
+  gimp_warp_tool_proxy_start (wt);
+
   gimp_warp_tool_create_filter (wt, drawable);
 
   if (! gimp_draw_tool_is_active (GIMP_DRAW_TOOL (wt)))
@@ -726,6 +827,8 @@ gimp_warp_tool_halt (GimpWarpTool *wt)
   GimpTool        *tool    = GIMP_TOOL (wt);
   GimpWarpOptions *options = GIMP_WARP_TOOL_GET_OPTIONS (wt);
 
+  gimp_warp_tool_proxy_stop (wt);
+
   if (wt->coords_buffer)
     {
       g_object_unref (wt->coords_buffer);
@@ -739,6 +842,16 @@ gimp_warp_tool_halt (GimpWarpTool *wt)
       wt->render_node = NULL;
     }
 
+  if (wt->preview_graph)
+    {
+      g_object_unref (wt->preview_graph);
+      wt->preview_graph       = NULL;
+      wt->preview_coords_node = NULL;
+      wt->preview_scale_node  = NULL;
+      wt->preview_factor_node = NULL;
+      wt->preview_render_node = NULL;
+    }
+
   if (wt->filter)
     {
       gimp_drawable_filter_abort (wt->filter);
@@ -777,14 +890,40 @@ gimp_warp_tool_commit (GimpWarpTool *wt)
 
   if (wt->filter)
     {
+      GeglRectangle bbox;
+
       gimp_tool_control_push_preserve (tool->control, TRUE);
 
-      gimp_warp_tool_set_sampler (wt, /* commit = */ TRUE);
+      /*  the preview filter only shows the proxy, replace it by one
+       *  rendering the full resolution strokes
+       */
+      gimp_warp_tool_proxy_stop (wt);
 
-      gimp_drawable_filter_commit (wt->filter, GIMP_PROGRESS (tool), FALSE);
+      gimp_drawable_filter_abort (wt->filter);
       g_object_unref (wt->filter);
       wt->filter = NULL;
 
+      bbox = gimp_warp_tool_get_bounds (wt, NULL);
+
+      if (! gegl_rectangle_is_empty (&bbox))
+        {
+          gimp_warp_tool_set_sampler (wt, /* commit = */ TRUE);
+
+          wt->filter = gimp_drawable_filter_new (tool->drawable,
+                                                 _("Warp transform"),
+                                                 wt->graph,
+                                                 GIMP_ICON_TOOL_WARP);
+
+          gimp_drawable_filter_set_region (wt->filter,
+                                           GIMP_FILTER_REGION_DRAWABLE);
+          gimp_drawable_filter_apply (wt->filter, &bbox);
+
+          gimp_drawable_filter_commit (wt->filter, GIMP_PROGRESS (tool),
+                                       FALSE);
+          g_object_unref (wt->filter);
+          wt->filter = NULL;
+        }
+
       gimp_tool_control_pop_preserve (tool->control);
 
       gimp_image_flush (gimp_display_get_image (tool->display));
@@ -875,6 +1014,67 @@ gimp_warp_tool_create_graph (GimpWarpTool *wt)
   wt->render_node = render;
 }
 
+static void
+gimp_warp_tool_create_preview_graph (GimpWarpTool *wt)
+{
+  GimpWarpOptions *options = GIMP_WARP_TOOL_GET_OPTIONS (wt);
+  GeglNode        *graph;
+  GeglNode        *input, *output;
+  GeglNode        *coords, *scale, *factor, *render;
+
+  g_return_if_fail (wt->preview_graph == NULL);
+
+  /*  like the main graph, but reading the coordinates from the
+   *  proxy, scaled back up to the layer size
+   */
+  graph = gegl_node_new ();
+
+  input  = gegl_node_get_input_proxy  (graph, "input");
+  output = gegl_node_get_output_proxy (graph, "output");
+
+  coords = gegl_node_new_child (graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer",    wt->proxy_buffer,
+                                NULL);
+
+  scale = gegl_node_new_child (graph,
+                               "operation", "gegl:scale-ratio",
+                               "origin-x",  0.0,
+                               "origin-y",  0.0,
+                               "sampler",   GEGL_SAMPLER_LINEAR,
+                               "x",         1.0 / wt->proxy_scale,
+                               "y",         1.0 / wt->proxy_scale,
+                               NULL);
+
+  factor = gegl_node_new_child (graph,
+                                "operation",    "gimp:scalar-multiply",
+                                "n-components", 2,
+                                "factor",       1.0 / wt->proxy_scale,
+                                NULL);
+
+  render = gegl_node_new_child (graph,
+                                "operation",    "gegl:map-relative",
+                                "abyss-policy", options->abyss_policy,
+                                NULL);
+
+  gegl_node_link_many (coords, scale, factor, NULL);
+
+  gegl_node_connect_to (input,  "output",
+                        render, "input");
+
+  gegl_node_connect_to (factor, "output",
+                        render, "aux");
+
+  gegl_node_connect_to (render, "output",
+                        output, "input");
+
+  wt->preview_graph       = graph;
+  wt->preview_coords_node = coords;
+  wt->preview_scale_node  = scale;
+  wt->preview_factor_node = factor;
+  wt->preview_render_node = render;
+}
+
 static void
 gimp_warp_tool_create_filter (GimpWarpTool *wt,
                               GimpDrawable *drawable)
@@ -882,11 +1082,14 @@ gimp_warp_tool_create_filter (GimpWarpTool *wt,
   if (! wt->graph)
     gimp_warp_tool_create_graph (wt);
 
+  if (! wt->preview_graph)
+    gimp_warp_tool_create_preview_graph (wt);
+
   gimp_warp_tool_set_sampler (wt, /* commit = */ FALSE);
 
   wt->filter = gimp_drawable_filter_new (drawable,
                                          _("Warp transform"),
-                                         wt->graph,
+                                         wt->preview_graph,
                                          GIMP_ICON_TOOL_WARP);
 
   gimp_drawable_filter_set_region (wt->filter, GIMP_FILTER_REGION_DRAWABLE);
@@ -905,10 +1108,14 @@ gimp_warp_tool_set_sampler (GimpWarpTool *wt,
                             gboolean      commit)
 {
   GimpWarpOptions *options = GIMP_WARP_TOOL_GET_OPTIONS (wt);
+  GeglNode        *node;
   GeglSamplerType  sampler;
   GeglSamplerType  old_sampler;
 
-  if (! wt->render_node)
+  /*  the full resolution graph is only rendered when committing  */
+  node = commit ? wt->render_node : wt->preview_render_node;
+
+  if (! node)
     return;
 
   if (commit || options->high_quality_preview)
@@ -916,18 +1123,38 @@ gimp_warp_tool_set_sampler (GimpWarpTool *wt,
   else
     sampler = PREVIEW_SAMPLER;
 
-  gegl_node_get (wt->render_node,
+  gegl_node_get (node,
                  "sampler-type", &old_sampler,
                  NULL);
 
   if (sampler != old_sampler)
     {
-      gegl_node_set (wt->render_node,
+      gegl_node_set (node,
                      "sampler-type", sampler,
                      NULL);
     }
 }
 
+static GeglRectangle
+gimp_warp_tool_get_path_bounds (GeglPath *stroke,
+                                gdouble   size)
+{
+  GeglRectangle bbox;
+  gdouble       min_x;
+  gdouble       max_x;
+  gdouble       min_y;
+  gdouble       max_y;
+
+  gegl_path_get_bounds (stroke, &min_x, &max_x, &min_y, &max_y);
+
+  bbox.x      = floor (min_x - size * 0.5);
+  bbox.y      = floor (min_y - size * 0.5);
+  bbox.width  = ceil (max_x + size * 0.5) - bbox.x;
+  bbox.height = ceil (max_y + size * 0.5) - bbox.y;
+
+  return bbox;
+}
+
 static GeglRectangle
 gimp_warp_tool_get_stroke_bounds (GeglNode *node)
 {
@@ -942,40 +1169,27 @@ gimp_warp_tool_get_stroke_bounds (GeglNode *node)
 
   if (stroke)
     {
-      gdouble        min_x;
-      gdouble        max_x;
-      gdouble        min_y;
-      gdouble        max_y;
-
-      gegl_path_get_bounds (stroke, &min_x, &max_x, &min_y, &max_y);
+      bbox = gimp_warp_tool_get_path_bounds (stroke, size);
       g_object_unref (stroke);
-
-      bbox.x      = floor (min_x - size * 0.5);
-      bbox.y      = floor (min_y - size * 0.5);
-      bbox.width  = ceil (max_x + size * 0.5) - bbox.x;
-      bbox.height = ceil (max_y + size * 0.5) - bbox.y;
     }
 
   return bbox;
 }
 
-static void
-gimp_warp_tool_update_stroke (GimpWarpTool *wt,
-                              GeglNode     *node)
+static GeglRectangle
+gimp_warp_tool_get_bounds (GimpWarpTool *wt,
+                           GeglNode     *node)
 {
   GeglRectangle bbox = {0, 0, 0, 0};
 
-  if (! wt->filter)
-    return;
-
   if (node)
     {
-      /* update just this stroke */
+      /* just this stroke */
       bbox = gimp_warp_tool_get_stroke_bounds (node);
     }
   else if (wt->render_node)
     {
-      /* update all strokes */
+      /* all strokes */
       for (node = gegl_node_get_producer (wt->render_node, "aux", NULL);
            ! strcmp (gegl_node_get_operation (node), "gegl:warp");
            node = gegl_node_get_producer (node, "input", NULL))
@@ -988,6 +1202,20 @@ gimp_warp_tool_update_stroke (GimpWarpTool *wt,
         }
     }
 
+  return bbox;
+}
+
+static void
+gimp_warp_tool_update_stroke (GimpWarpTool *wt,
+                              GeglNode     *node)
+{
+  GeglRectangle bbox;
+
+  if (! wt->filter)
+    return;
+
+  bbox = gimp_warp_tool_get_bounds (wt, node);
+
   if (! gegl_rectangle_is_empty (&bbox))
     {
 #ifdef WARP_DEBUG
@@ -1021,7 +1249,10 @@ gimp_warp_tool_stroke_changed (GeglPath            *path,
               update_region.width, update_region.height);
 #endif
 
-  gimp_drawable_filter_apply (wt->filter, &update_region);
+  /*  recompute the stroke on the proxy in the background, the region
+   *  is updated once that is done
+   */
+  gimp_warp_tool_proxy_queue (wt, PROXY_JOB_STROKE, &update_region);
 }
 
 static void
@@ -1190,3 +1421,402 @@ gimp_warp_tool_animate (GimpWarpTool *wt)
                        gimp_widget_get_monitor (widget));
   g_object_unref (image);
 }
+
+static void
+gimp_warp_tool_proxy_start (GimpWarpTool *wt)
+{
+  GimpWarpOptions     *options = GIMP_WARP_TOOL_GET_OPTIONS (wt);
+  const GeglRectangle *extent  = gegl_buffer_get_extent (wt->coords_buffer);
+  const Babl          *format  = gegl_buffer_get_format (wt->coords_buffer);
+  GeglRectangle        rect;
+  gdouble              scale   = 1.0;
+
+  g_return_if_fail (wt->proxy_thread == NULL);
+
+  /*  strokes are previewed on a proxy of the coordinates buffer,
+   *  small enough to keep up with the brush on any layer size
+   */
+  if (! options->high_quality_preview)
+    {
+      while ((gdouble) extent->width * extent->height * SQR (scale) >
+             PROXY_MAX_PIXELS)
+        {
+          scale /= 2.0;
+        }
+    }
+
+  rect.x      = floor (extent->x * scale);
+  rect.y      = floor (extent->y * scale);
+  rect.width  = ceil ((extent->x + extent->width)  * scale) - rect.x;
+  rect.height = ceil ((extent->y + extent->height) * scale) - rect.y;
+
+#ifdef WARP_DEBUG
+  g_printerr ("Initialize proxy buffer (%d,%d) at %d,%d, scale %g\n",
+              rect.width, rect.height, rect.x, rect.y, scale);
+#endif
+
+  wt->proxy_scale       = scale;
+  wt->proxy_buffer      = gegl_buffer_new (&rect, format);
+  wt->proxy_base_buffer = gegl_buffer_new (&rect, format);
+
+  if (wt->preview_graph)
+    {
+      gegl_node_set (wt->preview_coords_node,
+                     "buffer", wt->proxy_buffer,
+                     NULL);
+      gegl_node_set (wt->preview_scale_node,
+                     "x", 1.0 / scale,
+                     "y", 1.0 / scale,
+                     NULL);
+      gegl_node_set (wt->preview_factor_node,
+                     "factor", 1.0 / scale,
+                     NULL);
+    }
+
+  wt->proxy_quit   = FALSE;
+  wt->proxy_thread = g_thread_new ("warp proxy",
+                                   (GThreadFunc) gimp_warp_tool_proxy_thread,
+                                   wt);
+}
+
+static void
+gimp_warp_tool_proxy_stop (GimpWarpTool *wt)
+{
+  ProxyJob *job;
+
+  if (! wt->proxy_thread)
+    return;
+
+  g_mutex_lock (&wt->proxy_mutex);
+
+  wt->proxy_quit = TRUE;
+  g_cond_signal (&wt->proxy_cond);
+
+  g_mutex_unlock (&wt->proxy_mutex);
+
+  g_thread_join (wt->proxy_thread);
+  wt->proxy_thread = NULL;
+
+  while ((job = g_queue_pop_head (wt->proxy_jobs)))
+    gimp_warp_tool_proxy_job_free (job);
+
+  if (wt->proxy_idle_id)
+    {
+      g_source_remove (wt->proxy_idle_id);
+      wt->proxy_idle_id = 0;
+    }
+
+  wt->proxy_dirty.width  = 0;
+  wt->proxy_dirty.height = 0;
+
+  g_clear_object (&wt->proxy_buffer);
+  g_clear_object (&wt->proxy_base_buffer);
+}
+
+static void
+gimp_warp_tool_proxy_queue (GimpWarpTool        *wt,
+                            ProxyJobType         type,
+                            const GeglRectangle *area)
+{
+  ProxyJob *job;
+  ProxyJob *pending;
+  GeglNode *node;
+
+  if (! wt->proxy_thread)
+    return;
+
+  job = g_slice_new0 (ProxyJob);
+
+  job->type = type;
+  job->area = *area;
+
+  /*  the proxy is upscaled with a linear sampler, so each of its
+   *  pixels affects a little more than its own area of the layer
+   */
+  if (! gegl_rectangle_is_empty (&job->area))
+    {
+      gint margin = ceil (1.0 / wt->proxy_scale);
+
+      job->area.x      -= margin;
+      job->area.y      -= margin;
+      job->area.width  += 2 * margin;
+      job->area.height += 2 * margin;
+    }
+
+  /*  the strokes are copied here, the worker never touches the graph  */
+  node = gegl_node_get_producer (wt->render_node, "aux", NULL);
+
+  if (type == PROXY_JOB_REBUILD)
+    {
+      for (;
+           ! strcmp (gegl_node_get_operation (node), "gegl:warp");
+           node = gegl_node_get_producer (node, "input", NULL))
+        {
+          job->strokes = g_list_prepend (job->strokes,
+                                         gimp_warp_tool_proxy_stroke_new (wt,
+                                                                          node));
+        }
+    }
+  else
+    {
+      job->strokes = g_list_prepend (NULL,
+                                     gimp_warp_tool_proxy_stroke_new (wt,
+                                                                      node));
+    }
+
+  g_mutex_lock (&wt->proxy_mutex);
+
+  /*  a rebuild supersedes all pending jobs, and the current stroke's
+   *  latest state supersedes its pending updates
+   */
+  while ((pending = g_queue_peek_tail (wt->proxy_jobs)) &&
+         (type == PROXY_JOB_REBUILD || pending->type == PROXY_JOB_STROKE))
+    {
+      g_queue_pop_tail (wt->proxy_jobs);
+
+      gegl_rectangle_bounding_box (&job->area, &job->area, &pending->area);
+
+      gimp_warp_tool_proxy_job_free (pending);
+    }
+
+  g_queue_push_tail (wt->proxy_jobs, job);
+  g_cond_signal (&wt->proxy_cond);
+
+  g_mutex_unlock (&wt->proxy_mutex);
+}
+
+static void
+gimp_warp_tool_proxy_rebuild (GimpWarpTool *wt,
+                              GeglNode     *node)
+{
+  GeglRectangle bbox = gimp_warp_tool_get_bounds (wt, node);
+
+  gimp_warp_tool_proxy_queue (wt, PROXY_JOB_REBUILD, &bbox);
+}
+
+static ProxyStroke *
+gimp_warp_tool_proxy_stroke_new (GimpWarpTool *wt,
+                                 GeglNode     *node)
+{
+  ProxyStroke *stroke = g_slice_new0 (ProxyStroke);
+  GeglPath    *path;
+
+  gegl_node_get (node,
+                 "behavior", &stroke->behavior,
+                 "size",     &stroke->size,
+                 "hardness", &stroke->hardness,
+                 "strength", &stroke->strength,
+                 "spacing",  &stroke->spacing,
+                 "stroke",   &path,
+                 NULL);
+
+  stroke->size   = MAX (stroke->size * wt->proxy_scale, 1.0);
+  stroke->stroke = gegl_path_new ();
+
+  if (path)
+    {
+      gint n_nodes = gegl_path_get_n_nodes (path);
+      gint i;
+
+      for (i = 0; i < n_nodes; i++)
+        {
+          GeglPathItem item;
+
+          gegl_path_get_node (path, i, &item);
+
+          gegl_path_append (stroke->stroke,
+                            item.type,
+                            item.point[0].x * wt->proxy_scale,
+                            item.point[0].y * wt->proxy_scale);
+        }
+
+      g_object_unref (path);
+    }
+
+  return stroke;
+}
+
+static void
+gimp_warp_tool_proxy_stroke_free (ProxyStroke *stroke)
+{
+  g_object_unref (stroke->stroke);
+
+  g_slice_free (ProxyStroke, stroke);
+}
+
+static void
+gimp_warp_tool_proxy_job_free (ProxyJob *job)
+{
+  g_list_free_full (job->strokes,
+                    (GDestroyNotify) gimp_warp_tool_proxy_stroke_free);
+
+  g_slice_free (ProxyJob, job);
+}
+
+static void
+gimp_warp_tool_proxy_apply_stroke (ProxyStroke *stroke,
+                                   GeglBuffer  *src,
+                                   GeglBuffer  *dest)
+{
+  const Babl    *format = gegl_buffer_get_format (dest);
+  GeglRectangle  area;
+  GeglNode      *graph;
+  GeglNode      *source;
+  GeglNode      *warp;
+  gfloat        *data;
+
+  area = gimp_warp_tool_get_path_bounds (stroke->stroke, stroke->size);
+
+  if (! gegl_rectangle_intersect (&area, &area,
+                                  gegl_buffer_get_extent (dest)))
+    return;
+
+  graph = gegl_node_new ();
+
+  source = gegl_node_new_child (graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer",    src,
+                                NULL);
+
+  warp = gegl_node_new_child (graph,
+                              "operation", "gegl:warp",
+                              "behavior",  stroke->behavior,
+                              "size",      stroke->size,
+                              "hardness",  stroke->hardness,
+                              "strength",  stroke->strength,
+                              "spacing",   stroke->spacing,
+                              "stroke",    stroke->stroke,
+                              NULL);
+
+  gegl_node_connect_to (source, "output",
+                        warp,   "input");
+
+  /*  render the whole area before writing it, src may be dest  */
+  data = g_new (gfloat, 2 * area.width * area.height);
+
+  gegl_node_blit (warp, 1.0, &area, format, data,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+
+  gegl_buffer_set (dest, &area, 0, format, data, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+  g_object_unref (graph);
+}
+
+static void
+gimp_warp_tool_proxy_run_job (GimpWarpTool *wt,
+                              ProxyJob     *job)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (wt->proxy_buffer);
+  ProxyStroke         *stroke;
+  GeglRectangle        area;
+  GList               *list;
+
+  switch (job->type)
+    {
+    case PROXY_JOB_STROKE:
+      stroke = job->strokes->data;
+
+      gimp_warp_tool_proxy_apply_stroke (stroke,
+                                         wt->proxy_base_buffer,
+                                         wt->proxy_buffer);
+      break;
+
+    case PROXY_JOB_FINISH:
+      stroke = job->strokes->data;
+
+      gimp_warp_tool_proxy_apply_stroke (stroke,
+                                         wt->proxy_base_buffer,
+                                         wt->proxy_buffer);
+
+      area = gimp_warp_tool_get_path_bounds (stroke->stroke, stroke->size);
+
+      if (gegl_rectangle_intersect (&area, &area, extent))
+        {
+          gegl_buffer_copy (wt->proxy_buffer,      &area, GEGL_ABYSS_NONE,
+                            wt->proxy_base_buffer, &area);
+        }
+      break;
+
+    case PROXY_JOB_REBUILD:
+      gegl_buffer_clear (wt->proxy_base_buffer, extent);
+
+      for (list = job->strokes; list; list = g_list_next (list))
+        {
+          gimp_warp_tool_proxy_apply_stroke (list->data,
+                                             wt->proxy_base_buffer,
+                                             wt->proxy_base_buffer);
+        }
+
+      gegl_buffer_copy (wt->proxy_base_buffer, extent, GEGL_ABYSS_NONE,
+                        wt->proxy_buffer,      extent);
+      break;
+    }
+}
+
+static gpointer
+gimp_warp_tool_proxy_thread (GimpWarpTool *wt)
+{
+  g_mutex_lock (&wt->proxy_mutex);
+
+  while (! wt->proxy_quit)
+    {
+      ProxyJob *job = g_queue_pop_head (wt->proxy_jobs);
+
+      if (! job)
+        {
+          g_cond_wait (&wt->proxy_cond, &wt->proxy_mutex);
+          continue;
+        }
+
+      g_mutex_unlock (&wt->proxy_mutex);
+
+      gimp_warp_tool_proxy_run_job (wt, job);
+
+      g_mutex_lock (&wt->proxy_mutex);
+
+      gegl_rectangle_bounding_box (&wt->proxy_dirty,
+                                   &wt->proxy_dirty, &job->area);
+
+      if (! wt->proxy_idle_id)
+        {
+          wt->proxy_idle_id =
+            gdk_threads_add_idle ((GSourceFunc) gimp_warp_tool_proxy_idle,
+                                  wt);
+        }
+
+      gimp_warp_tool_proxy_job_free (job);
+    }
+
+  g_mutex_unlock (&wt->proxy_mutex);
+
+  return NULL;
+}
+
+static gboolean
+gimp_warp_tool_proxy_idle (GimpWarpTool *wt)
+{
+  GeglRectangle area;
+
+  g_mutex_lock (&wt->proxy_mutex);
+
+  area = wt->proxy_dirty;
+
+  wt->proxy_dirty.width  = 0;
+  wt->proxy_dirty.height = 0;
+  wt->proxy_idle_id      = 0;
+
+  g_mutex_unlock (&wt->proxy_mutex);
+
+  if (wt->filter && ! gegl_rectangle_is_empty (&area))
+    {
+#ifdef WARP_DEBUG
+      g_printerr ("update proxy: (%d,%d), %dx%d\n",
+                  area.x, area.y, area.width, area.height);
+#endif
+
+      gimp_drawable_filter_apply (wt->filter, &area);
+    }
+
+  return FALSE;
+}
@@ -49,6 +49,24 @@ struct _GimpWarpTool
   GeglNode           *graph;         /* Top level GeglNode */
   GeglNode           *render_node;   /* Node to render the transformation */
 
+  GeglBuffer         *proxy_buffer;      /* Low resolution coords for preview */
+  GeglBuffer         *proxy_base_buffer; /* Proxy coords of finished strokes */
+  gdouble             proxy_scale;       /* Proxy size relative to layer */
+
+  GeglNode           *preview_graph;       /* Graph used while stroking */
+  GeglNode           *preview_coords_node; /* Source of the proxy coords */
+  GeglNode           *preview_scale_node;  /* Upscales the proxy coords */
+  GeglNode           *preview_factor_node; /* Rescales the displacements */
+  GeglNode           *preview_render_node; /* Renders the preview */
+
+  GThread            *proxy_thread;  /* Computes strokes on the proxy */
+  GMutex              proxy_mutex;
+  GCond               proxy_cond;
+  GQueue             *proxy_jobs;
+  gboolean            proxy_quit;
+  GeglRectangle       proxy_dirty;   /* Area to update once jobs finish */
+  guint               proxy_idle_id;
+
   GeglPath           *current_stroke;
   guint               stroke_timer;
 
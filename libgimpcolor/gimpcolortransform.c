@@ -58,6 +58,17 @@
  **/
 
 
+/*  the number of grid points per axis of the 3D LUT  */
+#define LUT_SIZE 33
+
+/*  buffers smaller than this are processed on the calling thread  */
+#define MIN_PARALLEL_PIXELS (512 * 512)
+#define MAX_THREADS         64
+
+/*  GimpColorTransformFlags that are not lcms flags  */
+#define GIMP_COLOR_TRANSFORM_FLAGS_PRIVATE (GIMP_COLOR_TRANSFORM_FLAGS_LUT)
+
+
 enum
 {
   PROGRESS,
@@ -74,10 +85,47 @@ struct _GimpColorTransformPrivate
   const Babl       *dest_format;
 
   cmsHTRANSFORM     transform;
+
+  /*  LUT_SIZE^3 "R'G'B'A float" samples of the transform, indexed by
+   *  "R'G'B'A float" source pixels, red varying fastest
+   */
+  const Babl       *lut_format;
+  gfloat           *lut;
 };
 
 
-static void   gimp_color_transform_finalize (GObject *object);
+typedef struct
+{
+  GimpColorTransform *transform;
+  GeglBuffer         *src_buffer;
+  GeglRectangle       src_rect;
+  GeglBuffer         *dest_buffer;
+  GeglRectangle       dest_rect;
+  volatile gint      *done_pixels;
+  gint                total_pixels;
+} ProcessRectData;
+
+
+static void   gimp_color_transform_finalize     (GObject                   *object);
+
+static void   gimp_color_transform_make_lut     (GimpColorTransform        *transform,
+                                                 GimpColorProfile          *src_profile,
+                                                 GimpColorProfile          *dest_profile,
+                                                 GimpColorTransformFlags    flags);
+static void   gimp_color_transform_process_lut  (GimpColorTransformPrivate *priv,
+                                                 const gfloat              *src,
+                                                 gfloat                    *dest,
+                                                 gsize                      length);
+static void   gimp_color_transform_process_rect (GimpColorTransform        *transform,
+                                                 GeglBuffer                *src_buffer,
+                                                 const GeglRectangle       *src_rect,
+                                                 GeglBuffer                *dest_buffer,
+                                                 const GeglRectangle       *dest_rect,
+                                                 volatile gint             *done_pixels,
+                                                 gint                       total_pixels,
+                                                 gboolean                   emit_progress);
+static gpointer gimp_color_transform_process_thread
+                                                (gpointer                   user_data);
 
 
 G_DEFINE_TYPE (GimpColorTransform, gimp_color_transform,
@@ -164,6 +212,12 @@ gimp_color_transform_finalize (GObject *object)
       transform->priv->transform = NULL;
     }
 
+  if (transform->priv->lut)
+    {
+      gegl_free (transform->priv->lut);
+      transform->priv->lut = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -179,6 +233,13 @@ gimp_color_transform_finalize (GObject *object)
  *
  * This function creates an color transform.
  *
+ * If @flags contains %GIMP_COLOR_TRANSFORM_FLAGS_LUT and both profiles
+ * are RGB profiles, the transform is baked into a 3D lookup table
+ * which is used instead of lcms for pixels that are not 8-bit, at
+ * the cost of some precision. A new transform, and thus a new lookup
+ * table, has to be created when the profiles or the rendering intent
+ * change.
+ *
  * Return value: the #GimpColorTransform, or %NULL if no transform is needed
  *               to convert between pixels of @src_profile and @dest_profile.
  *
@@ -224,7 +285,8 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
   priv->transform = cmsCreateTransform (src_lcms,  lcms_src_format,
                                         dest_lcms, lcms_dest_format,
                                         rendering_intent,
-                                        flags);
+                                        flags &
+                                        ~GIMP_COLOR_TRANSFORM_FLAGS_PRIVATE);
 
   if (lcms_last_error)
     {
@@ -242,6 +304,11 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
       g_object_unref (transform);
       transform = NULL;
     }
+  else if (flags & GIMP_COLOR_TRANSFORM_FLAGS_LUT)
+    {
+      gimp_color_transform_make_lut (transform,
+                                     src_profile, dest_profile, flags);
+    }
 
   return transform;
 }
@@ -259,6 +326,8 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
  *
  * This function creates a simulation / proofing color transform.
  *
+ * See gimp_color_transform_new() for %GIMP_COLOR_TRANSFORM_FLAGS_LUT.
+ *
  * Return value: the #GimpColorTransform, or %NULL.
  *
  * Since: 2.10
@@ -307,7 +376,9 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
                                                 proof_lcms,
                                                 proof_intent,
                                                 display_intent,
-                                                flags | cmsFLAGS_SOFTPROOFING);
+                                                (flags |
+                                                 cmsFLAGS_SOFTPROOFING) &
+                                                ~GIMP_COLOR_TRANSFORM_FLAGS_PRIVATE);
 
   if (lcms_last_error)
     {
@@ -325,6 +396,11 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
       g_object_unref (transform);
       transform = NULL;
     }
+  else if (flags & GIMP_COLOR_TRANSFORM_FLAGS_LUT)
+    {
+      gimp_color_transform_make_lut (transform,
+                                     src_profile, dest_profile, flags);
+    }
 
   return transform;
 }
@@ -362,6 +438,23 @@ gimp_color_transform_process_pixels (GimpColorTransform *transform,
 
   priv = transform->priv;
 
+  if (priv->lut)
+    {
+      gfloat *buf = g_new (gfloat, length * 4);
+
+      babl_process (babl_fish (src_format, priv->lut_format),
+                    src_pixels, buf, length);
+
+      gimp_color_transform_process_lut (priv, buf, buf, length);
+
+      babl_process (babl_fish (priv->lut_format, dest_format),
+                    buf, dest_pixels, length);
+
+      g_free (buf);
+
+      return;
+    }
+
   if (src_format != priv->src_format)
     {
       src = g_malloc (length * babl_format_get_bytes_per_pixel (priv->src_format));
@@ -426,79 +519,96 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
                                      GeglBuffer          *dest_buffer,
                                      const GeglRectangle *dest_rect)
 {
-  GimpColorTransformPrivate *priv;
-  GeglBufferIterator        *iter;
-  gint                       total_pixels;
-  gint                       done_pixels = 0;
+  GeglRectangle  src_area;
+  GeglRectangle  dest_area;
+  gint           total_pixels;
+  volatile gint  done_pixels = 0;
+  gint           n_threads;
 
   g_return_if_fail (GIMP_IS_COLOR_TRANSFORM (transform));
   g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
   g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
 
-  priv = transform->priv;
-
-  if (src_rect)
-    {
-      total_pixels = src_rect->width * src_rect->height;
-    }
-  else
-    {
-      total_pixels = (gegl_buffer_get_width  (src_buffer) *
-                      gegl_buffer_get_height (src_buffer));
-    }
-
-  if (src_buffer != dest_buffer)
-    {
-      const Babl *fish = NULL;
-
-      if (babl_format_has_alpha (priv->dest_format))
-        fish = babl_fish (priv->src_format,
-                          priv->dest_format);
-
-      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                       priv->src_format,
-                                       GEGL_ACCESS_READ,
-                                       GEGL_ABYSS_NONE);
+  src_area  = src_rect  ? *src_rect  : *gegl_buffer_get_extent (src_buffer);
+  dest_area = dest_rect ? *dest_rect : *gegl_buffer_get_extent (dest_buffer);
 
-      gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                                priv->dest_format,
-                                GEGL_ACCESS_WRITE,
-                                GEGL_ABYSS_NONE);
+  total_pixels = src_area.width * src_area.height;
 
-      while (gegl_buffer_iterator_next (iter))
-        {
-          /* make sure the alpha channel is copied too, lcms doesn't copy it */
-          if (fish)
-            babl_process (fish, iter->data[0], iter->data[1], iter->length);
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
 
-          cmsDoTransform (priv->transform,
-                          iter->data[0], iter->data[1], iter->length);
+  if (total_pixels < MIN_PARALLEL_PIXELS)
+    n_threads = 1;
 
-          done_pixels += iter->roi[0].width * iter->roi[0].height;
+  n_threads = CLAMP (n_threads, 1, MAX_THREADS);
 
-          g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
-                         (gdouble) done_pixels /
-                         (gdouble) total_pixels);
-        }
+  if (n_threads == 1)
+    {
+      gimp_color_transform_process_rect (transform,
+                                         src_buffer,  &src_area,
+                                         dest_buffer, &dest_area,
+                                         &done_pixels, total_pixels,
+                                         TRUE);
     }
   else
     {
-      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                       priv->src_format,
-                                       GEGL_ACCESS_READWRITE,
-                                       GEGL_ABYSS_NONE);
-
-      while (gegl_buffer_iterator_next (iter))
+      ProcessRectData  data[MAX_THREADS];
+      GThread         *threads[MAX_THREADS];
+      gint             tile_height;
+      gint             band_height;
+      gint             y;
+      gint             i;
+
+      /*  split the area into bands of whole tile rows, lcms transforms
+       *  can be used from several threads at once
+       */
+      g_object_get (src_buffer,
+                    "tile-height", &tile_height,
+                    NULL);
+
+      tile_height = MAX (tile_height, 1);
+
+      band_height = (src_area.height + n_threads - 1) / n_threads;
+      band_height = ((band_height + tile_height - 1) / tile_height) *
+                    tile_height;
+
+      for (i = 0, y = 0; i < n_threads && y < src_area.height; i++)
         {
-          cmsDoTransform (priv->transform,
-                          iter->data[0], iter->data[0], iter->length);
+          gint height = MIN (band_height, src_area.height - y);
+
+          data[i].transform    = transform;
+          data[i].src_buffer   = src_buffer;
+          data[i].src_rect     = src_area;
+          data[i].dest_buffer  = dest_buffer;
+          data[i].dest_rect    = dest_area;
+          data[i].done_pixels  = &done_pixels;
+          data[i].total_pixels = total_pixels;
+
+          data[i].src_rect.y       += y;
+          data[i].src_rect.height   = height;
+          data[i].dest_rect.y      += y;
+          data[i].dest_rect.height  = height;
+
+          y += height;
+        }
 
-          done_pixels += iter->roi[0].width * iter->roi[0].height;
+      n_threads = i;
 
-          g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
-                         (gdouble) done_pixels /
-                         (gdouble) total_pixels);
-        }
+      for (i = 1; i < n_threads; i++)
+        threads[i] = g_thread_new ("color-transform",
+                                   gimp_color_transform_process_thread,
+                                   &data[i]);
+
+      /*  process the first band here, it also emits "progress"  */
+      gimp_color_transform_process_rect (transform,
+                                         src_buffer,  &data[0].src_rect,
+                                         dest_buffer, &data[0].dest_rect,
+                                         &done_pixels, total_pixels,
+                                         TRUE);
+
+      for (i = 1; i < n_threads; i++)
+        g_thread_join (threads[i]);
     }
 
   g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
@@ -556,3 +666,296 @@ gimp_color_transform_can_gegl_copy (GimpColorProfile *src_profile,
 
   return FALSE;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_color_transform_process_rect (GimpColorTransform  *transform,
+                                   GeglBuffer          *src_buffer,
+                                   const GeglRectangle *src_rect,
+                                   GeglBuffer          *dest_buffer,
+                                   const GeglRectangle *dest_rect,
+                                   volatile gint       *done_pixels,
+                                   gint                 total_pixels,
+                                   gboolean             emit_progress)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+  GeglBufferIterator        *iter;
+
+  if (priv->lut)
+    {
+      gint dest_index = 0;
+
+      if (src_buffer != dest_buffer)
+        {
+          iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
+                                           priv->lut_format,
+                                           GEGL_ACCESS_READ,
+                                           GEGL_ABYSS_NONE);
+
+          dest_index = gegl_buffer_iterator_add (iter, dest_buffer,
+                                                 dest_rect, 0,
+                                                 priv->lut_format,
+                                                 GEGL_ACCESS_WRITE,
+                                                 GEGL_ABYSS_NONE);
+        }
+      else
+        {
+          iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
+                                           priv->lut_format,
+                                           GEGL_ACCESS_READWRITE,
+                                           GEGL_ABYSS_NONE);
+        }
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          gimp_color_transform_process_lut (priv,
+                                            iter->data[0],
+                                            iter->data[dest_index],
+                                            iter->length);
+
+          g_atomic_int_add (done_pixels,
+                            iter->roi[0].width * iter->roi[0].height);
+
+          if (emit_progress)
+            g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
+                           (gdouble) g_atomic_int_get (done_pixels) /
+                           (gdouble) total_pixels);
+        }
+    }
+  else if (src_buffer != dest_buffer)
+    {
+      const Babl *fish = NULL;
+
+      if (babl_format_has_alpha (priv->dest_format))
+        fish = babl_fish (priv->src_format,
+                          priv->dest_format);
+
+      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
+                                       priv->src_format,
+                                       GEGL_ACCESS_READ,
+                                       GEGL_ABYSS_NONE);
+
+      gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
+                                priv->dest_format,
+                                GEGL_ACCESS_WRITE,
+                                GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          /* make sure the alpha channel is copied too, lcms doesn't copy it */
+          if (fish)
+            babl_process (fish, iter->data[0], iter->data[1], iter->length);
+
+          cmsDoTransform (priv->transform,
+                          iter->data[0], iter->data[1], iter->length);
+
+          g_atomic_int_add (done_pixels,
+                            iter->roi[0].width * iter->roi[0].height);
+
+          if (emit_progress)
+            g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
+                           (gdouble) g_atomic_int_get (done_pixels) /
+                           (gdouble) total_pixels);
+        }
+    }
+  else
+    {
+      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
+                                       priv->src_format,
+                                       GEGL_ACCESS_READWRITE,
+                                       GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          cmsDoTransform (priv->transform,
+                          iter->data[0], iter->data[0], iter->length);
+
+          g_atomic_int_add (done_pixels,
+                            iter->roi[0].width * iter->roi[0].height);
+
+          if (emit_progress)
+            g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
+                           (gdouble) g_atomic_int_get (done_pixels) /
+                           (gdouble) total_pixels);
+        }
+    }
+}
+
+static gpointer
+gimp_color_transform_process_thread (gpointer user_data)
+{
+  ProcessRectData *data = user_data;
+
+  gimp_color_transform_process_rect (data->transform,
+                                     data->src_buffer,  &data->src_rect,
+                                     data->dest_buffer, &data->dest_rect,
+                                     data->done_pixels, data->total_pixels,
+                                     FALSE);
+
+  return NULL;
+}
+
+static void
+gimp_color_transform_make_lut (GimpColorTransform      *transform,
+                               GimpColorProfile        *src_profile,
+                               GimpColorProfile        *dest_profile,
+                               GimpColorTransformFlags  flags)
+{
+  GimpColorTransformPrivate *priv     = transform->priv;
+  const gint                 n_points = LUT_SIZE * LUT_SIZE * LUT_SIZE;
+  gfloat                    *grid;
+  gpointer                   src;
+  gpointer                   dest;
+  gfloat                    *p;
+  gint                       r, g, b;
+
+  /*  only RGB to RGB transforms are indexed by three components, and
+   *  lcms' own precalculated 8-bit transforms are at least as fast
+   */
+  if (! gimp_color_profile_is_rgb (src_profile)  ||
+      ! gimp_color_profile_is_rgb (dest_profile) ||
+      (babl_format_get_n_components (priv->src_format) -
+       babl_format_has_alpha (priv->src_format)) != 3 ||
+      babl_format_get_type (priv->src_format, 0) == babl_type ("u8"))
+    {
+      return;
+    }
+
+  priv->lut_format = babl_format ("R'G'B'A float");
+
+  grid = g_new (gfloat, n_points * 4);
+
+  for (b = 0, p = grid; b < LUT_SIZE; b++)
+    for (g = 0; g < LUT_SIZE; g++)
+      for (r = 0; r < LUT_SIZE; r++)
+        {
+          *p++ = (gfloat) r / (LUT_SIZE - 1);
+          *p++ = (gfloat) g / (LUT_SIZE - 1);
+          *p++ = (gfloat) b / (LUT_SIZE - 1);
+          *p++ = 1.0;
+        }
+
+  src  = g_malloc (n_points *
+                   babl_format_get_bytes_per_pixel (priv->src_format));
+  dest = g_malloc0 (n_points *
+                    babl_format_get_bytes_per_pixel (priv->dest_format));
+
+  babl_process (babl_fish (priv->lut_format, priv->src_format),
+                grid, src, n_points);
+
+  cmsDoTransform (priv->transform, src, dest, n_points);
+
+  /*  16-byte aligned, one 4-float vector per grid point  */
+  priv->lut = gegl_malloc (n_points * 4 * sizeof (gfloat));
+
+  babl_process (babl_fish (priv->dest_format, priv->lut_format),
+                dest, priv->lut, n_points);
+
+  g_free (dest);
+  g_free (src);
+  g_free (grid);
+}
+
+/*  evaluates the LUT with tetrahedral interpolation, @src and @dest
+ *  are "R'G'B'A float" and may be the same, alpha is copied
+ */
+static void
+gimp_color_transform_process_lut (GimpColorTransformPrivate *priv,
+                                  const gfloat              *src,
+                                  gfloat                    *dest,
+                                  gsize                      length)
+{
+  const gint    dr  = 4;
+  const gint    dg  = 4 * LUT_SIZE;
+  const gint    db  = 4 * LUT_SIZE * LUT_SIZE;
+  const gfloat *lut = priv->lut;
+
+  while (length--)
+    {
+      gfloat        fr = CLAMP (src[0], 0.0f, 1.0f) * (LUT_SIZE - 1);
+      gfloat        fg = CLAMP (src[1], 0.0f, 1.0f) * (LUT_SIZE - 1);
+      gfloat        fb = CLAMP (src[2], 0.0f, 1.0f) * (LUT_SIZE - 1);
+      gint          ir = MIN ((gint) fr, LUT_SIZE - 2);
+      gint          ig = MIN ((gint) fg, LUT_SIZE - 2);
+      gint          ib = MIN ((gint) fb, LUT_SIZE - 2);
+      const gfloat *c0;
+      const gfloat *c1;
+      const gfloat *c2;
+      const gfloat *c3;
+      gfloat        w1, w2, w3;
+      gfloat        alpha = src[3];
+
+      fr -= ir;
+      fg -= ig;
+      fb -= ib;
+
+      c0 = lut + ir * dr + ig * dg + ib * db;
+      c3 = c0 + dr + dg + db;
+
+      /*  pick the tetrahedron containing the point, its vertices are
+       *  reached by stepping along the axes in order of decreasing
+       *  fractional part
+       */
+      if (fr > fg)
+        {
+          if (fg > fb)
+            {
+              c1 = c0 + dr; c2 = c1 + dg; w1 = fr; w2 = fg; w3 = fb;
+            }
+          else if (fr > fb)
+            {
+              c1 = c0 + dr; c2 = c1 + db; w1 = fr; w2 = fb; w3 = fg;
+            }
+          else
+            {
+              c1 = c0 + db; c2 = c1 + dr; w1 = fb; w2 = fr; w3 = fg;
+            }
+        }
+      else
+        {
+          if (fb > fg)
+            {
+              c1 = c0 + db; c2 = c1 + dg; w1 = fb; w2 = fg; w3 = fr;
+            }
+          else if (fb > fr)
+            {
+              c1 = c0 + dg; c2 = c1 + db; w1 = fg; w2 = fb; w3 = fr;
+            }
+          else
+            {
+              c1 = c0 + dg; c2 = c1 + dr; w1 = fg; w2 = fr; w3 = fb;
+            }
+        }
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+      {
+        typedef float v4sf __attribute__((vector_size(16)));
+        union { v4sf v; float f[4]; } out;
+        v4sf v0  = *(const v4sf *) c0;
+        v4sf v1  = *(const v4sf *) c1;
+        v4sf v2  = *(const v4sf *) c2;
+        v4sf v3  = *(const v4sf *) c3;
+        v4sf vw1 = { w1, w1, w1, w1 };
+        v4sf vw2 = { w2, w2, w2, w2 };
+        v4sf vw3 = { w3, w3, w3, w3 };
+
+        out.v = v0 + vw1 * (v1 - v0) + vw2 * (v2 - v1) + vw3 * (v3 - v2);
+
+        dest[0] = out.f[0];
+        dest[1] = out.f[1];
+        dest[2] = out.f[2];
+      }
+#else
+      dest[0] = c0[0] + w1 * (c1[0] - c0[0]) + w2 * (c2[0] - c1[0]) + w3 * (c3[0] - c2[0]);
+      dest[1] = c0[1] + w1 * (c1[1] - c0[1]) + w2 * (c2[1] - c1[1]) + w3 * (c3[1] - c2[1]);
+      dest[2] = c0[2] + w1 * (c1[2] - c0[2]) + w2 * (c2[2] - c1[2]) + w3 * (c3[2] - c2[2]);
+#endif
+
+      dest[3] = alpha;
+
+      src  += 4;
+      dest += 4;
+    }
+}
@@ -37,6 +37,7 @@ typedef enum
   GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE               = 0x0100,
   GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK              = 0x1000,
   GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION = 0x2000,
+  GIMP_COLOR_TRANSFORM_FLAGS_LUT                      = 0x40000000
 } GimpColorTransformFlags;
 
 
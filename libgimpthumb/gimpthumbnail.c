@@ -810,6 +810,7 @@ gimp_thumbnail_save (GimpThumbnail  *thumbnail,
                      const gchar    *software,
                      GError        **error)
 {
+  static gint   tmp_count = 0;
   const gchar  *keys[12];
   gchar        *values[12];
   gchar        *basename;
@@ -879,8 +880,10 @@ gimp_thumbnail_save (GimpThumbnail  *thumbnail,
   basename = g_path_get_basename (filename);
   dirname  = g_path_get_dirname (filename);
 
-  tmpname = g_strdup_printf ("%s%cgimp-thumb-%d-%.8s",
-                             dirname, G_DIR_SEPARATOR, getpid (), basename);
+  /*  thumbnails may be saved from several threads at once  */
+  tmpname = g_strdup_printf ("%s%cgimp-thumb-%d-%d-%.8s",
+                             dirname, G_DIR_SEPARATOR, getpid (),
+                             g_atomic_int_add (&tmp_count, 1), basename);
 
   g_free (dirname);
   g_free (basename);
@@ -799,7 +799,9 @@ gimp_widget_get_color_transform (GtkWidget        *widget,
       if (gimp_color_config_get_simulation_bpc (config))
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION;
 
-      if (! gimp_color_config_get_simulation_optimize (config))
+      if (gimp_color_config_get_simulation_optimize (config))
+        flags |= GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+      else
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE;
 
       if (gimp_color_config_get_simulation_gamut_check (config))
@@ -835,7 +837,9 @@ gimp_widget_get_color_transform (GtkWidget        *widget,
       if (gimp_color_config_get_display_bpc (config))
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION;
 
-      if (! gimp_color_config_get_display_optimize (config))
+      if (gimp_color_config_get_display_optimize (config))
+        flags |= GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+      else
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE;
 
       cache->transform =
@@ -69,6 +69,7 @@ typedef struct
   gboolean always_use_default_delay;
   gboolean always_use_default_dispose;
   gboolean as_animation;
+  gboolean crop_frames;
 } GIFSaveVals;
 
 
@@ -99,7 +100,6 @@ static void     comment_entry_callback (GtkTextBuffer    *buffer);
 
 static gboolean  comment_was_edited = FALSE;
 static gchar    *globalcomment      = NULL;
-static gint      Interlace; /* For compression code */
 
 
 const GimpPlugInInfo PLUG_IN_INFO =
@@ -119,7 +119,8 @@ static GIFSaveVals gsvals =
   0,       /* default_dispose = "don't care"       */
   FALSE,   /* don't always use default_delay       */
   FALSE,   /* don't always use default_dispose     */
-  FALSE    /* as_animation                         */
+  FALSE,   /* as_animation                         */
+  FALSE    /* crop_frames                          */
 };
 
 
@@ -382,13 +383,6 @@ run (const gchar      *name,
 
 #define MAXCOLORS 256
 
-/*
- * Pointer to function returning an int
- */
-typedef gint (* ifunptr) (gint x,
-                          gint y);
-
-
 static gint find_unused_ia_color           (const guchar  *pixels,
                                             gint           numpixels,
                                             gint           num_indices,
@@ -400,10 +394,15 @@ static void special_flatten_indexed_alpha  (guchar        *pixels,
 
 static gint colors_to_bpp                  (gint           colors);
 static gint bpp_to_colors                  (gint           bpp);
-static gint get_pixel                      (gint           x,
-                                            gint           y);
-static gint gif_next_pixel                 (ifunptr        getpixel);
-static void bump_pixel                     (void);
+
+static gboolean find_changed_area          (const guchar  *prev,
+                                            const guchar  *pixels,
+                                            gint           width,
+                                            gint           height,
+                                            gint          *x,
+                                            gint          *y,
+                                            gint          *area_width,
+                                            gint          *area_height);
 
 static gboolean gif_encode_header              (GOutputStream  *output,
                                                 gboolean        gif89,
@@ -414,24 +413,20 @@ static gboolean gif_encode_header              (GOutputStream  *output,
                                                 gint           *red,
                                                 gint           *green,
                                                 gint           *blue,
-                                                ifunptr         get_pixel,
                                                 GError        **error);
 static gboolean gif_encode_graphic_control_ext (GOutputStream  *output,
                                                 gint            disposal,
                                                 gint            delay89,
                                                 gint            n_frames,
-                                                gint            width,
-                                                gint            height,
                                                 gint            transparent,
-                                                gint            bpp,
-                                                ifunptr         get_pixel,
                                                 GError        **error);
 static gboolean gif_encode_image_data          (GOutputStream  *output,
                                                 gint            width,
                                                 gint            height,
                                                 gint            interlace,
                                                 gint            bpp,
-                                                ifunptr         get_pixel,
+                                                const guchar   *pixels,
+                                                gint            rowstride,
                                                 gint            offset_x,
                                                 gint            offset_y,
                                                 GError        **error);
@@ -444,26 +439,16 @@ static gboolean gif_encode_comment_ext         (GOutputStream  *output,
                                                 const gchar    *comment,
                                                 GError        **error);
 
-static gint     rowstride;
-static guchar  *pixels;
 static gint     cur_progress;
 static gint     max_progress;
 
 static gboolean compress        (GOutputStream *output,
                                  gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean no_compress     (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean rle_compress    (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean normal_compress (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
+                                 const guchar  *pixels,
+                                 gint           width,
+                                 gint           height,
+                                 gint           rowstride,
+                                 gboolean       interlace,
                                  GError        **error);
 
 static gboolean put_byte        (GOutputStream  *output,
@@ -480,7 +465,7 @@ static gboolean output_code     (GOutputStream  *output,
                                  GError        **error);
 static gboolean cl_block        (GOutputStream  *output,
                                  GError        **error);
-static void     cl_hash         (glong           hsize);
+static void     cl_table        (void);
 
 static void     char_init       (void);
 static gboolean char_out        (GOutputStream  *output,
@@ -720,6 +705,8 @@ save_image (GFile   *file,
   GimpImageType  drawable_type;
   const Babl    *format = NULL;
   GOutputStream *output;
+  guchar        *pixels;
+  guchar        *prev_pixels = NULL;
   gint           Red[MAXCOLORS];
   gint           Green[MAXCOLORS];
   gint           Blue[MAXCOLORS];
@@ -732,6 +719,14 @@ save_image (GFile   *file,
   gint           i;
   gint           transparent;
   gint           offset_x, offset_y;
+  gint           prev_offset_x    = 0;
+  gint           prev_offset_y    = 0;
+  guint          prev_cols        = 0;
+  guint          prev_rows        = 0;
+  gint           prev_transparent = -1;
+  gint           prev_disposal    = DISPOSE_UNSPECIFIED;
+  gint           frame_x, frame_y;
+  gint           frame_width, frame_height;
 
   gint32        *layers;
   gint           nlayers;
@@ -739,7 +734,7 @@ save_image (GFile   *file,
   gboolean       is_gif89 = FALSE;
 
   gint           Delay89;
-  gint           Disposal;
+  gint           Disposal = DISPOSE_UNSPECIFIED;
   gchar         *layer_name;
 
   GimpRGB        background;
@@ -913,9 +908,8 @@ save_image (GFile   *file,
 
   cols = gimp_image_width (image_ID);
   rows = gimp_image_height (image_ID);
-  Interlace = gsvals.interlace;
   if (! gif_encode_header (output, is_gif89, cols, rows, bgindex,
-                           BitsPerPixel, Red, Green, Blue, get_pixel,
+                           BitsPerPixel, Red, Green, Blue,
                            error))
     return FALSE;
 
@@ -948,7 +942,6 @@ save_image (GFile   *file,
       gimp_drawable_offsets (layers[i], &offset_x, &offset_y);
       cols = gimp_drawable_width (layers[i]);
       rows = gimp_drawable_height (layers[i]);
-      rowstride = cols;
 
       pixels = g_new (guchar, (cols * rows *
                                (((drawable_type == GIMP_INDEXEDA_IMAGE) ||
@@ -1042,19 +1035,46 @@ save_image (GFile   *file,
 
           if (! gif_encode_graphic_control_ext (output,
                                                 Disposal, Delay89, nlayers,
-                                                cols, rows,
                                                 transparent,
-                                                useBPP,
-                                                get_pixel,
                                                 error))
             return FALSE;
         }
 
-      if (! gif_encode_image_data (output, cols, rows,
-                                   (rows > 4) ? gsvals.interlace : 0,
+      frame_x      = 0;
+      frame_y      = 0;
+      frame_width  = cols;
+      frame_height = rows;
+
+      /* If neither this frame nor the previous one gets replaced,
+       * the previous frame is still on screen where this one is
+       * drawn, so only the pixels that differ from it need to be
+       * encoded.  Identical pixels include transparent ones, which
+       * leave the canvas alone in both frames.
+       */
+      if (prev_pixels                       &&
+          prev_disposal    != DISPOSE_REPLACE &&
+          Disposal         != DISPOSE_REPLACE &&
+          prev_transparent == transparent     &&
+          prev_offset_x    == offset_x        &&
+          prev_offset_y    == offset_y        &&
+          prev_cols        == cols            &&
+          prev_rows        == rows)
+        {
+          /* an unchanged frame still needs a pixel to carry its delay */
+          if (! find_changed_area (prev_pixels, pixels, cols, rows,
+                                   &frame_x, &frame_y,
+                                   &frame_width, &frame_height))
+            {
+              frame_width  = 1;
+              frame_height = 1;
+            }
+        }
+
+      if (! gif_encode_image_data (output, frame_width, frame_height,
+                                   (frame_height > 4) ? gsvals.interlace : 0,
                                    useBPP,
-                                   get_pixel,
-                                   offset_x, offset_y,
+                                   pixels + frame_y * cols + frame_x, cols,
+                                   offset_x + frame_x, offset_y + frame_y,
                                    error))
         return FALSE;
 
@@ -1062,9 +1082,25 @@ save_image (GFile   *file,
 
       g_object_unref (buffer);
 
-      g_free (pixels);
+      if (gsvals.crop_frames && nlayers > 1)
+        {
+          g_free (prev_pixels);
+          prev_pixels = pixels;
+
+          prev_offset_x    = offset_x;
+          prev_offset_y    = offset_y;
+          prev_cols        = cols;
+          prev_rows        = rows;
+          prev_transparent = transparent;
+          prev_disposal    = Disposal;
+        }
+      else
+        {
+          g_free (pixels);
+        }
     }
 
+  g_free (prev_pixels);
   g_free (layers);
 
   if (! gif_encode_close (output, error))
@@ -1308,6 +1344,8 @@ save_dialog (gint32 image_ID)
   file_gif_toggle_button_init (builder, "use-default-dispose",
                                gsvals.always_use_default_dispose,
                                &gsvals.always_use_default_dispose);
+  file_gif_toggle_button_init (builder, "crop-frames",
+                               gsvals.crop_frames, &gsvals.crop_frames);
 
   frame  = GTK_WIDGET (gtk_builder_get_object (builder, "animation-frame"));
   toggle = GTK_WIDGET (gtk_builder_get_object (builder, "as-animation"));
@@ -1385,114 +1423,80 @@ bpp_to_colors (gint bpp)
 
 
 
-static gint
-get_pixel (gint x,
-           gint y)
-{
-  return *(pixels + (rowstride * (long) y) + (long) x);
-}
-
-
-/*****************************************************************************
- *
- * GIFENCODE.C    - GIF Image compression interface
- *
- * GIFEncode( FName, GHeight, GWidth, GInterlace, Background, Transparent,
- *            BitsPerPixel, Red, Green, Blue, get_pixel )
- *
- *****************************************************************************/
-
-static gint  Width, Height;
-static gint  curx, cury;
-static glong CountDown;
-static gint  Pass = 0;
-
 /*
- * Bump the 'curx' and 'cury' to point to the next pixel
+ * Find the bounding box of the pixels that differ between two frames
+ * of the same geometry.  Returns FALSE if the frames are identical.
  */
-static void
-bump_pixel (void)
+static gboolean
+find_changed_area (const guchar *prev,
+                   const guchar *pixels,
+                   gint          width,
+                   gint          height,
+                   gint         *x,
+                   gint         *y,
+                   gint         *area_width,
+                   gint         *area_height)
 {
-  /*
-   * Bump the current X position
-   */
-  curx++;
+  gint top, bottom;
+  gint left, right;
+  gint row;
 
-  /*
-   * If we are at the end of a scan line, set curx back to the beginning
-   * If we are interlaced, bump the cury to the appropriate spot,
-   * otherwise, just increment it.
-   */
-  if (curx == Width)
+  for (top = 0; top < height; top++)
     {
-      cur_progress++;
-
-      if ((cur_progress % 20) == 0)
-        gimp_progress_update ((gdouble) cur_progress / (gdouble) max_progress);
+      if (memcmp (prev + top * width, pixels + top * width, width))
+        break;
+    }
 
-      curx = 0;
+  if (top == height)
+    return FALSE;
 
-      if (! Interlace)
-        ++cury;
-      else
-        {
-          switch (Pass)
-            {
+  for (bottom = height - 1; bottom > top; bottom--)
+    {
+      if (memcmp (prev + bottom * width, pixels + bottom * width, width))
+        break;
+    }
 
-            case 0:
-              cury += 8;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 4;
-                }
-              break;
+  left  = width - 1;
+  right = 0;
 
-            case 1:
-              cury += 8;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 2;
-                }
-              break;
+  for (row = top; row <= bottom; row++)
+    {
+      const guchar *p = prev   + row * width;
+      const guchar *c = pixels + row * width;
+      gint          i;
 
-            case 2:
-              cury += 4;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 1;
-                }
-              break;
+      for (i = 0; i < left; i++)
+        {
+          if (p[i] != c[i])
+            break;
+        }
+      left = i;
 
-            case 3:
-              cury += 2;
-              break;
-            }
+      for (i = width - 1; i > right; i--)
+        {
+          if (p[i] != c[i])
+            break;
         }
+      right = i;
     }
-}
 
-/*
- * Return the next pixel from the image
- */
-static gint
-gif_next_pixel (ifunptr getpixel)
-{
-  gint r;
+  *x           = left;
+  *y           = top;
+  *area_width  = right - left + 1;
+  *area_height = bottom - top + 1;
 
-  if (CountDown == 0)
-    return EOF;
-
-  --CountDown;
-
-  r = (*getpixel) (curx, cury);
+  return TRUE;
+}
 
-  bump_pixel ();
 
-  return r;
-}
+/*****************************************************************************
+ *
+ * GIFENCODE.C    - GIF Image compression interface
+ *
+ * GIFEncode( FName, GHeight, GWidth, GInterlace, Background, Transparent,
+ *            BitsPerPixel, Red, Green, Blue, pixels )
+ *
+ *****************************************************************************/
 
 /* public */
 
@@ -1506,7 +1510,6 @@ gif_encode_header (GOutputStream *output,
                    gint           Red[],
                    gint           Green[],
                    gint           Blue[],
-                   ifunptr        get_pixel,
                    GError       **error)
 {
   gint B;
@@ -1517,26 +1520,11 @@ gif_encode_header (GOutputStream *output,
 
   ColorMapSize = 1 << BitsPerPixel;
 
-  RWidth = Width = GWidth;
-  RHeight = Height = GHeight;
+  RWidth = GWidth;
+  RHeight = GHeight;
 
   Resolution = BitsPerPixel;
 
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write the Magic header
    */
@@ -1603,31 +1591,9 @@ gif_encode_graphic_control_ext (GOutputStream *output,
                                 int            Disposal,
                                 int            Delay89,
                                 int            NumFramesInImage,
-                                int            GWidth,
-                                int            GHeight,
                                 int            Transparent,
-                                int            BitsPerPixel,
-                                ifunptr        get_pixel,
                                 GError       **error)
 {
-  Width = GWidth;
-  Height = GHeight;
-
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write out extension for transparent color index, if necessary.
    */
@@ -1677,7 +1643,8 @@ gif_encode_image_data (GOutputStream *output,
                        int            GHeight,
                        int            GInterlace,
                        int            BitsPerPixel,
-                       ifunptr        get_pixel,
+                       const guchar  *pixels,
+                       gint           rowstride,
                        gint           offset_x,
                        gint           offset_y,
                        GError       **error)
@@ -1685,23 +1652,9 @@ gif_encode_image_data (GOutputStream *output,
   gint LeftOfs, TopOfs;
   gint InitCodeSize;
 
-  Interlace = GInterlace;
-
-  Width   = GWidth;
-  Height  = GHeight;
   LeftOfs = (gint) offset_x;
   TopOfs  = (gint) offset_y;
 
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width * (long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
   /*
    * The initial code size
    */
@@ -1710,11 +1663,6 @@ gif_encode_image_data (GOutputStream *output,
   else
     InitCodeSize = BitsPerPixel;
 
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write an Image separator
    */
@@ -1727,14 +1675,14 @@ gif_encode_image_data (GOutputStream *output,
 
   if (! put_word (output, LeftOfs, error) ||
       ! put_word (output, TopOfs,  error) ||
-      ! put_word (output, Width,   error) ||
-      ! put_word (output, Height,  error))
+      ! put_word (output, GWidth,  error) ||
+      ! put_word (output, GHeight, error))
     return FALSE;
 
   /*
    * Write out whether or not the image is interlaced
    */
-  if (Interlace)
+  if (GInterlace)
     {
       if (! put_byte (output, 0x40, error))
         return FALSE;
@@ -1754,7 +1702,9 @@ gif_encode_image_data (GOutputStream *output,
   /*
    * Go and actually compress the data
    */
-  if (! compress (output, InitCodeSize + 1, get_pixel, error))
+  if (! compress (output, InitCodeSize + 1,
+                  pixels, GWidth, GHeight, rowstride, GInterlace,
+                  error))
     return FALSE;
 
   /*
@@ -1763,27 +1713,6 @@ gif_encode_image_data (GOutputStream *output,
   if (! put_byte (output, 0, error))
     return FALSE;
 
-#if 0
-  /***************************/
-  Interlace = GInterlace;
-  Width = GWidth;
-  Height = GHeight;
-  LeftOfs = TopOfs = 0;
-
-  CountDown = (long) Width *(long) Height;
-  Pass = 0;
-  /*
-   * The initial code size
-   */
-  if (BitsPerPixel <= 1)
-    InitCodeSize = 2;
-  else
-    InitCodeSize = BitsPerPixel;
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-#endif
 
   return TRUE;
 }
@@ -1893,8 +1822,6 @@ put_string (GOutputStream  *output,
 
 #define GIF_BITS   12
 
-#define HSIZE    5003                /* 80% occupancy */
-
 /*
  * GIF Image compression - modified 'compress'
  *
@@ -1919,15 +1846,15 @@ static gint maxmaxcode = (gint) 1 << GIF_BITS;        /* should NEVER generate t
 #define MAXCODE(Mn_bits)        (((gint) 1 << (Mn_bits)) - 1)
 #endif /*COMPATIBLE */
 
-static glong   htab[HSIZE];
-static gushort codetab[HSIZE];
-#define HashTabOf(i)       htab[i]
-#define CodeTabOf(i)    codetab[i]
-
-static const gint hsize = HSIZE; /* the original reason for this being
-                                    variable was "for dynamic table sizing",
-                                    but since it was never actually changed
-                                    I made it const   --Adam. */
+/* The string table is a trie: the code for the string made of the
+ * string with code 'prefix' followed by pixel 'c' lives at
+ * lzw_next[prefix << 8 | c], 0 meaning no such string (real string
+ * codes always start above EOFCode).  lzw_used remembers the entries
+ * that were filled so a table clear only touches those.
+ */
+static gushort lzw_next[(1 << GIF_BITS) << 8];
+static gint    lzw_used[1 << GIF_BITS];
+static gint    n_lzw_used = 0;
 
 static gint free_ent = 0;        /* first unused entry */
 
@@ -1937,24 +1864,15 @@ static gint free_ent = 0;        /* first unused entry */
  */
 static gint  clear_flg = 0;
 
-static gint  offset;
-static glong in_count  = 1;        /* length of input */
-static glong out_count = 0;        /* # of codes output (for debugging) */
-
 /*
- * compress stdin to stdout
+ * compress a block of indexed pixels
  *
- * Algorithm:  use open addressing double hashing (no chaining) on the
- * prefix code / next character combination.  We do a variant of Knuth's
- * algorithm D (vol. 3, sec. 6.4) along with G. Knott's relatively-prime
- * secondary probe.  Here, the modular division first probe is gives way
- * to a faster exclusive-or manipulation.  Also do block compression with
- * an adaptive reset, whereby the code table is cleared when the compression
- * ratio decreases, but after the table fills.  The variable-length output
- * codes are re-sized at this point, and a special CLEAR code is generated
- * for the decompressor.  Late addition:  construct the table according to
- * file size for noticeable speed improvement on small files.  Please direct
- * questions about this implementation to ames!jaw.
+ * Algorithm:  walk the rows of the pixel buffer in the order the GIF
+ * stores them (the four passes when interlaced), extending the current
+ * string through the trie for as long as it is in the table.  Also do
+ * block compression, whereby the code table is cleared after it fills.
+ * The variable-length output codes are re-sized at this point, and a
+ * special CLEAR code is generated for the decompressor.
  */
 
 static gint g_init_bits;
@@ -1978,123 +1896,18 @@ static gulong masks[] =
 static gboolean
 compress (GOutputStream  *output,
           gint            init_bits,
-          ifunptr         ReadValue,
+          const guchar   *pixels,
+          gint            width,
+          gint            height,
+          gint            rowstride,
+          gboolean        interlace,
           GError        **error)
 {
-  if (FALSE)
-    return no_compress (output, init_bits, ReadValue, error);
-  else if (FALSE)
-    return rle_compress (output, init_bits, ReadValue, error);
-  else
-    return normal_compress (output, init_bits, ReadValue, error);
-}
-
-static gboolean
-no_compress (GOutputStream  *output,
-             gint            init_bits,
-             ifunptr         ReadValue,
-             GError        **error)
-{
-  glong fcode;
-  gint  i /* = 0 */ ;
-  gint  c;
-  gint  ent;
-  gint  hsize_reg;
-  gint  hshift;
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   */
-  g_init_bits = init_bits;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-  char_init();
-
-  ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
-
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
-
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
-
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
-
-      ++out_count;
-      ent = c;
-
-      if (free_ent < maxmaxcode)
-        {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        {
-          if (! cl_block (output, error))
-            return FALSE;
-        }
-    }
-
-  /*
-   * Put out the final code.
-   */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
-
-  ++out_count;
-
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
-
-  return TRUE;
-}
-
-static gboolean
-rle_compress (GOutputStream  *output,
-              gint            init_bits,
-              ifunptr         ReadValue,
-              GError        **error)
-{
-  glong fcode;
-  gint  i /* = 0 */ ;
-  gint  c, last;
-  gint  ent;
-  gint  disp;
-  gint  hsize_reg;
-  gint  hshift;
+  static const gint pass_start[] = { 0, 4, 2, 1 };
+  static const gint pass_step[]  = { 8, 8, 4, 2 };
+  gint              n_passes     = interlace ? 4 : 1;
+  gint              pass;
+  gint              ent;
 
   /*
    * Set up the globals:  g_init_bits - initial number of bits
@@ -2107,199 +1920,67 @@ rle_compress (GOutputStream  *output,
   /*
    * Set up the necessary values
    */
-  offset = 0;
-  out_count = 0;
   clear_flg = 0;
-  in_count = 1;
 
   ClearCode = (1 << (init_bits - 1));
   EOFCode = ClearCode + 1;
   free_ent = ClearCode + 2;
 
-
-  /* Had some problems here... should be okay now.  --Adam */
   n_bits = g_init_bits;
   maxcode = MAXCODE (n_bits);
 
-
   char_init ();
-
-  last = ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
+  cl_table ();
 
   if (! output_code (output, (gint) ClearCode, error))
     return FALSE;
 
+  /* the first row is always row 0, whether interlaced or not */
+  ent = pixels[0];
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
+  for (pass = 0; pass < n_passes; pass++)
     {
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
-
-
-      if (last == c) {
-        if (HashTabOf (i) == fcode)
-          {
-            ent = CodeTabOf (i);
-            continue;
-          }
-        else if ((long) HashTabOf (i) < 0)        /* empty slot */
-          goto nomatch;
-        disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
-        if (i == 0)
-          disp = 1;
-      probe:
-        if ((i -= disp) < 0)
-          i += hsize_reg;
-
-        if (HashTabOf (i) == fcode)
-          {
-            ent = CodeTabOf (i);
-            continue;
-          }
-        if ((long) HashTabOf (i) > 0)
-          goto probe;
-        }
-    nomatch:
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+      gint step = interlace ? pass_step[pass] : 1;
+      gint y;
 
-      ++out_count;
-      last = ent = c;
-      if (free_ent < maxmaxcode)
-        {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
+      for (y = interlace ? pass_start[pass] : 0; y < height; y += step)
         {
-          if (! cl_block (output, error))
-            return FALSE;
-        }
-    }
-
-  /*
-   * Put out the final code.
-   */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
-
-  ++out_count;
-
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
-
-  return TRUE;
-}
-
-static gboolean
-normal_compress (GOutputStream  *output,
-                 gint            init_bits,
-                 ifunptr         ReadValue,
-                 GError        **error)
-{
-  glong fcode;
-  gint  i /* = 0 */ ;
-  gint  c;
-  gint  ent;
-  gint  disp;
-  gint  hsize_reg;
-  gint  hshift;
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   */
-  g_init_bits = init_bits;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
+          const guchar *row = pixels + (gsize) y * rowstride;
+          gint          x;
 
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-  char_init();
-
-  ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
+          for (x = (y == 0) ? 1 : 0; x < width; x++)
+            {
+              gint c = row[x];
+              gint i = (ent << 8) | c;
 
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
+              if (lzw_next[i])
+                {
+                  ent = lzw_next[i];
+                  continue;
+                }
 
+              if (! output_code (output, (gint) ent, error))
+                return FALSE;
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {
-      ++in_count;
+              ent = c;
 
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
+              if (free_ent < maxmaxcode)
+                {
+                  lzw_next[i] = free_ent++;        /* code -> table */
+                  lzw_used[n_lzw_used++] = i;
+                }
+              else
+                {
+                  if (! cl_block (output, error))
+                    return FALSE;
+                }
+            }
 
-      if (HashTabOf (i) == fcode)
-        {
-          ent = CodeTabOf (i);
-          continue;
-        }
-      else if ((long) HashTabOf (i) < 0)        /* empty slot */
-        goto nomatch;
-      disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
-      if (i == 0)
-        disp = 1;
-    probe:
-      if ((i -= disp) < 0)
-        i += hsize_reg;
-
-      if (HashTabOf (i) == fcode)
-        {
-          ent = CodeTabOf (i);
-          continue;
-        }
-      if ((long) HashTabOf (i) > 0)
-        goto probe;
-    nomatch:
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+          cur_progress++;
 
-      ++out_count;
-      ent = c;
-      if (free_ent < maxmaxcode)
-        {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        {
-          if (! cl_block (output, error))
-            return FALSE;
+          if ((cur_progress % 20) == 0)
+            gimp_progress_update ((gdouble) cur_progress /
+                                  (gdouble) max_progress);
         }
     }
 
@@ -2309,8 +1990,6 @@ normal_compress (GOutputStream  *output,
   if (! output_code (output, (gint) ent, error))
     return FALSE;
 
-  ++out_count;
-
   if (! output_code (output, (gint) EOFCode, error))
     return FALSE;
 
@@ -2401,13 +2080,13 @@ output_code (GOutputStream  *output,
 }
 
 /*
- * Clear out the hash table
+ * Clear out the code table
  */
 static gboolean
 cl_block (GOutputStream  *output,
           GError        **error) /* table clear for block compress */
 {
-  cl_hash ((glong) hsize);
+  cl_table ();
   free_ent = ClearCode + 2;
   clear_flg = 1;
 
@@ -2415,38 +2094,14 @@ cl_block (GOutputStream  *output,
 }
 
 static void
-cl_hash (glong hsize)        /* reset code table */
+cl_table (void)                  /* reset code table */
 {
-  glong *htab_p = htab + hsize;
-
-  long i;
-  long m1 = -1;
+  gint i;
 
-  i = hsize - 16;
-  do
-    {                                /* might use Sys V memset(3) here */
-      *(htab_p - 16) = m1;
-      *(htab_p - 15) = m1;
-      *(htab_p - 14) = m1;
-      *(htab_p - 13) = m1;
-      *(htab_p - 12) = m1;
-      *(htab_p - 11) = m1;
-      *(htab_p - 10) = m1;
-      *(htab_p - 9) = m1;
-      *(htab_p - 8) = m1;
-      *(htab_p - 7) = m1;
-      *(htab_p - 6) = m1;
-      *(htab_p - 5) = m1;
-      *(htab_p - 4) = m1;
-      *(htab_p - 3) = m1;
-      *(htab_p - 2) = m1;
-      *(htab_p - 1) = m1;
-      htab_p -= 16;
-    }
-  while ((i -= 16) >= 0);
+  for (i = 0; i < n_lzw_used; i++)
+    lzw_next[lzw_used[i]] = 0;
 
-  for (i += 16; i > 0; --i)
-    *--htab_p = m1;
+  n_lzw_used = 0;
 }
 
 
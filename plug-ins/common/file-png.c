@@ -49,6 +49,7 @@
 #include <libgimp/gimpui.h>
 
 #include <png.h>                /* PNG library definitions */
+#include <zlib.h>
 
 #include "libgimp/stdplugins-intl.h"
 
@@ -73,6 +74,8 @@
 
 #define PNG_DEFAULTS_PARASITE  "png-save-defaults"
 
+#define DEFLATE_WINDOW_SIZE    32768
+
 /*
  * Structures...
  */
@@ -141,6 +144,59 @@ typedef struct
 }
 PngGlobals;
 
+/* A run of rows that is filtered and deflated on its own */
+typedef struct
+{
+  const guchar *rows;
+  const guchar *prev_row;
+  gint          n_rows;
+
+  guchar       *filtered;
+  gsize         filtered_len;
+  uLong         adler;
+
+  const guchar *dict;
+  gsize         dict_len;
+
+  guchar       *compressed;
+  gsize         compressed_size;
+  gsize         compressed_len;
+  gboolean      last;
+  gboolean      success;
+}
+PngDeflateBlock;
+
+/* State for writing the IDAT stream in independently compressed blocks */
+typedef struct
+{
+  png_structp      pp;
+  gint             level;
+  gboolean         filter;
+  gboolean         swap;
+  gsize            rowbytes;
+  gint             pixel_bytes;
+  gint             height;
+  gint             rows_added;
+
+  gint             block_rows;
+  gint             n_blocks;
+  guchar          *raw;
+  gint             raw_rows;
+  PngDeflateBlock *blocks;
+
+  guchar          *dict;
+  gsize            dict_len;
+  uLong            adler;
+  gboolean         header_written;
+
+  GThreadPool     *pool;
+  GMutex           mutex;
+  GCond            cond;
+  gint             n_pending;
+  gboolean         compress;
+}
+PngDeflate;
+
 
 /*
  * Local functions...
@@ -179,6 +235,16 @@ static void      save_dialog_response      (GtkWidget        *widget,
 static gboolean  offsets_dialog            (gint              offset_x,
                                             gint              offset_y);
 
+static PngDeflate * png_deflate_new        (png_structp       pp,
+                                            png_infop         info,
+                                            gint              level,
+                                            gint              block_rows);
+static void      png_deflate_write_rows    (PngDeflate       *idat,
+                                            guchar          **rows,
+                                            gint              n_rows);
+static void      png_deflate_finish        (PngDeflate       *idat);
+static void      png_deflate_free          (PngDeflate       *idat);
+
 static gboolean  ia_has_transparent_pixels (GeglBuffer       *buffer);
 
 static gint      find_unused_ia_color      (GeglBuffer       *buffer,
@@ -1479,6 +1545,9 @@ save_image (const gchar  *filename,
 
   png_textp         text = NULL;
 
+  /* Parallel IDAT writer -- protected for setjmp() */
+  PngDeflate * volatile idat = NULL;
+
 #if defined(PNG_iCCP_SUPPORTED)
   profile = gimp_image_get_color_profile (orig_image_ID);
 #endif
@@ -1532,6 +1601,10 @@ save_image (const gchar  *filename,
 
   if (setjmp (png_jmpbuf (pp)))
     {
+      /* png_error() from the parallel IDAT writer ends up here too */
+      if (idat)
+        png_deflate_free (idat);
+
       g_set_error (error, 0, 0,
                    _("Error while exporting '%s'. Could not export image."),
                    gimp_filename_to_utf8 (filename));
@@ -1970,6 +2043,16 @@ save_image (const gchar  *filename,
   for (i = 0; i < tile_height; i++)
     pixels[i] = pixel + width * bpp * i;
 
+  /*
+   * Without interlacing, rows can be filtered and compressed in
+   * blocks on all processors...
+   */
+
+  if (! pngvals.interlaced &&
+      ! (color_type == PNG_COLOR_TYPE_PALETTE && bit_depth < 8))
+    idat = png_deflate_new (pp, info,
+                            pngvals.compression_level, tile_height);
+
   for (pass = 0; pass < num_passes; pass++)
     {
       /* This works if you are only writing one row at a time... */
@@ -2056,7 +2139,10 @@ save_image (const gchar  *filename,
                 }
             }
 
-          png_write_rows (pp, pixels, num);
+          if (idat)
+            png_deflate_write_rows (idat, pixels, num);
+          else
+            png_write_rows (pp, pixels, num);
 
           gimp_progress_update (((double) pass + (double) end /
                                  (double) height) /
@@ -2066,7 +2152,16 @@ save_image (const gchar  *filename,
 
   gimp_progress_update (1.0);
 
-  png_write_end (pp, info);
+  if (idat)
+    {
+      png_deflate_finish (idat);
+      png_deflate_free (idat);
+    }
+  else
+    {
+      png_write_end (pp, info);
+    }
+
   png_destroy_write_struct (&pp, &info);
 
   g_free (pixel);
@@ -2090,6 +2185,472 @@ save_image (const gchar  *filename,
   return TRUE;
 }
 
+/*
+ * Parallel IDAT writing, after pigz: the image is split into blocks
+ * of rows which are filtered and deflated on worker threads.  Each
+ * block ends on a byte boundary (Z_SYNC_FLUSH) and is primed with the
+ * last 32k of its predecessor, so the concatenated blocks form one
+ * zlib stream that compresses about as well as a serial one.
+ */
+
+static PngDeflate *
+png_deflate_new (png_structp pp,
+                 png_infop   info,
+                 gint        level,
+                 gint        block_rows)
+{
+  PngDeflate *idat;
+  gint        n_threads = g_get_num_processors ();
+  gint        height    = png_get_image_height (pp, info);
+  gint        i;
+
+  /* not worth it for small images */
+  if (n_threads < 2 || height < 2 * block_rows)
+    return NULL;
+
+  idat = g_slice_new0 (PngDeflate);
+
+  idat->pp          = pp;
+  idat->level       = level;
+  idat->filter      = (png_get_color_type (pp, info) !=
+                       PNG_COLOR_TYPE_PALETTE);
+  idat->swap        = (png_get_bit_depth (pp, info) == 16 &&
+                       G_BYTE_ORDER == G_LITTLE_ENDIAN);
+  idat->rowbytes    = png_get_rowbytes (pp, info);
+  idat->pixel_bytes = (png_get_channels (pp, info) *
+                       png_get_bit_depth (pp, info) / 8);
+  idat->height      = height;
+  idat->block_rows  = block_rows;
+  idat->n_blocks    = 2 * n_threads;
+  idat->adler       = adler32 (0L, NULL, 0);
+
+  /* the first row holds the row above the current group, which is
+   * all zeros for the first row of the image
+   */
+  idat->raw = g_malloc0 ((1 + idat->n_blocks * block_rows) *
+                         idat->rowbytes);
+  idat->dict = g_malloc (DEFLATE_WINDOW_SIZE);
+
+  idat->blocks = g_new0 (PngDeflateBlock, idat->n_blocks);
+
+  for (i = 0; i < idat->n_blocks; i++)
+    {
+      PngDeflateBlock *block = &idat->blocks[i];
+
+      block->filtered = g_malloc (block_rows * (idat->rowbytes + 1));
+
+      /* deflateBound() doesn't account for the flush marker */
+      block->compressed_size = compressBound (block_rows *
+                                              (idat->rowbytes + 1)) + 16;
+      block->compressed      = g_malloc (block->compressed_size);
+    }
+
+  g_mutex_init (&idat->mutex);
+  g_cond_init (&idat->cond);
+
+  return idat;
+}
+
+static void
+png_deflate_free (PngDeflate *idat)
+{
+  gint i;
+
+  if (idat->pool)
+    g_thread_pool_free (idat->pool, FALSE, TRUE);
+
+  for (i = 0; i < idat->n_blocks; i++)
+    {
+      g_free (idat->blocks[i].filtered);
+      g_free (idat->blocks[i].compressed);
+    }
+
+  g_free (idat->blocks);
+  g_free (idat->dict);
+  g_free (idat->raw);
+
+  g_cond_clear (&idat->cond);
+  g_mutex_clear (&idat->mutex);
+
+  g_slice_free (PngDeflate, idat);
+}
+
+static inline guchar
+png_deflate_paeth (gint a,
+                   gint b,
+                   gint c)
+{
+  gint p  = a + b - c;
+  gint pa = abs (p - a);
+  gint pb = abs (p - b);
+  gint pc = abs (p - c);
+
+  if (pa <= pb && pa <= pc)
+    return a;
+  else if (pb <= pc)
+    return b;
+
+  return c;
+}
+
+/* Filters one row with the given PNG filter type */
+static void
+png_deflate_filter_row (const guchar *row,
+                        const guchar *prev,
+                        gsize         rowbytes,
+                        gint          bpp,
+                        gint          type,
+                        guchar       *dest)
+{
+  gsize i;
+
+  *dest++ = type;
+
+  for (i = 0; i < rowbytes; i++)
+    {
+      gint a = i >= bpp ? row[i - bpp]  : 0;
+      gint b = prev[i];
+      gint c = i >= bpp ? prev[i - bpp] : 0;
+
+      switch (type)
+        {
+        case PNG_FILTER_VALUE_NONE:
+          dest[i] = row[i];
+          break;
+
+        case PNG_FILTER_VALUE_SUB:
+          dest[i] = row[i] - a;
+          break;
+
+        case PNG_FILTER_VALUE_UP:
+          dest[i] = row[i] - b;
+          break;
+
+        case PNG_FILTER_VALUE_AVG:
+          dest[i] = row[i] - ((a + b) >> 1);
+          break;
+
+        case PNG_FILTER_VALUE_PAETH:
+          dest[i] = row[i] - png_deflate_paeth (a, b, c);
+          break;
+        }
+    }
+}
+
+/* Picks the filter for each row the way libpng does by default:
+ * the one with the smallest sum of absolute (signed) differences.
+ * Indexed images are never filtered.
+ */
+static void
+png_deflate_filter_block (PngDeflate      *idat,
+                          PngDeflateBlock *block)
+{
+  const guchar *row      = block->rows;
+  const guchar *prev     = block->prev_row;
+  guchar       *dest     = block->filtered;
+  gsize         rowbytes = idat->rowbytes;
+  gint          y;
+
+  for (y = 0; y < block->n_rows; y++)
+    {
+      if (idat->filter)
+        {
+          guint best_sum  = G_MAXUINT;
+          gint  best_type = PNG_FILTER_VALUE_NONE;
+          gint  type;
+
+          for (type = PNG_FILTER_VALUE_NONE;
+               type < PNG_FILTER_VALUE_LAST;
+               type++)
+            {
+              guint sum = 0;
+              gsize i;
+
+              png_deflate_filter_row (row, prev, rowbytes,
+                                      idat->pixel_bytes, type, dest);
+
+              for (i = 1; i <= rowbytes && sum < best_sum; i++)
+                sum += ABS ((gint8) dest[i]);
+
+              if (sum < best_sum)
+                {
+                  best_sum  = sum;
+                  best_type = type;
+                }
+            }
+
+          if (best_type != PNG_FILTER_VALUE_LAST - 1)
+            png_deflate_filter_row (row, prev, rowbytes,
+                                    idat->pixel_bytes, best_type, dest);
+        }
+      else
+        {
+          png_deflate_filter_row (row, prev, rowbytes,
+                                  idat->pixel_bytes,
+                                  PNG_FILTER_VALUE_NONE, dest);
+        }
+
+      prev  = row;
+      row  += rowbytes;
+      dest += rowbytes + 1;
+    }
+
+  block->filtered_len = block->n_rows * (rowbytes + 1);
+  block->adler        = adler32 (adler32 (0L, NULL, 0),
+                                 block->filtered, block->filtered_len);
+}
+
+static void
+png_deflate_compress_block (PngDeflate      *idat,
+                            PngDeflateBlock *block)
+{
+  z_stream strm = { 0, };
+  gint     ret;
+
+  block->success = FALSE;
+
+  /* raw deflate, the zlib header and trailer are written separately */
+  if (deflateInit2 (&strm, idat->level, Z_DEFLATED,
+                    -15, 8,
+                    idat->filter ? Z_FILTERED : Z_DEFAULT_STRATEGY) != Z_OK)
+    return;
+
+  if (block->dict_len > 0)
+    deflateSetDictionary (&strm, block->dict, block->dict_len);
+
+  strm.next_in   = block->filtered;
+  strm.avail_in  = block->filtered_len;
+  strm.next_out  = block->compressed;
+  strm.avail_out = block->compressed_size;
+
+  ret = deflate (&strm, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+
+  if (block->last ? ret == Z_STREAM_END : (ret == Z_OK && strm.avail_out > 0))
+    {
+      block->compressed_len = strm.total_out;
+      block->success        = TRUE;
+    }
+
+  deflateEnd (&strm);
+}
+
+static void
+png_deflate_block_func (gpointer data,
+                        gpointer user_data)
+{
+  PngDeflate *idat = user_data;
+
+  if (idat->compress)
+    png_deflate_compress_block (idat, data);
+  else
+    png_deflate_filter_block (idat, data);
+
+  g_mutex_lock (&idat->mutex);
+
+  if (--idat->n_pending == 0)
+    g_cond_signal (&idat->cond);
+
+  g_mutex_unlock (&idat->mutex);
+}
+
+static void
+png_deflate_run (PngDeflate *idat,
+                 gint        n_blocks,
+                 gboolean    compress)
+{
+  gint i;
+
+  if (! idat->pool)
+    idat->pool = g_thread_pool_new (png_deflate_block_func, idat,
+                                    g_get_num_processors (), TRUE, NULL);
+
+  idat->compress  = compress;
+  idat->n_pending = n_blocks;
+
+  for (i = 0; i < n_blocks; i++)
+    g_thread_pool_push (idat->pool, &idat->blocks[i], NULL);
+
+  g_mutex_lock (&idat->mutex);
+
+  while (idat->n_pending > 0)
+    g_cond_wait (&idat->cond, &idat->mutex);
+
+  g_mutex_unlock (&idat->mutex);
+}
+
+static void
+png_deflate_flush (PngDeflate *idat)
+{
+  gsize    rowbytes = idat->rowbytes;
+  gboolean last     = (idat->rows_added == idat->height);
+  gint     n_blocks;
+  gint     i;
+
+  n_blocks = ((idat->raw_rows + idat->block_rows - 1) /
+              idat->block_rows);
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      PngDeflateBlock *block = &idat->blocks[i];
+
+      block->rows     = idat->raw + (1 + i * idat->block_rows) * rowbytes;
+      block->prev_row = block->rows - rowbytes;
+      block->n_rows   = MIN (idat->block_rows,
+                             idat->raw_rows - i * idat->block_rows);
+      block->last     = last && (i == n_blocks - 1);
+    }
+
+  png_deflate_run (idat, n_blocks, FALSE);
+
+  /* each block is primed with the data preceding it */
+  for (i = 0; i < n_blocks; i++)
+    {
+      PngDeflateBlock *block = &idat->blocks[i];
+
+      if (i == 0)
+        {
+          block->dict     = idat->dict;
+          block->dict_len = idat->dict_len;
+        }
+      else
+        {
+          PngDeflateBlock *prev = &idat->blocks[i - 1];
+
+          block->dict_len = MIN (prev->filtered_len, DEFLATE_WINDOW_SIZE);
+          block->dict     = (prev->filtered +
+                             prev->filtered_len - block->dict_len);
+        }
+    }
+
+  png_deflate_run (idat, n_blocks, TRUE);
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      PngDeflateBlock *block = &idat->blocks[i];
+      png_uint_32      length;
+
+      if (! block->success)
+        png_error (idat->pp, "zlib failed to compress image data");
+
+      length = block->compressed_len;
+
+      if (! idat->header_written)
+        length += 2;
+
+      if (block->last)
+        length += 4;
+
+      idat->adler = adler32_combine (idat->adler,
+                                     block->adler, block->filtered_len);
+
+      png_write_chunk_start (idat->pp, (png_const_bytep) "IDAT", length);
+
+      if (! idat->header_written)
+        {
+          guchar header[2];
+          gint   level;
+
+          /* CMF: deflate with a 32k window, FLG: level and check bits */
+          if (idat->level < 2)
+            level = 0;
+          else if (idat->level < 6)
+            level = 1;
+          else if (idat->level == 6)
+            level = 2;
+          else
+            level = 3;
+
+          header[0] = 0x78;
+          header[1] = level << 6;
+          header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+
+          png_write_chunk_data (idat->pp, header, 2);
+
+          idat->header_written = TRUE;
+        }
+
+      png_write_chunk_data (idat->pp,
+                            block->compressed, block->compressed_len);
+
+      if (block->last)
+        {
+          guchar trailer[4];
+
+          trailer[0] = (idat->adler >> 24) & 0xff;
+          trailer[1] = (idat->adler >> 16) & 0xff;
+          trailer[2] = (idat->adler >>  8) & 0xff;
+          trailer[3] =  idat->adler        & 0xff;
+
+          png_write_chunk_data (idat->pp, trailer, 4);
+        }
+
+      png_write_chunk_end (idat->pp);
+    }
+
+  /* keep the window and the last row for the next group */
+  if (n_blocks > 0)
+    {
+      PngDeflateBlock *block = &idat->blocks[n_blocks - 1];
+
+      idat->dict_len = MIN (block->filtered_len, DEFLATE_WINDOW_SIZE);
+      memcpy (idat->dict,
+              block->filtered + block->filtered_len - idat->dict_len,
+              idat->dict_len);
+
+      memcpy (idat->raw,
+              idat->raw + idat->raw_rows * rowbytes,
+              rowbytes);
+    }
+
+  idat->raw_rows = 0;
+}
+
+static void
+png_deflate_write_rows (PngDeflate  *idat,
+                        guchar     **rows,
+                        gint         n_rows)
+{
+  gint capacity = idat->n_blocks * idat->block_rows;
+  gint i;
+
+  for (i = 0; i < n_rows; i++)
+    {
+      guchar *dest = idat->raw + (1 + idat->raw_rows) * idat->rowbytes;
+
+      if (idat->swap)
+        {
+          const guint16 *src = (const guint16 *) rows[i];
+          guint16       *d   = (guint16 *) dest;
+          gsize          j;
+
+          for (j = 0; j < idat->rowbytes / 2; j++)
+            d[j] = GUINT16_TO_BE (src[j]);
+        }
+      else
+        {
+          memcpy (dest, rows[i], idat->rowbytes);
+        }
+
+      idat->raw_rows++;
+      idat->rows_added++;
+
+      if (idat->raw_rows == capacity)
+        png_deflate_flush (idat);
+    }
+}
+
+static void
+png_deflate_finish (PngDeflate *idat)
+{
+  if (idat->raw_rows > 0)
+    png_deflate_flush (idat);
+
+  /* png_write_end() refuses to run without IDATs written by libpng
+   * itself; everything else was already written by png_write_info()
+   */
+  png_write_chunk (idat->pp, (png_const_bytep) "IEND", NULL, 0);
+}
+
 static gboolean
 ia_has_transparent_pixels (GeglBuffer *buffer)
 {
@@ -163,7 +163,9 @@ foreach (sort keys %plugins) {
     my $optlib = "";
 
     if (exists $plugins{$_}->{libs}) {
-		$optlib = "\n\t\$(" . $plugins{$_}->{libs} . ")\t\t\\";
+	foreach my $lib (split / /, $plugins{$_}->{libs}) {
+	    $optlib .= "\n\t\$(" . $lib . ")\t\t\\";
+	}
     }
 
     if (exists $plugins{$_}->{ldflags}) {
@@ -46,6 +46,10 @@ static gboolean  jpeg_load_resolution       (gint32    image_ID,
 
 static void      jpeg_load_sanitize_comment (gchar    *comment);
 
+static gint      jpeg_load_scale_denom      (gint      width,
+                                             gint      height,
+                                             gint      size);
+
 static gpointer  jpeg_load_cmyk_transform   (guint8   *profile_data,
                                              gsize     profile_len);
 static void      jpeg_load_cmyk_to_rgb      (guchar   *buf,
@@ -59,6 +63,7 @@ gint32
 load_image (const gchar  *filename,
             GimpRunMode   runmode,
             gboolean      preview,
+            gint          scale_denom,
             gboolean     *resolution_loaded,
             GError      **error)
 {
@@ -161,6 +166,18 @@ load_image (const gchar  *filename,
 
   cinfo.dct_method = JDCT_FLOAT;
 
+  /* Let the library scale the image while it does the inverse DCT,
+   * which skips most of the decoding work.  Precision doesn't matter
+   * much at that point, so use the fast integer DCT as well.
+   */
+  if (scale_denom > 1)
+    {
+      cinfo.scale_num           = 1;
+      cinfo.scale_denom         = scale_denom;
+      cinfo.dct_method          = JDCT_IFAST;
+      cinfo.do_fancy_upsampling = FALSE;
+    }
+
   /* Step 5: Start decompressor */
 
   jpeg_start_decompress (&cinfo);
@@ -456,6 +473,13 @@ jpeg_load_resolution (gint32                         image_ID,
           break;
         }
 
+      /* keep the physical size of an image loaded at reduced size */
+      if (cinfo->density_unit != 0)
+        {
+          xresolution = xresolution * cinfo->output_width  / cinfo->image_width;
+          yresolution = yresolution * cinfo->output_height / cinfo->image_height;
+        }
+
       gimp_image_set_resolution (image_ID, xresolution, yresolution);
 
       return TRUE;
@@ -488,8 +512,28 @@ jpeg_load_sanitize_comment (gchar *comment)
     }
 }
 
+/* Picks the largest DCT scaling that still gives at least @size
+ * pixels along the longer side of the image.
+ */
+static gint
+jpeg_load_scale_denom (gint width,
+                       gint height,
+                       gint size)
+{
+  gint denom = 8;
+
+  if (size <= 0)
+    return 1;
+
+  while (denom > 1 && (MAX (width, height) + denom - 1) / denom < size)
+    denom /= 2;
+
+  return denom;
+}
+
 gint32
 load_thumbnail_image (GFile         *file,
+                      gint           size,
                       gint          *width,
                       gint          *height,
                       GimpImageType *type,
@@ -499,13 +543,12 @@ load_thumbnail_image (GFile         *file,
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr           jerr;
   FILE                         *infile   = NULL;
+  gboolean                      known    = TRUE;
 
   gimp_progress_init_printf (_("Opening thumbnail for '%s'"),
                              g_file_get_parse_name (file));
 
-  image_ID = gimp_image_metadata_load_thumbnail (file, error);
-  if (image_ID < 1)
-    return -1;
+  image_ID = gimp_image_metadata_load_thumbnail (file, NULL);
 
   cinfo.err = jpeg_std_error (&jerr.pub);
   jerr.pub.error_exit     = my_error_exit;
@@ -532,6 +575,8 @@ load_thumbnail_image (GFile         *file,
        */
       jpeg_destroy_decompress (&cinfo);
 
+      fclose (infile);
+
       if (image_ID != -1)
         gimp_image_delete (image_ID);
 
@@ -549,7 +594,10 @@ load_thumbnail_image (GFile         *file,
 
   jpeg_read_header (&cinfo, TRUE);
 
-  jpeg_start_decompress (&cinfo);
+  /* only the output parameters are needed, there is no need to
+   * start the decompressor
+   */
+  jpeg_calc_output_dimensions (&cinfo);
 
   *width  = cinfo.output_width;
   *height = cinfo.output_height;
@@ -578,8 +626,7 @@ load_thumbnail_image (GFile         *file,
                  cinfo.output_components, cinfo.out_color_space,
                  cinfo.jpeg_color_space);
 
-      gimp_image_delete (image_ID);
-      image_ID = -1;
+      known = FALSE;
       break;
     }
 
@@ -592,6 +639,28 @@ load_thumbnail_image (GFile         *file,
 
   fclose (infile);
 
+  if (! known)
+    {
+      if (image_ID != -1)
+        gimp_image_delete (image_ID);
+
+      return -1;
+    }
+
+  /* Without an embedded thumbnail, decode the image itself at the
+   * smallest DCT scaling that is still large enough.
+   */
+  if (image_ID < 1)
+    {
+      gchar *filename = g_file_get_path (file);
+
+      image_ID = load_image (filename, GIMP_RUN_NONINTERACTIVE, FALSE,
+                             jpeg_load_scale_denom (*width, *height, size),
+                             NULL, error);
+
+      g_free (filename);
+    }
+
   return image_ID;
 }
 
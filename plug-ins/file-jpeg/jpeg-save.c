@@ -218,7 +218,8 @@ background_jpeg_save (PreviewPersistent *pp)
           g_object_unref (file);
 
           /* and load the preview */
-          load_image (pp->file_name, GIMP_RUN_NONINTERACTIVE, TRUE, NULL, NULL);
+          load_image (pp->file_name, GIMP_RUN_NONINTERACTIVE, TRUE, 1,
+                      NULL, NULL);
         }
 
       /* we cleanup here (load_image doesn't run in the background) */
@@ -75,7 +75,8 @@ query (void)
   {
     { GIMP_PDB_INT32,    "run-mode",     "The run mode { RUN-INTERACTIVE (0), RUN-NONINTERACTIVE (1) }" },
     { GIMP_PDB_STRING,   "filename",     "The name of the file to load" },
-    { GIMP_PDB_STRING,   "raw-filename", "The name of the file to load" }
+    { GIMP_PDB_STRING,   "raw-filename", "The name of the file to load" },
+    { GIMP_PDB_INT32,    "scale-denom",  "Load the image at reduced size, scaled by 1 / scale-denom { 1, 2, 4, 8 } (optional)" }
   };
   static const GimpParamDef load_return_vals[] =
   {
@@ -133,7 +134,8 @@ query (void)
 
   gimp_install_procedure (LOAD_THUMB_PROC,
                           "Loads a thumbnail from a JPEG image",
-                          "Loads a thumbnail from a JPEG image (only if it exists)",
+                          "Loads the embedded thumbnail from a JPEG image, or "
+                          "decodes the image at reduced size if there is none",
                           "Mukund Sivaraman <muks@mukund.org>, Sven Neumann <sven@gimp.org>",
                           "Mukund Sivaraman <muks@mukund.org>, Sven Neumann <sven@gimp.org>",
                           "November 15, 2004",
@@ -197,6 +199,7 @@ run (const gchar      *name,
   if (strcmp (name, LOAD_PROC) == 0)
     {
       gboolean resolution_loaded = FALSE;
+      gint     scale_denom       = 1;
 
       switch (run_mode)
         {
@@ -210,8 +213,24 @@ run (const gchar      *name,
           break;
         }
 
+      if (nparams > 3)
+        {
+          switch (param[3].data.d_int32)
+            {
+            case 2:
+            case 4:
+            case 8:
+              scale_denom = param[3].data.d_int32;
+              break;
+
+            default:
+              scale_denom = 1;
+              break;
+            }
+        }
+
       image_ID = load_image (param[1].data.d_string, run_mode, FALSE,
-                             &resolution_loaded, &error);
+                             scale_denom, &resolution_loaded, &error);
 
       if (image_ID != -1)
         {
@@ -259,7 +278,8 @@ run (const gchar      *name,
           gint          height = 0;
           GimpImageType type   = -1;
 
-          image_ID = load_thumbnail_image (file, &width, &height, &type,
+          image_ID = load_thumbnail_image (file, param[1].data.d_int32,
+                                           &width, &height, &type,
                                            &error);
 
           g_object_unref (file);
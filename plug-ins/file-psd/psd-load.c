@@ -39,6 +39,39 @@
 #define COMP_MODE_SIZE sizeof(guint16)
 
 
+/* Layer channels are decoded in strips of rows, directly into the
+ * layer's buffer, and the channels of a strip on worker threads.
+ */
+typedef struct
+{
+  PSDchannel   *channel;
+  guint16       bps;                    /* Bits per sample */
+  guint16       compression;            /* Compression mode */
+  gboolean      empty;                  /* No channel data stored */
+  guint32       readline_len;           /* Length of a raw row */
+  glong         data_start;             /* File offset of raw data */
+  gchar        *comp_data;              /* Compressed channel data */
+  guint32       comp_len;               /* Compressed data length */
+  guint16      *rle_pack_len;           /* Packed length of each row */
+  guint32      *rle_offset;             /* Offset of each row in comp_data */
+  z_stream      zs;                     /* Zip stream state */
+  gboolean      zs_init;                /* Zip stream initialized */
+  gchar        *raw_data;               /* Raw rows of the current strip */
+  gint          row;                    /* First row of the current strip */
+  gint          n_rows;                 /* Rows in the current strip */
+  gint          strip_rows;             /* Maximum rows in a strip */
+  gboolean      failed;                 /* Decoding the strip failed */
+} PSDchannelreader;
+
+typedef struct
+{
+  GThreadPool  *pool;
+  GMutex        mutex;
+  GCond         cond;
+  gint          n_pending;
+} PSDdecoder;
+
+
 /*  Local function prototypes  */
 static gint             read_header_block          (PSDimage     *img_a,
                                                     FILE         *f,
@@ -99,6 +132,28 @@ static gint             read_channel_data          (PSDchannel     *channel,
                                                     guint32         comp_len,
                                                     GError        **error);
 
+static gint             init_channel_reader        (PSDchannelreader *reader,
+                                                    PSDchannel       *channel,
+                                                    guint16           bps,
+                                                    guint16           compression,
+                                                    guint32           comp_len,
+                                                    gint              strip_rows,
+                                                    FILE             *f,
+                                                    GError          **error);
+static void             free_channel_reader        (PSDchannelreader *reader);
+static void             decode_channel_strip       (PSDchannelreader *reader);
+static void             decode_channel_strip_func  (PSDchannelreader *reader,
+                                                    PSDdecoder       *decoder);
+static void             init_decoder               (PSDdecoder       *decoder);
+static void             free_decoder               (PSDdecoder       *decoder);
+static gint             decode_channel_strips      (PSDdecoder       *decoder,
+                                                    PSDchannelreader **readers,
+                                                    gint              n_readers,
+                                                    gint              row,
+                                                    gint              n_rows,
+                                                    FILE             *f,
+                                                    GError          **error);
+
 static void             convert_1_bit              (const gchar *src,
                                                     gchar       *dst,
                                                     guint32      rows,
@@ -1109,7 +1164,10 @@ add_layers (gint32     image_id,
             FILE      *f,
             GError   **error)
 {
-  PSDchannel          **lyr_chn;
+  PSDchannel          **lyr_chn = NULL;
+  PSDchannelreader     *lyr_rdr = NULL;
+  PSDchannelreader     *strip_rdr[MAX_CHANNELS];
+  PSDdecoder            decoder;
   GArray               *parent_group_stack;
   gint32                parent_group_id = -1;
   guchar               *pixels;
@@ -1117,7 +1175,6 @@ add_layers (gint32     image_id,
   guint16               user_mask_chn;
   guint16               layer_channels;
   guint16               channel_idx[MAX_CHANNELS];
-  guint16              *rle_pack_len;
   guint16               bps;
   gint32                l_x;                   /* Layer x */
   gint32                l_y;                   /* Layer y */
@@ -1127,13 +1184,17 @@ add_layers (gint32     image_id,
   gint32                lm_y;                  /* Layer mask y */
   gint32                lm_w;                  /* Layer mask width */
   gint32                lm_h;                  /* Layer mask height */
+  gint32                lm_x1, lm_y1;          /* Layer mask visible area */
+  gint32                lm_x2, lm_y2;
   gint32                layer_size;
+  glong                 layer_end;
   gint32                layer_id = -1;
   gint32                mask_id = -1;
   gint                  lidx;                  /* Layer index */
   gint                  cidx;                  /* Channel index */
   gint                  rowi;                  /* Row index */
-  gint                  coli;                  /* Column index */
+  gint                  strip_rows;
+  gint                  n_rows;
   gint                  i;
   gboolean              alpha;
   gboolean              user_mask;
@@ -1160,6 +1221,10 @@ add_layers (gint32     image_id,
       return -1;
     }
 
+  /* decode the layers in strips of tile rows */
+  strip_rows = gimp_tile_height ();
+  init_decoder (&decoder);
+
   /* set the root of the group hierarchy */
   parent_group_stack = g_array_new (FALSE, FALSE, sizeof (gint32));
   g_array_append_val (parent_group_stack, parent_group_id);
@@ -1178,7 +1243,7 @@ add_layers (gint32     image_id,
               if (fseek (f, lyr_a[lidx]->chn_info[cidx].data_len, SEEK_CUR) < 0)
                 {
                   psd_set_error (feof (f), errno, error);
-                  return -1;
+                  goto add_layers_error;
                 }
             }
           g_free (lyr_a[lidx]->chn_info);
@@ -1236,7 +1301,8 @@ add_layers (gint32     image_id,
           /* Load layer channel data */
           IFDBG(2) g_debug ("Number of channels: %d", lyr_a[lidx]->num_channels);
           /* Create pointer array for the channel records */
-          lyr_chn = g_new (PSDchannel *, lyr_a[lidx]->num_channels);
+          lyr_chn = g_new0 (PSDchannel *, lyr_a[lidx]->num_channels);
+          lyr_rdr = g_new0 (PSDchannelreader, lyr_a[lidx]->num_channels);
           for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
             {
               guint16 comp_mode = PSD_COMP_RAW;
@@ -1278,79 +1344,29 @@ add_layers (gint32     image_id,
                                 lyr_chn[cidx]->columns,
                                 lyr_chn[cidx]->rows);
 
-              /* Only read channel data if there is any channel
-               * data. Note that the channel data can contain a
-               * compression method but no actual data.
+              /* Only read the compression mode if there is any
+               * channel data, the pixel data itself is decoded later
                */
               if (lyr_a[lidx]->chn_info[cidx].data_len >= COMP_MODE_SIZE)
                 {
                   if (fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
                     {
                       psd_set_error (feof (f), errno, error);
-                      return -1;
+                      goto add_layers_error;
                     }
                   comp_mode = GUINT16_FROM_BE (comp_mode);
                   IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
                 }
-              if (lyr_a[lidx]->chn_info[cidx].data_len > COMP_MODE_SIZE)
-                {
-                  switch (comp_mode)
-                    {
-                      case PSD_COMP_RAW:        /* Planar raw data */
-                        IFDBG(3) g_debug ("Raw data length: %d",
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2);
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               PSD_COMP_RAW, NULL, f, 0,
-                                               error) < 1)
-                          return -1;
-                        break;
-
-                      case PSD_COMP_RLE:        /* Packbits */
-                        IFDBG(3) g_debug ("RLE channel length %d, RLE length data: %d, "
-                                          "RLE data block: %d",
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                          lyr_chn[cidx]->rows * 2,
-                                          (lyr_a[lidx]->chn_info[cidx].data_len - 2 -
-                                           lyr_chn[cidx]->rows * 2));
-                        rle_pack_len = g_malloc (lyr_chn[cidx]->rows * 2);
-                        for (rowi = 0; rowi < lyr_chn[cidx]->rows; ++rowi)
-                          {
-                            if (fread (&rle_pack_len[rowi], 2, 1, f) < 1)
-                              {
-                                psd_set_error (feof (f), errno, error);
-                                g_free (rle_pack_len);
-                                return -1;
-                              }
-                            rle_pack_len[rowi] = GUINT16_FROM_BE (rle_pack_len[rowi]);
-                          }
-
-                        IFDBG(3) g_debug ("RLE decode - data");
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               PSD_COMP_RLE, rle_pack_len, f, 0,
-                                               error) < 1)
-                          return -1;
-
-                        g_free (rle_pack_len);
-                        break;
-
-                      case PSD_COMP_ZIP:                 /* ? */
-                      case PSD_COMP_ZIP_PRED:
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               comp_mode, NULL, f,
-                                               lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                               error) < 1)
-                          return -1;
-                        break;
-
-                      default:
-                        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                                    _("Unsupported compression mode: %d"), comp_mode);
-                        return -1;
-                        break;
-                    }
-                }
+
+              if (init_channel_reader (&lyr_rdr[cidx], lyr_chn[cidx],
+                                       img_a->bps, comp_mode,
+                                       lyr_a[lidx]->chn_info[cidx].data_len > COMP_MODE_SIZE ?
+                                       lyr_a[lidx]->chn_info[cidx].data_len - COMP_MODE_SIZE : 0,
+                                       strip_rows, f, error) < 1)
+                goto add_layers_error;
             }
           g_free (lyr_a[lidx]->chn_info);
+          layer_end = ftell (f);
 
           /* Draw layer */
 
@@ -1450,19 +1466,9 @@ add_layers (gint32     image_id,
               IFDBG(3) g_debug ("Draw layer");
               image_type = get_gimp_image_type (img_a->base_type, alpha);
               IFDBG(3) g_debug ("Layer type %d", image_type);
-              layer_size = l_w * l_h;
               bps = img_a->bps / 8;
               if (bps == 0)
                 bps++;
-              pixels = g_malloc (layer_size * layer_channels * bps);
-              for (cidx = 0; cidx < layer_channels; ++cidx)
-                {
-                  IFDBG(3) g_debug ("Start channel %d", channel_idx[cidx]);
-                  for (i = 0; i < layer_size; ++i)
-                    memcpy (&pixels[((i * layer_channels) + cidx) * bps],
-                            &lyr_chn[channel_idx[cidx]]->data[i * bps], bps);
-                  g_free (lyr_chn[channel_idx[cidx]]->data);
-                }
 
               layer_mode = psd_to_gimp_blend_mode (lyr_a[lidx]->blend_mode, &layer_composite);
               layer_id = gimp_layer_new (image_id, lyr_a[lidx]->name, l_w, l_h,
@@ -1475,12 +1481,40 @@ add_layers (gint32     image_id,
               gimp_layer_set_offsets (layer_id, l_x, l_y);
               gimp_layer_set_lock_alpha  (layer_id, lyr_a[lidx]->layer_flags.trans_prot);
               buffer = gimp_drawable_get_buffer (layer_id);
-              gegl_buffer_set (buffer,
-                               GEGL_RECTANGLE (0, 0,
-                                               gegl_buffer_get_width (buffer),
-                                               gegl_buffer_get_height (buffer)),
-                               0, get_layer_format (img_a, alpha),
-                               pixels, GEGL_AUTO_ROWSTRIDE);
+
+              for (cidx = 0; cidx < layer_channels; ++cidx)
+                strip_rdr[cidx] = &lyr_rdr[channel_idx[cidx]];
+
+              pixels = g_malloc (l_w * strip_rows * layer_channels * bps);
+
+              for (rowi = 0; rowi < l_h; rowi += strip_rows)
+                {
+                  n_rows = MIN (strip_rows, l_h - rowi);
+
+                  if (decode_channel_strips (&decoder,
+                                             strip_rdr, layer_channels,
+                                             rowi, n_rows, f, error) < 1)
+                    {
+                      g_object_unref (buffer);
+                      g_free (pixels);
+                      goto add_layers_error;
+                    }
+
+                  layer_size = l_w * n_rows;
+                  for (cidx = 0; cidx < layer_channels; ++cidx)
+                    {
+                      IFDBG(3) g_debug ("Start channel %d", channel_idx[cidx]);
+                      for (i = 0; i < layer_size; ++i)
+                        memcpy (&pixels[((i * layer_channels) + cidx) * bps],
+                                &lyr_chn[channel_idx[cidx]]->data[i * bps], bps);
+                    }
+
+                  gegl_buffer_set (buffer,
+                                   GEGL_RECTANGLE (0, rowi, l_w, n_rows),
+                                   0, get_layer_format (img_a, alpha),
+                                   pixels, GEGL_AUTO_ROWSTRIDE);
+                }
+
               gimp_item_set_visible (layer_id, lyr_a[lidx]->layer_flags.visible);
               if (lyr_a[lidx]->id)
                 gimp_item_set_tattoo (layer_id, lyr_a[lidx]->id);
@@ -1525,9 +1559,8 @@ add_layers (gint32     image_id,
                   IFDBG(3) g_debug ("Relative pos %d",
                                     lyr_a[lidx]->layer_mask.mask_flags.relative_pos);
                   bps = (img_a->bps + 1) / 8;
-                  layer_size = lm_w * lm_h * bps;
-                  pixels = g_malloc (layer_size);
-                  IFDBG(3) g_debug ("Allocate Pixels %d", layer_size);
+                  if (bps == 0)
+                    bps++;
                   /* Crop mask at layer boundary */
                   IFDBG(3) g_debug ("Original Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
                   if (lm_x < 0
@@ -1540,47 +1573,18 @@ add_layers (gint32     image_id,
                                    "The layer mask is partly outside the "
                                    "layer boundary. The mask will be "
                                    "cropped which may result in data loss.");
-                      i = 0;
-                      for (rowi = 0; rowi < lm_h; ++rowi)
-                        {
-                          if (rowi + lm_y >= 0 && rowi + lm_y < l_h)
-                            {
-                              for (coli = 0; coli < lm_w; ++coli)
-                                {
-                                  if (coli + lm_x >= 0 && coli + lm_x < l_w)
-                                    {
-                                      memcpy (&pixels[i * bps], &lyr_chn[user_mask_chn]->data[(rowi * lm_w + coli) * bps], bps);
-                                      i++;
-                                    }
-                                }
-                            }
-                        }
-                      if (lm_x < 0)
-                        {
-                          lm_w += lm_x;
-                          lm_x = 0;
-                        }
-                      if (lm_y < 0)
-                        {
-                          lm_h += lm_y;
-                          lm_y = 0;
-                        }
-                      if (lm_w + lm_x > l_w)
-                        lm_w = l_w - lm_x;
-                      if (lm_h + lm_y > l_h)
-                        lm_h = l_h - lm_y;
                     }
-                  else
-                    {
-                      memcpy (pixels, lyr_chn[user_mask_chn]->data, layer_size);
-                      i = layer_size;
-                    }
-                  g_free (lyr_chn[user_mask_chn]->data);
+                  lm_x1 = MAX (lm_x, 0);
+                  lm_y1 = MAX (lm_y, 0);
+                  lm_x2 = MIN (lm_x + lm_w, l_w);
+                  lm_y2 = MIN (lm_y + lm_h, l_h);
+
                   /* Draw layer mask data, if any */
-                  if (i > 0)
+                  if (lm_x2 > lm_x1 && lm_y2 > lm_y1)
                     {
                       IFDBG(3) g_debug ("Layer %d %d %d %d", l_x, l_y, l_w, l_h);
-                      IFDBG(3) g_debug ("Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
+                      IFDBG(3) g_debug ("Mask %d %d %d %d", lm_x1, lm_y1,
+                                        lm_x2 - lm_x1, lm_y2 - lm_y1);
 
                       if (lyr_a[lidx]->layer_mask.def_color == 255)
                         mask_id = gimp_layer_create_mask (layer_id,
@@ -1592,33 +1596,97 @@ add_layers (gint32     image_id,
                       IFDBG(3) g_debug ("New layer mask %d", mask_id);
                       gimp_layer_add_mask (layer_id, mask_id);
                       buffer = gimp_drawable_get_buffer (mask_id);
-                      gegl_buffer_set (buffer,
-                                       GEGL_RECTANGLE (lm_x, lm_y, lm_w, lm_h),
-                                       0, get_mask_format (img_a),
-                                       pixels, GEGL_AUTO_ROWSTRIDE);
+
+                      strip_rdr[0] = &lyr_rdr[user_mask_chn];
+
+                      /* Compressed rows can only be decoded in order, so
+                       * rows above the layer are decoded and dropped
+                       */
+                      for (rowi = 0; lm_y + rowi < lm_y2; rowi += strip_rows)
+                        {
+                          gint32 y1, y2;
+
+                          n_rows = MIN (strip_rows, lm_h - rowi);
+
+                          if (decode_channel_strips (&decoder,
+                                                     strip_rdr, 1,
+                                                     rowi, n_rows, f,
+                                                     error) < 1)
+                            {
+                              g_object_unref (buffer);
+                              goto add_layers_error;
+                            }
+
+                          y1 = MAX (lm_y + rowi, lm_y1);
+                          y2 = MIN (lm_y + rowi + n_rows, lm_y2);
+
+                          if (y2 > y1)
+                            gegl_buffer_set (buffer,
+                                             GEGL_RECTANGLE (lm_x1, y1,
+                                                             lm_x2 - lm_x1,
+                                                             y2 - y1),
+                                             0, get_mask_format (img_a),
+                                             lyr_chn[user_mask_chn]->data +
+                                             ((y1 - lm_y - rowi) * lm_w +
+                                              lm_x1 - lm_x) * bps,
+                                             lm_w * bps);
+                        }
+
                       g_object_unref (buffer);
                       gimp_layer_set_apply_mask (layer_id,
                                                  ! lyr_a[lidx]->layer_mask.mask_flags.disabled);
                     }
-                  g_free (pixels);
                 }
             }
 
+          /* Raw channel data is read in place, go back to the next layer */
+          if (fseek (f, layer_end, SEEK_SET) < 0)
+            {
+              psd_set_error (feof (f), errno, error);
+              goto add_layers_error;
+            }
+
           /* Set layer color tag */
           gimp_item_set_color_tag(layer_id,
                                   psd_to_gimp_layer_color_tag(lyr_a[lidx]->color_tag[0]));
 
           for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            if (lyr_chn[cidx])
-              g_free (lyr_chn[cidx]);
+            {
+              free_channel_reader (&lyr_rdr[cidx]);
+              if (lyr_chn[cidx])
+                g_free (lyr_chn[cidx]);
+            }
+          g_free (lyr_rdr);
           g_free (lyr_chn);
+          lyr_rdr = NULL;
+          lyr_chn = NULL;
         }
       g_free (lyr_a[lidx]);
     }
   g_free (lyr_a);
   g_array_free (parent_group_stack, FALSE);
 
+  free_decoder (&decoder);
+
   return 0;
+
+ add_layers_error:
+  /* Free the strip buffers of the layer being loaded */
+  if (lyr_rdr)
+    {
+      for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
+        {
+          free_channel_reader (&lyr_rdr[cidx]);
+          if (lyr_chn[cidx])
+            g_free (lyr_chn[cidx]);
+        }
+      g_free (lyr_rdr);
+      g_free (lyr_chn);
+    }
+
+  free_decoder (&decoder);
+
+  return -1;
 }
 
 static gint
@@ -2183,6 +2251,383 @@ read_channel_data (PSDchannel     *channel,
   return 1;
 }
 
+static gint
+init_channel_reader (PSDchannelreader *reader,
+                     PSDchannel       *channel,
+                     guint16           bps,
+                     guint16           compression,
+                     guint32           comp_len,
+                     gint              strip_rows,
+                     FILE             *f,
+                     GError          **error)
+{
+  gint rowi;
+
+  memset (reader, 0, sizeof (PSDchannelreader));
+
+  reader->channel     = channel;
+  reader->bps         = bps;
+  reader->compression = compression;
+  reader->strip_rows  = strip_rows;
+
+  channel->data = NULL;
+
+  /* Only read channel data if there is any channel
+   * data. Note that the channel data can contain a
+   * compression method but no actual data.
+   */
+  if (comp_len == 0)
+    {
+      reader->empty = TRUE;
+      return 1;
+    }
+
+  if (bps == 1)
+    reader->readline_len = ((channel->columns + 7) / 8);
+  else
+    reader->readline_len = (channel->columns * bps / 8);
+
+  /* sanity check, int overflow check (avoid divisions by zero) */
+  if ((channel->rows == 0) || (channel->columns == 0) ||
+      (channel->rows > G_MAXINT32 / channel->columns / MAX (bps / 8, 1)))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Unsupported or invalid channel size"));
+      return -1;
+    }
+
+  switch (compression)
+    {
+      case PSD_COMP_RAW:        /* Planar raw data */
+        IFDBG(3) g_debug ("Raw data length: %d", comp_len);
+
+        /* Raw rows are read from the file strip by strip */
+        reader->data_start = ftell (f);
+        if (fseek (f, reader->readline_len * channel->rows, SEEK_CUR) < 0)
+          {
+            psd_set_error (feof (f), errno, error);
+            return -1;
+          }
+        break;
+
+      case PSD_COMP_RLE:        /* Packbits */
+        IFDBG(3) g_debug ("RLE channel length %d, RLE length data: %d, "
+                          "RLE data block: %d",
+                          comp_len, channel->rows * 2,
+                          comp_len - channel->rows * 2);
+        reader->rle_pack_len = g_new (guint16, channel->rows);
+        reader->rle_offset   = g_new (guint32, channel->rows);
+
+        if (fread (reader->rle_pack_len, 2, channel->rows, f) < channel->rows)
+          {
+            psd_set_error (feof (f), errno, error);
+            return -1;
+          }
+
+        reader->comp_len = 0;
+        for (rowi = 0; rowi < channel->rows; ++rowi)
+          {
+            reader->rle_pack_len[rowi] = GUINT16_FROM_BE (reader->rle_pack_len[rowi]);
+            reader->rle_offset[rowi]   = reader->comp_len;
+            reader->comp_len          += reader->rle_pack_len[rowi];
+          }
+
+        reader->comp_data = g_malloc (reader->comp_len);
+        if (reader->comp_len > 0 &&
+            fread (reader->comp_data, reader->comp_len, 1, f) < 1)
+          {
+            psd_set_error (feof (f), errno, error);
+            return -1;
+          }
+        break;
+
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        reader->comp_len  = comp_len;
+        reader->comp_data = g_malloc (comp_len);
+        if (fread (reader->comp_data, comp_len, 1, f) < 1)
+          {
+            psd_set_error (feof (f), errno, error);
+            return -1;
+          }
+        break;
+
+      default:
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                    _("Unsupported compression mode: %d"), compression);
+        return -1;
+        break;
+    }
+
+  return 1;
+}
+
+static void
+free_channel_reader (PSDchannelreader *reader)
+{
+  if (reader->zs_init)
+    inflateEnd (&reader->zs);
+
+  g_free (reader->comp_data);
+  g_free (reader->rle_pack_len);
+  g_free (reader->rle_offset);
+  g_free (reader->raw_data);
+
+  if (reader->channel)
+    {
+      g_free (reader->channel->data);
+      reader->channel->data = NULL;
+    }
+}
+
+static void
+decode_channel_strip (PSDchannelreader *reader)
+{
+  PSDchannel *channel  = reader->channel;
+  gint        n_pixels = reader->n_rows * channel->columns;
+  gint        i, j;
+
+  if (reader->empty)
+    {
+      memset (channel->data, 0, n_pixels * MAX (reader->bps / 8, 1));
+      return;
+    }
+
+  switch (reader->compression)
+    {
+      case PSD_COMP_RAW:
+        /* Already read by decode_channel_strips() */
+        break;
+
+      case PSD_COMP_RLE:
+        for (i = 0; i < reader->n_rows; ++i)
+          {
+            gint rowi = reader->row + i;
+
+            /* FIXME check for errors returned from decode packbits */
+            decode_packbits (reader->comp_data + reader->rle_offset[rowi],
+                             reader->raw_data + i * reader->readline_len,
+                             reader->rle_pack_len[rowi],
+                             reader->readline_len);
+          }
+        break;
+
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        if (! reader->zs_init)
+          {
+            reader->zs.next_in  = (guchar*) reader->comp_data;
+            reader->zs.avail_in = reader->comp_len;
+            reader->zs.zalloc   = zzalloc;
+            reader->zs.zfree    = zzfree;
+            reader->zs.opaque   = Z_NULL;
+
+            if (inflateInit (&reader->zs) != Z_OK)
+              {
+                reader->failed = TRUE;
+                return;
+              }
+
+            reader->zs_init = TRUE;
+          }
+
+        reader->zs.next_out  = (guchar*) reader->raw_data;
+        reader->zs.avail_out = reader->n_rows * reader->readline_len;
+
+        while (reader->zs.avail_out > 0)
+          {
+            gint ret = inflate (&reader->zs, Z_NO_FLUSH);
+
+            if (ret == Z_STREAM_END)
+              {
+                memset (reader->zs.next_out, 0, reader->zs.avail_out);
+                break;
+              }
+            else if (ret != Z_OK)
+              {
+                reader->failed = TRUE;
+                return;
+              }
+          }
+        break;
+    }
+
+  /* Convert channel data to GIMP format */
+  switch (reader->bps)
+    {
+    case 32:
+      {
+        guint32 *src = (guint32*) reader->raw_data;
+        guint32 *dst = (guint32*) channel->data;
+
+        for (i = 0; i < n_pixels; ++i)
+          dst[i] = GUINT32_FROM_BE (src[i]);
+
+        if (reader->compression == PSD_COMP_ZIP_PRED)
+          {
+            for (i = 0; i < reader->n_rows; ++i)
+              for (j = 1; j < channel->columns; ++j)
+                dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
+          }
+        break;
+      }
+
+    case 16:
+      {
+        guint16 *src = (guint16*) reader->raw_data;
+        guint16 *dst = (guint16*) channel->data;
+
+        for (i = 0; i < n_pixels; ++i)
+          dst[i] = GUINT16_FROM_BE (src[i]);
+
+        if (reader->compression == PSD_COMP_ZIP_PRED)
+          {
+            for (i = 0; i < reader->n_rows; ++i)
+              for (j = 1; j < channel->columns; ++j)
+                dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
+          }
+        break;
+      }
+
+      case 8:
+        memcpy (channel->data, reader->raw_data, n_pixels);
+
+        if (reader->compression == PSD_COMP_ZIP_PRED)
+          {
+            for (i = 0; i < reader->n_rows; ++i)
+              for (j = 1; j < channel->columns; ++j)
+                channel->data[i * channel->columns + j] += channel->data[i * channel->columns + j - 1];
+          }
+        break;
+
+      case 1:
+        convert_1_bit (reader->raw_data, channel->data,
+                       reader->n_rows, channel->columns);
+        break;
+
+      default:
+        reader->failed = TRUE;
+        break;
+    }
+}
+
+static void
+decode_channel_strip_func (PSDchannelreader *reader,
+                           PSDdecoder       *decoder)
+{
+  decode_channel_strip (reader);
+
+  g_mutex_lock (&decoder->mutex);
+
+  if (--decoder->n_pending == 0)
+    g_cond_signal (&decoder->cond);
+
+  g_mutex_unlock (&decoder->mutex);
+}
+
+static void
+init_decoder (PSDdecoder *decoder)
+{
+  gint n_threads = MIN (g_get_num_processors (), MAX_CHANNELS) - 1;
+
+  /* The calling thread decodes one of the channels itself */
+  if (n_threads > 0)
+    decoder->pool = g_thread_pool_new ((GFunc) decode_channel_strip_func,
+                                       decoder, n_threads, FALSE, NULL);
+  else
+    decoder->pool = NULL;
+
+  decoder->n_pending = 0;
+
+  g_mutex_init (&decoder->mutex);
+  g_cond_init (&decoder->cond);
+}
+
+static void
+free_decoder (PSDdecoder *decoder)
+{
+  if (decoder->pool)
+    g_thread_pool_free (decoder->pool, FALSE, TRUE);
+
+  g_mutex_clear (&decoder->mutex);
+  g_cond_clear (&decoder->cond);
+}
+
+static gint
+decode_channel_strips (PSDdecoder        *decoder,
+                       PSDchannelreader **readers,
+                       gint               n_readers,
+                       gint               row,
+                       gint               n_rows,
+                       FILE              *f,
+                       GError           **error)
+{
+  gint i;
+
+  /* File access stays on this thread, only decoding is parallel */
+  for (i = 0; i < n_readers; ++i)
+    {
+      PSDchannelreader *reader  = readers[i];
+      PSDchannel       *channel = reader->channel;
+
+      if (! channel->data)
+        channel->data = g_malloc (reader->strip_rows * channel->columns *
+                                  MAX (reader->bps / 8, 1));
+
+      if (! reader->empty && ! reader->raw_data)
+        reader->raw_data = g_malloc (reader->strip_rows * reader->readline_len);
+
+      reader->row    = row;
+      reader->n_rows = n_rows;
+      reader->failed = FALSE;
+
+      if (! reader->empty && reader->compression == PSD_COMP_RAW)
+        {
+          if (fseek (f, reader->data_start + (glong) row * reader->readline_len,
+                     SEEK_SET) < 0 ||
+              fread (reader->raw_data, reader->readline_len, n_rows, f) < n_rows)
+            {
+              psd_set_error (feof (f), errno, error);
+              return -1;
+            }
+        }
+    }
+
+  if (decoder->pool && n_readers > 1)
+    {
+      decoder->n_pending = n_readers - 1;
+
+      for (i = 1; i < n_readers; ++i)
+        g_thread_pool_push (decoder->pool, readers[i], NULL);
+
+      decode_channel_strip (readers[0]);
+
+      g_mutex_lock (&decoder->mutex);
+
+      while (decoder->n_pending > 0)
+        g_cond_wait (&decoder->cond, &decoder->mutex);
+
+      g_mutex_unlock (&decoder->mutex);
+    }
+  else
+    {
+      for (i = 0; i < n_readers; ++i)
+        decode_channel_strip (readers[i]);
+    }
+
+  for (i = 0; i < n_readers; ++i)
+    {
+      if (readers[i]->failed)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Failed to decompress data"));
+          return -1;
+        }
+    }
+
+  return 1;
+}
+
 static void
 convert_1_bit (const gchar *src,
                gchar       *dst,
@@ -47,6 +47,8 @@ typedef struct
 } TiffIO;
 
 
+static void      tiff_io_log           (const gchar *fmt,
+                                        va_list      ap) G_GNUC_PRINTF (1, 0);
 static void      tiff_io_warning       (const gchar *module,
                                         const gchar *fmt,
                                         va_list      ap) G_GNUC_PRINTF (2, 0);
@@ -66,7 +68,7 @@ static gint      tiff_io_close         (thandle_t    handle);
 static toff_t    tiff_io_get_file_size (thandle_t    handle);
 
 
-static TiffIO tiff_io = { 0, };
+static GThread *tiff_io_main_thread = NULL;
 
 
 TIFF *
@@ -74,45 +76,88 @@ tiff_open (GFile        *file,
            const gchar  *mode,
            GError      **error)
 {
+  TiffIO *io;
+  TIFF   *tif;
+
+  if (! tiff_io_main_thread)
+    tiff_io_main_thread = g_thread_self ();
+
   TIFFSetWarningHandler (tiff_io_warning);
   TIFFSetErrorHandler (tiff_io_error);
 
-  tiff_io.file = file;
+  /*  each handle gets its own stream, so that the loader can read
+   *  a file on several threads at once
+   */
+  io = g_slice_new0 (TiffIO);
+
+  io->file = file;
 
   if (! strcmp (mode, "r"))
     {
-      tiff_io.input = G_INPUT_STREAM (g_file_read (file, NULL, error));
-      if (! tiff_io.input)
-        return NULL;
+      io->input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+      if (! io->input)
+        {
+          g_slice_free (TiffIO, io);
+          return NULL;
+        }
 
-      tiff_io.stream = G_OBJECT (tiff_io.input);
+      io->stream = G_OBJECT (io->input);
     }
   else
     {
-      tiff_io.output = G_OUTPUT_STREAM (g_file_replace (file,
-                                                        NULL, FALSE,
-                                                        G_FILE_CREATE_NONE,
-                                                        NULL, error));
-      if (! tiff_io.output)
-        return NULL;
-
-      tiff_io.stream = G_OBJECT (tiff_io.output);
+      io->output = G_OUTPUT_STREAM (g_file_replace (file,
+                                                    NULL, FALSE,
+                                                    G_FILE_CREATE_NONE,
+                                                    NULL, error));
+      if (! io->output)
+        {
+          g_slice_free (TiffIO, io);
+          return NULL;
+        }
+
+      io->stream = G_OBJECT (io->output);
     }
 
 #if 0
 #warning FIXME !can_seek code is broken
-  tiff_io.can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io.stream));
+  io->can_seek = g_seekable_can_seek (G_SEEKABLE (io->stream));
 #endif
-  tiff_io.can_seek = TRUE;
-
-  return TIFFClientOpen ("file-tiff", mode,
-                         (thandle_t) &tiff_io,
-                         tiff_io_read,
-                         tiff_io_write,
-                         tiff_io_seek,
-                         tiff_io_close,
-                         tiff_io_get_file_size,
-                         NULL, NULL);
+  io->can_seek = TRUE;
+
+  tif = TIFFClientOpen ("file-tiff", mode,
+                        (thandle_t) io,
+                        tiff_io_read,
+                        tiff_io_write,
+                        tiff_io_seek,
+                        tiff_io_close,
+                        tiff_io_get_file_size,
+                        NULL, NULL);
+
+  /*  TIFFClientOpen() doesn't close the handle when it fails  */
+  if (! tif)
+    tiff_io_close ((thandle_t) io);
+
+  return tif;
+}
+
+static void
+tiff_io_log (const gchar *fmt,
+             va_list      ap)
+{
+  /*  messages end up in a PDB call, which can only be made from the
+   *  thread that talks to the core; decoder threads use stderr
+   */
+  if (g_thread_self () == tiff_io_main_thread)
+    {
+      g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
+    }
+  else
+    {
+      gchar *msg = g_strdup_vprintf (fmt, ap);
+
+      g_printerr ("%s\n", msg);
+      g_free (msg);
+    }
 }
 
 static void
@@ -164,7 +209,7 @@ tiff_io_warning (const gchar *module,
       return;
     }
 
-  g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
+  tiff_io_log (fmt, ap);
 }
 
 static void
@@ -178,7 +223,7 @@ tiff_io_error (const gchar *module,
   if (! strcmp (fmt, "Compression algorithm does not support random access"))
     return;
 
-  g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
+  tiff_io_log (fmt, ap);
 }
 
 static tsize_t
@@ -411,16 +456,9 @@ tiff_io_close (thandle_t handle)
     }
 
   g_object_unref (io->stream);
-  io->stream = NULL;
-  io->input  = NULL;
-  io->output = NULL;
-
   g_free (io->buffer);
-  io->buffer = NULL;
 
-  io->allocated = 0;
-  io->used      = 0;
-  io->position  = 0;
+  g_slice_free (TiffIO, io);
 
   return closed ? 0 : -1;
 }
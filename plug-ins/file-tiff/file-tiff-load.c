@@ -52,6 +52,7 @@
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
+#include "file-tiff-io.h"
 #include "file-tiff-load.h"
 
 #include "libgimp/stdplugins-intl.h"
@@ -76,6 +77,63 @@ typedef struct
   guchar     *pixel;
 } ChannelData;
 
+typedef enum
+{
+  CHUNK_PENDING,
+  CHUNK_DONE,
+  CHUNK_FAILED
+} ChunkState;
+
+typedef struct
+{
+  guchar     *data;
+  ChunkState  state;
+} Chunk;
+
+typedef struct
+{
+  GMutex   mutex;
+  GCond    cond;
+
+  guint16  sample;
+  guint32  image_width;
+  guint32  chunk_width;
+  guint32  chunk_height;
+  gsize    chunk_size;
+  gint     n_across;
+
+  Chunk   *chunks;
+  gint     n_chunks;
+  gint     next;
+  gint     consumed;
+  gint     window;
+} ChunkReader;
+
+typedef struct
+{
+  ChunkReader *reader;
+  TIFF        *tif;
+  GThread     *thread;
+} ChunkWorker;
+
+typedef struct
+{
+  ChannelData *channel;
+  const Babl  *src_format;
+  gint         extra;
+  gint         offset;
+  gboolean     is_bw;
+  guchar      *bw_buffer;
+} ChunkData;
+
+typedef void (* ChunkFunc) (const guchar *data,
+                            guint32       x,
+                            guint32       y,
+                            guint32       cols,
+                            guint32       rows,
+                            guint32       chunk_width,
+                            gpointer      user_data);
+
 
 /* Declare some local functions */
 
@@ -83,14 +141,47 @@ static GimpColorProfile * load_profile     (TIFF         *tif);
 
 static void               load_rgba        (TIFF         *tif,
                                             ChannelData  *channel);
-static void               load_contiguous  (TIFF         *tif,
+static gboolean           get_chunk_size   (TIFF         *tif,
+                                            guint32      *chunk_width,
+                                            guint32      *chunk_height);
+static gboolean           read_chunk       (TIFF         *tif,
+                                            guchar       *data,
+                                            guint32       x,
+                                            guint32       y,
+                                            guint16       sample,
+                                            gboolean      whole);
+static gpointer           chunk_thread     (gpointer      data);
+static void               load_chunks      (GFile        *file,
+                                            TIFF         *tif,
+                                            guint16       sample,
+                                            gdouble       progress_start,
+                                            gdouble       progress_end,
+                                            ChunkFunc     func,
+                                            gpointer      user_data);
+static void               load_contiguous_chunk (const guchar *data,
+                                                 guint32       x,
+                                                 guint32       y,
+                                                 guint32       cols,
+                                                 guint32       rows,
+                                                 guint32       chunk_width,
+                                                 gpointer      user_data);
+static void               load_contiguous  (GFile        *file,
+                                            TIFF         *tif,
                                             ChannelData  *channel,
                                             const Babl   *type,
                                             gushort       bps,
                                             gushort       spp,
                                             gboolean      is_bw,
                                             gint          extra);
-static void               load_separate    (TIFF         *tif,
+static void               load_separate_chunk (const guchar *data,
+                                               guint32       x,
+                                               guint32       y,
+                                               guint32       cols,
+                                               guint32       rows,
+                                               guint32       chunk_width,
+                                               gpointer      user_data);
+static void               load_separate    (GFile        *file,
+                                            TIFF         *tif,
                                             ChannelData  *channel,
                                             const Babl   *type,
                                             gushort       bps,
@@ -972,11 +1063,11 @@ load_image (GFile              *file,
         }
       else if (planar == PLANARCONFIG_CONTIG)
         {
-          load_contiguous (tif, channel, type, bps, spp, is_bw, extra);
+          load_contiguous (file, tif, channel, type, bps, spp, is_bw, extra);
         }
       else
         {
-          load_separate (tif, channel, type, bps, spp, is_bw, extra);
+          load_separate (file, tif, channel, type, bps, spp, is_bw, extra);
         }
 
       if (TIFFGetField (tif, TIFFTAG_ORIENTATION, &orientation))
@@ -1361,197 +1452,372 @@ load_paths (TIFF *tif,
 }
 
 
-static void
-load_contiguous (TIFF        *tif,
-                 ChannelData *channel,
-                 const Babl  *type,
-                 gushort      bps,
-                 gushort      spp,
-                 gboolean     is_bw,
-                 gint         extra)
+/*  Returns TRUE if the image data is split into tiles or strips which
+ *  can be decoded independently of each other, FALSE if it has to be
+ *  read scanline by scanline.
+ */
+static gboolean
+get_chunk_size (TIFF    *tif,
+                guint32 *chunk_width,
+                guint32 *chunk_height)
 {
-  guint32     image_width;
-  guint32     image_height;
-  guint32     tile_width;
-  guint32     tile_height;
-  gint        bytes_per_pixel;
-  const Babl *src_format;
-  guchar     *buffer;
-  guchar     *bw_buffer = NULL;
-  gdouble     progress  = 0.0;
-  gdouble     one_row;
-  guint32     y;
-  gint        i;
-
-  g_printerr ("%s\n", __func__);
+  guint32 image_width;
+  guint32 image_height;
+  guint32 rows_per_strip;
 
   TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
   TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
 
-  tile_width = image_width;
-
   if (TIFFIsTiled (tif))
     {
-      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
-      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  chunk_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, chunk_height);
 
-      buffer = g_malloc (TIFFTileSize (tif));
+      return TRUE;
     }
-  else
+
+  *chunk_width = image_width;
+
+  TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+
+  /*  a single strip has nothing to decode in parallel, and may be far
+   *  too large to keep in memory at once
+   */
+  if (rows_per_strip > 0 && rows_per_strip < image_height)
     {
-      tile_width  = image_width;
-      tile_height = 1;
+      *chunk_height = rows_per_strip;
 
-      buffer = g_malloc (TIFFScanlineSize (tif));
+      return TRUE;
     }
 
-  if (is_bw)
-    bw_buffer = g_malloc (tile_width * tile_height);
+  *chunk_height = 1;
 
-  one_row = (gdouble) tile_height / (gdouble) image_height;
+  return FALSE;
+}
 
-  src_format = babl_format_n (type, spp);
+static gboolean
+read_chunk (TIFF     *tif,
+            guchar   *data,
+            guint32   x,
+            guint32   y,
+            guint16   sample,
+            gboolean  whole)
+{
+  if (TIFFIsTiled (tif))
+    {
+      return TIFFReadTile (tif, data, x, y, 0, sample) >= 0;
+    }
+  else if (whole)
+    {
+      return TIFFReadEncodedStrip (tif, TIFFComputeStrip (tif, y, sample),
+                                   data, (tsize_t) -1) >= 0;
+    }
+  else
+    {
+      return TIFFReadScanline (tif, data, y, sample) >= 0;
+    }
+}
 
-  /* consistency check */
-  bytes_per_pixel = 0;
-  for (i = 0; i <= extra; i++)
-    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+static gpointer
+chunk_thread (gpointer data)
+{
+  ChunkWorker *worker = data;
+  ChunkReader *reader = worker->reader;
 
-  g_printerr ("bytes_per_pixel: %d, format: %d\n",
-              bytes_per_pixel,
-              babl_format_get_bytes_per_pixel (src_format));
+  g_mutex_lock (&reader->mutex);
 
-  for (y = 0; y < image_height; y += tile_height)
+  while (TRUE)
     {
-      guint32 x;
+      guchar   *buffer;
+      gboolean  success = FALSE;
+      gint      index;
 
-      for (x = 0; x < image_width; x += tile_width)
+      /*  don't run too far ahead of the main thread  */
+      while (reader->next < reader->n_chunks &&
+             reader->next - reader->consumed >= reader->window)
         {
-          GeglBuffer *src_buf;
-          guint32     rows;
-          guint32     cols;
-          gint        offset;
+          g_cond_wait (&reader->cond, &reader->mutex);
+        }
 
-          gimp_progress_update (progress + one_row *
-                                ((gdouble) x / (gdouble) image_width));
+      if (reader->next >= reader->n_chunks)
+        break;
 
-          if (TIFFIsTiled (tif))
-            TIFFReadTile (tif, buffer, x, y, 0, 0);
-          else
-            TIFFReadScanline (tif, buffer, y, 0);
+      index = reader->next++;
 
-          cols = MIN (image_width  - x, tile_width);
-          rows = MIN (image_height - y, tile_height);
+      g_mutex_unlock (&reader->mutex);
 
-          if (is_bw)
-            convert_bit2byte (buffer, bw_buffer, cols, rows);
+      buffer = g_try_malloc (reader->chunk_size);
+
+      if (buffer)
+        success = read_chunk (worker->tif, buffer,
+                              (index % reader->n_across) * reader->chunk_width,
+                              (index / reader->n_across) * reader->chunk_height,
+                              reader->sample, TRUE);
+
+      g_mutex_lock (&reader->mutex);
+
+      reader->chunks[index].data  = buffer;
+      reader->chunks[index].state = success ? CHUNK_DONE : CHUNK_FAILED;
+
+      g_cond_broadcast (&reader->cond);
+    }
+
+  g_mutex_unlock (&reader->mutex);
+
+  return NULL;
+}
+
+/*  Reads all tiles or strips of one sample plane, in order, and passes
+ *  them to @func.  Independent chunks are decoded ahead of time by
+ *  worker threads, each with its own handle on the file, while the
+ *  main thread copies finished chunks into the image.
+ */
+static void
+load_chunks (GFile     *file,
+             TIFF      *tif,
+             guint16    sample,
+             gdouble    progress_start,
+             gdouble    progress_end,
+             ChunkFunc  func,
+             gpointer   user_data)
+{
+  ChunkReader  reader  = { 0, };
+  ChunkWorker *workers = NULL;
+  gint         n_workers = 0;
+  guint32      image_height;
+  guchar      *buffer;
+  gboolean     whole;
+  gint         n_down;
+  gint         i;
+
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &reader.image_width);
+  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
+
+  whole = get_chunk_size (tif, &reader.chunk_width, &reader.chunk_height);
+
+  if (TIFFIsTiled (tif))
+    reader.chunk_size = TIFFTileSize (tif);
+  else if (whole)
+    reader.chunk_size = TIFFStripSize (tif);
+  else
+    reader.chunk_size = TIFFScanlineSize (tif);
+
+  reader.sample   = sample;
+  reader.n_across = ((reader.image_width + reader.chunk_width - 1) /
+                     reader.chunk_width);
+  n_down          = ((image_height + reader.chunk_height - 1) /
+                     reader.chunk_height);
+  reader.n_chunks = reader.n_across * n_down;
+
+  if (whole)
+    {
+      gint n_threads = MIN (g_get_num_processors (), reader.n_chunks);
+
+      if (n_threads > 1)
+        {
+          g_mutex_init (&reader.mutex);
+          g_cond_init (&reader.cond);
 
-          src_buf = gegl_buffer_linear_new_from_data (is_bw ? bw_buffer : buffer,
-                                                      src_format,
-                                                      GEGL_RECTANGLE (0, 0, cols, rows),
-                                                      tile_width * bytes_per_pixel,
-                                                      NULL, NULL);
+          reader.chunks = g_new0 (Chunk, reader.n_chunks);
+          reader.window = 2 * n_threads;
 
-          offset = 0;
+          workers = g_new0 (ChunkWorker, n_threads);
 
-          for (i = 0; i <= extra; i++)
+          for (i = 0; i < n_threads; i++)
             {
-              GeglBufferIterator *iter;
-              gint                src_bpp;
-              gint                dest_bpp;
-
-              src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-              dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
-
-              iter = gegl_buffer_iterator_new (src_buf,
-                                               GEGL_RECTANGLE (0, 0, cols, rows),
-                                               0, NULL,
-                                               GEGL_ACCESS_READ,
-                                               GEGL_ABYSS_NONE);
-              gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                        GEGL_RECTANGLE (x, y, cols, rows),
-                                        0, channel[i].format,
-                                        GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
-              while (gegl_buffer_iterator_next (iter))
-                {
-                  guchar *s      = iter->data[0];
-                  guchar *d      = iter->data[1];
-                  gint    length = iter->length;
+              TIFF *worker_tif = tiff_open (file, "r", NULL);
 
-                  s += offset;
+              if (! worker_tif)
+                break;
 
-                  while (length--)
-                    {
-                      memcpy (d, s, dest_bpp);
-                      d += dest_bpp;
-                      s += src_bpp;
-                    }
+              if (! TIFFSetDirectory (worker_tif, TIFFCurrentDirectory (tif)))
+                {
+                  TIFFClose (worker_tif);
+                  break;
                 }
 
-              offset += dest_bpp;
+              workers[i].reader = &reader;
+              workers[i].tif    = worker_tif;
+              workers[i].thread = g_thread_new ("tiff-decode",
+                                                chunk_thread, &workers[i]);
+              n_workers++;
             }
+        }
+    }
+
+  buffer = g_malloc (reader.chunk_size);
+
+  for (i = 0; i < reader.n_chunks; i++)
+    {
+      const guchar *data  = NULL;
+      guchar       *chunk = NULL;
+      guint32       x     = (i % reader.n_across) * reader.chunk_width;
+      guint32       y     = (i / reader.n_across) * reader.chunk_height;
+
+      if (i % reader.n_across == 0)
+        gimp_progress_update (progress_start +
+                              (progress_end - progress_start) *
+                              (gdouble) y / (gdouble) image_height);
 
-          g_object_unref (src_buf);
+      if (n_workers > 0)
+        {
+          g_mutex_lock (&reader.mutex);
+
+          while (reader.chunks[i].state == CHUNK_PENDING)
+            g_cond_wait (&reader.cond, &reader.mutex);
+
+          chunk = reader.chunks[i].data;
+
+          if (reader.chunks[i].state == CHUNK_DONE)
+            data = chunk;
+
+          g_mutex_unlock (&reader.mutex);
         }
 
-      progress += one_row;
+      /*  a chunk the workers failed on is read again here, so that any
+       *  error gets reported the usual way
+       */
+      if (! data)
+        {
+          read_chunk (tif, buffer, x, y, sample, whole);
+          data = buffer;
+        }
+
+      func (data, x, y,
+            MIN (reader.image_width - x, reader.chunk_width),
+            MIN (image_height       - y, reader.chunk_height),
+            reader.chunk_width,
+            user_data);
+
+      if (n_workers > 0)
+        {
+          g_free (chunk);
+
+          g_mutex_lock (&reader.mutex);
+          reader.consumed++;
+          g_cond_broadcast (&reader.cond);
+          g_mutex_unlock (&reader.mutex);
+        }
+    }
+
+  for (i = 0; i < n_workers; i++)
+    {
+      g_thread_join (workers[i].thread);
+      TIFFClose (workers[i].tif);
+    }
+
+  if (workers)
+    {
+      g_free (workers);
+      g_free (reader.chunks);
+
+      g_cond_clear (&reader.cond);
+      g_mutex_clear (&reader.mutex);
     }
 
   g_free (buffer);
-  g_free (bw_buffer);
-}
 
+  gimp_progress_update (progress_end);
+}
 
 static void
-load_separate (TIFF        *tif,
-               ChannelData *channel,
-               const Babl  *type,
-               gushort      bps,
-               gushort      spp,
-               gboolean     is_bw,
-               gint         extra)
+load_contiguous_chunk (const guchar *data,
+                       guint32       x,
+                       guint32       y,
+                       guint32       cols,
+                       guint32       rows,
+                       guint32       chunk_width,
+                       gpointer      user_data)
 {
-  guint32     image_width;
-  guint32     image_height;
-  guint32     tile_width;
-  guint32     tile_height;
-  gint        bytes_per_pixel;
-  const Babl *src_format;
-  guchar     *buffer;
-  guchar     *bw_buffer = NULL;
-  gdouble     progress  = 0.0;
-  gdouble     one_row;
-  gint        i, compindex;
+  ChunkData  *chunk_data = user_data;
+  GeglBuffer *src_buf;
+  gint        src_bpp;
+  gint        offset;
+  gint        i;
 
-  g_printerr ("%s\n", __func__);
+  src_bpp = babl_format_get_bytes_per_pixel (chunk_data->src_format);
 
-  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
-  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
+  if (chunk_data->is_bw)
+    {
+      convert_bit2byte (data, chunk_data->bw_buffer, chunk_width, rows);
+      data = chunk_data->bw_buffer;
+    }
 
-  tile_width = image_width;
+  src_buf = gegl_buffer_linear_new_from_data ((gpointer) data,
+                                              chunk_data->src_format,
+                                              GEGL_RECTANGLE (0, 0, cols, rows),
+                                              chunk_width * src_bpp,
+                                              NULL, NULL);
 
-  if (TIFFIsTiled (tif))
-    {
-      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
-      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+  offset = 0;
 
-      buffer = g_malloc (TIFFTileSize (tif));
-    }
-  else
+  for (i = 0; i <= chunk_data->extra; i++)
     {
-      tile_width  = image_width;
-      tile_height = 1;
+      ChannelData        *channel = &chunk_data->channel[i];
+      GeglBufferIterator *iter;
+      gint                dest_bpp;
+
+      dest_bpp = babl_format_get_bytes_per_pixel (channel->format);
+
+      iter = gegl_buffer_iterator_new (src_buf,
+                                       GEGL_RECTANGLE (0, 0, cols, rows),
+                                       0, NULL,
+                                       GEGL_ACCESS_READ,
+                                       GEGL_ABYSS_NONE);
+      gegl_buffer_iterator_add (iter, channel->buffer,
+                                GEGL_RECTANGLE (x, y, cols, rows),
+                                0, channel->format,
+                                GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          guchar *s      = iter->data[0];
+          guchar *d      = iter->data[1];
+          gint    length = iter->length;
 
-      buffer = g_malloc (TIFFScanlineSize (tif));
+          s += offset;
+
+          while (length--)
+            {
+              memcpy (d, s, dest_bpp);
+              d += dest_bpp;
+              s += src_bpp;
+            }
+        }
+
+      offset += dest_bpp;
     }
 
-  if (is_bw)
-    bw_buffer = g_malloc (tile_width * tile_height);
+  g_object_unref (src_buf);
+}
+
+static void
+load_contiguous (GFile       *file,
+                 TIFF        *tif,
+                 ChannelData *channel,
+                 const Babl  *type,
+                 gushort      bps,
+                 gushort      spp,
+                 gboolean     is_bw,
+                 gint         extra)
+{
+  ChunkData chunk_data = { 0, };
+  guint32   chunk_width;
+  guint32   chunk_height;
+  gint      bytes_per_pixel;
+  gint      i;
 
-  one_row = (gdouble) tile_height / (gdouble) image_height;
+  g_printerr ("%s\n", __func__);
 
-  src_format = babl_format_n (type, 1);
+  get_chunk_size (tif, &chunk_width, &chunk_height);
+
+  chunk_data.channel    = channel;
+  chunk_data.src_format = babl_format_n (type, spp);
+  chunk_data.extra      = extra;
+  chunk_data.is_bw      = is_bw;
+
+  if (is_bw)
+    chunk_data.bw_buffer = g_malloc (chunk_width * chunk_height);
 
   /* consistency check */
   bytes_per_pixel = 0;
@@ -1560,99 +1826,140 @@ load_separate (TIFF        *tif,
 
   g_printerr ("bytes_per_pixel: %d, format: %d\n",
               bytes_per_pixel,
-              babl_format_get_bytes_per_pixel (src_format));
+              babl_format_get_bytes_per_pixel (chunk_data.src_format));
 
-  compindex = 0;
+  load_chunks (file, tif, 0, 0.0, 1.0,
+               load_contiguous_chunk, &chunk_data);
 
-  for (i = 0; i <= extra; i++)
+  g_free (chunk_data.bw_buffer);
+}
+
+static void
+load_separate_chunk (const guchar *data,
+                     guint32       x,
+                     guint32       y,
+                     guint32       cols,
+                     guint32       rows,
+                     guint32       chunk_width,
+                     gpointer      user_data)
+{
+  ChunkData          *chunk_data = user_data;
+  ChannelData        *channel    = chunk_data->channel;
+  GeglBuffer         *src_buf;
+  GeglBufferIterator *iter;
+  gint                src_bpp;
+  gint                dest_bpp;
+
+  src_bpp  = babl_format_get_bytes_per_pixel (chunk_data->src_format);
+  dest_bpp = babl_format_get_bytes_per_pixel (channel->format);
+
+  if (chunk_data->is_bw)
     {
-      gint n_comps;
-      gint src_bpp;
-      gint dest_bpp;
-      gint offset;
-      gint j;
+      convert_bit2byte (data, chunk_data->bw_buffer, chunk_width, rows);
+      data = chunk_data->bw_buffer;
+    }
 
-      n_comps  = babl_format_get_n_components (channel[i].format);
-      src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-      dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
+  src_buf = gegl_buffer_linear_new_from_data ((gpointer) data,
+                                              chunk_data->src_format,
+                                              GEGL_RECTANGLE (0, 0, cols, rows),
+                                              chunk_width * src_bpp,
+                                              NULL, NULL);
+
+  iter = gegl_buffer_iterator_new (src_buf,
+                                   GEGL_RECTANGLE (0, 0, cols, rows),
+                                   0, NULL,
+                                   GEGL_ACCESS_READ,
+                                   GEGL_ABYSS_NONE);
+  gegl_buffer_iterator_add (iter, channel->buffer,
+                            GEGL_RECTANGLE (x, y, cols, rows),
+                            0, channel->format,
+                            GEGL_ACCESS_READWRITE,
+                            GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      guchar *s      = iter->data[0];
+      guchar *d      = iter->data[1];
+      gint    length = iter->length;
 
-      offset = 0;
+      d += chunk_data->offset;
 
-      for (j = 0; j < n_comps; j++)
+      while (length--)
         {
-          guint32 y;
+          memcpy (d, s, src_bpp);
+          d += dest_bpp;
+          s += src_bpp;
+        }
+    }
 
-          for (y = 0; y < image_height; y += tile_height)
-            {
-              guint32 x;
+  g_object_unref (src_buf);
+}
 
-              for (x = 0; x < image_width; x += tile_width)
-                {
-                  GeglBuffer         *src_buf;
-                  GeglBufferIterator *iter;
-                  guint32             rows;
-                  guint32             cols;
+static void
+load_separate (GFile       *file,
+               TIFF        *tif,
+               ChannelData *channel,
+               const Babl  *type,
+               gushort      bps,
+               gushort      spp,
+               gboolean     is_bw,
+               gint         extra)
+{
+  ChunkData chunk_data = { 0, };
+  guint32   chunk_width;
+  guint32   chunk_height;
+  gint      bytes_per_pixel;
+  gint      n_samples;
+  gint      i, compindex;
 
-                  gimp_progress_update (progress + one_row *
-                                        ((gdouble) x / (gdouble) image_width));
+  g_printerr ("%s\n", __func__);
 
-                  if (TIFFIsTiled (tif))
-                    TIFFReadTile (tif, buffer, x, y, 0, compindex);
-                  else
-                    TIFFReadScanline (tif, buffer, y, compindex);
-
-                  cols = MIN (image_width  - x, tile_width);
-                  rows = MIN (image_height - y, tile_height);
-
-                  if (is_bw)
-                    convert_bit2byte (buffer, bw_buffer, cols, rows);
-
-                  src_buf = gegl_buffer_linear_new_from_data (is_bw ? bw_buffer : buffer,
-                                                              src_format,
-                                                              GEGL_RECTANGLE (0, 0, cols, rows),
-                                                              GEGL_AUTO_ROWSTRIDE,
-                                                              NULL, NULL);
-
-                  iter = gegl_buffer_iterator_new (src_buf,
-                                                   GEGL_RECTANGLE (0, 0, cols, rows),
-                                                   0, NULL,
-                                                   GEGL_ACCESS_READ,
-                                                   GEGL_ABYSS_NONE);
-                  gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                            GEGL_RECTANGLE (x, y, cols, rows),
-                                            0, channel[i].format,
-                                            GEGL_ACCESS_READWRITE,
-                                            GEGL_ABYSS_NONE);
-
-                  while (gegl_buffer_iterator_next (iter))
-                    {
-                      guchar *s      = iter->data[0];
-                      guchar *d      = iter->data[1];
-                      gint    length = iter->length;
+  get_chunk_size (tif, &chunk_width, &chunk_height);
 
-                      d += offset;
+  chunk_data.src_format = babl_format_n (type, 1);
+  chunk_data.is_bw      = is_bw;
 
-                      while (length--)
-                        {
-                          memcpy (d, s, src_bpp);
-                          d += dest_bpp;
-                          s += src_bpp;
-                        }
-                    }
+  if (is_bw)
+    chunk_data.bw_buffer = g_malloc (chunk_width * chunk_height);
 
-                  g_object_unref (src_buf);
-                }
-            }
+  /* consistency check */
+  bytes_per_pixel = 0;
+  n_samples       = 0;
+  for (i = 0; i <= extra; i++)
+    {
+      bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+      n_samples       += babl_format_get_n_components (channel[i].format);
+    }
+
+  g_printerr ("bytes_per_pixel: %d, format: %d\n",
+              bytes_per_pixel,
+              babl_format_get_bytes_per_pixel (chunk_data.src_format));
+
+  compindex = 0;
 
-          offset += src_bpp;
+  for (i = 0; i <= extra; i++)
+    {
+      gint n_comps;
+      gint j;
+
+      n_comps = babl_format_get_n_components (channel[i].format);
+
+      chunk_data.channel = &channel[i];
+      chunk_data.offset  = 0;
+
+      for (j = 0; j < n_comps; j++)
+        {
+          load_chunks (file, tif, compindex,
+                       (gdouble) compindex       / (gdouble) n_samples,
+                       (gdouble) (compindex + 1) / (gdouble) n_samples,
+                       load_separate_chunk, &chunk_data);
+
+          chunk_data.offset += babl_format_get_bytes_per_pixel (chunk_data.src_format);
           compindex++;
         }
-
-      progress += one_row;
     }
 
-  g_free (buffer);
-  g_free (bw_buffer);
+  g_free (chunk_data.bw_buffer);
 }
 
 
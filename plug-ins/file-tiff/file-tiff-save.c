@@ -48,6 +48,7 @@
 #include <string.h>
 
 #include <tiffio.h>
+#include <zlib.h>
 
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
@@ -60,6 +61,30 @@
 
 #define PLUG_IN_ROLE "gimp-file-tiff-save"
 
+#define TILE_SIZE    256
+
+
+typedef struct
+{
+  guchar   *data;
+  guchar   *compressed;
+  uLongf    compressed_size;
+  gboolean  success;
+} TileData;
+
+typedef struct
+{
+  GMutex  mutex;
+  GCond   cond;
+  gint    n_pending;
+
+  gsize   tile_size;
+  gsize   tile_rowsize;
+  gint    predictor;
+  gint    bitspersample;
+  gint    samplesperpixel;
+} TileWriter;
+
 
 static gboolean  save_paths             (TIFF          *tif,
                                          gint32         image);
@@ -72,6 +97,25 @@ static void      byte2bit               (const guchar  *byteline,
                                          guchar        *bitline,
                                          gboolean       invert);
 
+static void      predict_tile           (guchar        *data,
+                                         gsize          rowsize,
+                                         gint           n_rows,
+                                         gint           bitspersample,
+                                         gint           samplesperpixel);
+static void      compress_tile          (TileData      *tile,
+                                         TileWriter    *writer);
+static void      compress_tile_func     (gpointer       data,
+                                         gpointer       user_data);
+static gboolean  save_tiles             (TIFF          *tif,
+                                         GeglBuffer    *buffer,
+                                         const Babl    *format,
+                                         gboolean       is_bw,
+                                         gboolean       invert,
+                                         gushort        compression,
+                                         gshort         predictor,
+                                         gshort         bitspersample,
+                                         gshort         samplesperpixel);
+
 
 static void
 double_to_psd_fixed (gdouble  value,
@@ -677,8 +721,16 @@ save_image (GFile        *file,
   TIFFSetField (tif, TIFFTAG_PHOTOMETRIC, photometric);
   TIFFSetField (tif, TIFFTAG_DOCUMENTNAME, g_file_get_path (file));
   TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);
-  TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
-  /* TIFFSetField( tif, TIFFTAG_STRIPBYTECOUNTS, rows / rowsperstrip ); */
+  if (tsvals->save_tiled)
+    {
+      TIFFSetField (tif, TIFFTAG_TILEWIDTH,  TILE_SIZE);
+      TIFFSetField (tif, TIFFTAG_TILELENGTH, TILE_SIZE);
+    }
+  else
+    {
+      TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+      /* TIFFSetField( tif, TIFFTAG_STRIPBYTECOUNTS, rows / rowsperstrip ); */
+    }
   TIFFSetField (tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
 
   /* resolution fields */
@@ -773,60 +825,70 @@ save_image (GFile        *file,
   if (!is_bw && drawable_type == GIMP_INDEXED_IMAGE)
     TIFFSetField (tif, TIFFTAG_COLORMAP, red, grn, blu);
 
-  /* array to rearrange data */
-  src  = g_new (guchar, bytesperrow * tile_height);
-  data = g_new (guchar, bytesperrow);
-
-  /* Now write the TIFF data. */
-  for (y = 0; y < rows; y = yend)
+  if (tsvals->save_tiled)
     {
-      yend = y + tile_height;
-      yend = MIN (yend, rows);
-
-      gegl_buffer_get (buffer,
-                       GEGL_RECTANGLE (0, y, cols, yend - y), 1.0,
-                       format, src,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      if (! save_tiles (tif, buffer, format, is_bw, invert,
+                        compression, predictor,
+                        bitspersample, samplesperpixel))
+        goto out;
+    }
+  else
+    {
+      /* array to rearrange data */
+      src  = g_new (guchar, bytesperrow * tile_height);
+      data = g_new (guchar, bytesperrow);
 
-      for (row = y; row < yend; row++)
+      /* Now write the TIFF data. */
+      for (y = 0; y < rows; y = yend)
         {
-          guchar *t = src + bytesperrow * (row - y);
+          yend = y + tile_height;
+          yend = MIN (yend, rows);
+
+          gegl_buffer_get (buffer,
+                           GEGL_RECTANGLE (0, y, cols, yend - y), 1.0,
+                           format, src,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-          switch (drawable_type)
+          for (row = y; row < yend; row++)
             {
-            case GIMP_INDEXED_IMAGE:
-              if (is_bw)
-                {
-                  byte2bit (t, bytesperrow, data, invert);
-                  success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
-                }
-              else
+              guchar *t = src + bytesperrow * (row - y);
+
+              switch (drawable_type)
                 {
+                case GIMP_INDEXED_IMAGE:
+                  if (is_bw)
+                    {
+                      byte2bit (t, bytesperrow, data, invert);
+                      success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
+                    }
+                  else
+                    {
+                      success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
+                    }
+                  break;
+
+                case GIMP_GRAY_IMAGE:
+                case GIMP_GRAYA_IMAGE:
+                case GIMP_RGB_IMAGE:
+                case GIMP_RGBA_IMAGE:
                   success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-                }
-              break;
+                  break;
 
-            case GIMP_GRAY_IMAGE:
-            case GIMP_GRAYA_IMAGE:
-            case GIMP_RGB_IMAGE:
-            case GIMP_RGBA_IMAGE:
-              success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-              break;
+                default:
+                  success = FALSE;
+                  break;
+                }
 
-            default:
-              success = FALSE;
-              break;
+              if (!success)
+                {
+                  g_message (_("Failed a scanline write on row %d"), row);
+                  goto out;
+                }
             }
 
-          if (!success)
-            {
-              g_message (_("Failed a scanline write on row %d"), row);
-              goto out;
-            }
+          if ((row % 32) == 0)
+            gimp_progress_update ((gdouble) row / (gdouble) rows);
         }
-
-      if ((row % 32) == 0)
-        gimp_progress_update ((gdouble) row / (gdouble) rows);
     }
 
   TIFFWriteDirectory (tif);
@@ -1051,6 +1113,13 @@ save_dialog (TiffSaveVals  *tsvals,
                     G_CALLBACK (gimp_toggle_button_update),
                     &tsvals->save_thumbnail);
 
+  toggle = GTK_WIDGET (gtk_builder_get_object (builder, "sv_tiled"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle),
+                                tsvals->save_tiled);
+  g_signal_connect (toggle, "toggled",
+                    G_CALLBACK (gimp_toggle_button_update),
+                    &tsvals->save_tiled);
+
   gtk_widget_show (dialog);
 
   run = (gimp_dialog_run (GIMP_DIALOG (dialog)) == GTK_RESPONSE_OK);
@@ -1111,3 +1180,254 @@ byte2bit (const guchar *byteline,
       *bitline = invert ? ~bitval & (0xff << (8 - width)) : bitval;
     }
 }
+
+/* Horizontal differencing, as done by libtiff for TIFFTAG_PREDICTOR 2 */
+static void
+predict_tile (guchar *data,
+              gsize   rowsize,
+              gint    n_rows,
+              gint    bitspersample,
+              gint    samplesperpixel)
+{
+  gint y;
+
+  for (y = 0; y < n_rows; y++, data += rowsize)
+    {
+      gint n = rowsize / (bitspersample / 8);
+      gint i;
+
+      switch (bitspersample)
+        {
+        case 8:
+          {
+            guint8 *p = (guint8 *) data;
+
+            for (i = n - 1; i >= samplesperpixel; i--)
+              p[i] -= p[i - samplesperpixel];
+          }
+          break;
+
+        case 16:
+          {
+            guint16 *p = (guint16 *) data;
+
+            for (i = n - 1; i >= samplesperpixel; i--)
+              p[i] -= p[i - samplesperpixel];
+          }
+          break;
+
+        case 32:
+          {
+            guint32 *p = (guint32 *) data;
+
+            for (i = n - 1; i >= samplesperpixel; i--)
+              p[i] -= p[i - samplesperpixel];
+          }
+          break;
+
+        case 64:
+          {
+            guint64 *p = (guint64 *) data;
+
+            for (i = n - 1; i >= samplesperpixel; i--)
+              p[i] -= p[i - samplesperpixel];
+          }
+          break;
+        }
+    }
+}
+
+static void
+compress_tile (TileData   *tile,
+               TileWriter *writer)
+{
+  if (writer->predictor == 2)
+    predict_tile (tile->data, writer->tile_rowsize,
+                  writer->tile_size / writer->tile_rowsize,
+                  writer->bitspersample, writer->samplesperpixel);
+
+  tile->compressed_size = compressBound (writer->tile_size);
+
+  tile->success = (compress2 (tile->compressed, &tile->compressed_size,
+                              tile->data, writer->tile_size,
+                              Z_DEFAULT_COMPRESSION) == Z_OK);
+}
+
+static void
+compress_tile_func (gpointer data,
+                    gpointer user_data)
+{
+  TileWriter *writer = user_data;
+
+  compress_tile (data, writer);
+
+  g_mutex_lock (&writer->mutex);
+
+  if (--writer->n_pending == 0)
+    g_cond_signal (&writer->cond);
+
+  g_mutex_unlock (&writer->mutex);
+}
+
+/* Writes the image as tiles of TILE_SIZE x TILE_SIZE pixels.  Deflate
+ * compressed tiles don't depend on each other, so a whole row of them
+ * is compressed at once on all processors and then written out raw;
+ * other codecs are left to libtiff.
+ */
+static gboolean
+save_tiles (TIFF       *tif,
+            GeglBuffer *buffer,
+            const Babl *format,
+            gboolean    is_bw,
+            gboolean    invert,
+            gushort     compression,
+            gshort      predictor,
+            gshort      bitspersample,
+            gshort      samplesperpixel)
+{
+  TileWriter   writer = { 0, };
+  GThreadPool *pool   = NULL;
+  TileData    *tiles;
+  guchar      *src;
+  gint         cols;
+  gint         rows;
+  gint         bpp;
+  gint         n_across;
+  gint         x, y, i;
+  gboolean     deflate;
+  gboolean     success = TRUE;
+
+  cols = gegl_buffer_get_width (buffer);
+  rows = gegl_buffer_get_height (buffer);
+  bpp  = babl_format_get_bytes_per_pixel (format);
+
+  n_across = (cols + TILE_SIZE - 1) / TILE_SIZE;
+
+  deflate = (compression == COMPRESSION_ADOBE_DEFLATE);
+
+  writer.tile_size       = TIFFTileSize (tif);
+  writer.tile_rowsize    = TIFFTileRowSize (tif);
+  writer.predictor       = predictor;
+  writer.bitspersample   = bitspersample;
+  writer.samplesperpixel = samplesperpixel;
+
+  tiles = g_new0 (TileData, n_across);
+
+  for (i = 0; i < n_across; i++)
+    {
+      tiles[i].data = g_malloc (writer.tile_size);
+
+      if (deflate)
+        tiles[i].compressed = g_malloc (compressBound (writer.tile_size));
+    }
+
+  if (deflate)
+    {
+      gint n_threads = MIN (g_get_num_processors (), n_across);
+
+      g_mutex_init (&writer.mutex);
+      g_cond_init (&writer.cond);
+
+      if (n_threads > 1)
+        pool = g_thread_pool_new (compress_tile_func, &writer,
+                                  n_threads, TRUE, NULL);
+    }
+
+  src = g_new (guchar, (gsize) cols * bpp * TILE_SIZE);
+
+  for (y = 0; y < rows && success; y += TILE_SIZE)
+    {
+      gint height = MIN (TILE_SIZE, rows - y);
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (0, y, cols, height), 1.0,
+                       format, src,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (i = 0, x = 0; i < n_across; i++, x += TILE_SIZE)
+        {
+          gint width = MIN (TILE_SIZE, cols - x);
+          gint row;
+
+          /* edge tiles are padded with zeros */
+          memset (tiles[i].data, 0, writer.tile_size);
+
+          for (row = 0; row < height; row++)
+            {
+              const guchar *s = src + ((gsize) row * cols + x) * bpp;
+              guchar       *d = tiles[i].data + row * writer.tile_rowsize;
+
+              if (is_bw)
+                byte2bit (s, width, d, invert);
+              else
+                memcpy (d, s, width * bpp);
+            }
+        }
+
+      if (deflate)
+        {
+          if (pool)
+            {
+              writer.n_pending = n_across;
+
+              for (i = 0; i < n_across; i++)
+                g_thread_pool_push (pool, &tiles[i], NULL);
+
+              g_mutex_lock (&writer.mutex);
+
+              while (writer.n_pending > 0)
+                g_cond_wait (&writer.cond, &writer.mutex);
+
+              g_mutex_unlock (&writer.mutex);
+            }
+          else
+            {
+              for (i = 0; i < n_across; i++)
+                compress_tile (&tiles[i], &writer);
+            }
+        }
+
+      for (i = 0, x = 0; i < n_across; i++, x += TILE_SIZE)
+        {
+          ttile_t tile = TIFFComputeTile (tif, x, y, 0, 0);
+
+          if (deflate)
+            success = (tiles[i].success &&
+                       TIFFWriteRawTile (tif, tile,
+                                         tiles[i].compressed,
+                                         tiles[i].compressed_size) >= 0);
+          else
+            success = (TIFFWriteEncodedTile (tif, tile,
+                                             tiles[i].data,
+                                             writer.tile_size) >= 0);
+
+          if (! success)
+            {
+              g_message (_("Failed a tile write on row %d"), y);
+              break;
+            }
+        }
+
+      gimp_progress_update ((gdouble) (y + height) / (gdouble) rows);
+    }
+
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (deflate)
+    {
+      g_cond_clear (&writer.cond);
+      g_mutex_clear (&writer.mutex);
+    }
+
+  for (i = 0; i < n_across; i++)
+    {
+      g_free (tiles[i].data);
+      g_free (tiles[i].compressed);
+    }
+
+  g_free (tiles);
+  g_free (src);
+
+  return success;
+}
@@ -89,7 +89,8 @@ static TiffSaveVals tsvals =
   TRUE,                /*  save exif           */
   TRUE,                /*  save xmp            */
   TRUE,                /*  save iptc           */
-  TRUE                 /*  save thumbnail      */
+  TRUE,                /*  save thumbnail      */
+  FALSE                /*  save tiled          */
 };
 
 static gchar *image_comment = NULL;
@@ -128,7 +129,8 @@ query (void)
   static const GimpParamDef save_args[] =
   {
     COMMON_SAVE_ARGS,
-    { GIMP_PDB_INT32, "save-transp-pixels", "Keep the color data masked by an alpha channel intact" }
+    { GIMP_PDB_INT32, "save-transp-pixels", "Keep the color data masked by an alpha channel intact" },
+    { GIMP_PDB_INT32, "save-tiled",         "Store the image in tiles, which are compressed in parallel" }
   };
 
   gimp_install_procedure (LOAD_PROC,
@@ -409,7 +411,7 @@ run (const gchar      *name,
 
         case GIMP_RUN_NONINTERACTIVE:
           /*  Make sure all the arguments are there!  */
-          if (nparams == 6 || nparams == 7)
+          if (nparams >= 6 && nparams <= 8)
             {
               switch (param[5].data.d_int32)
                 {
@@ -423,10 +425,15 @@ run (const gchar      *name,
                 default: status = GIMP_PDB_CALLING_ERROR; break;
                 }
 
-              if (nparams == 7)
+              if (nparams >= 7)
                 tsvals.save_transp_pixels = param[6].data.d_int32;
               else
                 tsvals.save_transp_pixels = TRUE;
+
+              if (nparams == 8)
+                tsvals.save_tiled = param[7].data.d_int32;
+              else
+                tsvals.save_tiled = FALSE;
             }
           else
             {